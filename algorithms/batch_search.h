@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Many binary searches against one sorted array.
+//
+// A single search is a chain of dependent cache misses. Here a group of
+// queries advances in lock-step: every query takes one step and prefetches
+// the element it will probe next, so by the time the group comes back
+// around the loads have arrived and the misses of the whole group overlap.
+// All queries in a group probe at the same offsets from their own base
+// because the remaining length depends only on the array size.
+namespace perf {
+
+namespace detail {
+
+    constexpr size_t batch_group = 32;
+
+    // GoRight(element, query) moves the search past `element`
+    template <typename T, typename GoRight>
+    void batch_search(const T* sorted, size_t n, const T* queries, size_t count, size_t* out, GoRight go_right)
+    {
+        if (n == 0) {
+            std::fill_n(out, count, 0);
+            return;
+        }
+
+        const T* base[batch_group];
+        for (size_t first = 0; first < count; first += batch_group) {
+            size_t group = std::min(batch_group, count - first);
+            const T* q = queries + first;
+
+            std::fill_n(base, group, sorted);
+            size_t len = n;
+            while (len > 1) {
+                size_t half = len / 2;
+                size_t next = (len - half) / 2;
+                for (size_t j = 0; j < group; ++j) {
+                    base[j] += half * go_right(base[j][half - 1], q[j]);
+                    __builtin_prefetch(base[j] + (next ? next - 1 : 0));
+                }
+                len -= half;
+            }
+            for (size_t j = 0; j < group; ++j) {
+                out[first + j] = (base[j] - sorted) + go_right(*base[j], q[j]);
+            }
+        }
+    }
+
+} // namespace detail
+
+// out[i] = std::lower_bound(sorted, sorted + n, queries[i], comp) - sorted
+template <typename T, typename Compare = std::less<>>
+void batch_lower_bound(const T* sorted, size_t n, const T* queries, size_t count, size_t* out, Compare comp = Compare())
+{
+    detail::batch_search(sorted, n, queries, count, out,
+        [&](const T& element, const T& query) { return comp(element, query); });
+}
+
+// out[i] = std::upper_bound(sorted, sorted + n, queries[i], comp) - sorted
+template <typename T, typename Compare = std::less<>>
+void batch_upper_bound(const T* sorted, size_t n, const T* queries, size_t count, size_t* out, Compare comp = Compare())
+{
+    detail::batch_search(sorted, n, queries, count, out,
+        [&](const T& element, const T& query) { return !comp(query, element); });
+}
+
+template <typename T, typename Compare = std::less<>>
+std::vector<size_t> batch_lower_bound(const std::vector<T>& sorted, const std::vector<T>& queries, Compare comp = Compare())
+{
+    std::vector<size_t> result(queries.size());
+    batch_lower_bound(sorted.data(), sorted.size(), queries.data(), queries.size(), result.data(), comp);
+    return result;
+}
+
+template <typename T, typename Compare = std::less<>>
+std::vector<size_t> batch_upper_bound(const std::vector<T>& sorted, const std::vector<T>& queries, Compare comp = Compare())
+{
+    std::vector<size_t> result(queries.size());
+    batch_upper_bound(sorted.data(), sorted.size(), queries.data(), queries.size(), result.data(), comp);
+    return result;
+}
+
+} // namespace perf
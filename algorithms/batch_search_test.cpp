@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include "batch_search.h"
+#include "benchmark.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+} // namespace
+
+TEST(BatchSearch, LowerBound)
+{
+    std::vector<int> v{ 1, 1, 2, 3, 3, 3 };
+
+    auto result = perf::batch_lower_bound(v, std::vector<int>{ 0, 1, 2, 3, 4 });
+
+    ASSERT_EQ((std::vector<size_t>{ 0, 0, 2, 3, 6 }), result);
+}
+
+TEST(BatchSearch, UpperBound)
+{
+    std::vector<int> v{ 1, 1, 2, 3, 3, 3 };
+
+    auto result = perf::batch_upper_bound(v, std::vector<int>{ 0, 1, 2, 3, 4 });
+
+    ASSERT_EQ((std::vector<size_t>{ 0, 2, 3, 6, 6 }), result);
+}
+
+TEST(BatchSearch, MatchesStdForEverySize)
+{
+    for (size_t n = 0; n < 100; ++n) {
+        auto v = random_ints(n, 0, 50, static_cast<unsigned>(n));
+        std::sort(begin(v), end(v));
+        auto queries = random_ints(77, 0, 52, 1);
+
+        auto lower = perf::batch_lower_bound(v, queries);
+        auto upper = perf::batch_upper_bound(v, queries);
+
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT_EQ(std::lower_bound(begin(v), end(v), queries[i]) - begin(v), static_cast<long>(lower[i]));
+            ASSERT_EQ(std::upper_bound(begin(v), end(v), queries[i]) - begin(v), static_cast<long>(upper[i]));
+        }
+    }
+}
+
+TEST(BatchSearch, CustomComparator)
+{
+    std::vector<int> v{ 9, 7, 7, 3, 1 };
+
+    auto result = perf::batch_lower_bound(v, std::vector<int>{ 10, 7, 2, 0 }, std::greater<>());
+
+    ASSERT_EQ((std::vector<size_t>{ 0, 1, 4, 5 }), result);
+}
+
+TEST(BatchSearchBenchmark, DISABLED_LowerBoundBatch)
+{
+    const size_t queries = 1 << 21;
+    auto q = random_ints(queries, 0, 1 << 30, 2);
+    for (size_t n = 1 << 12; n <= bench::size(1 << 26); n <<= 2) {
+        auto v = random_ints(n, 0, 1 << 30, 3);
+        std::sort(begin(v), end(v));
+        std::vector<size_t> out(queries);
+
+        auto std_time = bench::best_of(3, [&] {
+            for (size_t i = 0; i < queries; ++i) {
+                out[i] = std::lower_bound(begin(v), end(v), q[i]) - begin(v);
+            }
+            bench::keep(out);
+        });
+        auto batch_time = bench::best_of(3, [&] {
+            perf::batch_lower_bound(v.data(), n, q.data(), queries, out.data());
+            bench::keep(out);
+        });
+        std::printf("n = %10zu  std::lower_bound %7.1f ns  batch %7.1f ns\n", n,
+            std_time / queries * 1e9, batch_time / queries * 1e9);
+    }
+}
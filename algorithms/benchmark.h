@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+// Helpers for the *Benchmark test cases. They are disabled by default,
+// run them with `make bench`.
+namespace bench {
+
+// Problem size, can be overridden with the BENCH_N environment variable
+inline size_t size(size_t fallback)
+{
+    const char* env = std::getenv("BENCH_N");
+    return env ? std::strtoull(env, nullptr, 10) : fallback;
+}
+
+// Keeps the compiler from optimizing away a computed value
+template <typename T>
+void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Wall-clock seconds of the fastest of `repeats` calls to f
+template <typename F>
+double best_of(int repeats, F f)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        best = std::min(best, took.count());
+    }
+    return best;
+}
+
+// Prints one result line; `bytes` is the memory traffic of one call
+inline void report(const char* name, double seconds, double bytes)
+{
+    std::printf("%-40s %10.3f ms %8.2f GB/s\n", name, seconds * 1e3, bytes / seconds / 1e9);
+}
+
+} // namespace bench
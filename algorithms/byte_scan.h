@@ -0,0 +1,509 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Scanning text for classes of bytes, a locale-free replacement for
+// std::any_of with std::isupper and friends.
+//
+// A byte class is a matcher: byte_equal, byte_range or any set of bytes as
+// a byte_set. The kernels compare 64 bytes per step into a bitmask and
+// stop at the first step that decides the answer. Bytes are unsigned, so
+// text with bytes above 127 is fine; the ascii classes simply don't
+// contain them.
+namespace perf {
+
+// A matcher answers for one byte, and for 16 or 32 bytes at once as an
+// all-ones/all-zeroes lane mask. Matchers without an SSE2 form are
+// scanned a byte at a time unless AVX2 is available.
+
+struct byte_equal {
+    explicit byte_equal(unsigned char c)
+        : c(c)
+    {
+    }
+
+    static constexpr bool has_sse2 = true;
+
+    bool scalar(unsigned char x) const { return x == c; }
+#if PERF_X86
+    __m128i sse2(__m128i x) const { return _mm_cmpeq_epi8(x, _mm_set1_epi8(static_cast<char>(c))); }
+    PERF_AVX2 __m256i avx2(__m256i x) const { return _mm256_cmpeq_epi8(x, _mm256_set1_epi8(static_cast<char>(c))); }
+#endif
+
+    unsigned char c;
+};
+
+// lo <= x <= hi, as x - lo <= hi - lo in unsigned bytes
+struct byte_range {
+    byte_range(unsigned char lo, unsigned char hi)
+        : lo(lo)
+        , span(static_cast<unsigned char>(hi - lo))
+    {
+    }
+
+    static constexpr bool has_sse2 = true;
+
+    bool scalar(unsigned char x) const { return static_cast<unsigned char>(x - lo) <= span; }
+#if PERF_X86
+    __m128i sse2(__m128i x) const
+    {
+        __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(static_cast<char>(lo)));
+        return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(static_cast<char>(span))), d);
+    }
+    PERF_AVX2 __m256i avx2(__m256i x) const
+    {
+        __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(static_cast<char>(lo)));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(static_cast<char>(span))), d);
+    }
+#endif
+
+    unsigned char lo;
+    unsigned char span;
+};
+
+// Any set of bytes.
+//
+// Scalar code looks bytes up in a 256-entry table. For SIMD the set is
+// also stored as two 16-byte tables indexed by the low nibble: entry l of
+// half h has bit k set when byte 128 * h + 16 * k + l is in the set. With
+// AVX2 two byte shuffles look up the entries of 32 bytes at once, the
+// top bit of each byte picks the half and a third shuffle turns bits 4-6
+// into the bit to test.
+//
+// SSE2 has no byte shuffle, so there the set is tested as its runs of
+// consecutive bytes, one byte_range compare per run. The ascii classes
+// have at most four runs; sets of more than max_sse2_runs are looked up
+// in the table 16 bytes at a time.
+class byte_set {
+public:
+    byte_set() = default;
+
+    // The bytes of `members`
+    explicit byte_set(const char* members)
+    {
+        for (; *members; ++members) {
+            insert(static_cast<unsigned char>(*members));
+        }
+        find_runs();
+    }
+
+    byte_set& add(unsigned char c)
+    {
+        insert(c);
+        find_runs();
+        return *this;
+    }
+
+    byte_set& add_range(unsigned char lo, unsigned char hi)
+    {
+        for (unsigned c = lo; c <= hi; ++c) {
+            insert(static_cast<unsigned char>(c));
+        }
+        find_runs();
+        return *this;
+    }
+
+    byte_set& add(const byte_set& other)
+    {
+        for (unsigned c = 0; c < 256; ++c) {
+            if (other.members[c]) {
+                insert(static_cast<unsigned char>(c));
+            }
+        }
+        find_runs();
+        return *this;
+    }
+
+    bool contains(unsigned char c) const { return members[c]; }
+
+    static constexpr bool has_sse2 = true;
+    static constexpr int max_sse2_runs = 8;
+
+    bool scalar(unsigned char x) const { return contains(x); }
+#if PERF_X86
+    __m128i sse2(__m128i x) const
+    {
+        if (runs > max_sse2_runs) {
+            alignas(16) unsigned char bytes[16];
+            alignas(16) unsigned char found[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(bytes), x);
+            for (int j = 0; j < 16; ++j) {
+                found[j] = members[bytes[j]] ? 0xff : 0;
+            }
+            return _mm_load_si128(reinterpret_cast<const __m128i*>(found));
+        }
+        __m128i in = _mm_setzero_si128();
+        for (int r = 0; r < runs; ++r) {
+            in = _mm_or_si128(in, byte_range(run_lo[r], run_hi[r]).sse2(x));
+        }
+        return in;
+    }
+
+    PERF_AVX2 __m256i avx2(__m256i x) const
+    {
+        __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[0])));
+        __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1])));
+        __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+        __m256i nibble = _mm256_and_si256(x, _mm256_set1_epi8(15));
+        __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, nibble), _mm256_shuffle_epi8(high, nibble), x);
+        __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(7)));
+        return _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+    }
+#endif
+
+private:
+    void insert(unsigned char c)
+    {
+        members[c] = true;
+        rows[c >> 7][c & 15] |= static_cast<uint8_t>(1 << ((c >> 4) & 7));
+    }
+
+    // Counts the runs of consecutive members, keeping the first
+    // max_sse2_runs of them
+    void find_runs()
+    {
+        runs = 0;
+        for (unsigned c = 0; c < 256; ++c) {
+            if (members[c] && (c == 0 || !members[c - 1])) {
+                if (runs < max_sse2_runs) {
+                    run_lo[runs] = static_cast<unsigned char>(c);
+                }
+                ++runs;
+            }
+            if (members[c] && (c == 255 || !members[c + 1]) && runs <= max_sse2_runs) {
+                run_hi[runs - 1] = static_cast<unsigned char>(c);
+            }
+        }
+    }
+
+    bool members[256] = {};
+    uint8_t rows[2][16] = {};
+    int runs = 0;
+    unsigned char run_lo[max_sse2_runs] = {};
+    unsigned char run_hi[max_sse2_runs] = {};
+};
+
+// Classification of all 256 byte values into up to eight classes, one bit
+// each. A byte may be in several classes.
+class byte_classes {
+public:
+    uint8_t operator[](unsigned char c) const { return table[c]; }
+
+    byte_classes& add(unsigned char c, uint8_t classes)
+    {
+        table[c] |= classes;
+        return *this;
+    }
+
+    byte_classes& add_range(unsigned char lo, unsigned char hi, uint8_t classes)
+    {
+        for (unsigned c = lo; c <= hi; ++c) {
+            table[c] |= classes;
+        }
+        return *this;
+    }
+
+    // The bytes in any of `classes`, to scan for
+    byte_set matching(uint8_t classes) const
+    {
+        byte_set set;
+        for (unsigned c = 0; c < 256; ++c) {
+            if (table[c] & classes) {
+                unsigned last = c;
+                while (last < 255 && (table[last + 1] & classes)) {
+                    ++last;
+                }
+                set.add_range(static_cast<unsigned char>(c), static_cast<unsigned char>(last));
+                c = last;
+            }
+        }
+        return set;
+    }
+
+private:
+    uint8_t table[256] = {};
+};
+
+namespace ascii {
+
+    enum : uint8_t {
+        upper = 1,
+        lower = 2,
+        digit = 4,
+        space = 8,
+        punct = 16,
+        control = 32,
+        alpha = upper | lower,
+        alnum = alpha | digit,
+    };
+
+    // The classes of the C locale's isupper, islower, isdigit, isspace,
+    // ispunct and iscntrl
+    inline const byte_classes& classes()
+    {
+        static const byte_classes table = byte_classes()
+                                              .add_range('A', 'Z', upper)
+                                              .add_range('a', 'z', lower)
+                                              .add_range('0', '9', digit)
+                                              .add(' ', space)
+                                              .add_range('\t', '\r', space | control)
+                                              .add_range(0, 8, control)
+                                              .add_range(14, 31, control)
+                                              .add(127, control)
+                                              .add_range('!', '/', punct)
+                                              .add_range(':', '@', punct)
+                                              .add_range('[', '`', punct)
+                                              .add_range('{', '~', punct);
+        return table;
+    }
+
+    inline byte_set matching(uint8_t classes)
+    {
+        return ascii::classes().matching(classes);
+    }
+
+} // namespace ascii
+
+namespace detail {
+
+    // Position of the first byte from i on for which the matcher gives
+    // Match, n if there is none
+    template <bool Match, typename Matcher>
+    size_t find_scalar(const unsigned char* s, size_t i, size_t n, const Matcher& m)
+    {
+        for (; i < n; ++i) {
+            if (m.scalar(s[i]) == Match) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    template <typename Matcher>
+    size_t count_scalar(const unsigned char* s, size_t i, size_t n, const Matcher& m)
+    {
+        size_t count = 0;
+        for (; i < n; ++i) {
+            count += m.scalar(s[i]);
+        }
+        return count;
+    }
+
+#if PERF_X86
+    template <typename Matcher>
+    uint64_t mask64_sse2(const unsigned char* s, const Matcher& m)
+    {
+        uint64_t mask = 0;
+        for (int j = 0; j < 64; j += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + j));
+            mask |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(m.sse2(x)))) << j;
+        }
+        return mask;
+    }
+
+    template <typename Matcher>
+    PERF_AVX2 uint64_t mask64_avx2(const unsigned char* s, const Matcher& m)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+        return uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(m.avx2(a))))
+            | uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(m.avx2(b)))) << 32;
+    }
+
+    template <bool Match, typename Matcher>
+    size_t find_sse2(const unsigned char* s, size_t n, const Matcher& m)
+    {
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            uint64_t mask = mask64_sse2(s + i, m);
+            mask = Match ? mask : ~mask;
+            if (mask) {
+                return i + __builtin_ctzll(mask);
+            }
+        }
+        return find_scalar<Match>(s, i, n, m);
+    }
+
+    template <bool Match, typename Matcher>
+    PERF_AVX2 size_t find_avx2(const unsigned char* s, size_t n, const Matcher& m)
+    {
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            uint64_t mask = mask64_avx2(s + i, m);
+            mask = Match ? mask : ~mask;
+            if (mask) {
+                return i + __builtin_ctzll(mask);
+            }
+        }
+        return find_scalar<Match>(s, i, n, m);
+    }
+
+    template <typename Matcher>
+    size_t count_sse2(const unsigned char* s, size_t n, const Matcher& m)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            count += __builtin_popcountll(mask64_sse2(s + i, m));
+        }
+        return count + count_scalar(s, i, n, m);
+    }
+
+    template <typename Matcher>
+    PERF_AVX2 size_t count_avx2(const unsigned char* s, size_t n, const Matcher& m)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            count += __builtin_popcountll(mask64_avx2(s + i, m));
+        }
+        return count + count_scalar(s, i, n, m);
+    }
+
+    // Only matchers with an SSE2 form get the SSE2 kernels
+    template <bool Match, typename Matcher>
+    size_t find_sse2_or_scalar(const unsigned char* s, size_t n, const Matcher& m, std::true_type)
+    {
+        return find_sse2<Match>(s, n, m);
+    }
+
+    template <bool Match, typename Matcher>
+    size_t find_sse2_or_scalar(const unsigned char* s, size_t n, const Matcher& m, std::false_type)
+    {
+        return find_scalar<Match>(s, 0, n, m);
+    }
+
+    template <typename Matcher>
+    size_t count_sse2_or_scalar(const unsigned char* s, size_t n, const Matcher& m, std::true_type)
+    {
+        return count_sse2(s, n, m);
+    }
+
+    template <typename Matcher>
+    size_t count_sse2_or_scalar(const unsigned char* s, size_t n, const Matcher& m, std::false_type)
+    {
+        return count_scalar(s, 0, n, m);
+    }
+#endif
+
+    template <bool Match, typename Matcher>
+    size_t find(const char* text, size_t n, const Matcher& m)
+    {
+        auto s = reinterpret_cast<const unsigned char*>(text);
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return find_avx2<Match>(s, n, m);
+        case isa::sse2:
+            return find_sse2_or_scalar<Match>(s, n, m, std::integral_constant<bool, Matcher::has_sse2>());
+        case isa::scalar:
+            break;
+        }
+#endif
+        return find_scalar<Match>(s, 0, n, m);
+    }
+
+    template <typename Matcher>
+    size_t count(const char* text, size_t n, const Matcher& m)
+    {
+        auto s = reinterpret_cast<const unsigned char*>(text);
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return count_avx2(s, n, m);
+        case isa::sse2:
+            return count_sse2_or_scalar(s, n, m, std::integral_constant<bool, Matcher::has_sse2>());
+        case isa::scalar:
+            break;
+        }
+#endif
+        return count_scalar(s, 0, n, m);
+    }
+
+} // namespace detail
+
+// Position of the first byte in the class, n if there is none
+template <typename Matcher>
+size_t find_byte(const char* s, size_t n, const Matcher& m)
+{
+    return detail::find<true>(s, n, m);
+}
+
+// Position of the first byte not in the class, n if there is none
+template <typename Matcher>
+size_t find_byte_not(const char* s, size_t n, const Matcher& m)
+{
+    return detail::find<false>(s, n, m);
+}
+
+template <typename Matcher>
+bool any_byte(const char* s, size_t n, const Matcher& m)
+{
+    return find_byte(s, n, m) != n;
+}
+
+template <typename Matcher>
+bool all_bytes(const char* s, size_t n, const Matcher& m)
+{
+    return find_byte_not(s, n, m) == n;
+}
+
+template <typename Matcher>
+bool no_byte(const char* s, size_t n, const Matcher& m)
+{
+    return find_byte(s, n, m) == n;
+}
+
+// Number of bytes in the class; reads all of the input
+template <typename Matcher>
+size_t count_bytes(const char* s, size_t n, const Matcher& m)
+{
+    return detail::count(s, n, m);
+}
+
+template <typename Matcher>
+size_t find_byte(const std::string& s, const Matcher& m)
+{
+    size_t i = find_byte(s.data(), s.size(), m);
+    return i == s.size() ? std::string::npos : i;
+}
+
+template <typename Matcher>
+size_t find_byte_not(const std::string& s, const Matcher& m)
+{
+    size_t i = find_byte_not(s.data(), s.size(), m);
+    return i == s.size() ? std::string::npos : i;
+}
+
+template <typename Matcher>
+bool any_byte(const std::string& s, const Matcher& m)
+{
+    return any_byte(s.data(), s.size(), m);
+}
+
+template <typename Matcher>
+bool all_bytes(const std::string& s, const Matcher& m)
+{
+    return all_bytes(s.data(), s.size(), m);
+}
+
+template <typename Matcher>
+bool no_byte(const std::string& s, const Matcher& m)
+{
+    return no_byte(s.data(), s.size(), m);
+}
+
+template <typename Matcher>
+size_t count_bytes(const std::string& s, const Matcher& m)
+{
+    return count_bytes(s.data(), s.size(), m);
+}
+
+} // namespace perf
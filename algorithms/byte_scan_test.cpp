@@ -0,0 +1,175 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "byte_scan.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <string>
+
+namespace {
+
+std::string random_text(size_t n)
+{
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::string s(n, '\0');
+    std::generate(begin(s), end(s), [&] { return static_cast<char>(dist(rng)); });
+    return s;
+}
+
+class ByteScan : public test_support::isa_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, ByteScan,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(ByteScan, CheckThatOneElementSatisfiesACondition)
+{
+    std::string s{ "hello, world" };
+
+    ASSERT_TRUE(perf::any_byte(s, perf::byte_equal(' ')));
+}
+
+TEST_P(ByteScan, CheckThatNoElementSatisfiesCondition)
+{
+    std::string s{ "hello, world" };
+
+    ASSERT_TRUE(perf::no_byte(s, perf::byte_range('A', 'Z')));
+    ASSERT_TRUE(perf::no_byte(s, perf::ascii::matching(perf::ascii::upper)));
+}
+
+TEST_P(ByteScan, FindsPositionsPastTheFirstBlocks)
+{
+    std::string s(1000, 'a');
+    s[700] = 'Q';
+    s[900] = '7';
+
+    ASSERT_EQ(700u, perf::find_byte(s, perf::byte_range('A', 'Z')));
+    ASSERT_EQ(700u, perf::find_byte_not(s, perf::ascii::matching(perf::ascii::lower)));
+    ASSERT_EQ(900u, perf::find_byte(s, perf::ascii::matching(perf::ascii::digit)));
+    ASSERT_EQ(std::string::npos, perf::find_byte(s, perf::byte_equal('!')));
+    ASSERT_TRUE(perf::all_bytes(s, perf::ascii::matching(perf::ascii::alnum)));
+    ASSERT_FALSE(perf::all_bytes(s, perf::ascii::matching(perf::ascii::alpha)));
+}
+
+TEST_P(ByteScan, HighBytesAreNotAscii)
+{
+    std::string s{ "caf\xc3\xa9" };
+
+    ASSERT_EQ(3u, perf::find_byte_not(s, perf::ascii::matching(perf::ascii::alpha)));
+    ASSERT_EQ(2u, perf::count_bytes(s, perf::byte_range(0x80, 0xff)));
+    ASSERT_TRUE(perf::any_byte(s, perf::byte_set("\xa9")));
+}
+
+TEST_P(ByteScan, MatchesCharacterClassesOfTheCLocale)
+{
+    auto text = random_text(10000);
+    struct {
+        uint8_t classes;
+        int (*predicate)(int);
+    } cases[] = {
+        { perf::ascii::upper, std::isupper },
+        { perf::ascii::lower, std::islower },
+        { perf::ascii::digit, std::isdigit },
+        { perf::ascii::space, std::isspace },
+        { perf::ascii::punct, std::ispunct },
+        { perf::ascii::control, std::iscntrl },
+        { perf::ascii::alnum, std::isalnum },
+    };
+    for (auto& c : cases) {
+        auto predicate = [&](char x) { return c.predicate(static_cast<unsigned char>(x)) != 0; };
+        auto set = perf::ascii::matching(c.classes);
+        for (size_t n : { 0, 1, 63, 64, 65, 1000, 10000 }) {
+            auto first = std::find_if(text.data(), text.data() + n, predicate) - text.data();
+            auto first_not = std::find_if_not(text.data(), text.data() + n, predicate) - text.data();
+            auto count = std::count_if(text.data(), text.data() + n, predicate);
+
+            ASSERT_EQ(static_cast<size_t>(first), perf::find_byte(text.data(), n, set));
+            ASSERT_EQ(static_cast<size_t>(first_not), perf::find_byte_not(text.data(), n, set));
+            ASSERT_EQ(static_cast<size_t>(count), perf::count_bytes(text.data(), n, set));
+        }
+    }
+}
+
+TEST_P(ByteScan, RangesAndSetsAgree)
+{
+    auto text = random_text(5000);
+    for (int lo : { 0, 1, int('a'), 200, 255 }) {
+        for (int hi : { lo, lo + 10, 255 }) {
+            if (hi > 255) {
+                continue;
+            }
+            perf::byte_range range(lo, hi);
+            auto set = perf::byte_set().add_range(lo, hi);
+            size_t expected = 0;
+            for (char c : text) {
+                expected += static_cast<unsigned char>(c) >= lo && static_cast<unsigned char>(c) <= hi;
+            }
+
+            ASSERT_EQ(expected, perf::count_bytes(text, range)) << lo << " " << hi;
+            ASSERT_EQ(expected, perf::count_bytes(text, set)) << lo << " " << hi;
+            ASSERT_EQ(perf::find_byte(text, range), perf::find_byte(text, set));
+        }
+    }
+}
+
+TEST_P(ByteScan, SetsOfManyRuns)
+{
+    // Every third byte: too many runs to compare one by one with SSE2
+    auto text = random_text(5000);
+    for (int runs : { 1, 7, 8, 9, 86 }) {
+        perf::byte_set set;
+        for (int r = 0; r < runs; ++r) {
+            set.add(static_cast<unsigned char>(3 * r));
+        }
+        size_t expected = std::count_if(begin(text), end(text), [&](char c) { return set.contains(c); });
+        size_t first = std::find_if(begin(text), end(text), [&](char c) { return set.contains(c); }) - begin(text);
+        size_t first_not = std::find_if(begin(text), end(text), [&](char c) { return !set.contains(c); }) - begin(text);
+
+        ASSERT_EQ(expected, perf::count_bytes(text, set)) << runs;
+        ASSERT_EQ(first, perf::find_byte(text.data(), text.size(), set)) << runs;
+        ASSERT_EQ(first_not, perf::find_byte_not(text.data(), text.size(), set)) << runs;
+    }
+}
+
+TEST(ByteScan, ClassTable)
+{
+    const auto& table = perf::ascii::classes();
+
+    ASSERT_EQ(perf::ascii::upper, table['Q']);
+    ASSERT_EQ(perf::ascii::space | perf::ascii::control, table['\n']);
+    ASSERT_EQ(0, table[0xe9]);
+
+    auto vowels = perf::byte_classes().add('a', 1).add('e', 1).add('i', 1).add('o', 1).add('u', 1).add('y', 2);
+    ASSERT_EQ(5u, perf::count_bytes(std::string("you are it"), vowels.matching(1)));
+    ASSERT_EQ(6u, perf::count_bytes(std::string("you are it"), vowels.matching(3)));
+}
+
+TEST(ByteScanBenchmark, DISABLED_FindUppercase)
+{
+    auto n = bench::size(1 << 28);
+    std::string text(n, 'x');
+    text[n - 1] = 'X';
+    auto upper = perf::ascii::matching(perf::ascii::upper);
+
+    bench::report("std::any_of isupper", bench::best_of(5, [&] {
+        bench::keep(std::any_of(begin(text), end(text), [](char c) { return std::isupper(static_cast<unsigned char>(c)); }));
+    }), n);
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* range_names[] = { "any_byte byte_range scalar", "any_byte byte_range sse2", "any_byte byte_range avx2" };
+        const char* set_names[] = { "any_byte byte_set scalar", "any_byte byte_set sse2", "any_byte byte_set avx2" };
+        bench::report(range_names[static_cast<int>(level)], bench::best_of(5, [&] {
+            bench::keep(perf::any_byte(text, perf::byte_range('A', 'Z')));
+        }), n);
+        bench::report(set_names[static_cast<int>(level)], bench::best_of(5, [&] {
+            bench::keep(perf::any_byte(text, upper));
+        }), n);
+    }
+    perf::limit_isa(perf::isa::avx2);
+}
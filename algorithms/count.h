@@ -0,0 +1,262 @@
+#pragma once
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Counting predicates over 32-bit integer columns.
+//
+// Every count_* function has a select_* twin that additionally writes a
+// packed selection bitmap: bit i % 64 of word i / 64 is set when element i
+// matches. Bits past the end of the input are zero. The bitmap needs
+// selection_words(n) words.
+namespace perf {
+
+inline size_t selection_words(size_t n)
+{
+    return (n + 63) / 64;
+}
+
+inline bool selected(const uint64_t* bitmap, size_t i)
+{
+    return (bitmap[i / 64] >> (i % 64)) & 1;
+}
+
+namespace detail {
+
+    // A predicate answers for element i in scalar code and for four or eight
+    // consecutive elements starting at i as an all-ones/all-zeroes lane mask.
+
+    struct equal_to_value {
+        bool scalar(size_t i) const { return v[i] == x; }
+#if PERF_X86
+        __m128i sse2(size_t i) const
+        {
+            return _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)), _mm_set1_epi32(x));
+        }
+        PERF_AVX2 __m256i avx2(size_t i) const
+        {
+            return _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), _mm256_set1_epi32(x));
+        }
+#endif
+        const int32_t* v;
+        int32_t x;
+    };
+
+    // lo <= v <= hi is one unsigned comparison: v - lo <= hi - lo. SIMD only
+    // has signed comparisons, flipping the sign bit turns them unsigned.
+    struct in_range {
+        bool scalar(size_t i) const { return static_cast<uint32_t>(v[i]) - lo <= span; }
+#if PERF_X86
+        __m128i sse2(size_t i) const
+        {
+            const __m128i sign = _mm_set1_epi32(INT32_MIN);
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            x = _mm_xor_si128(_mm_sub_epi32(x, _mm_set1_epi32(static_cast<int32_t>(lo))), sign);
+            __m128i above = _mm_cmpgt_epi32(x, _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(span)), sign));
+            return _mm_xor_si128(above, _mm_set1_epi32(-1));
+        }
+        PERF_AVX2 __m256i avx2(size_t i) const
+        {
+            const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+            x = _mm256_xor_si256(_mm256_sub_epi32(x, _mm256_set1_epi32(static_cast<int32_t>(lo))), sign);
+            __m256i above = _mm256_cmpgt_epi32(x, _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(span)), sign));
+            return _mm256_xor_si256(above, _mm256_set1_epi32(-1));
+        }
+#endif
+        const int32_t* v;
+        uint32_t lo;
+        uint32_t span;
+    };
+
+    // v mod 2^k == r, as a mask test
+    struct masked_equal {
+        bool scalar(size_t i) const { return (v[i] & mask) == r; }
+#if PERF_X86
+        __m128i sse2(size_t i) const
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            return _mm_cmpeq_epi32(_mm_and_si128(x, _mm_set1_epi32(mask)), _mm_set1_epi32(r));
+        }
+        PERF_AVX2 __m256i avx2(size_t i) const
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+            return _mm256_cmpeq_epi32(_mm256_and_si256(x, _mm256_set1_epi32(mask)), _mm256_set1_epi32(r));
+        }
+#endif
+        const int32_t* v;
+        int32_t mask;
+        int32_t r;
+    };
+
+    // Other divisors have no cheap SIMD form
+    struct modulo {
+        bool scalar(size_t i) const
+        {
+            int32_t m = v[i] % d;
+            return (m < 0 ? m + d : m) == r;
+        }
+        const int32_t* v;
+        int32_t d;
+        int32_t r;
+    };
+
+    struct equal_elements {
+        bool scalar(size_t i) const { return a[i] == b[i]; }
+#if PERF_X86
+        __m128i sse2(size_t i) const
+        {
+            return _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        }
+        PERF_AVX2 __m256i avx2(size_t i) const
+        {
+            return _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        }
+#endif
+        const int32_t* a;
+        const int32_t* b;
+    };
+
+    template <typename Pred>
+    size_t select_scalar(size_t first, size_t n, const Pred& pred, uint64_t* bitmap)
+    {
+        size_t count = 0;
+        for (size_t i = first; i < n; i += 64) {
+            uint64_t word = 0;
+            size_t bits = std::min<size_t>(64, n - i);
+            for (size_t j = 0; j < bits; ++j) {
+                word |= static_cast<uint64_t>(pred.scalar(i + j)) << j;
+            }
+            count += __builtin_popcountll(word);
+            if (bitmap) {
+                bitmap[i / 64] = word;
+            }
+        }
+        return count;
+    }
+
+#if PERF_X86
+    // Whole 64-element words with compare + movemask, the tail in scalar code
+    template <typename Pred>
+    size_t select_sse2(size_t n, const Pred& pred, uint64_t* bitmap)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            uint64_t word = 0;
+            for (size_t j = 0; j < 64; j += 4) {
+                uint64_t bits = _mm_movemask_ps(_mm_castsi128_ps(pred.sse2(i + j)));
+                word |= bits << j;
+            }
+            count += __builtin_popcountll(word);
+            if (bitmap) {
+                bitmap[i / 64] = word;
+            }
+        }
+        return count + select_scalar(i, n, pred, bitmap);
+    }
+
+    template <typename Pred>
+    PERF_AVX2 size_t select_avx2(size_t n, const Pred& pred, uint64_t* bitmap)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            uint64_t word = 0;
+            for (size_t j = 0; j < 64; j += 8) {
+                uint64_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(pred.avx2(i + j)));
+                word |= bits << j;
+            }
+            count += __builtin_popcountll(word);
+            if (bitmap) {
+                bitmap[i / 64] = word;
+            }
+        }
+        return count + select_scalar(i, n, pred, bitmap);
+    }
+#endif
+
+    template <typename Pred>
+    size_t select(size_t n, const Pred& pred, uint64_t* bitmap)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return select_avx2(n, pred, bitmap);
+        case isa::sse2:
+            return select_sse2(n, pred, bitmap);
+        case isa::scalar:
+            break;
+        }
+#endif
+        return select_scalar(0, n, pred, bitmap);
+    }
+
+    inline bool is_power_of_two(int32_t d)
+    {
+        return d > 0 && (d & (d - 1)) == 0;
+    }
+
+} // namespace detail
+
+// Elements equal to x
+inline size_t select_equal(const int32_t* v, size_t n, int32_t x, uint64_t* bitmap)
+{
+    return detail::select(n, detail::equal_to_value{ v, x }, bitmap);
+}
+
+// Elements in the closed range [lo, hi]
+inline size_t select_in_range(const int32_t* v, size_t n, int32_t lo, int32_t hi, uint64_t* bitmap)
+{
+    if (hi < lo) {
+        if (bitmap) {
+            std::fill_n(bitmap, selection_words(n), 0);
+        }
+        return 0;
+    }
+    uint32_t span = static_cast<uint32_t>(hi) - static_cast<uint32_t>(lo);
+    return detail::select(n, detail::in_range{ v, static_cast<uint32_t>(lo), span }, bitmap);
+}
+
+// Elements with v mod d == r, where mod is the non-negative remainder and
+// d > 0 and 0 <= r < d. Power of two divisors are vectorized.
+inline size_t select_mod(const int32_t* v, size_t n, int32_t d, int32_t r, uint64_t* bitmap)
+{
+    if (detail::is_power_of_two(d)) {
+        return detail::select(n, detail::masked_equal{ v, d - 1, r }, bitmap);
+    }
+    return detail::select_scalar(0, n, detail::modulo{ v, d, r }, bitmap);
+}
+
+// Positions where a[i] == b[i]
+inline size_t select_equal_elements(const int32_t* a, const int32_t* b, size_t n, uint64_t* bitmap)
+{
+    return detail::select(n, detail::equal_elements{ a, b }, bitmap);
+}
+
+inline size_t count_equal(const int32_t* v, size_t n, int32_t x)
+{
+    return select_equal(v, n, x, nullptr);
+}
+
+inline size_t count_in_range(const int32_t* v, size_t n, int32_t lo, int32_t hi)
+{
+    return select_in_range(v, n, lo, hi, nullptr);
+}
+
+inline size_t count_mod(const int32_t* v, size_t n, int32_t d, int32_t r)
+{
+    return select_mod(v, n, d, r, nullptr);
+}
+
+inline size_t count_equal_elements(const int32_t* a, const int32_t* b, size_t n)
+{
+    return select_equal_elements(a, b, n, nullptr);
+}
+
+} // namespace perf
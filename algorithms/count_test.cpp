@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "count.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+class Count : public test_support::isa_fixture {
+};
+
+template <typename Pred>
+void expect_selection(const std::vector<int32_t>& v, const std::vector<uint64_t>& bitmap, Pred pred)
+{
+    for (size_t i = 0; i < v.size(); ++i) {
+        ASSERT_EQ(pred(v[i]), perf::selected(bitmap.data(), i)) << "i = " << i;
+    }
+    if (v.size() % 64) {
+        ASSERT_EQ(0u, bitmap.back() >> (v.size() % 64));
+    }
+}
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, Count,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(Count, CountZeroes)
+{
+    std::vector<int32_t> v{ 0, 1, 2, 4, 0, 1, 2 };
+
+    ASSERT_EQ(2u, perf::count_equal(v.data(), v.size(), 0));
+}
+
+TEST_P(Count, CountEvens)
+{
+    std::vector<int32_t> v{ 1, 2, 3, 4, 5, 6, 7 };
+
+    ASSERT_EQ(3u, perf::count_mod(v.data(), v.size(), 2, 0));
+}
+
+TEST_P(Count, CountEqualElements)
+{
+    std::vector<int32_t> a{ 1, 2, 3, 4, 5 };
+    std::vector<int32_t> b{ 10, 2, 30, 4, 50 };
+
+    ASSERT_EQ(2u, perf::count_equal_elements(a.data(), b.data(), a.size()));
+}
+
+TEST_P(Count, EqualMatchesStdCount)
+{
+    for (size_t n : { 0, 1, 63, 64, 65, 1000 }) {
+        auto v = random_ints(n, -3, 3);
+        std::vector<uint64_t> bitmap(perf::selection_words(n));
+
+        auto count = perf::select_equal(v.data(), n, -2, bitmap.data());
+
+        ASSERT_EQ(std::count(begin(v), end(v), -2), static_cast<long>(count));
+        expect_selection(v, bitmap, [](int32_t x) { return x == -2; });
+    }
+}
+
+TEST_P(Count, InRangeIncludesBothEnds)
+{
+    auto v = random_ints(1001, -100, 100);
+    std::vector<uint64_t> bitmap(perf::selection_words(v.size()));
+
+    auto count = perf::select_in_range(v.data(), v.size(), -10, 20, bitmap.data());
+
+    auto pred = [](int32_t x) { return -10 <= x && x <= 20; };
+    ASSERT_EQ(std::count_if(begin(v), end(v), pred), static_cast<long>(count));
+    expect_selection(v, bitmap, pred);
+}
+
+TEST_P(Count, InRangeAtTheLimits)
+{
+    std::vector<int32_t> v{ INT32_MIN, -1, 0, 1, INT32_MAX };
+
+    ASSERT_EQ(5u, perf::count_in_range(v.data(), v.size(), INT32_MIN, INT32_MAX));
+    ASSERT_EQ(2u, perf::count_in_range(v.data(), v.size(), 1, INT32_MAX));
+    ASSERT_EQ(0u, perf::count_in_range(v.data(), v.size(), 1, 0));
+}
+
+TEST_P(Count, ModuloOfNegativeNumbers)
+{
+    auto v = random_ints(777, -1000, 1000);
+
+    for (int32_t d : { 2, 3, 8, 10 }) {
+        for (int32_t r = 0; r < d; ++r) {
+            std::vector<uint64_t> bitmap(perf::selection_words(v.size()));
+            auto count = perf::select_mod(v.data(), v.size(), d, r, bitmap.data());
+
+            auto pred = [=](int32_t x) { return ((x % d) + d) % d == r; };
+            ASSERT_EQ(std::count_if(begin(v), end(v), pred), static_cast<long>(count));
+            expect_selection(v, bitmap, pred);
+        }
+    }
+}
+
+TEST(CountBenchmark, DISABLED_CountEvens)
+{
+    auto n = bench::size(1 << 26);
+    auto v = random_ints(n, -1000, 1000);
+    std::vector<uint64_t> bitmap(perf::selection_words(n));
+    double bytes = 1.0 * n * sizeof(int32_t);
+
+    bench::report("std::count_if", bench::best_of(5, [&] {
+        bench::keep(std::count_if(begin(v), end(v), [](int32_t x) { return x % 2 == 0; }));
+    }), bytes);
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* names[] = { "count_mod scalar", "count_mod sse2", "count_mod avx2" };
+        bench::report(names[static_cast<int>(level)], bench::best_of(5, [&] {
+            bench::keep(perf::count_mod(v.data(), n, 2, 0));
+        }), bytes);
+    }
+    bench::report("select_mod avx2", bench::best_of(5, [&] {
+        bench::keep(perf::select_mod(v.data(), n, 2, 0, bitmap.data()));
+    }), bytes);
+    perf::limit_isa(perf::isa::avx2);
+}
@@ -0,0 +1,325 @@
+#include "delta_column.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace perf {
+
+namespace {
+
+    // A block is `width` rows of eight 32-bit words. Difference j of the
+    // block is in lane j % 8, at bit (j / 8) * width of that lane's words.
+    constexpr size_t lanes = 8;
+    constexpr size_t positions = delta_column::block_size / lanes;
+
+    uint32_t zigzag(uint32_t delta)
+    {
+        return (delta << 1) ^ (0u - (delta >> 31));
+    }
+
+    uint32_t unzigzag(uint32_t z)
+    {
+        return (z >> 1) ^ (0u - (z & 1));
+    }
+
+    uint32_t bit_width(uint32_t x)
+    {
+        return x ? 32 - __builtin_clz(x) : 0;
+    }
+
+    void pack(uint32_t* rows, uint32_t width, size_t j, uint32_t u)
+    {
+        size_t bit = j / lanes * width;
+        size_t shift = bit % 32;
+        uint32_t* word = rows + bit / 32 * lanes + j % lanes;
+        word[0] |= u << shift;
+        if (shift + width > 32) {
+            word[lanes] |= u >> (32 - shift);
+        }
+    }
+
+    uint32_t unpack(const uint32_t* rows, uint32_t width, size_t j)
+    {
+        if (width == 0) {
+            return 0;
+        }
+        size_t bit = j / lanes * width;
+        size_t shift = bit % 32;
+        const uint32_t* word = rows + bit / 32 * lanes + j % lanes;
+        uint32_t u = word[0] >> shift;
+        if (shift + width > 32) {
+            u |= word[lanes] << (32 - shift);
+        }
+        return width == 32 ? u : u & ((1u << width) - 1);
+    }
+
+    // Writes the 256 values of a block to out
+    using block_decoder = void (*)(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out);
+
+    template <unsigned Width>
+    void decode_scalar(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out)
+    {
+        uint32_t value = static_cast<uint32_t>(base);
+        for (size_t j = 0; j < delta_column::block_size; ++j) {
+            value += unzigzag(unpack(rows, Width, j) + reference);
+            out[j] = static_cast<int32_t>(value);
+        }
+    }
+
+    template <unsigned Width>
+    constexpr uint32_t low_bits()
+    {
+        return Width == 32 ? ~0u : (1u << Width) - 1;
+    }
+
+#if PERF_X86
+    // The eight differences at position P of every lane. The shifts are
+    // constants, so every step compiles to a few instructions.
+    template <unsigned Width, unsigned P>
+    inline __m128i unpack_sse2(const __m128i* rows)
+    {
+        constexpr unsigned bit = P * Width;
+        constexpr unsigned shift = bit % 32;
+        if (Width == 0) {
+            return _mm_setzero_si128();
+        }
+        __m128i u = _mm_srli_epi32(_mm_loadu_si128(rows + bit / 32 * 2), shift);
+        if (shift + Width > 32) {
+            u = _mm_or_si128(u, _mm_slli_epi32(_mm_loadu_si128(rows + bit / 32 * 2 + 2), 32 - shift));
+        }
+        return _mm_and_si128(u, _mm_set1_epi32(static_cast<int>(low_bits<Width>())));
+    }
+
+    // Decodes four differences and adds them to the running value
+    inline __m128i running_sum_sse2(__m128i u, __m128i reference, __m128i& carry)
+    {
+        __m128i z = _mm_add_epi32(u, reference);
+        __m128i d = _mm_xor_si128(_mm_srli_epi32(z, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi32(1))));
+        d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi32(d, carry);
+        carry = _mm_shuffle_epi32(d, _MM_SHUFFLE(3, 3, 3, 3));
+        return d;
+    }
+
+    template <unsigned Width, unsigned P>
+    inline void decode_position_sse2(const __m128i* rows, __m128i reference, __m128i& carry, int32_t* out)
+    {
+        // Lanes 0-3 and 4-7 are the two halves of a row
+        __m128i low = unpack_sse2<Width, P>(rows);
+        __m128i high = unpack_sse2<Width, P>(rows + 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + P * lanes), running_sum_sse2(low, reference, carry));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + P * lanes + 4), running_sum_sse2(high, reference, carry));
+    }
+
+    template <unsigned Width, size_t... P>
+    void decode_sse2(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out, std::index_sequence<P...>)
+    {
+        auto r = reinterpret_cast<const __m128i*>(rows);
+        __m128i ref = _mm_set1_epi32(static_cast<int>(reference));
+        __m128i carry = _mm_set1_epi32(base);
+        int expand[] = { (decode_position_sse2<Width, P>(r, ref, carry, out), 0)... };
+        (void)expand;
+    }
+
+    template <unsigned Width>
+    void decode_sse2(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out)
+    {
+        decode_sse2<Width>(rows, reference, base, out, std::make_index_sequence<positions>());
+    }
+
+    template <unsigned Width, unsigned P>
+    PERF_AVX2 inline __m256i unpack_avx2(const __m256i* rows)
+    {
+        constexpr unsigned bit = P * Width;
+        constexpr unsigned shift = bit % 32;
+        if (Width == 0) {
+            return _mm256_setzero_si256();
+        }
+        __m256i u = _mm256_srli_epi32(_mm256_loadu_si256(rows + bit / 32), shift);
+        if (shift + Width > 32) {
+            u = _mm256_or_si256(u, _mm256_slli_epi32(_mm256_loadu_si256(rows + bit / 32 + 1), 32 - shift));
+        }
+        return _mm256_and_si256(u, _mm256_set1_epi32(static_cast<int>(low_bits<Width>())));
+    }
+
+    template <unsigned Width, unsigned P>
+    PERF_AVX2 inline void decode_position_avx2(const __m256i* rows, const __m256i& reference, __m256i& carry, int32_t* out)
+    {
+        __m256i z = _mm256_add_epi32(unpack_avx2<Width, P>(rows), reference);
+        __m256i d = _mm256_xor_si256(_mm256_srli_epi32(z, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(z, _mm256_set1_epi32(1))));
+        // Running sum of each 128-bit half, then the low half's total is
+        // added to the high half
+        d = _mm256_add_epi32(d, _mm256_slli_si256(d, 4));
+        d = _mm256_add_epi32(d, _mm256_slli_si256(d, 8));
+        d = _mm256_add_epi32(d, _mm256_shuffle_epi32(_mm256_permute2x128_si256(d, d, 0x08), _MM_SHUFFLE(3, 3, 3, 3)));
+        d = _mm256_add_epi32(d, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + P * lanes), d);
+        carry = _mm256_permutevar8x32_epi32(d, _mm256_set1_epi32(7));
+    }
+
+    template <unsigned Width, size_t... P>
+    PERF_AVX2 void decode_avx2(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out, std::index_sequence<P...>)
+    {
+        auto r = reinterpret_cast<const __m256i*>(rows);
+        __m256i ref = _mm256_set1_epi32(static_cast<int>(reference));
+        __m256i carry = _mm256_set1_epi32(base);
+        int expand[] = { (decode_position_avx2<Width, P>(r, ref, carry, out), 0)... };
+        (void)expand;
+    }
+
+    template <unsigned Width>
+    PERF_AVX2 void decode_avx2(const uint32_t* rows, uint32_t reference, int32_t base, int32_t* out)
+    {
+        decode_avx2<Width>(rows, reference, base, out, std::make_index_sequence<positions>());
+    }
+#endif
+
+    // One decoder per width
+    struct decoders {
+        block_decoder by_width[33];
+    };
+
+    template <size_t... Width>
+    decoders make_decoders(isa level, std::index_sequence<Width...>)
+    {
+        switch (level) {
+#if PERF_X86
+        case isa::avx2:
+            return { { &decode_avx2<Width>... } };
+        case isa::sse2:
+            return { { &decode_sse2<Width>... } };
+#endif
+        default:
+            return { { &decode_scalar<Width>... } };
+        }
+    }
+
+    block_decoder decoder_for(uint32_t width)
+    {
+        static const decoders tables[] = {
+            make_decoders(isa::scalar, std::make_index_sequence<33>()),
+            make_decoders(isa::sse2, std::make_index_sequence<33>()),
+            make_decoders(isa::avx2, std::make_index_sequence<33>()),
+        };
+        return tables[static_cast<int>(active_isa())].by_width[width];
+    }
+
+} // namespace
+
+constexpr size_t delta_column::block_size;
+
+delta_column::delta_column(const int32_t* values, size_t n)
+{
+    size_t full = n / block_size * block_size;
+    blocks.reserve(n / block_size);
+    for (size_t i = 0; i < full; i += block_size) {
+        encode_block(values + i, last_encoded);
+        last_encoded = values[i + block_size - 1];
+    }
+    tail.assign(values + full, values + n);
+}
+
+delta_column::delta_column(const std::vector<int32_t>& values)
+    : delta_column(values.data(), values.size())
+{
+}
+
+void delta_column::push_back(int32_t value)
+{
+    tail.push_back(value);
+    if (tail.size() == block_size) {
+        encode_block(tail.data(), last_encoded);
+        last_encoded = tail.back();
+        tail.clear();
+    }
+}
+
+void delta_column::encode_block(const int32_t* values, int32_t base)
+{
+    uint32_t z[block_size];
+    uint32_t previous = static_cast<uint32_t>(base);
+    for (size_t j = 0; j < block_size; ++j) {
+        uint32_t value = static_cast<uint32_t>(values[j]);
+        z[j] = zigzag(value - previous);
+        previous = value;
+    }
+    uint32_t reference = *std::min_element(z, z + block_size);
+    uint32_t width = bit_width(*std::max_element(z, z + block_size) - reference);
+
+    size_t offset = words.size();
+    blocks.push_back({ offset, width, base, reference });
+    if (width == 0) {
+        return;
+    }
+    words.resize(offset + width * lanes);
+    for (size_t j = 0; j < block_size; ++j) {
+        pack(words.data() + offset, width, j, z[j] - reference);
+    }
+}
+
+void delta_column::decode_block(size_t b, int32_t* out) const
+{
+    const block_header& h = blocks[b];
+    decoder_for(h.width)(words.data() + h.offset, h.reference, h.base, out);
+}
+
+int32_t delta_column::operator[](size_t i) const
+{
+    size_t b = i / block_size;
+    if (b == blocks.size()) {
+        return tail[i % block_size];
+    }
+    int32_t values[block_size];
+    decode_block(b, values);
+    return values[i % block_size];
+}
+
+void delta_column::decode(int32_t* out) const
+{
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        decode_block(b, out + b * block_size);
+    }
+    std::copy(tail.begin(), tail.end(), out + blocks.size() * block_size);
+}
+
+void delta_column::decode(size_t first, size_t count, int32_t* out) const
+{
+    size_t end = first + count;
+    size_t encoded = blocks.size() * block_size;
+    // Blocks cut by the range are decoded into a buffer
+    int32_t buffer[block_size];
+    while (first < std::min(end, encoded)) {
+        size_t b = first / block_size;
+        size_t from = first % block_size;
+        size_t to = std::min(block_size, end - b * block_size);
+        if (from == 0 && to == block_size) {
+            decode_block(b, out);
+        } else {
+            decode_block(b, buffer);
+            std::copy(buffer + from, buffer + to, out);
+        }
+        out += to - from;
+        first += to - from;
+    }
+    if (first < end) {
+        std::copy(tail.begin() + (first - encoded), tail.begin() + (end - encoded), out);
+    }
+}
+
+std::vector<int32_t> delta_column::decode() const
+{
+    std::vector<int32_t> out(size());
+    decode(out.data());
+    return out;
+}
+
+size_t delta_column::memory_bytes() const
+{
+    return words.size() * sizeof(uint32_t) + blocks.size() * sizeof(block_header) + tail.size() * sizeof(int32_t);
+}
+
+} // namespace perf
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A compressed array of int32_t for long series of close values, such as
+// measurements sampled over time.
+//
+// Values are stored in blocks of 256 as differences to their predecessor.
+// The differences are zigzag encoded, so small negative ones are small
+// too, and packed with as many bits as the widest one of the block needs
+// after subtracting the block's smallest (frame of reference). A random
+// walk with steps of up to +-100 takes 8.5 bits per value instead of 32,
+// steps of up to +-10 take 5.5 bits, a constant slope next to nothing.
+//
+// The bits of a block are interleaved over eight 32-bit lanes, so one
+// AVX2 register (or two SSE2 ones) unpacks eight consecutive differences
+// at a time, and decoding adds them up in the same registers.
+//
+// Every block has a header with its position in the packed words and the
+// value before it, so element access and decoding a range only touch the
+// blocks concerned.
+namespace perf {
+
+class delta_column {
+public:
+    static constexpr size_t block_size = 256;
+
+    delta_column() = default;
+    delta_column(const int32_t* values, size_t n);
+    explicit delta_column(const std::vector<int32_t>& values);
+
+    // Appends a value. Values collect uncompressed until they fill a block.
+    void push_back(int32_t value);
+
+    size_t size() const { return blocks.size() * block_size + tail.size(); }
+    bool empty() const { return size() == 0; }
+
+    // The value at position i < size(), decoding one block
+    int32_t operator[](size_t i) const;
+
+    // Writes all values to out[0, size())
+    void decode(int32_t* out) const;
+
+    // Writes the values at positions [first, first + count) to out
+    void decode(size_t first, size_t count, int32_t* out) const;
+
+    std::vector<int32_t> decode() const;
+
+    // Bytes used by the encoded values and block headers
+    size_t memory_bytes() const;
+
+private:
+    struct block_header {
+        // Index of the block's first packed word, 64 bit so that long
+        // columns do not wrap, sharing the word with the width
+        uint64_t offset : 58;
+        // Bits per packed difference, 0 to 32
+        uint64_t width : 6;
+        // The value before the block, 0 for the first one
+        int32_t base;
+        // Subtracted from every zigzag encoded difference before packing
+        uint32_t reference;
+    };
+
+    void encode_block(const int32_t* values, int32_t base);
+    void decode_block(size_t b, int32_t* out) const;
+
+    std::vector<block_header> blocks;
+    std::vector<uint32_t> words;
+    // The values after the last full block, not encoded yet
+    std::vector<int32_t> tail;
+    // The last value of the last full block
+    int32_t last_encoded = 0;
+};
+
+} // namespace perf
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "delta_column.h"
+#include "simd.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+// A random walk with steps in [-max_step, max_step]
+std::vector<int32_t> random_walk(size_t n, int32_t max_step, unsigned seed = 7)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int32_t> step(-max_step, max_step);
+    std::vector<int32_t> v(n);
+    int32_t height = 1000;
+    for (auto& x : v) {
+        height += step(rng);
+        x = height;
+    }
+    return v;
+}
+
+class DeltaColumn : public test_support::isa_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, DeltaColumn,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(DeltaColumn, CalculatesHeightsFromDifferences)
+{
+    std::vector<int> diff{ 0, 1, 5, -2, 10, -12 };
+    std::vector<int> heights;
+    std::partial_sum(begin(diff), end(diff), std::back_inserter(heights));
+
+    perf::delta_column column(heights);
+
+    std::vector<int> expected{ 0, 1, 6, 4, 14, 2 };
+    ASSERT_EQ(expected, column.decode());
+    ASSERT_EQ(14, column[4]);
+}
+
+TEST_P(DeltaColumn, RoundTripsEveryBitWidth)
+{
+    std::mt19937 rng(3);
+    for (int bits = 0; bits <= 32; ++bits) {
+        std::vector<int32_t> v(3 * perf::delta_column::block_size + 17);
+        for (auto& x : v) {
+            x = bits == 32 ? static_cast<int32_t>(rng()) : static_cast<int32_t>(rng() & ((uint64_t(1) << bits) - 1));
+        }
+
+        perf::delta_column column(v);
+
+        ASSERT_EQ(v, column.decode()) << bits;
+    }
+}
+
+TEST_P(DeltaColumn, ExtremeDifferencesWrapAround)
+{
+    const int32_t min = std::numeric_limits<int32_t>::min();
+    const int32_t max = std::numeric_limits<int32_t>::max();
+    std::vector<int32_t> v(1000);
+    for (size_t i = 0; i < v.size(); ++i) {
+        v[i] = i % 3 == 0 ? min : i % 3 == 1 ? max : 0;
+    }
+
+    ASSERT_EQ(v, perf::delta_column(v).decode());
+}
+
+TEST_P(DeltaColumn, CompressesSmallSteps)
+{
+    auto v = random_walk(1 << 16, 100);
+
+    perf::delta_column column(v);
+
+    ASSERT_EQ(v, column.decode());
+    // 8 bits per zigzag step plus the block headers
+    ASSERT_GT(v.size() * sizeof(int32_t) / 3.5, column.memory_bytes());
+
+    std::vector<int32_t> constant_slope(100000);
+    std::iota(begin(constant_slope), end(constant_slope), -7);
+    ASSERT_GT(constant_slope.size() / 10, perf::delta_column(constant_slope).memory_bytes());
+}
+
+TEST_P(DeltaColumn, RandomAccessAndRanges)
+{
+    auto v = random_walk(5000, 1000);
+    perf::delta_column column(v);
+
+    for (size_t i : { 0, 1, 255, 256, 257, 4095, 4096, 4999 }) {
+        ASSERT_EQ(v[i], column[i]) << i;
+    }
+    std::mt19937 rng(5);
+    for (int trial = 0; trial < 200; ++trial) {
+        size_t first = rng() % v.size();
+        size_t count = rng() % (v.size() - first + 1);
+        std::vector<int32_t> out(count);
+
+        column.decode(first, count, out.data());
+
+        ASSERT_TRUE(std::equal(begin(out), end(out), begin(v) + first)) << first << " " << count;
+    }
+}
+
+TEST_P(DeltaColumn, AppendsValueByValue)
+{
+    auto v = random_walk(1000, 50);
+    perf::delta_column column;
+
+    for (size_t i = 0; i < v.size(); ++i) {
+        column.push_back(v[i]);
+        ASSERT_EQ(i + 1, column.size());
+        ASSERT_EQ(v[i], column[i]);
+    }
+    ASSERT_EQ(v, column.decode());
+    ASSERT_EQ(perf::delta_column(v).memory_bytes(), column.memory_bytes());
+}
+
+TEST(DeltaColumnBenchmark, DISABLED_Decode)
+{
+    auto n = bench::size(1 << 25);
+    auto heights = random_walk(n, 100);
+    std::vector<int32_t> out(n);
+    perf::delta_column column(heights);
+
+    std::printf("%zu bytes uncompressed, %zu compressed\n", n * sizeof(int32_t), column.memory_bytes());
+    bench::report("memcpy", bench::best_of(5, [&] {
+        std::memcpy(out.data(), heights.data(), n * sizeof(int32_t));
+        bench::keep(out[n / 2]);
+    }), n * sizeof(int32_t));
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* names[] = { "decode scalar", "decode sse2", "decode avx2" };
+        bench::report(names[static_cast<int>(level)], bench::best_of(5, [&] {
+            column.decode(out.data());
+            bench::keep(out[n / 2]);
+        }), n * sizeof(int32_t));
+    }
+    perf::limit_isa(perf::isa::avx2);
+    bench::report("encode", bench::best_of(3, [&] {
+        bench::keep(perf::delta_column(heights).memory_bytes());
+    }), n * sizeof(int32_t));
+    std::mt19937 rng(1);
+    bench::report("1000 random accesses", bench::best_of(5, [&] {
+        int64_t sum = 0;
+        for (int i = 0; i < 1000; ++i) {
+            sum += column[rng() % n];
+        }
+        bench::keep(sum);
+    }), 1000 * sizeof(int32_t));
+}
@@ -0,0 +1,773 @@
+#pragma once
+
+#include "batch_search.h"
+#include "count.h"
+#include "parallel.h"
+#include "partition.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Execution policies for C++14, after std::execution of C++17.
+//
+// Every algorithm takes the arguments of its std namesake after a policy,
+// so that a call site switches with
+//
+//     std::accumulate(begin(v), end(v), 0)
+//     perf::accumulate(perf::execution::par, begin(v), end(v), 0)
+//
+// seq runs on the calling thread. par splits the range into blocks of
+// at least execution_grain elements and runs them on default_pool().
+// par_unseq may also reorder the additions of accumulate and
+// inner_product over arithmetic types into several running sums, so that
+// they vectorize. As with the C++17 policies, the operations must not
+// depend on the order they run in: par and par_unseq need associative
+// operators for accumulate, inner_product and partial_sum, which changes
+// the rounding of floating-point sums.
+//
+// Arrays of int32_t and ranges of a std::vector or a pointer pair go to
+// the kernels of this directory where they compute the std result:
+// count of an int32_t, accumulate and partial_sum of 32-bit integers with
+// std::plus, stable_partition, and the batched lower_bound and
+// upper_bound. Anything else runs the std algorithm on every block, or on
+// the whole range when the iterators are not random access, or when the
+// operator of accumulate cannot combine two partial results.
+namespace perf {
+
+namespace execution {
+
+    struct sequenced_policy {
+    };
+    struct parallel_policy {
+    };
+    struct parallel_unsequenced_policy {
+    };
+
+    constexpr sequenced_policy seq{};
+    constexpr parallel_policy par{};
+    constexpr parallel_unsequenced_policy par_unseq{};
+
+    template <typename T>
+    struct is_execution_policy : std::false_type {
+    };
+    template <>
+    struct is_execution_policy<sequenced_policy> : std::true_type {
+    };
+    template <>
+    struct is_execution_policy<parallel_policy> : std::true_type {
+    };
+    template <>
+    struct is_execution_policy<parallel_unsequenced_policy> : std::true_type {
+    };
+
+} // namespace execution
+
+// Blocks smaller than this stay on one thread
+constexpr size_t execution_grain = 1 << 16;
+
+namespace detail {
+
+    // The return type R of an algorithm taking a policy of type Policy
+    template <typename Policy, typename R>
+    using if_policy = std::enable_if_t<execution::is_execution_policy<std::decay_t<Policy>>::value, R>;
+
+    template <typename Policy>
+    using is_parallel = std::integral_constant<bool,
+        !std::is_same<std::decay_t<Policy>, execution::sequenced_policy>::value>;
+
+    template <typename Policy>
+    using is_unsequenced = std::is_same<std::decay_t<Policy>, execution::parallel_unsequenced_policy>;
+
+    template <typename It>
+    using value_of = typename std::iterator_traits<It>::value_type;
+
+    template <typename... It>
+    struct all_random_access : std::true_type {
+    };
+    template <typename It, typename... Rest>
+    struct all_random_access<It, Rest...> : std::integral_constant<bool,
+        std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category>::value
+            && all_random_access<Rest...>::value> {
+    };
+
+    template <typename It, typename V>
+    struct is_vector_iterator : std::integral_constant<bool, std::is_same<It, typename std::vector<V>::iterator>::value
+            || std::is_same<It, typename std::vector<V>::const_iterator>::value> {
+    };
+    // Output iterators such as std::back_insert_iterator
+    template <typename It>
+    struct is_vector_iterator<It, void> : std::false_type {
+    };
+    template <typename It>
+    struct is_vector_iterator<It, bool> : std::false_type {
+    };
+
+    // Pointers and the iterators of std::vector and std::string, whose
+    // elements are one array
+    template <typename It>
+    using is_contiguous = std::integral_constant<bool, std::is_pointer<It>::value || is_vector_iterator<It, value_of<It>>::value
+            || std::is_same<It, std::string::iterator>::value || std::is_same<It, std::string::const_iterator>::value>;
+
+    // The element array of a contiguous range of n > 0 elements
+    template <typename It>
+    auto data(It it)
+    {
+        return std::addressof(*it);
+    }
+
+    template <typename T, typename Op>
+    using is_std_plus = std::integral_constant<bool, std::is_same<Op, std::plus<>>::value || std::is_same<Op, std::plus<T>>::value>;
+
+    template <typename T, typename Op>
+    using is_std_multiplies = std::integral_constant<bool, std::is_same<Op, std::multiplies<>>::value || std::is_same<Op, std::multiplies<T>>::value>;
+
+    // Whether op(T, T) is a T and an element converts to T, so that
+    // partial results of blocks can be combined
+    template <typename T, typename Op, typename E, typename = void>
+    struct combines : std::false_type {
+    };
+    template <typename T, typename Op, typename E>
+    struct combines<T, Op, E, decltype(void(T(std::declval<Op&>()(std::declval<T>(), std::declval<T>()))), void(T(std::declval<E>())))>
+        : std::true_type {
+    };
+
+    // Combines f(begin, end) of every block, left to right. Every partial
+    // result starts as a copy of seed.
+    template <typename R, typename F, typename Combine>
+    R reduce_blocks(const block_partition& p, const R& seed, F f, Combine combine)
+    {
+        std::vector<R> partial(p.count, seed);
+        parallel_for_each_block(p, [&](size_t b, size_t begin, size_t end) {
+            partial[b] = f(b, begin, end);
+        });
+        R result = std::move(partial[0]);
+        for (size_t b = 1; b < p.count; ++b) {
+            result = combine(std::move(result), std::move(partial[b]));
+        }
+        return result;
+    }
+
+    // accumulate
+
+    // Eight running sums, which the compiler keeps in SIMD registers
+    template <typename It, typename T>
+    T unsequenced_sum(It first, size_t n, T init)
+    {
+        T sum[8] = {};
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            for (size_t j = 0; j < 8; ++j) {
+                sum[j] += first[i + j];
+            }
+        }
+        for (; i < n; ++i) {
+            sum[i % 8] += first[i];
+        }
+        return init + (((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7])));
+    }
+
+    // The accumulation of one block: a SIMD kernel, several running sums
+    // or std::accumulate
+    template <typename It, typename T, typename Op, typename Unsequenced>
+    T accumulate_block(It first, size_t n, T init, Op op, std::true_type, Unsequenced)
+    {
+        return n ? static_cast<T>(init + reduce(data(first), n, op, std::true_type())) : init;
+    }
+
+    template <typename It, typename T, typename Op>
+    T accumulate_block(It first, size_t n, T init, Op, std::false_type, std::true_type)
+    {
+        return unsequenced_sum(first, n, init);
+    }
+
+    template <typename It, typename T, typename Op>
+    T accumulate_block(It first, size_t n, T init, Op op, std::false_type, std::false_type)
+    {
+        return std::accumulate(first, first + n, std::move(init), op);
+    }
+
+    template <typename It, typename T, typename Op, typename Unsequenced>
+    T accumulate(It first, It last, T init, Op op, std::true_type, bool parallel, Unsequenced)
+    {
+        using kernel = std::integral_constant<bool, is_contiguous<It>::value
+                && std::is_same<value_of<It>, T>::value && simd_add<T, Op>::value>;
+        size_t n = last - first;
+        block_partition p(n, parallel ? execution_grain : n);
+        if (p.count == 1) {
+            return accumulate_block(first, n, std::move(init), op, kernel(), Unsequenced());
+        }
+        return reduce_blocks(p, init, [&](size_t b, size_t begin, size_t end) {
+            if (b == 0) {
+                return accumulate_block(first, end, init, op, kernel(), Unsequenced());
+            }
+            return accumulate_block(first + begin + 1, end - begin - 1, T(first[begin]), op, kernel(), Unsequenced());
+        }, op);
+    }
+
+    template <typename It, typename T, typename Op, typename Unsequenced>
+    T accumulate(It first, It last, T init, Op op, std::false_type, bool, Unsequenced)
+    {
+        return std::accumulate(first, last, std::move(init), op);
+    }
+
+    // inner_product
+
+    template <typename It1, typename It2, typename T>
+    T unsequenced_dot(It1 first1, size_t n, It2 first2, T init)
+    {
+        T sum[8] = {};
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            for (size_t j = 0; j < 8; ++j) {
+                sum[j] += first1[i + j] * first2[i + j];
+            }
+        }
+        for (; i < n; ++i) {
+            sum[i % 8] += first1[i] * first2[i];
+        }
+        return init + (((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7])));
+    }
+
+    template <typename It1, typename It2, typename T, typename Sum, typename Product>
+    T inner_product_block(It1 first1, size_t n, It2 first2, T init, Sum, Product, std::true_type)
+    {
+        return unsequenced_dot(first1, n, first2, init);
+    }
+
+    template <typename It1, typename It2, typename T, typename Sum, typename Product>
+    T inner_product_block(It1 first1, size_t n, It2 first2, T init, Sum sum, Product product, std::false_type)
+    {
+        return std::inner_product(first1, first1 + n, first2, std::move(init), sum, product);
+    }
+
+    template <typename It1, typename It2, typename T, typename Sum, typename Product, typename Unsequenced>
+    T inner_product(It1 first1, It1 last1, It2 first2, T init, Sum sum, Product product, std::true_type, Unsequenced)
+    {
+        block_partition p(last1 - first1, execution_grain);
+        if (p.count == 1) {
+            return inner_product_block(first1, p.n, first2, std::move(init), sum, product, Unsequenced());
+        }
+        return reduce_blocks(p, init, [&](size_t b, size_t begin, size_t end) {
+            if (b == 0) {
+                return inner_product_block(first1, end, first2, init, sum, product, Unsequenced());
+            }
+            return inner_product_block(first1 + begin + 1, end - begin - 1, first2 + begin + 1,
+                T(product(first1[begin], first2[begin])), sum, product, Unsequenced());
+        }, sum);
+    }
+
+    template <typename It1, typename It2, typename T, typename Sum, typename Product, typename Unsequenced>
+    T inner_product(It1 first1, It1 last1, It2 first2, T init, Sum sum, Product product, std::false_type, Unsequenced)
+    {
+        return std::inner_product(first1, last1, first2, std::move(init), sum, product);
+    }
+
+    // partial_sum
+
+    template <typename InputIt, typename OutputIt, typename Op>
+    OutputIt partial_sum(InputIt first, InputIt last, OutputIt d_first, Op op, bool parallel, std::true_type)
+    {
+        size_t n = last - first;
+        if (n == 0) {
+            return d_first;
+        }
+        if (parallel) {
+            parallel_inclusive_scan(data(first), n, data(d_first), op);
+        } else {
+            inclusive_scan(data(first), n, data(d_first), op);
+        }
+        return d_first + n;
+    }
+
+    template <typename InputIt, typename OutputIt, typename Op>
+    OutputIt partial_sum(InputIt first, InputIt last, OutputIt d_first, Op op, bool, std::false_type)
+    {
+        return std::partial_sum(first, last, d_first, op);
+    }
+
+    // transform
+
+    template <typename InputIt, typename OutputIt, typename UnaryOp>
+    OutputIt transform(InputIt first, InputIt last, OutputIt d_first, UnaryOp op, std::true_type)
+    {
+        size_t n = last - first;
+        parallel_for_each_block(block_partition(n, execution_grain), [&](size_t, size_t begin, size_t end) {
+            std::transform(first + begin, first + end, d_first + begin, op);
+        });
+        return d_first + n;
+    }
+
+    template <typename InputIt, typename OutputIt, typename UnaryOp>
+    OutputIt transform(InputIt first, InputIt last, OutputIt d_first, UnaryOp op, std::false_type)
+    {
+        return std::transform(first, last, d_first, op);
+    }
+
+    template <typename InputIt1, typename InputIt2, typename OutputIt, typename BinaryOp>
+    OutputIt transform(InputIt1 first1, InputIt1 last1, InputIt2 first2, OutputIt d_first, BinaryOp op, std::true_type)
+    {
+        size_t n = last1 - first1;
+        parallel_for_each_block(block_partition(n, execution_grain), [&](size_t, size_t begin, size_t end) {
+            std::transform(first1 + begin, first1 + end, first2 + begin, d_first + begin, op);
+        });
+        return d_first + n;
+    }
+
+    template <typename InputIt1, typename InputIt2, typename OutputIt, typename BinaryOp>
+    OutputIt transform(InputIt1 first1, InputIt1 last1, InputIt2 first2, OutputIt d_first, BinaryOp op, std::false_type)
+    {
+        return std::transform(first1, last1, first2, d_first, op);
+    }
+
+    // count
+
+    template <typename It, typename T>
+    size_t count_block(It first, size_t n, const T& value, std::true_type)
+    {
+        return n ? count_equal(data(first), n, value) : 0;
+    }
+
+    template <typename It, typename T>
+    size_t count_block(It first, size_t n, const T& value, std::false_type)
+    {
+        return std::count(first, first + n, value);
+    }
+
+    template <typename It, typename T>
+    typename std::iterator_traits<It>::difference_type count(It first, It last, const T& value, bool parallel, std::true_type)
+    {
+        using kernel = std::integral_constant<bool, is_contiguous<It>::value
+                && std::is_same<value_of<It>, int32_t>::value && std::is_same<T, int32_t>::value>;
+        block_partition p(last - first, parallel ? execution_grain : last - first);
+        return reduce_blocks(p, size_t(0), [&](size_t, size_t begin, size_t end) {
+            return count_block(first + begin, end - begin, value, kernel());
+        }, std::plus<>());
+    }
+
+    template <typename It, typename T>
+    typename std::iterator_traits<It>::difference_type count(It first, It last, const T& value, bool, std::false_type)
+    {
+        return std::count(first, last, value);
+    }
+
+    template <typename It, typename Predicate>
+    typename std::iterator_traits<It>::difference_type count_if(It first, It last, Predicate pred, std::true_type)
+    {
+        return reduce_blocks(block_partition(last - first, execution_grain), size_t(0), [&](size_t, size_t begin, size_t end) {
+            return static_cast<size_t>(std::count_if(first + begin, first + end, pred));
+        }, std::plus<>());
+    }
+
+    template <typename It, typename Predicate>
+    typename std::iterator_traits<It>::difference_type count_if(It first, It last, Predicate pred, std::false_type)
+    {
+        return std::count_if(first, last, pred);
+    }
+
+    // any_of, all_of, none_of
+
+    // Blocks look at a shared flag every this many elements and stop once
+    // another block found a match
+    constexpr size_t any_of_step = 4096;
+
+    template <typename It, typename Predicate>
+    bool any_of(It first, It last, Predicate pred, std::true_type)
+    {
+        std::atomic<bool> found{ false };
+        parallel_for_each_block(block_partition(last - first, execution_grain), [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end && !found.load(std::memory_order_relaxed); i += any_of_step) {
+                if (std::any_of(first + i, first + std::min(end, i + any_of_step), pred)) {
+                    found.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+        return found.load();
+    }
+
+    template <typename It, typename Predicate>
+    bool any_of(It first, It last, Predicate pred, std::false_type)
+    {
+        return std::any_of(first, last, pred);
+    }
+
+    // minmax_element
+
+    template <typename It, typename Compare>
+    std::pair<It, It> minmax_element(It first, It last, Compare comp, std::true_type)
+    {
+        block_partition p(last - first, execution_grain);
+        if (p.count == 1) {
+            return std::minmax_element(first, last, comp);
+        }
+        // The first smallest and the last largest element, as std
+        return reduce_blocks(p, std::make_pair(first, first), [&](size_t, size_t begin, size_t end) {
+            return std::minmax_element(first + begin, first + end, comp);
+        }, [&](std::pair<It, It> left, std::pair<It, It> right) {
+            return std::make_pair(comp(*right.first, *left.first) ? right.first : left.first,
+                comp(*right.second, *left.second) ? left.second : right.second);
+        });
+    }
+
+    template <typename It, typename Compare>
+    std::pair<It, It> minmax_element(It first, It last, Compare comp, std::false_type)
+    {
+        return std::minmax_element(first, last, comp);
+    }
+
+    // stable_partition
+
+    template <typename It, typename Predicate>
+    It stable_partition(It first, It last, Predicate pred, bool parallel, std::true_type)
+    {
+        size_t n = last - first;
+        if (n == 0) {
+            return first;
+        }
+        using T = value_of<It>;
+        // The parallel kernel copies the elements through its scratch buffer
+        if (parallel && std::is_trivially_copyable<T>::value) {
+            thread_scratch<T> scratch;
+            return first + parallel_stable_partition(data(first), n, pred, scratch.get());
+        }
+        return first + perf::stable_partition(data(first), n, pred);
+    }
+
+    template <typename It, typename Predicate>
+    It stable_partition(It first, It last, Predicate pred, bool, std::false_type)
+    {
+        return std::stable_partition(first, last, pred);
+    }
+
+    // sort: the blocks are sorted with std::sort, then merged in pairs
+    // through a buffer until one run is left. The merges of a round are
+    // cut into pieces of about execution_grain elements: the piece
+    // boundaries in the output are mapped to both runs with a binary
+    // search for where the merge path crosses them. All of the searches
+    // finish before any piece moves elements out of the runs.
+
+    struct merge_piece {
+        // The runs [first, middle) and [middle, last) merge into out [begin, end)
+        size_t first, middle, last, begin, end;
+        // Elements of the first run that go before begin and before end
+        size_t from, to;
+    };
+
+    // Where the first k elements of the merge of a[0, m) and b[0, n) end in a
+    template <typename It, typename Compare>
+    size_t merge_path(It a, size_t m, It b, size_t n, size_t k, Compare& comp)
+    {
+        size_t lo = k > n ? k - n : 0;
+        size_t hi = std::min(k, m);
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (comp(b[k - mid - 1], a[mid])) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+    // Merges the runs of in in pairs into out and returns the new run boundaries
+    template <typename In, typename Out, typename Compare>
+    std::vector<size_t> merge_round(In in, Out out, const std::vector<size_t>& runs, Compare& comp)
+    {
+        std::vector<merge_piece> pieces;
+        std::vector<size_t> merged{ 0 };
+        for (size_t r = 0; r + 1 < runs.size(); r += 2) {
+            size_t first = runs[r];
+            size_t middle = runs[r + 1];
+            size_t last = r + 2 < runs.size() ? runs[r + 2] : middle;
+            for (size_t begin = first; begin < last; begin += execution_grain) {
+                pieces.push_back({ first, middle, last, begin, std::min(last, begin + execution_grain), 0, 0 });
+            }
+            merged.push_back(last);
+        }
+
+        default_pool().parallel_for(0, pieces.size(), 1, [&](size_t p0, size_t p1) {
+            for (size_t p = p0; p < p1; ++p) {
+                merge_piece& piece = pieces[p];
+                size_t m = piece.middle - piece.first;
+                size_t n = piece.last - piece.middle;
+                piece.from = merge_path(in + piece.first, m, in + piece.middle, n, piece.begin - piece.first, comp);
+                piece.to = merge_path(in + piece.first, m, in + piece.middle, n, piece.end - piece.first, comp);
+            }
+        });
+        default_pool().parallel_for(0, pieces.size(), 1, [&](size_t p0, size_t p1) {
+            for (size_t p = p0; p < p1; ++p) {
+                const merge_piece& piece = pieces[p];
+                size_t j0 = piece.begin - piece.first - piece.from;
+                size_t j1 = piece.end - piece.first - piece.to;
+                std::merge(std::make_move_iterator(in + piece.first + piece.from), std::make_move_iterator(in + piece.first + piece.to),
+                    std::make_move_iterator(in + piece.middle + j0), std::make_move_iterator(in + piece.middle + j1),
+                    out + piece.begin, comp);
+            }
+        });
+        return merged;
+    }
+
+    template <typename It, typename Compare>
+    void sort(It first, It last, Compare comp, std::true_type)
+    {
+        using T = value_of<It>;
+        block_partition p(last - first, execution_grain);
+        if (p.count == 1) {
+            std::sort(first, last, comp);
+            return;
+        }
+        parallel_for_each_block(p, [&](size_t, size_t begin, size_t end) {
+            std::sort(first + begin, first + end, comp);
+        });
+
+        std::vector<size_t> runs;
+        for (size_t b = 0; b <= p.count; ++b) {
+            runs.push_back(p.begin(b));
+        }
+        std::unique_ptr<T[]> buffer(new T[p.n]);
+        bool in_buffer = false;
+        while (runs.size() > 2) {
+            runs = in_buffer ? merge_round(buffer.get(), first, runs, comp) : merge_round(first, buffer.get(), runs, comp);
+            in_buffer = !in_buffer;
+        }
+        if (in_buffer) {
+            parallel_for_each_block(p, [&](size_t, size_t begin, size_t end) {
+                std::move(buffer.get() + begin, buffer.get() + end, first + begin);
+            });
+        }
+    }
+
+    template <typename It, typename Compare>
+    void sort(It first, It last, Compare comp, std::false_type)
+    {
+        std::sort(first, last, comp);
+    }
+
+    // lower_bound and upper_bound for many values
+
+    template <bool Upper, typename It, typename T, typename Compare>
+    void batch_bound(It first, size_t n, const T* values, size_t count, size_t* out, Compare comp)
+    {
+        if (Upper) {
+            batch_upper_bound(n ? data(first) : nullptr, n, values, count, out, comp);
+        } else {
+            batch_lower_bound(n ? data(first) : nullptr, n, values, count, out, comp);
+        }
+    }
+
+    // Searches values[begin, end) and writes the positions to d_first[begin, end)
+    template <bool Upper, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare>
+    void bounds(ForwardIt first, ForwardIt last, InputIt values, OutputIt d_first, size_t begin, size_t end, Compare comp, std::true_type)
+    {
+        size_t positions[256];
+        size_t n = last - first;
+        for (size_t i = begin; i < end; i += 256) {
+            size_t count = std::min<size_t>(256, end - i);
+            batch_bound<Upper>(first, n, data(values + i), count, positions, comp);
+            for (size_t j = 0; j < count; ++j) {
+                d_first[i + j] = first + positions[j];
+            }
+        }
+    }
+
+    template <bool Upper, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare>
+    void bounds(ForwardIt first, ForwardIt last, InputIt values, OutputIt d_first, size_t begin, size_t end, Compare comp, std::false_type)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            d_first[i] = Upper ? std::upper_bound(first, last, values[i], comp) : std::lower_bound(first, last, values[i], comp);
+        }
+    }
+
+    template <bool Upper, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare>
+    OutputIt bounds(ForwardIt first, ForwardIt last, InputIt values_first, InputIt values_last, OutputIt d_first, Compare comp,
+        bool parallel, std::true_type)
+    {
+        using kernel = std::integral_constant<bool, is_contiguous<ForwardIt>::value && is_contiguous<InputIt>::value
+                && std::is_same<value_of<ForwardIt>, value_of<InputIt>>::value>;
+        size_t count = values_last - values_first;
+        block_partition p(count, parallel ? execution_grain / 16 : count);
+        parallel_for_each_block(p, [&](size_t, size_t begin, size_t end) {
+            bounds<Upper>(first, last, values_first, d_first, begin, end, comp, kernel());
+        });
+        return d_first + count;
+    }
+
+    template <bool Upper, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare>
+    OutputIt bounds(ForwardIt first, ForwardIt last, InputIt values_first, InputIt values_last, OutputIt d_first, Compare comp,
+        bool, std::false_type)
+    {
+        for (; values_first != values_last; ++values_first, ++d_first) {
+            *d_first = Upper ? std::upper_bound(first, last, *values_first, comp) : std::lower_bound(first, last, *values_first, comp);
+        }
+        return d_first;
+    }
+
+} // namespace detail
+
+template <typename Policy, typename InputIt, typename T, typename BinaryOp>
+detail::if_policy<Policy, T> accumulate(Policy&&, InputIt first, InputIt last, T init, BinaryOp op)
+{
+    // Blocks need random access and an operator that combines their sums
+    using blocks = std::integral_constant<bool, detail::all_random_access<InputIt>::value
+            && detail::combines<T, BinaryOp, detail::value_of<InputIt>>::value>;
+    // Only sums of arithmetic types are reordered
+    using unsequenced = std::integral_constant<bool, detail::is_unsequenced<Policy>::value && detail::is_std_plus<T, BinaryOp>::value
+            && std::is_arithmetic<T>::value && std::is_arithmetic<detail::value_of<InputIt>>::value>;
+    return detail::accumulate(first, last, std::move(init), op, blocks(), detail::is_parallel<Policy>::value, unsequenced());
+}
+
+template <typename Policy, typename InputIt, typename T>
+detail::if_policy<Policy, T> accumulate(Policy&& policy, InputIt first, InputIt last, T init)
+{
+    return perf::accumulate(policy, first, last, std::move(init), std::plus<>());
+}
+
+template <typename Policy, typename InputIt1, typename InputIt2, typename T, typename BinaryOp1, typename BinaryOp2>
+detail::if_policy<Policy, T> inner_product(Policy&&, InputIt1 first1, InputIt1 last1, InputIt2 first2, T init,
+    BinaryOp1 sum, BinaryOp2 product)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value
+            && detail::all_random_access<InputIt1, InputIt2>::value
+            && detail::combines<T, BinaryOp1, decltype(product(*first1, *first2))>::value>;
+    using unsequenced = std::integral_constant<bool, detail::is_unsequenced<Policy>::value
+            && detail::is_std_plus<T, BinaryOp1>::value && detail::is_std_multiplies<T, BinaryOp2>::value && std::is_arithmetic<T>::value
+            && std::is_arithmetic<detail::value_of<InputIt1>>::value && std::is_arithmetic<detail::value_of<InputIt2>>::value>;
+    return detail::inner_product(first1, last1, first2, std::move(init), sum, product, parallel(), unsequenced());
+}
+
+template <typename Policy, typename InputIt1, typename InputIt2, typename T>
+detail::if_policy<Policy, T> inner_product(Policy&& policy, InputIt1 first1, InputIt1 last1, InputIt2 first2, T init)
+{
+    return perf::inner_product(policy, first1, last1, first2, std::move(init), std::plus<>(), std::multiplies<>());
+}
+
+template <typename Policy, typename InputIt, typename OutputIt, typename BinaryOp>
+detail::if_policy<Policy, OutputIt> partial_sum(Policy&&, InputIt first, InputIt last, OutputIt d_first, BinaryOp op)
+{
+    using T = detail::value_of<InputIt>;
+    using kernel = std::integral_constant<bool, detail::is_contiguous<InputIt>::value && detail::is_contiguous<OutputIt>::value
+            && std::is_same<T, detail::value_of<OutputIt>>::value && !std::is_const<std::remove_reference_t<decltype(*d_first)>>::value>;
+    return detail::partial_sum(first, last, d_first, op, detail::is_parallel<Policy>::value, kernel());
+}
+
+template <typename Policy, typename InputIt, typename OutputIt>
+detail::if_policy<Policy, OutputIt> partial_sum(Policy&& policy, InputIt first, InputIt last, OutputIt d_first)
+{
+    return perf::partial_sum(policy, first, last, d_first, std::plus<>());
+}
+
+template <typename Policy, typename InputIt, typename OutputIt, typename UnaryOp>
+detail::if_policy<Policy, OutputIt> transform(Policy&&, InputIt first, InputIt last, OutputIt d_first, UnaryOp op)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value && detail::all_random_access<InputIt, OutputIt>::value>;
+    return detail::transform(first, last, d_first, op, parallel());
+}
+
+template <typename Policy, typename InputIt1, typename InputIt2, typename OutputIt, typename BinaryOp>
+detail::if_policy<Policy, OutputIt> transform(Policy&&, InputIt1 first1, InputIt1 last1, InputIt2 first2, OutputIt d_first, BinaryOp op)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value
+            && detail::all_random_access<InputIt1, InputIt2, OutputIt>::value>;
+    return detail::transform(first1, last1, first2, d_first, op, parallel());
+}
+
+template <typename Policy, typename InputIt, typename T>
+detail::if_policy<Policy, typename std::iterator_traits<InputIt>::difference_type> count(Policy&&, InputIt first, InputIt last, const T& value)
+{
+    return detail::count(first, last, value, detail::is_parallel<Policy>::value, detail::all_random_access<InputIt>());
+}
+
+template <typename Policy, typename InputIt, typename UnaryPredicate>
+detail::if_policy<Policy, typename std::iterator_traits<InputIt>::difference_type> count_if(Policy&&, InputIt first, InputIt last,
+    UnaryPredicate pred)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value && detail::all_random_access<InputIt>::value>;
+    return detail::count_if(first, last, pred, parallel());
+}
+
+template <typename Policy, typename InputIt, typename UnaryPredicate>
+detail::if_policy<Policy, bool> any_of(Policy&&, InputIt first, InputIt last, UnaryPredicate pred)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value && detail::all_random_access<InputIt>::value>;
+    return detail::any_of(first, last, pred, parallel());
+}
+
+template <typename Policy, typename InputIt, typename UnaryPredicate>
+detail::if_policy<Policy, bool> all_of(Policy&& policy, InputIt first, InputIt last, UnaryPredicate pred)
+{
+    return !perf::any_of(policy, first, last, [&](auto&& x) { return !pred(x); });
+}
+
+template <typename Policy, typename InputIt, typename UnaryPredicate>
+detail::if_policy<Policy, bool> none_of(Policy&& policy, InputIt first, InputIt last, UnaryPredicate pred)
+{
+    return !perf::any_of(policy, first, last, pred);
+}
+
+template <typename Policy, typename ForwardIt, typename Compare>
+detail::if_policy<Policy, std::pair<ForwardIt, ForwardIt>> minmax_element(Policy&&, ForwardIt first, ForwardIt last, Compare comp)
+{
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value && detail::all_random_access<ForwardIt>::value>;
+    return detail::minmax_element(first, last, comp, parallel());
+}
+
+template <typename Policy, typename ForwardIt>
+detail::if_policy<Policy, std::pair<ForwardIt, ForwardIt>> minmax_element(Policy&& policy, ForwardIt first, ForwardIt last)
+{
+    return perf::minmax_element(policy, first, last, std::less<>());
+}
+
+template <typename Policy, typename BidirIt, typename UnaryPredicate>
+detail::if_policy<Policy, BidirIt> stable_partition(Policy&&, BidirIt first, BidirIt last, UnaryPredicate pred)
+{
+    using kernel = std::integral_constant<bool, detail::is_contiguous<BidirIt>::value
+            && !std::is_const<std::remove_reference_t<decltype(*first)>>::value>;
+    return detail::stable_partition(first, last, pred, detail::is_parallel<Policy>::value, kernel());
+}
+
+template <typename Policy, typename RandomIt, typename Compare>
+detail::if_policy<Policy, void> sort(Policy&&, RandomIt first, RandomIt last, Compare comp)
+{
+    // The merges need a buffer of default constructed elements
+    using parallel = std::integral_constant<bool, detail::is_parallel<Policy>::value
+            && std::is_default_constructible<detail::value_of<RandomIt>>::value>;
+    detail::sort(first, last, comp, parallel());
+}
+
+template <typename Policy, typename RandomIt>
+detail::if_policy<Policy, void> sort(Policy&& policy, RandomIt first, RandomIt last)
+{
+    perf::sort(policy, first, last, std::less<>());
+}
+
+// d_first[i] = std::lower_bound(first, last, values_first[i], comp) for
+// every value, returns the end of the output
+template <typename Policy, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare = std::less<>>
+detail::if_policy<Policy, OutputIt> lower_bound(Policy&&, ForwardIt first, ForwardIt last, InputIt values_first, InputIt values_last,
+    OutputIt d_first, Compare comp = Compare())
+{
+    return detail::bounds<false>(first, last, values_first, values_last, d_first, comp, detail::is_parallel<Policy>::value,
+        detail::all_random_access<ForwardIt, InputIt, OutputIt>());
+}
+
+// d_first[i] = std::upper_bound(first, last, values_first[i], comp)
+template <typename Policy, typename ForwardIt, typename InputIt, typename OutputIt, typename Compare = std::less<>>
+detail::if_policy<Policy, OutputIt> upper_bound(Policy&&, ForwardIt first, ForwardIt last, InputIt values_first, InputIt values_last,
+    OutputIt d_first, Compare comp = Compare())
+{
+    return detail::bounds<true>(first, last, values_first, values_last, d_first, comp, detail::is_parallel<Policy>::value,
+        detail::all_random_access<ForwardIt, InputIt, OutputIt>());
+}
+
+} // namespace perf
@@ -0,0 +1,479 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "execution.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace execution = perf::execution;
+
+// Calls f with every policy
+template <typename F>
+void for_each_policy(F f)
+{
+    f(execution::seq);
+    f(execution::par);
+    f(execution::par_unseq);
+}
+
+using test_support::random_ints;
+
+// Large enough for several blocks
+const size_t large = 10 * perf::execution_grain + 123;
+
+struct no_default {
+    explicit no_default(int x)
+        : x(x)
+    {
+    }
+    bool operator<(const no_default& other) const { return x < other.x; }
+    int x;
+};
+
+// x -> a * x + b modulo 2^64. Composing them is associative but not
+// commutative, and takes constant time unlike concatenating strings
+struct affine {
+    uint64_t a;
+    uint64_t b;
+    bool operator==(const affine& other) const { return a == other.a && b == other.b; }
+};
+
+// x -> g(f(x))
+affine then(const affine& f, const affine& g)
+{
+    return { g.a * f.a, g.a * f.b + g.b };
+}
+
+class Execution : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST_F(Execution, SumOfVectorElements)
+{
+    std::vector<int> v{ 1, 2, 3, 4, 5 };
+
+    for_each_policy([&](auto policy) {
+        int sum = perf::accumulate(policy, begin(v), end(v), 0);
+
+        ASSERT_EQ(15, sum);
+    });
+}
+
+TEST_F(Execution, AccumulateMatchesStd)
+{
+    auto v = random_ints(large);
+    std::deque<int> d(begin(v), end(v));
+    std::vector<int64_t> wide(begin(v), end(v));
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(std::accumulate(begin(v), end(v), 7), perf::accumulate(policy, begin(v), end(v), 7));
+        ASSERT_EQ(std::accumulate(begin(d), end(d), 7), perf::accumulate(policy, begin(d), end(d), 7));
+        ASSERT_EQ(std::accumulate(begin(wide), end(wide), int64_t(7)), perf::accumulate(policy, begin(wide), end(wide), int64_t(7)));
+        // Unsigned, so that the product wraps instead of overflowing
+        ASSERT_EQ(std::accumulate(begin(v), end(v), 1ULL, std::multiplies<>()),
+            perf::accumulate(policy, begin(v), end(v), 1ULL, std::multiplies<>()));
+        ASSERT_EQ(0, perf::accumulate(policy, v.data(), v.data(), 0));
+    });
+}
+
+TEST_F(Execution, AccumulateKeepsTheOrderOfOperands)
+{
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 5000; ++i) {
+        words.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+    }
+    // Concatenation is quadratic, so the blocks are left to the maps
+    std::mt19937_64 rng(4);
+    std::vector<affine> maps(large);
+    for (auto& f : maps) {
+        f = { rng() | 1, rng() };
+    }
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(std::accumulate(begin(words), end(words), std::string(">")),
+            perf::accumulate(policy, begin(words), end(words), std::string(">")));
+        ASSERT_EQ(std::accumulate(begin(maps), end(maps), affine{ 1, 0 }, then),
+            perf::accumulate(policy, begin(maps), end(maps), affine{ 1, 0 }, then));
+    });
+}
+
+TEST_F(Execution, ConvertAVectorToString)
+{
+    std::vector<int> v{ 1, 2, 3, 4, 5 };
+
+    for_each_policy([&](auto policy) {
+        // The operator cannot combine two strings, so this runs sequentially
+        auto s = perf::accumulate(policy, std::next(begin(v)), end(v), std::to_string(v[0]),
+            [](auto& acc, auto& x) { return acc + ", " + std::to_string(x); });
+
+        ASSERT_EQ("[1, 2, 3, 4, 5]", "[" + s + "]");
+    });
+}
+
+TEST_F(Execution, SumsFloatingPointClosely)
+{
+    std::vector<double> v(large);
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> dist(0, 1);
+    std::generate(begin(v), end(v), [&] { return dist(rng); });
+    double exact = std::accumulate(begin(v), end(v), 0.0L);
+
+    for_each_policy([&](auto policy) {
+        ASSERT_NEAR(exact, perf::accumulate(policy, begin(v), end(v), 0.0), 1e-9 * exact);
+        ASSERT_NEAR(exact, perf::accumulate(policy, begin(v), end(v), 0.0f), 1e-3 * exact);
+    });
+}
+
+TEST_F(Execution, InnerProductOfVectors)
+{
+    std::vector<int> v1{ 1, 2, 3, 4, 5 };
+    std::vector<int> v2{ 2, 2, 2, 2, 2 };
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(30, perf::inner_product(policy, begin(v1), end(v1), begin(v2), 0));
+    });
+}
+
+TEST_F(Execution, CountEqualElements)
+{
+    auto a = random_ints(large, 0, 9, 1);
+    auto b = random_ints(large, 0, 9, 2);
+    auto expected = std::inner_product(begin(a), end(a), begin(b), 0, std::plus<int>(), std::equal_to<int>());
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(expected, perf::inner_product(policy, begin(a), end(a), begin(b), 0, std::plus<int>(), std::equal_to<int>()));
+        ASSERT_EQ(std::inner_product(begin(a), end(a), begin(b), 0.0), perf::inner_product(policy, begin(a), end(a), begin(b), 0.0));
+    });
+}
+
+TEST_F(Execution, PartialSumOfVectors)
+{
+    std::vector<int> v{ 1, 1, 1, 1, 1 };
+
+    for_each_policy([&](auto policy) {
+        std::vector<int> partial_sums;
+        perf::partial_sum(policy, begin(v), end(v), std::back_inserter(partial_sums));
+
+        std::vector<int> expected{ 1, 2, 3, 4, 5 };
+        ASSERT_EQ(expected, partial_sums);
+    });
+}
+
+TEST_F(Execution, PartialSumMatchesStd)
+{
+    auto v = random_ints(large);
+    std::vector<int> expected(v.size());
+    std::partial_sum(begin(v), end(v), begin(expected));
+    std::deque<int> d(begin(v), end(v));
+
+    for_each_policy([&](auto policy) {
+        std::vector<int> out(v.size());
+        ASSERT_EQ(end(out), perf::partial_sum(policy, begin(v), end(v), begin(out)));
+        ASSERT_EQ(expected, out);
+
+        auto in_place = v;
+        perf::partial_sum(policy, begin(in_place), end(in_place), begin(in_place));
+        ASSERT_EQ(expected, in_place);
+
+        std::deque<int> from_deque(v.size());
+        perf::partial_sum(policy, begin(d), end(d), begin(from_deque));
+        ASSERT_TRUE(std::equal(begin(expected), end(expected), begin(from_deque)));
+    });
+}
+
+TEST_F(Execution, TransformMatchesStd)
+{
+    auto a = random_ints(large, -1000, 1000, 1);
+    auto b = random_ints(large, -1000, 1000, 2);
+    std::vector<int> squares(a.size());
+    std::transform(begin(a), end(a), begin(squares), [](int x) { return x * x; });
+    std::vector<int> sums(a.size());
+    std::transform(begin(a), end(a), begin(b), begin(sums), std::plus<>());
+
+    for_each_policy([&](auto policy) {
+        std::vector<int> out(a.size());
+        ASSERT_EQ(end(out), perf::transform(policy, begin(a), end(a), begin(out), [](int x) { return x * x; }));
+        ASSERT_EQ(squares, out);
+        ASSERT_EQ(end(out), perf::transform(policy, begin(a), end(a), begin(b), begin(out), std::plus<>()));
+        ASSERT_EQ(sums, out);
+    });
+}
+
+TEST_F(Execution, CreateMapFromKeysAndValues)
+{
+    std::vector<std::string> keys{ "Helsinki", "Espoo", "Tampere", "Vantaa", "Oulu" };
+    std::vector<int> values{ 639'222, 276'087, 228'942, 220'908, 200'600 };
+
+    for_each_policy([&](auto policy) {
+        std::map<std::string, int> population;
+        perf::transform(policy, begin(keys), end(keys), begin(values), std::inserter(population, begin(population)),
+            [](auto k, auto v) { return std::make_pair(k, v); });
+
+        ASSERT_EQ(5, population.size());
+        ASSERT_EQ(639'222, population["Helsinki"]);
+    });
+}
+
+TEST_F(Execution, FindZeroCrossingOfCosine)
+{
+    for_each_policy([&](auto policy) {
+        std::vector<double> c(628300);
+
+        std::iota(begin(c), end(c), 0);
+        perf::transform(policy, begin(c), end(c), begin(c), [](auto d) { return std::cos(d / 100000.0); });
+
+        double zero = 0.0;
+        std::vector<double>::iterator result;
+        perf::upper_bound(policy, begin(c), end(c), &zero, &zero + 1, &result, std::greater<double>());
+        ASSERT_EQ(157080, result - begin(c));
+    });
+}
+
+TEST_F(Execution, CountZeroesAndEvens)
+{
+    std::vector<int> v{ 0, 1, 2, 4, 0, 1, 2 };
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(2, perf::count(policy, begin(v), end(v), 0));
+        ASSERT_EQ(5, perf::count_if(policy, begin(v), end(v), [](auto n) { return n % 2 == 0; }));
+    });
+}
+
+TEST_F(Execution, CountMatchesStd)
+{
+    auto v = random_ints(large, 0, 20);
+    std::list<int> l(begin(v), end(v));
+    std::vector<long> wide(begin(v), end(v));
+
+    for_each_policy([&](auto policy) {
+        ASSERT_EQ(std::count(begin(v), end(v), 7), perf::count(policy, begin(v), end(v), 7));
+        ASSERT_EQ(std::count(begin(v), end(v), 7), perf::count(policy, v.data(), v.data() + v.size(), 7));
+        ASSERT_EQ(std::count(begin(v), end(v), 7), perf::count(policy, begin(l), end(l), 7));
+        ASSERT_EQ(std::count(begin(v), end(v), 7), perf::count(policy, begin(wide), end(wide), 7));
+        auto large_values = [](int x) { return x > 15; };
+        ASSERT_EQ(std::count_if(begin(v), end(v), large_values), perf::count_if(policy, begin(v), end(v), large_values));
+    });
+}
+
+TEST_F(Execution, AnyAllNone)
+{
+    std::string s{ "hello, world" };
+    std::vector<int> odd(large, 3);
+
+    for_each_policy([&](auto policy) {
+        ASSERT_TRUE(perf::any_of(policy, begin(s), end(s), [](auto c) { return c == ' '; }));
+        ASSERT_FALSE(perf::any_of(policy, begin(s), end(s), [](auto c) { return std::isupper(c); }));
+        ASSERT_TRUE(perf::all_of(policy, begin(odd), end(odd), [](auto n) { return n % 2 == 1; }));
+        ASSERT_TRUE(perf::none_of(policy, begin(odd), end(odd), [](auto n) { return n == 4; }));
+
+        for (size_t at : { size_t(0), large / 2, large - 1 }) {
+            odd[at] = 4;
+            ASSERT_TRUE(perf::any_of(policy, begin(odd), end(odd), [](auto n) { return n == 4; })) << at;
+            ASSERT_FALSE(perf::all_of(policy, begin(odd), end(odd), [](auto n) { return n % 2 == 1; })) << at;
+            odd[at] = 3;
+        }
+        ASSERT_FALSE(perf::any_of(policy, begin(odd), begin(odd), [](auto) { return true; }));
+    });
+}
+
+TEST_F(Execution, FindMinimumAndMaximumElement)
+{
+    std::vector<int> v{ 1, 6, 3, 7, 9, 4, 12, 2 };
+
+    for_each_policy([&](auto policy) {
+        auto minmax = perf::minmax_element(policy, begin(v), end(v));
+
+        ASSERT_EQ(1, *minmax.first);
+        ASSERT_EQ(12, *minmax.second);
+    });
+}
+
+TEST_F(Execution, MinmaxElementPicksFirstMinimumAndLastMaximum)
+{
+    // Few distinct values, so every block has the extremes
+    auto v = random_ints(large, 0, 5);
+
+    for_each_policy([&](auto policy) {
+        auto expected = std::minmax_element(begin(v), end(v));
+        ASSERT_EQ(expected, perf::minmax_element(policy, begin(v), end(v)));
+        auto reversed = std::minmax_element(begin(v), end(v), std::greater<>());
+        ASSERT_EQ(reversed, perf::minmax_element(policy, begin(v), end(v), std::greater<>()));
+    });
+}
+
+TEST_F(Execution, StablePartitionMatchesStd)
+{
+    auto v = random_ints(large);
+    auto is_even = [](int x) { return x % 2 == 0; };
+    auto expected = v;
+    auto expected_middle = std::stable_partition(begin(expected), end(expected), is_even) - begin(expected);
+
+    for_each_policy([&](auto policy) {
+        auto copy = v;
+        ASSERT_EQ(expected_middle, perf::stable_partition(policy, begin(copy), end(copy), is_even) - begin(copy));
+        ASSERT_EQ(expected, copy);
+
+        std::deque<int> d(begin(v), end(v));
+        ASSERT_EQ(expected_middle, perf::stable_partition(policy, begin(d), end(d), is_even) - begin(d));
+        ASSERT_TRUE(std::equal(begin(expected), end(expected), begin(d)));
+
+        std::vector<std::string> numbers{ "1", "2", "3", "3", "2", "4", "2", "1", "5" };
+        perf::stable_partition(policy, begin(numbers), end(numbers), [](auto& x) { return x == "2"; });
+        ASSERT_EQ((std::vector<std::string>{ "2", "2", "2", "1", "3", "3", "4", "1", "5" }), numbers);
+    });
+}
+
+TEST_F(Execution, SortMatchesStd)
+{
+    for (size_t n : { size_t(0), size_t(1), size_t(1000), large, 3 * large + 7 }) {
+        auto v = random_ints(n, -1000000, 1000000);
+        auto expected = v;
+        std::sort(begin(expected), end(expected));
+
+        for_each_policy([&](auto policy) {
+            auto copy = v;
+            perf::sort(policy, begin(copy), end(copy));
+            ASSERT_EQ(expected, copy) << n;
+
+            std::deque<int> d(begin(v), end(v));
+            perf::sort(policy, begin(d), end(d), std::greater<>());
+            ASSERT_TRUE(std::equal(expected.rbegin(), expected.rend(), begin(d))) << n;
+        });
+    }
+}
+
+TEST_F(Execution, SortsStringsAndTypesWithoutDefaultConstructor)
+{
+    auto ints = random_ints(large, 0, 1 << 30);
+    std::vector<std::string> strings;
+    std::vector<no_default> objects;
+    for (int x : ints) {
+        strings.push_back(std::to_string(x));
+        objects.emplace_back(x);
+    }
+    auto expected = strings;
+    std::sort(begin(expected), end(expected));
+    std::sort(begin(ints), end(ints));
+
+    for_each_policy([&](auto policy) {
+        auto copy = strings;
+        perf::sort(policy, begin(copy), end(copy));
+        ASSERT_EQ(expected, copy);
+
+        auto objects_copy = objects;
+        perf::sort(policy, begin(objects_copy), end(objects_copy));
+        for (size_t i = 0; i < ints.size(); ++i) {
+            ASSERT_EQ(ints[i], objects_copy[i].x);
+        }
+    });
+}
+
+TEST_F(Execution, LowerBound)
+{
+    std::vector<int> v{ 1, 1, 2, 3, 3, 3 };
+    int two = 2;
+
+    for_each_policy([&](auto policy) {
+        std::vector<int>::iterator result;
+        perf::lower_bound(policy, begin(v), end(v), &two, &two + 1, &result);
+        ASSERT_EQ(2, result - begin(v));
+        perf::upper_bound(policy, begin(v), end(v), &two, &two + 1, &result);
+        ASSERT_EQ(3, result - begin(v));
+    });
+}
+
+TEST_F(Execution, BatchedBoundsMatchStd)
+{
+    auto sorted = random_ints(100000, -50000, 50000, 1);
+    std::sort(begin(sorted), end(sorted));
+    auto values = random_ints(large, -60000, 60000, 2);
+    std::deque<int> d(begin(sorted), end(sorted));
+
+    for_each_policy([&](auto policy) {
+        std::vector<std::vector<int>::const_iterator> lower(values.size());
+        std::vector<std::vector<int>::const_iterator> upper(values.size());
+        ASSERT_EQ(end(lower), perf::lower_bound(policy, sorted.cbegin(), sorted.cend(), begin(values), end(values), begin(lower)));
+        perf::upper_bound(policy, sorted.cbegin(), sorted.cend(), begin(values), end(values), begin(upper));
+        std::vector<std::deque<int>::iterator> in_deque(values.size());
+        perf::lower_bound(policy, begin(d), end(d), begin(values), end(values), begin(in_deque));
+
+        for (size_t i = 0; i < values.size(); ++i) {
+            ASSERT_EQ(std::lower_bound(sorted.cbegin(), sorted.cend(), values[i]), lower[i]) << i;
+            ASSERT_EQ(std::upper_bound(sorted.cbegin(), sorted.cend(), values[i]), upper[i]) << i;
+            ASSERT_EQ(lower[i] - sorted.cbegin(), in_deque[i] - begin(d)) << i;
+        }
+    });
+}
+
+TEST_F(Execution, RethrowsExceptionsOfTheOperations)
+{
+    auto v = random_ints(large);
+
+    for_each_policy([&](auto policy) {
+        ASSERT_THROW(perf::count_if(policy, begin(v), end(v), [](int x) {
+            if (x == 1000) {
+                throw std::runtime_error("predicate");
+            }
+            return false;
+        }),
+            std::runtime_error);
+        ASSERT_THROW(perf::sort(policy, begin(v), end(v), [](int a, int b) {
+            if (a == 1000 || b == 1000) {
+                throw std::runtime_error("comparison");
+            }
+            return a < b;
+        }),
+            std::runtime_error);
+    });
+}
+
+TEST(ExecutionBenchmark, DISABLED_Policies)
+{
+    auto n = bench::size(1 << 25);
+    auto v = random_ints(n, -1000000, 1000000);
+    std::vector<float> f(begin(v), end(v));
+    std::vector<int> out(n);
+    const char* names[] = { "seq", "par", "par_unseq" };
+
+    auto run = [&](const char* algorithm, auto std_version, auto perf_version) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s std", algorithm);
+        bench::report(name, bench::best_of(3, std_version), n * sizeof(int));
+        int i = 0;
+        for_each_policy([&](auto policy) {
+            std::snprintf(name, sizeof(name), "%s %s", algorithm, names[i++]);
+            bench::report(name, bench::best_of(3, [&] { perf_version(policy); }), n * sizeof(int));
+        });
+    };
+
+    run("accumulate int", [&] { bench::keep(std::accumulate(begin(v), end(v), 0)); },
+        [&](auto policy) { bench::keep(perf::accumulate(policy, begin(v), end(v), 0)); });
+    run("accumulate float", [&] { bench::keep(std::accumulate(begin(f), end(f), 0.0f)); },
+        [&](auto policy) { bench::keep(perf::accumulate(policy, begin(f), end(f), 0.0f)); });
+    run("inner_product float", [&] { bench::keep(std::inner_product(begin(f), end(f), begin(f), 0.0f)); },
+        [&](auto policy) { bench::keep(perf::inner_product(policy, begin(f), end(f), begin(f), 0.0f)); });
+    run("partial_sum", [&] { std::partial_sum(begin(v), end(v), begin(out)); bench::keep(out[0]); },
+        [&](auto policy) { perf::partial_sum(policy, begin(v), end(v), begin(out)); bench::keep(out[0]); });
+    run("count", [&] { bench::keep(std::count(begin(v), end(v), 7)); },
+        [&](auto policy) { bench::keep(perf::count(policy, begin(v), end(v), 7)); });
+    run("minmax_element", [&] { bench::keep(std::minmax_element(begin(v), end(v))); },
+        [&](auto policy) { bench::keep(perf::minmax_element(policy, begin(v), end(v))); });
+    run("sort", [&] { out = v; std::sort(begin(out), end(out)); bench::keep(out[0]); },
+        [&](auto policy) { out = v; perf::sort(policy, begin(out), end(out)); bench::keep(out[0]); });
+}
@@ -0,0 +1,255 @@
+#include "external_sort.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace perf {
+
+namespace {
+
+    std::runtime_error io_error(const char* what, const std::string& path)
+    {
+        return std::runtime_error(std::string("external sort: cannot ") + what + " " + path + ": " + std::strerror(errno));
+    }
+
+    std::FILE* open(const std::string& path, const char* mode)
+    {
+        std::FILE* file = std::fopen(path.c_str(), mode);
+        if (!file) {
+            throw io_error("open", path);
+        }
+        // The buffers are large enough already
+        std::setvbuf(file, nullptr, _IONBF, 0);
+        return file;
+    }
+
+} // namespace
+
+namespace detail {
+
+    io_thread::io_thread()
+        : thread([this] { run(); })
+    {
+    }
+
+    io_thread::~io_thread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        thread.join();
+    }
+
+    std::future<size_t> io_thread::submit(std::function<size_t()> job)
+    {
+        std::packaged_task<size_t()> task(std::move(job));
+        auto done = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(task));
+        }
+        ready.notify_one();
+        return done;
+    }
+
+    void io_thread::run()
+    {
+        for (;;) {
+            std::packaged_task<size_t()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                task = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            task();
+        }
+    }
+
+    temp_file::temp_file(const std::string& directory)
+    {
+        std::string pattern = directory + "/perf-sort-XXXXXX";
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back('\0');
+        int fd = mkstemp(path.data());
+        if (fd < 0) {
+            throw io_error("create a file in", directory);
+        }
+        ::close(fd);
+        name = path.data();
+    }
+
+    temp_file::~temp_file()
+    {
+        if (!name.empty()) {
+            std::remove(name.c_str());
+        }
+    }
+
+    temp_file::temp_file(temp_file&& other) noexcept
+        : name(std::move(other.name))
+    {
+        other.name.clear();
+    }
+
+    temp_file& temp_file::operator=(temp_file&& other) noexcept
+    {
+        if (this != &other) {
+            if (!name.empty()) {
+                std::remove(name.c_str());
+            }
+            name = std::move(other.name);
+            other.name.clear();
+        }
+        return *this;
+    }
+
+    async_writer::async_writer(io_thread& io, const std::string& path, size_t buffer_bytes)
+        : io(io)
+        , path(path)
+        , file(open(path, "wb"))
+        , buffers{ std::vector<char>(buffer_bytes), std::vector<char>(buffer_bytes) }
+    {
+    }
+
+    async_writer::~async_writer()
+    {
+        if (pending.valid()) {
+            pending.wait();
+        }
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    void async_writer::write(const void* data, size_t bytes)
+    {
+        auto p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            size_t n = std::min(bytes, buffers[current].size() - used);
+            std::memcpy(buffers[current].data() + used, p, n);
+            used += n;
+            p += n;
+            bytes -= n;
+            if (used == buffers[current].size()) {
+                flush();
+            }
+        }
+    }
+
+    void async_writer::flush()
+    {
+        // The other buffer is free once its write is done
+        if (pending.valid()) {
+            pending.get();
+        }
+        std::FILE* f = file;
+        const char* data = buffers[current].data();
+        size_t n = used;
+        std::string name = path;
+        pending = io.submit([f, data, n, name] {
+            if (std::fwrite(data, 1, n, f) != n) {
+                throw io_error("write", name);
+            }
+            return n;
+        });
+        current ^= 1;
+        used = 0;
+    }
+
+    void async_writer::close()
+    {
+        if (used > 0) {
+            flush();
+        }
+        if (pending.valid()) {
+            pending.get();
+        }
+        int failed = std::fclose(file);
+        file = nullptr;
+        if (failed) {
+            throw io_error("write", path);
+        }
+    }
+
+    async_reader::async_reader(io_thread& io, const std::string& path, size_t buffer_bytes)
+        : io(io)
+        , path(path)
+        , file(open(path, "rb"))
+        , buffers{ std::vector<char>(buffer_bytes), std::vector<char>(buffer_bytes) }
+    {
+        read_ahead();
+    }
+
+    async_reader::~async_reader()
+    {
+        if (pending.valid()) {
+            pending.wait();
+        }
+        std::fclose(file);
+    }
+
+    std::pair<const char*, size_t> async_reader::next()
+    {
+        if (!pending.valid()) {
+            return { nullptr, 0 };
+        }
+        size_t n = pending.get();
+        const char* data = buffers[current].data();
+        if (n > 0) {
+            // The caller is done with the other buffer
+            current ^= 1;
+            read_ahead();
+        }
+        return { data, n };
+    }
+
+    void async_reader::read_ahead()
+    {
+        std::FILE* f = file;
+        char* data = buffers[current].data();
+        size_t size = buffers[current].size();
+        std::string name = path;
+        pending = io.submit([f, data, size, name] {
+            size_t n = std::fread(data, 1, size, f);
+            if (n < size && std::ferror(f)) {
+                throw io_error("read", name);
+            }
+            return n;
+        });
+    }
+
+    std::string default_temp_directory()
+    {
+        const char* dir = std::getenv("TMPDIR");
+        return dir && *dir ? dir : "/tmp";
+    }
+
+    size_t write_file(const std::string& path, const void* data, size_t bytes)
+    {
+        std::FILE* file = open(path, "wb");
+        bool failed = std::fwrite(data, 1, bytes, file) != bytes;
+        if (std::fclose(file) != 0 || failed) {
+            throw io_error("write", path);
+        }
+        return bytes;
+    }
+
+    size_t io_buffer_bytes(const external_sort_options& options, size_t element_size)
+    {
+        size_t bytes = std::min(options.io_buffer, options.memory_budget / 8);
+        return std::max(element_size, bytes / element_size * element_size);
+    }
+
+} // namespace detail
+
+} // namespace perf
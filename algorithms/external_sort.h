@@ -0,0 +1,607 @@
+#pragma once
+
+#include "execution.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Sorting more data than fits in memory.
+//
+// external_sorter collects elements into one of two run buffers. When it
+// is full it is sorted with perf::sort(execution::par, ...) and handed to
+// the I/O thread, which writes it to a temporary file straight from the
+// buffer while the next run fills the other one; pushing only waits when
+// that one is full before the write is done. At the end the runs are
+// merged k at a time through a loser tree: every inner node keeps the
+// loser of the match played there, so taking the smallest element and
+// replaying the path of its run costs log2(k) comparisons. When there are
+// more runs than the memory budget has read buffers for, groups of them
+// are merged into longer runs first.
+//
+// All file I/O is sequential and happens on a thread of its own. Runs are
+// written in one piece; the merges read and write in buffers of io_buffer
+// bytes, two per file, one filled or drained by that thread while the
+// merge works on the other, so reads run ahead of the merge and writes
+// behind it.
+//
+// The result is a sorted_stream that hands out the elements in order, or
+// a file written from it. Nothing is spilled when everything fits in the
+// budget. Elements are written to disk as they are in memory, so they
+// must be trivially copyable, and the sort is not stable. I/O errors
+// throw std::runtime_error.
+namespace perf {
+
+struct external_sort_options {
+    // Bytes for the two run buffers, the scratch of the parallel sort and
+    // the I/O buffers together
+    size_t memory_budget = size_t(256) << 20;
+    // Where runs are spilled; empty for $TMPDIR, or /tmp without it
+    std::string temp_directory;
+    // Bytes per read or write, at most an eighth of the budget
+    size_t io_buffer = size_t(1) << 20;
+};
+
+namespace detail {
+
+    // Runs blocking reads and writes in the order they are submitted, on
+    // a thread of its own. Exceptions of a job go to its future.
+    class io_thread {
+    public:
+        io_thread();
+        ~io_thread();
+
+        io_thread(const io_thread&) = delete;
+        io_thread& operator=(const io_thread&) = delete;
+
+        std::future<size_t> submit(std::function<size_t()> job);
+
+    private:
+        void run();
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::packaged_task<size_t()>> jobs;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    // A new empty file in `directory`, removed again with this object
+    class temp_file {
+    public:
+        explicit temp_file(const std::string& directory);
+        ~temp_file();
+
+        temp_file(temp_file&& other) noexcept;
+        temp_file& operator=(temp_file&& other) noexcept;
+
+        const std::string& path() const { return name; }
+
+    private:
+        std::string name;
+    };
+
+    // Writes a file through two buffers: a full one goes to the I/O
+    // thread while the other fills up
+    class async_writer {
+    public:
+        async_writer(io_thread& io, const std::string& path, size_t buffer_bytes);
+        ~async_writer();
+
+        async_writer(const async_writer&) = delete;
+        async_writer& operator=(const async_writer&) = delete;
+
+        void write(const void* data, size_t bytes);
+        // Writes what is buffered and closes the file
+        void close();
+
+    private:
+        void flush();
+
+        io_thread& io;
+        std::string path;
+        std::FILE* file;
+        std::vector<char> buffers[2];
+        size_t current = 0;
+        size_t used = 0;
+        std::future<size_t> pending;
+    };
+
+    // Reads a file through two buffers: the I/O thread reads the next
+    // chunk while the caller works on the last one
+    class async_reader {
+    public:
+        async_reader(io_thread& io, const std::string& path, size_t buffer_bytes);
+        ~async_reader();
+
+        async_reader(const async_reader&) = delete;
+        async_reader& operator=(const async_reader&) = delete;
+
+        // The next chunk of buffer_bytes, less at the end of the file and
+        // none after it. Valid until the next call.
+        std::pair<const char*, size_t> next();
+
+    private:
+        void read_ahead();
+
+        io_thread& io;
+        std::string path;
+        std::FILE* file;
+        std::vector<char> buffers[2];
+        size_t current = 0;
+        std::future<size_t> pending;
+    };
+
+    // Tournament over k sources. beats(a, b) tells whether the head of
+    // source a goes before the head of source b.
+    class loser_tree {
+    public:
+        template <typename Beats>
+        void build(size_t k, Beats beats)
+        {
+            std::vector<size_t> winners(2 * k);
+            losers.assign(k, 0);
+            for (size_t i = 0; i < k; ++i) {
+                winners[k + i] = i;
+            }
+            for (size_t node = k - 1; node >= 1; --node) {
+                size_t left = winners[2 * node];
+                size_t right = winners[2 * node + 1];
+                bool left_wins = beats(left, right);
+                winners[node] = left_wins ? left : right;
+                losers[node] = left_wins ? right : left;
+            }
+            top = k > 1 ? winners[1] : 0;
+        }
+
+        size_t winner() const { return top; }
+
+        // After the head of winner() changed
+        template <typename Beats>
+        void replay(Beats beats)
+        {
+            size_t w = top;
+            for (size_t node = (w + losers.size()) / 2; node >= 1; node /= 2) {
+                if (beats(losers[node], w)) {
+                    std::swap(losers[node], w);
+                }
+            }
+            top = w;
+        }
+
+    private:
+        std::vector<size_t> losers;
+        size_t top = 0;
+    };
+
+    template <typename T>
+    class run_reader {
+    public:
+        run_reader(io_thread& io, const std::string& path, size_t buffer_bytes)
+            : file(io, path, buffer_bytes)
+        {
+            fetch();
+        }
+
+        bool empty() const { return pos == count; }
+        const T& head() const { return chunk[pos]; }
+
+        void pop()
+        {
+            if (++pos == count) {
+                fetch();
+            }
+        }
+
+    private:
+        void fetch()
+        {
+            auto next = file.next();
+            chunk = reinterpret_cast<const T*>(next.first);
+            count = next.second / sizeof(T);
+            pos = 0;
+        }
+
+        async_reader file;
+        const T* chunk = nullptr;
+        size_t count = 0;
+        size_t pos = 0;
+    };
+
+    // Merges sorted runs; ties go to the earlier run
+    template <typename T, typename Compare>
+    class run_merger {
+    public:
+        run_merger(io_thread& io, const std::vector<temp_file>& runs, size_t first, size_t last, size_t buffer_bytes, Compare comp)
+            : comp(comp)
+        {
+            for (size_t r = first; r < last; ++r) {
+                sources.emplace_back(new run_reader<T>(io, runs[r].path(), buffer_bytes));
+            }
+            tree.build(sources.size(), beats());
+        }
+
+        // Writes up to n of the smallest elements left to out, returns how
+        // many
+        size_t read(T* out, size_t n)
+        {
+            auto b = beats();
+            size_t i = 0;
+            while (i < n) {
+                run_reader<T>& source = *sources[tree.winner()];
+                if (source.empty()) {
+                    break;
+                }
+                out[i++] = source.head();
+                source.pop();
+                tree.replay(b);
+            }
+            return i;
+        }
+
+    private:
+        struct beats_fn {
+            bool operator()(size_t a, size_t b) const
+            {
+                const run_reader<T>& x = *m->sources[a];
+                const run_reader<T>& y = *m->sources[b];
+                if (x.empty() || y.empty()) {
+                    return !x.empty() || (y.empty() && a < b);
+                }
+                return m->comp(x.head(), y.head()) || (!m->comp(y.head(), x.head()) && a < b);
+            }
+
+            const run_merger* m;
+        };
+
+        beats_fn beats() const { return beats_fn{ this }; }
+
+        Compare comp;
+        std::vector<std::unique_ptr<run_reader<T>>> sources;
+        loser_tree tree;
+    };
+
+    std::string default_temp_directory();
+
+    // Writes `bytes` to the file at `path`, replacing it. Returns bytes.
+    size_t write_file(const std::string& path, const void* data, size_t bytes);
+
+    // Bytes per read or write: options.io_buffer, at most an eighth of the
+    // budget, in whole elements
+    size_t io_buffer_bytes(const external_sort_options& options, size_t element_size);
+
+} // namespace detail
+
+template <typename T, typename Compare>
+class external_sorter;
+
+// The sorted elements, in order
+template <typename T, typename Compare = std::less<>>
+class sorted_stream {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator() = default;
+        explicit iterator(sorted_stream* s)
+            : s(s)
+        {
+            ++*this;
+        }
+
+        const T& operator*() const { return value; }
+        const T* operator->() const { return &value; }
+
+        iterator& operator++()
+        {
+            if (!s->next(value)) {
+                s = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return s == other.s; }
+        bool operator!=(const iterator& other) const { return s != other.s; }
+
+    private:
+        sorted_stream* s = nullptr;
+        T value;
+    };
+
+    // The next element, false after the last one
+    bool next(T& x)
+    {
+        if (pos == count && !refill()) {
+            return false;
+        }
+        x = buffer[pos++];
+        return true;
+    }
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+    // Number of elements sorted
+    size_t size() const { return total; }
+
+    // Writes the elements not read yet to a file
+    void write(const std::string& path)
+    {
+        detail::async_writer out(*io, path, io_bytes);
+        do {
+            out.write(buffer.data() + pos, (count - pos) * sizeof(T));
+            pos = count;
+        } while (refill());
+        out.close();
+    }
+
+private:
+    friend class external_sorter<T, Compare>;
+
+    sorted_stream(size_t io_bytes, size_t total)
+        : io(new detail::io_thread)
+        , io_bytes(io_bytes)
+        , total(total)
+    {
+    }
+
+    bool refill()
+    {
+        pos = 0;
+        count = merger ? merger->read(buffer.data(), buffer.size()) : 0;
+        return count > 0;
+    }
+
+    // Declared in this order so that the readers stop first, then the
+    // runs are removed, then the I/O thread
+    std::unique_ptr<detail::io_thread> io;
+    std::vector<detail::temp_file> runs;
+    std::unique_ptr<detail::run_merger<T, Compare>> merger;
+    size_t io_bytes;
+    size_t total;
+    std::vector<T> buffer;
+    size_t pos = 0;
+    size_t count = 0;
+};
+
+template <typename T, typename Compare = std::less<>>
+class external_sorter {
+    static_assert(std::is_trivially_copyable<T>::value, "external_sorter writes the bytes of the elements to files");
+
+public:
+    explicit external_sorter(const external_sort_options& options = external_sort_options(), Compare comp = Compare())
+        : options(options)
+        , comp(comp)
+        , io(new detail::io_thread)
+    {
+        if (this->options.temp_directory.empty()) {
+            this->options.temp_directory = detail::default_temp_directory();
+        }
+        size_t budget = options.memory_budget;
+        io_bytes = detail::io_buffer_bytes(options, sizeof(T));
+        // The run being written, the one filling up, and the buffer as
+        // large as a run that the parallel sort merges through
+        size_t copies = concurrency() > 1 ? 3 : 2;
+        capacity = budget / (copies * sizeof(T));
+        if (capacity == 0) {
+            throw std::invalid_argument("external_sorter: memory budget too small");
+        }
+        // A merge holds two buffers for each of its runs and for its output
+        // file, and one for the elements it has merged
+        size_t buffers = budget / io_bytes;
+        fan_in = std::max<size_t>(2, buffers > 3 ? (buffers - 3) / 2 : 0);
+        run.reserve(capacity);
+    }
+
+    // Waits for the run being written, which uses the buffer and the file
+    ~external_sorter()
+    {
+        if (writing.valid()) {
+            writing.wait();
+        }
+    }
+
+    external_sorter(const external_sorter&) = delete;
+    external_sorter& operator=(const external_sorter&) = delete;
+
+    void push(const T& x)
+    {
+        if (run.size() == run.capacity()) {
+            make_room();
+        }
+        run.push_back(x);
+        ++total;
+    }
+
+    void push(const T* v, size_t n)
+    {
+        while (n > 0) {
+            if (run.size() == run.capacity()) {
+                make_room();
+            }
+            size_t m = std::min(n, run.capacity() - run.size());
+            run.insert(run.end(), v, v + m);
+            v += m;
+            n -= m;
+            total += m;
+        }
+    }
+
+    void push(const std::vector<T>& v)
+    {
+        push(v.data(), v.size());
+    }
+
+    // Elements pushed so far
+    size_t size() const { return total; }
+    // Runs on disk so far
+    size_t spilled_runs() const { return runs.size(); }
+
+    // Ends the input and hands out the elements in order. The sorter is
+    // empty again afterwards.
+    sorted_stream<T, Compare> sorted()
+    {
+        sorted_stream<T, Compare> stream(io_bytes, total);
+        if (runs.empty()) {
+            sort_run();
+            stream.buffer = std::move(run);
+            stream.count = stream.buffer.size();
+        } else {
+            if (!run.empty()) {
+                spill();
+            }
+            wait_for_spill();
+            std::vector<T>().swap(run);
+            std::vector<T>().swap(spilling);
+            while (runs.size() > fan_in) {
+                merge_pass();
+            }
+            stream.runs = std::move(runs);
+            stream.merger.reset(new detail::run_merger<T, Compare>(*stream.io, stream.runs, 0, stream.runs.size(), io_bytes, comp));
+            stream.buffer.resize(io_bytes / sizeof(T));
+        }
+        runs.clear();
+        // Reserved again by the next push, not while the stream is in use
+        run = std::vector<T>();
+        total = 0;
+        return stream;
+    }
+
+    // Ends the input and writes the elements in order to a file
+    void write(const std::string& path)
+    {
+        sorted().write(path);
+    }
+
+private:
+    void sort_run()
+    {
+        perf::sort(execution::par, run.begin(), run.end(), comp);
+    }
+
+    // Spills a full run, or reserves the whole run buffer so that it never
+    // grows past the budget by doubling
+    void make_room()
+    {
+        if (run.size() >= capacity) {
+            spill();
+        } else {
+            run.reserve(capacity);
+        }
+    }
+
+    // Sorts the run and starts writing it, from a buffer the next run
+    // does not fill until the write is done
+    void spill()
+    {
+        sort_run();
+        detail::temp_file file(options.temp_directory);
+        wait_for_spill();
+        run.swap(spilling);
+        std::string path = file.path();
+        const T* data = spilling.data();
+        size_t bytes = spilling.size() * sizeof(T);
+        writing = io->submit([path, data, bytes] { return detail::write_file(path, data, bytes); });
+        runs.push_back(std::move(file));
+        run.clear();
+        run.reserve(capacity);
+    }
+
+    // Rethrows the error of the last spill, if any
+    void wait_for_spill()
+    {
+        if (writing.valid()) {
+            writing.get();
+        }
+    }
+
+    // Merges groups of fan_in runs into one each
+    void merge_pass()
+    {
+        std::vector<detail::temp_file> merged;
+        std::vector<T> buffer(io_bytes / sizeof(T));
+        for (size_t first = 0; first < runs.size(); first += fan_in) {
+            size_t last = std::min(runs.size(), first + fan_in);
+            if (last - first == 1) {
+                merged.push_back(std::move(runs[first]));
+                continue;
+            }
+            detail::temp_file file(options.temp_directory);
+            {
+                detail::run_merger<T, Compare> merger(*io, runs, first, last, io_bytes, comp);
+                detail::async_writer out(*io, file.path(), io_bytes);
+                while (size_t n = merger.read(buffer.data(), buffer.size())) {
+                    out.write(buffer.data(), n * sizeof(T));
+                }
+                out.close();
+            }
+            merged.push_back(std::move(file));
+            // Frees the disk space of the merged runs right away
+            for (size_t r = first; r < last; ++r) {
+                detail::temp_file done(std::move(runs[r]));
+            }
+        }
+        runs = std::move(merged);
+    }
+
+    external_sort_options options;
+    Compare comp;
+    size_t io_bytes;
+    size_t capacity;
+    size_t fan_in;
+    std::unique_ptr<detail::io_thread> io;
+    std::vector<T> run;
+    // The last run spilled, written by the I/O thread until `writing` is
+    // ready
+    std::vector<T> spilling;
+    std::future<size_t> writing;
+    std::vector<detail::temp_file> runs;
+    size_t total = 0;
+};
+
+// Sorts a file of elements of T into another one. Throws
+// std::invalid_argument if the input size is not a multiple of sizeof(T).
+template <typename T, typename Compare = std::less<>>
+void external_sort_file(const std::string& input, const std::string& output,
+    const external_sort_options& options = external_sort_options(), Compare comp = Compare())
+{
+    // The two read buffers come out of the sorter's budget
+    size_t io_bytes = detail::io_buffer_bytes(options, sizeof(T));
+    external_sort_options rest = options;
+    rest.memory_budget -= std::min(rest.memory_budget, 2 * io_bytes);
+    rest.io_buffer = io_bytes;
+    external_sorter<T, Compare> sorter(rest, comp);
+    {
+        // Reads on a thread of their own, so that they overlap the spills
+        detail::io_thread io;
+        detail::async_reader in(io, input, io_bytes);
+        for (auto chunk = in.next(); chunk.second > 0; chunk = in.next()) {
+            if (chunk.second % sizeof(T) != 0) {
+                throw std::invalid_argument("external_sort_file: input is not a whole number of elements");
+            }
+            sorter.push(reinterpret_cast<const T*>(chunk.first), chunk.second / sizeof(T));
+        }
+    }
+    sorter.write(output);
+}
+
+} // namespace perf
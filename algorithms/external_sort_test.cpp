@@ -0,0 +1,278 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "external_sort.h"
+#include "parallel.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+struct record {
+    uint32_t key;
+    uint32_t payload;
+};
+
+std::vector<uint64_t> random_keys(size_t n, uint64_t range, std::mt19937_64& rng)
+{
+    std::vector<uint64_t> v(n);
+    for (auto& x : v) {
+        x = rng() % range;
+    }
+    return v;
+}
+
+template <typename T>
+std::vector<T> drain(perf::sorted_stream<T>& stream)
+{
+    std::vector<T> out;
+    T x;
+    while (stream.next(x)) {
+        out.push_back(x);
+    }
+    return out;
+}
+
+template <typename T>
+void write_file(const std::string& path, const std::vector<T>& v)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    // An empty vector may have no data pointer to pass
+    if (!v.empty()) {
+        std::fwrite(v.data(), sizeof(T), v.size(), file);
+    }
+    std::fclose(file);
+}
+
+template <typename T>
+std::vector<T> read_file(const std::string& path)
+{
+    std::vector<T> v;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    T x;
+    while (std::fread(&x, sizeof(T), 1, file) == 1) {
+        v.push_back(x);
+    }
+    std::fclose(file);
+    return v;
+}
+
+// A budget that holds a few thousand elements, so that even small inputs
+// spill many runs and need more than one merge pass
+perf::external_sort_options small_budget(const std::string& directory)
+{
+    perf::external_sort_options options;
+    options.memory_budget = 64 << 10;
+    options.io_buffer = 4 << 10;
+    options.temp_directory = directory;
+    return options;
+}
+
+class ExternalSort : public test_support::parallel_fixture {
+protected:
+    virtual void SetUp() override
+    {
+        parallel_fixture::SetUp();
+        char name[] = "/tmp/perf-external-sort-test-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(name));
+        directory = name;
+    }
+
+    virtual void TearDown() override
+    {
+        for (auto& file : files()) {
+            std::remove((directory + "/" + file).c_str());
+        }
+        rmdir(directory.c_str());
+        parallel_fixture::TearDown();
+    }
+
+    std::vector<std::string> files() const
+    {
+        std::vector<std::string> names;
+        DIR* dir = opendir(directory.c_str());
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        return names;
+    }
+
+    std::string directory;
+};
+
+} // namespace
+
+TEST_F(ExternalSort, FitsInMemoryWithoutSpilling)
+{
+    std::mt19937_64 rng(1);
+    auto v = random_keys(1000, 100, rng);
+    perf::external_sorter<uint64_t> sorter(small_budget(directory));
+    sorter.push(v);
+    ASSERT_EQ(0u, sorter.spilled_runs());
+
+    auto stream = sorter.sorted();
+    std::sort(begin(v), end(v));
+    ASSERT_EQ(v.size(), stream.size());
+    ASSERT_EQ(v, drain(stream));
+    ASSERT_TRUE(files().empty());
+}
+
+TEST_F(ExternalSort, MergesManyRunsInSeveralPasses)
+{
+    std::mt19937_64 rng(2);
+    for (size_t n : { 5000, 100000, 300001 }) {
+        auto v = random_keys(n, n / 3 + 1, rng);
+        perf::external_sorter<uint64_t> sorter(small_budget(directory));
+        for (uint64_t x : v) {
+            sorter.push(x);
+        }
+        size_t runs = sorter.spilled_runs();
+        ASSERT_LT(0u, runs) << n;
+
+        auto stream = sorter.sorted();
+        ASSERT_EQ(n, stream.size());
+        std::sort(begin(v), end(v));
+        ASSERT_EQ(v, drain(stream)) << n << " " << runs;
+    }
+    // The streams are gone, and so are their runs
+    ASSERT_TRUE(files().empty());
+}
+
+TEST_F(ExternalSort, IteratesInOrderWithComparator)
+{
+    std::mt19937_64 rng(3);
+    std::vector<record> v(50000);
+    for (uint32_t i = 0; i < v.size(); ++i) {
+        v[i] = { static_cast<uint32_t>(rng() % 1000), i };
+    }
+    auto by_key_descending = [](const record& a, const record& b) { return a.key > b.key; };
+    perf::external_sorter<record, decltype(by_key_descending)> sorter(small_budget(directory), by_key_descending);
+    sorter.push(v.data(), v.size());
+
+    std::vector<record> out;
+    for (const record& r : sorter.sorted()) {
+        out.push_back(r);
+    }
+    ASSERT_EQ(v.size(), out.size());
+    ASSERT_TRUE(std::is_sorted(begin(out), end(out), by_key_descending));
+    // Every record once
+    std::vector<bool> seen(v.size());
+    for (const record& r : out) {
+        ASSERT_FALSE(seen[r.payload]);
+        ASSERT_EQ(v[r.payload].key, r.key);
+        seen[r.payload] = true;
+    }
+}
+
+TEST_F(ExternalSort, SortsAFile)
+{
+    std::mt19937_64 rng(4);
+    std::vector<double> v(123457);
+    for (auto& x : v) {
+        x = std::uniform_real_distribution<double>(-1e9, 1e9)(rng);
+    }
+    std::string input = directory + "/input";
+    std::string output = directory + "/output";
+    write_file(input, v);
+
+    perf::external_sort_file<double, std::greater<>>(input, output, small_budget(directory));
+    std::sort(begin(v), end(v), std::greater<>());
+    ASSERT_EQ(v, read_file<double>(output));
+    ASSERT_EQ(2u, files().size());
+}
+
+TEST_F(ExternalSort, EmptyInput)
+{
+    perf::external_sorter<uint64_t> sorter(small_budget(directory));
+    auto stream = sorter.sorted();
+    uint64_t x;
+
+    ASSERT_EQ(0u, stream.size());
+    ASSERT_FALSE(stream.next(x));
+    ASSERT_TRUE(stream.begin() == stream.end());
+
+    std::string input = directory + "/input";
+    std::string output = directory + "/output";
+    write_file(input, std::vector<uint64_t>());
+    perf::external_sort_file<uint64_t>(input, output, small_budget(directory));
+    ASSERT_TRUE(read_file<uint64_t>(output).empty());
+}
+
+TEST_F(ExternalSort, SorterIsReusable)
+{
+    std::mt19937_64 rng(5);
+    perf::external_sorter<uint64_t> sorter(small_budget(directory));
+    for (size_t n : { 20000, 10, 20000 }) {
+        auto v = random_keys(n, 1 << 20, rng);
+        sorter.push(v);
+        auto stream = sorter.sorted();
+        std::sort(begin(v), end(v));
+        ASSERT_EQ(v, drain(stream)) << n;
+        ASSERT_EQ(0u, sorter.size());
+    }
+}
+
+TEST_F(ExternalSort, Errors)
+{
+    perf::external_sort_options tiny;
+    tiny.memory_budget = 8;
+    ASSERT_THROW(perf::external_sorter<uint64_t> sorter(tiny), std::invalid_argument);
+
+    // Spilling fails in a directory that does not exist
+    perf::external_sorter<uint64_t> sorter(small_budget(directory + "/missing"));
+    std::vector<uint64_t> v(100000);
+    ASSERT_THROW(sorter.push(v), std::runtime_error);
+
+    std::string input = directory + "/input";
+    write_file(input, std::vector<uint8_t>(12));
+    ASSERT_THROW(perf::external_sort_file<uint64_t>(input, directory + "/output", small_budget(directory)),
+        std::invalid_argument);
+    ASSERT_THROW(perf::external_sort_file<uint64_t>(directory + "/missing", directory + "/output", small_budget(directory)),
+        std::runtime_error);
+}
+
+TEST(ExternalSortBenchmark, DISABLED_SortLargerThanBudget)
+{
+    std::mt19937_64 rng(6);
+    auto n = bench::size(1 << 24);
+    auto v = random_keys(n, uint64_t(-1), rng);
+    size_t bytes = n * sizeof(uint64_t);
+
+    bench::report("std::sort in memory", bench::best_of(3, [&] {
+        auto w = v;
+        std::sort(begin(w), end(w));
+        bench::keep(w.back());
+    }), bytes);
+    for (size_t budget : { bytes * 2, bytes / 4, bytes / 32 }) {
+        perf::external_sort_options options;
+        options.memory_budget = budget;
+        std::string name = "external_sorter, budget " + std::to_string(budget >> 20) + " MB";
+        bench::report(name.c_str(), bench::best_of(3, [&] {
+            perf::external_sorter<uint64_t> sorter(options);
+            sorter.push(v);
+            auto stream = sorter.sorted();
+            uint64_t x;
+            uint64_t sum = 0;
+            while (stream.next(x)) {
+                sum += x;
+            }
+            bench::keep(sum);
+        }), bytes);
+    }
+}
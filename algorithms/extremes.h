@@ -0,0 +1,528 @@
+#pragma once
+
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Minimum, maximum and their positions in one pass over the array.
+//
+// Every SIMD lane keeps its own running minimum and maximum, two vectors
+// of each to hide the instruction latency, and the lanes are reduced once
+// at the end. int32_t, int64_t, float and double have SSE2 and AVX2
+// kernels (int64_t only AVX2), other types are scanned in scalar code.
+//
+// A NaN anywhere makes the result NaN, and argmin/argmax return the
+// position of the first NaN, as numpy does. -0.0 and +0.0 are equal and
+// either may be returned. Ties go to the first position, as with
+// std::min_element and std::max_element.
+namespace perf {
+
+namespace detail {
+
+    template <typename T>
+    struct extremes {
+        T min;
+        T max;
+        bool nan;
+    };
+
+    template <typename T>
+    bool is_nan(T x, std::true_type)
+    {
+        return std::isnan(x);
+    }
+
+    template <typename T>
+    bool is_nan(T, std::false_type)
+    {
+        return false;
+    }
+
+    template <typename T>
+    bool is_nan(T x)
+    {
+        return is_nan(x, std::is_floating_point<T>());
+    }
+
+    // Folds v[0, n) into e
+    template <bool Min, bool Max, typename T>
+    extremes<T> extremes_scalar(const T* v, size_t n, extremes<T> e)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            T x = v[i];
+            if (Min) {
+                e.min = x < e.min ? x : e.min;
+            }
+            if (Max) {
+                e.max = e.max < x ? x : e.max;
+            }
+            e.nan |= is_nan(x);
+        }
+        return e;
+    }
+
+    // The lane operations of one element type. min(x, acc) and max(x, acc)
+    // return acc when x is NaN; NaNs are tracked by a separate mask.
+    template <typename T>
+    struct lanes {
+        static constexpr bool has_sse2 = false;
+        static constexpr bool has_avx2 = false;
+    };
+
+#if PERF_X86
+    template <>
+    struct lanes<float> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        struct sse2 {
+            using vec = __m128;
+            static constexpr size_t width = 4;
+            static vec load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, vec x) { _mm_storeu_ps(p, x); }
+            static vec min(vec x, vec acc) { return _mm_min_ps(x, acc); }
+            static vec max(vec x, vec acc) { return _mm_max_ps(x, acc); }
+            static vec nan(vec x) { return _mm_cmpunord_ps(x, x); }
+            static vec either(vec a, vec b) { return _mm_or_ps(a, b); }
+            static bool any(vec mask) { return _mm_movemask_ps(mask) != 0; }
+        };
+
+        struct avx2 {
+            using vec = __m256;
+            static constexpr size_t width = 8;
+            PERF_AVX2 static vec load(const float* p) { return _mm256_loadu_ps(p); }
+            PERF_AVX2 static void store(float* p, vec x) { _mm256_storeu_ps(p, x); }
+            PERF_AVX2 static vec min(vec x, vec acc) { return _mm256_min_ps(x, acc); }
+            PERF_AVX2 static vec max(vec x, vec acc) { return _mm256_max_ps(x, acc); }
+            PERF_AVX2 static vec nan(vec x) { return _mm256_cmp_ps(x, x, _CMP_UNORD_Q); }
+            PERF_AVX2 static vec either(vec a, vec b) { return _mm256_or_ps(a, b); }
+            PERF_AVX2 static bool any(vec mask) { return _mm256_movemask_ps(mask) != 0; }
+        };
+    };
+
+    template <>
+    struct lanes<double> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        struct sse2 {
+            using vec = __m128d;
+            static constexpr size_t width = 2;
+            static vec load(const double* p) { return _mm_loadu_pd(p); }
+            static void store(double* p, vec x) { _mm_storeu_pd(p, x); }
+            static vec min(vec x, vec acc) { return _mm_min_pd(x, acc); }
+            static vec max(vec x, vec acc) { return _mm_max_pd(x, acc); }
+            static vec nan(vec x) { return _mm_cmpunord_pd(x, x); }
+            static vec either(vec a, vec b) { return _mm_or_pd(a, b); }
+            static bool any(vec mask) { return _mm_movemask_pd(mask) != 0; }
+        };
+
+        struct avx2 {
+            using vec = __m256d;
+            static constexpr size_t width = 4;
+            PERF_AVX2 static vec load(const double* p) { return _mm256_loadu_pd(p); }
+            PERF_AVX2 static void store(double* p, vec x) { _mm256_storeu_pd(p, x); }
+            PERF_AVX2 static vec min(vec x, vec acc) { return _mm256_min_pd(x, acc); }
+            PERF_AVX2 static vec max(vec x, vec acc) { return _mm256_max_pd(x, acc); }
+            PERF_AVX2 static vec nan(vec x) { return _mm256_cmp_pd(x, x, _CMP_UNORD_Q); }
+            PERF_AVX2 static vec either(vec a, vec b) { return _mm256_or_pd(a, b); }
+            PERF_AVX2 static bool any(vec mask) { return _mm256_movemask_pd(mask) != 0; }
+        };
+    };
+
+    template <>
+    struct lanes<int32_t> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        // SSE2 has no 32-bit min and max, select with a comparison mask
+        struct sse2 {
+            using vec = __m128i;
+            static constexpr size_t width = 4;
+            static vec load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static void store(int32_t* p, vec x) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x); }
+            static vec select(vec mask, vec a, vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+            static vec min(vec x, vec acc) { return select(_mm_cmplt_epi32(x, acc), x, acc); }
+            static vec max(vec x, vec acc) { return select(_mm_cmpgt_epi32(x, acc), x, acc); }
+            static vec nan(vec) { return _mm_setzero_si128(); }
+            static vec either(vec a, vec b) { return _mm_or_si128(a, b); }
+            static bool any(vec) { return false; }
+        };
+
+        struct avx2 {
+            using vec = __m256i;
+            static constexpr size_t width = 8;
+            PERF_AVX2 static vec load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            PERF_AVX2 static void store(int32_t* p, vec x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+            PERF_AVX2 static vec min(vec x, vec acc) { return _mm256_min_epi32(x, acc); }
+            PERF_AVX2 static vec max(vec x, vec acc) { return _mm256_max_epi32(x, acc); }
+            PERF_AVX2 static vec nan(vec) { return _mm256_setzero_si256(); }
+            PERF_AVX2 static vec either(vec a, vec b) { return _mm256_or_si256(a, b); }
+            PERF_AVX2 static bool any(vec) { return false; }
+        };
+    };
+
+    // 64-bit comparisons arrived with SSE4.2
+    template <>
+    struct lanes<int64_t> {
+        static constexpr bool has_sse2 = false;
+        static constexpr bool has_avx2 = true;
+
+        struct avx2 {
+            using vec = __m256i;
+            static constexpr size_t width = 4;
+            PERF_AVX2 static vec load(const int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            PERF_AVX2 static void store(int64_t* p, vec x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+            PERF_AVX2 static vec min(vec x, vec acc) { return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(acc, x)); }
+            PERF_AVX2 static vec max(vec x, vec acc) { return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(x, acc)); }
+            PERF_AVX2 static vec nan(vec) { return _mm256_setzero_si256(); }
+            PERF_AVX2 static vec either(vec a, vec b) { return _mm256_or_si256(a, b); }
+            PERF_AVX2 static bool any(vec) { return false; }
+        };
+    };
+
+    template <bool Min, bool Max, typename T>
+    extremes<T> extremes_sse2(const T* v, size_t n, std::true_type)
+    {
+        using L = typename lanes<T>::sse2;
+        constexpr size_t w = L::width;
+        extremes<T> e{ v[0], v[0], false };
+        size_t i = 0;
+        if (n >= 2 * w) {
+            auto lo0 = L::load(v);
+            auto lo1 = L::load(v + w);
+            auto hi0 = lo0;
+            auto hi1 = lo1;
+            auto nan = L::either(L::nan(lo0), L::nan(lo1));
+            for (i = 2 * w; i + 2 * w <= n; i += 2 * w) {
+                auto x0 = L::load(v + i);
+                auto x1 = L::load(v + i + w);
+                if (Min) {
+                    lo0 = L::min(x0, lo0);
+                    lo1 = L::min(x1, lo1);
+                }
+                if (Max) {
+                    hi0 = L::max(x0, hi0);
+                    hi1 = L::max(x1, hi1);
+                }
+                nan = L::either(nan, L::either(L::nan(x0), L::nan(x1)));
+            }
+            // The lanes are folded into e in scalar code
+            T lo[2 * w];
+            T hi[2 * w];
+            L::store(lo, lo0);
+            L::store(lo + w, lo1);
+            L::store(hi, hi0);
+            L::store(hi + w, hi1);
+            e = extremes_scalar<Min, false>(lo, 2 * w, e);
+            e = extremes_scalar<false, Max>(hi, 2 * w, e);
+            e.nan |= L::any(nan);
+        }
+        return extremes_scalar<Min, Max>(v + i, n - i, e);
+    }
+
+    template <bool Min, bool Max, typename T>
+    extremes<T> extremes_sse2(const T* v, size_t n, std::false_type)
+    {
+        return extremes_scalar<Min, Max>(v, n, extremes<T>{ v[0], v[0], false });
+    }
+
+    template <bool Min, bool Max, typename T>
+    PERF_AVX2 extremes<T> extremes_avx2(const T* v, size_t n, std::true_type)
+    {
+        using L = typename lanes<T>::avx2;
+        constexpr size_t w = L::width;
+        extremes<T> e{ v[0], v[0], false };
+        size_t i = 0;
+        if (n >= 2 * w) {
+            auto lo0 = L::load(v);
+            auto lo1 = L::load(v + w);
+            auto hi0 = lo0;
+            auto hi1 = lo1;
+            auto nan = L::either(L::nan(lo0), L::nan(lo1));
+            for (i = 2 * w; i + 2 * w <= n; i += 2 * w) {
+                auto x0 = L::load(v + i);
+                auto x1 = L::load(v + i + w);
+                if (Min) {
+                    lo0 = L::min(x0, lo0);
+                    lo1 = L::min(x1, lo1);
+                }
+                if (Max) {
+                    hi0 = L::max(x0, hi0);
+                    hi1 = L::max(x1, hi1);
+                }
+                nan = L::either(nan, L::either(L::nan(x0), L::nan(x1)));
+            }
+            // The lanes are folded into e in scalar code
+            T lo[2 * w];
+            T hi[2 * w];
+            L::store(lo, lo0);
+            L::store(lo + w, lo1);
+            L::store(hi, hi0);
+            L::store(hi + w, hi1);
+            e = extremes_scalar<Min, false>(lo, 2 * w, e);
+            e = extremes_scalar<false, Max>(hi, 2 * w, e);
+            e.nan |= L::any(nan);
+        }
+        return extremes_scalar<Min, Max>(v + i, n - i, e);
+    }
+
+    template <bool Min, bool Max, typename T>
+    extremes<T> extremes_avx2(const T* v, size_t n, std::false_type)
+    {
+        return extremes_sse2<Min, Max>(v, n, std::integral_constant<bool, lanes<T>::has_sse2>());
+    }
+#endif
+
+    // Extremes of v[0, n), n > 0
+    template <bool Min, bool Max, typename T>
+    extremes<T> find_extremes(const T* v, size_t n)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return extremes_avx2<Min, Max>(v, n, std::integral_constant<bool, lanes<T>::has_avx2>());
+        case isa::sse2:
+            return extremes_sse2<Min, Max>(v, n, std::integral_constant<bool, lanes<T>::has_sse2>());
+        case isa::scalar:
+            break;
+        }
+#endif
+        return extremes_scalar<Min, Max>(v, n, extremes<T>{ v[0], v[0], false });
+    }
+
+    template <typename T>
+    size_t first_nan(const T* v, size_t n)
+    {
+        size_t i = 0;
+        while (i < n && !is_nan(v[i])) {
+            ++i;
+        }
+        return i;
+    }
+
+    // argmin/argmax go through the array in blocks that fit in L1. Only the
+    // extreme value of each block is computed with the lane kernels; the
+    // block holding the best one is scanned again for its position. A
+    // block with a NaN ends the search right away.
+    constexpr size_t arg_block = 2048;
+
+    struct position {
+        size_t index;
+        bool nan;
+    };
+
+    template <bool Max, typename T>
+    position arg_extreme(const T* v, size_t n)
+    {
+        T best = v[0];
+        size_t best_block = 0;
+        for (size_t b = 0; b < n; b += arg_block) {
+            size_t length = std::min(arg_block, n - b);
+            auto e = find_extremes<!Max, Max>(v + b, length);
+            if (e.nan) {
+                return { b + first_nan(v + b, length), true };
+            }
+            T x = Max ? e.max : e.min;
+            if (Max ? best < x : x < best) {
+                best = x;
+                best_block = b;
+            }
+        }
+        size_t i = best_block;
+        while (!(v[i] == best)) {
+            ++i;
+        }
+        return { i, false };
+    }
+
+    template <typename T>
+    T nan_of(std::true_type)
+    {
+        return std::numeric_limits<T>::quiet_NaN();
+    }
+
+    template <typename T>
+    T nan_of(std::false_type)
+    {
+        return T();
+    }
+
+    template <bool Min, bool Max, typename T>
+    extremes<T> checked_extremes(const T* v, size_t n)
+    {
+        if (n == 0) {
+            throw std::invalid_argument("minimum or maximum of an empty array");
+        }
+        auto e = find_extremes<Min, Max>(v, n);
+        if (e.nan) {
+            e.min = e.max = nan_of<T>(std::is_floating_point<T>());
+        }
+        return e;
+    }
+
+    constexpr size_t extremes_grain = 1 << 18;
+
+    template <bool Min, bool Max, typename T>
+    extremes<T> parallel_extremes(const T* v, size_t n, size_t grain)
+    {
+        if (n == 0) {
+            throw std::invalid_argument("minimum or maximum of an empty array");
+        }
+        block_partition blocks(n, grain);
+        std::vector<extremes<T>> partial(blocks.count);
+        parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+            partial[b] = find_extremes<Min, Max>(v + begin, end - begin);
+        });
+
+        auto e = partial[0];
+        for (size_t b = 1; b < blocks.count; ++b) {
+            e = extremes_scalar<Min, false>(&partial[b].min, 1, e);
+            e = extremes_scalar<false, Max>(&partial[b].max, 1, e);
+            e.nan |= partial[b].nan;
+        }
+        if (e.nan) {
+            e.min = e.max = nan_of<T>(std::is_floating_point<T>());
+        }
+        return e;
+    }
+
+    template <bool Max, typename T>
+    size_t parallel_arg_extreme(const T* v, size_t n, size_t grain)
+    {
+        if (n == 0) {
+            return 0;
+        }
+        block_partition blocks(n, grain);
+        std::vector<position> partial(blocks.count);
+        parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+            partial[b] = arg_extreme<Max>(v + begin, end - begin);
+            partial[b].index += begin;
+        });
+
+        // The first NaN, otherwise the first block with the best value
+        size_t best = partial[0].index;
+        for (size_t b = 0; b < blocks.count; ++b) {
+            if (partial[b].nan) {
+                return partial[b].index;
+            }
+            T x = v[partial[b].index];
+            if (Max ? v[best] < x : x < v[best]) {
+                best = partial[b].index;
+            }
+        }
+        return best;
+    }
+
+} // namespace detail
+
+// Smallest element of v[0, n). Throws std::invalid_argument if n == 0.
+template <typename T>
+T min_value(const T* v, size_t n)
+{
+    return detail::checked_extremes<true, false>(v, n).min;
+}
+
+// Largest element of v[0, n). Throws std::invalid_argument if n == 0.
+template <typename T>
+T max_value(const T* v, size_t n)
+{
+    return detail::checked_extremes<false, true>(v, n).max;
+}
+
+// Smallest and largest element of v[0, n) in one pass. Throws
+// std::invalid_argument if n == 0.
+template <typename T>
+std::pair<T, T> minmax_value(const T* v, size_t n)
+{
+    auto e = detail::checked_extremes<true, true>(v, n);
+    return { e.min, e.max };
+}
+
+// Position of the first smallest element, n if n == 0
+template <typename T>
+size_t argmin(const T* v, size_t n)
+{
+    return n ? detail::arg_extreme<false>(v, n).index : 0;
+}
+
+// Position of the first largest element, n if n == 0
+template <typename T>
+size_t argmax(const T* v, size_t n)
+{
+    return n ? detail::arg_extreme<true>(v, n).index : 0;
+}
+
+template <typename T>
+T min_value(const std::vector<T>& v)
+{
+    return min_value(v.data(), v.size());
+}
+
+template <typename T>
+T max_value(const std::vector<T>& v)
+{
+    return max_value(v.data(), v.size());
+}
+
+template <typename T>
+std::pair<T, T> minmax_value(const std::vector<T>& v)
+{
+    return minmax_value(v.data(), v.size());
+}
+
+template <typename T>
+size_t argmin(const std::vector<T>& v)
+{
+    return argmin(v.data(), v.size());
+}
+
+template <typename T>
+size_t argmax(const std::vector<T>& v)
+{
+    return argmax(v.data(), v.size());
+}
+
+// The same split over threads in blocks of at least `grain` elements
+
+template <typename T>
+T parallel_min_value(const T* v, size_t n, size_t grain = detail::extremes_grain)
+{
+    return detail::parallel_extremes<true, false>(v, n, grain).min;
+}
+
+template <typename T>
+T parallel_max_value(const T* v, size_t n, size_t grain = detail::extremes_grain)
+{
+    return detail::parallel_extremes<false, true>(v, n, grain).max;
+}
+
+template <typename T>
+std::pair<T, T> parallel_minmax_value(const T* v, size_t n, size_t grain = detail::extremes_grain)
+{
+    auto e = detail::parallel_extremes<true, true>(v, n, grain);
+    return { e.min, e.max };
+}
+
+template <typename T>
+size_t parallel_argmin(const T* v, size_t n, size_t grain = detail::extremes_grain)
+{
+    return detail::parallel_arg_extreme<false>(v, n, grain);
+}
+
+template <typename T>
+size_t parallel_argmax(const T* v, size_t n, size_t grain = detail::extremes_grain)
+{
+    return detail::parallel_arg_extreme<true>(v, n, grain);
+}
+
+} // namespace perf
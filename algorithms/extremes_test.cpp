@@ -0,0 +1,162 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "extremes.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using test_support::random_values;
+
+class Extremes : public test_support::isa_fixture {
+};
+
+template <typename T>
+void expect_like_std(const std::vector<T>& v)
+{
+    auto minmax = std::minmax_element(begin(v), end(v));
+    auto first_max = std::max_element(begin(v), end(v));
+
+    ASSERT_EQ(*minmax.first, perf::min_value(v));
+    ASSERT_EQ(*first_max, perf::max_value(v));
+    ASSERT_EQ(std::make_pair(*minmax.first, *first_max), perf::minmax_value(v));
+    ASSERT_EQ(static_cast<size_t>(minmax.first - begin(v)), perf::argmin(v));
+    ASSERT_EQ(static_cast<size_t>(first_max - begin(v)), perf::argmax(v));
+}
+
+class ParallelExtremes : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, Extremes,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(Extremes, FindMinimumAndMaximumElement)
+{
+    std::vector<int> v{ 1, 6, 3, 7, 9, 4, 12, 2 };
+
+    auto minmax = perf::minmax_value(v);
+
+    ASSERT_EQ(1, minmax.first);
+    ASSERT_EQ(12, minmax.second);
+}
+
+TEST_P(Extremes, MatchesStdForAllTypes)
+{
+    for (size_t n : { 1, 2, 7, 16, 17, 100, 2047, 2048, 2049, 10000 }) {
+        expect_like_std(random_values<int32_t>(n));
+        expect_like_std(random_values<int64_t>(n));
+        expect_like_std(random_values<float>(n));
+        expect_like_std(random_values<double>(n));
+        expect_like_std(random_values<int16_t>(n));
+    }
+}
+
+TEST_P(Extremes, TiesGoToTheFirstPosition)
+{
+    std::vector<int32_t> v(5000, 3);
+    v[10] = v[4000] = -7;
+    v[20] = v[3000] = 9;
+
+    ASSERT_EQ(10u, perf::argmin(v));
+    ASSERT_EQ(20u, perf::argmax(v));
+}
+
+TEST_P(Extremes, ExtremeValuesOfTheType)
+{
+    auto v = random_values<int64_t>(1000);
+    v[500] = std::numeric_limits<int64_t>::min();
+    v[501] = std::numeric_limits<int64_t>::max();
+    expect_like_std(v);
+
+    auto f = random_values<float>(1000);
+    f[700] = -std::numeric_limits<float>::infinity();
+    expect_like_std(f);
+}
+
+TEST_P(Extremes, NanPropagates)
+{
+    for (size_t at : { 0, 1, 33, 999, 2500, 4999 }) {
+        auto v = random_values<double>(5000);
+        v[at] = std::nan("");
+        v[at + 1 < v.size() ? at + 1 : 0] = std::nan("");
+
+        ASSERT_TRUE(std::isnan(perf::min_value(v)));
+        ASSERT_TRUE(std::isnan(perf::max_value(v)));
+        ASSERT_TRUE(std::isnan(perf::minmax_value(v).first));
+        ASSERT_EQ(at == 4999 ? 0 : at, perf::argmin(v));
+        ASSERT_EQ(at == 4999 ? 0 : at, perf::argmax(v));
+    }
+}
+
+TEST_P(Extremes, EmptyInput)
+{
+    std::vector<float> v;
+
+    ASSERT_THROW(perf::min_value(v), std::invalid_argument);
+    ASSERT_THROW(perf::minmax_value(v), std::invalid_argument);
+    ASSERT_EQ(0u, perf::argmin(v));
+}
+
+TEST_F(ParallelExtremes, MatchesSequential)
+{
+    auto v = random_values<float>(1000003, 1000000, 9);
+    v[700001] = -2e6f;
+    v[300] = -2e6f;
+
+    ASSERT_EQ(perf::minmax_value(v), perf::parallel_minmax_value(v.data(), v.size(), 1000));
+    ASSERT_EQ(perf::min_value(v), perf::parallel_min_value(v.data(), v.size(), 1000));
+    ASSERT_EQ(perf::max_value(v), perf::parallel_max_value(v.data(), v.size(), 1000));
+    ASSERT_EQ(300u, perf::parallel_argmin(v.data(), v.size(), 1000));
+    ASSERT_EQ(perf::argmax(v), perf::parallel_argmax(v.data(), v.size(), 1000));
+
+    v[800000] = std::nanf("");
+    ASSERT_TRUE(std::isnan(perf::parallel_min_value(v.data(), v.size(), 1000)));
+    ASSERT_EQ(800000u, perf::parallel_argmin(v.data(), v.size(), 1000));
+}
+
+TEST(ExtremesBenchmark, DISABLED_MinMax)
+{
+    auto n = bench::size(1 << 24);
+    auto ints = random_values<int32_t>(n);
+    auto doubles = random_values<double>(n);
+
+    bench::report("std::minmax_element int32", bench::best_of(5, [&] {
+        bench::keep(std::minmax_element(begin(ints), end(ints)));
+    }), n * sizeof(int32_t));
+    bench::report("std::min_element int32", bench::best_of(5, [&] {
+        bench::keep(std::min_element(begin(ints), end(ints)));
+    }), n * sizeof(int32_t));
+    bench::report("std::minmax_element double", bench::best_of(5, [&] {
+        bench::keep(std::minmax_element(begin(doubles), end(doubles)));
+    }), n * sizeof(double));
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* isa_names[] = { "scalar", "sse2", "avx2" };
+        std::printf("%s\n", isa_names[static_cast<int>(level)]);
+        bench::report("  minmax_value int32", bench::best_of(5, [&] {
+            bench::keep(perf::minmax_value(ints));
+        }), n * sizeof(int32_t));
+        bench::report("  argmin int32", bench::best_of(5, [&] {
+            bench::keep(perf::argmin(ints));
+        }), n * sizeof(int32_t));
+        bench::report("  minmax_value double", bench::best_of(5, [&] {
+            bench::keep(perf::minmax_value(doubles));
+        }), n * sizeof(double));
+        bench::report("  argmin double", bench::best_of(5, [&] {
+            bench::keep(perf::argmin(doubles));
+        }), n * sizeof(double));
+    }
+    perf::limit_isa(perf::isa::avx2);
+    bench::report("parallel_minmax_value double", bench::best_of(5, [&] {
+        bench::keep(perf::parallel_minmax_value(doubles.data(), n));
+    }), n * sizeof(double));
+}
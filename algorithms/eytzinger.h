@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include <stdlib.h>
+
+namespace perf {
+
+namespace detail {
+
+    constexpr size_t cache_line = 64;
+
+    // Allocates on cache line boundaries
+    template <typename T>
+    struct cache_aligned_allocator {
+        using value_type = T;
+
+        cache_aligned_allocator() = default;
+        template <typename U>
+        cache_aligned_allocator(const cache_aligned_allocator<U>&)
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            void* p = nullptr;
+            if (posix_memalign(&p, cache_line, n * sizeof(T)) != 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+
+        void deallocate(T* p, size_t) { std::free(p); }
+
+        template <typename U>
+        bool operator==(const cache_aligned_allocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const cache_aligned_allocator<U>&) const { return false; }
+    };
+
+} // namespace detail
+
+// A sorted array re-laid in Eytzinger (breadth-first binary heap) order.
+//
+// Node k has its children at 2k and 2k + 1, so the first levels of every
+// search share the same few cache lines. With L elements to a cache line,
+// the L descendants log2(L) levels below node k are k * L to k * L + L - 1;
+// the array starts on a line boundary, so they fill exactly one line,
+// which is prefetched before it is needed: four levels ahead for 4-byte
+// elements. Searches are branchless and return positions in the original
+// sorted array, exactly like std::lower_bound and std::upper_bound.
+template <typename T, typename Compare = std::less<>>
+class eytzinger_array {
+public:
+    eytzinger_array() = default;
+
+    // `sorted` must be sorted by `comp`; duplicates are allowed
+    explicit eytzinger_array(const std::vector<T>& sorted, Compare comp = Compare())
+        : tree(sorted.size() + 1)
+        , comp(comp)
+    {
+        size_t next = 0;
+        build(sorted, 1, next);
+    }
+
+    size_t size() const { return tree.size() - 1; }
+
+    // Index of the first element not less than x, size() if there is none
+    size_t lower_bound(const T& x) const
+    {
+        return rank(search(x, [this](const T& node, const T& key) { return comp(node, key); }));
+    }
+
+    // Index of the first element greater than x, size() if there is none
+    size_t upper_bound(const T& x) const
+    {
+        return rank(search(x, [this](const T& node, const T& key) { return !comp(key, node); }));
+    }
+
+private:
+    void build(const std::vector<T>& sorted, size_t k, size_t& next)
+    {
+        if (k <= size()) {
+            build(sorted, 2 * k, next);
+            tree[k] = sorted[next++];
+            build(sorted, 2 * k + 1, next);
+        }
+    }
+
+    // Descends right while go_right(node, x) holds. The answer is the last
+    // node where the search went left: strip the trailing right turns (ones)
+    // and that left turn (a zero) off k. k becomes 0 if it never went left.
+    template <typename GoRight>
+    size_t search(const T& x, GoRight go_right) const
+    {
+        const T* t = tree.data();
+        size_t n = size();
+        size_t k = 1;
+        while (k <= n) {
+            // The descendants prefetch_distance times further down, one
+            // aligned line
+            __builtin_prefetch(t + prefetch_distance * k);
+            k = 2 * k + go_right(t[k], x);
+        }
+        return k >> __builtin_ffsll(~static_cast<long long>(k));
+    }
+
+    // Index in the sorted array of node k, size() for node 0. In a perfect
+    // tree with the same last level, node k at depth d has 2^(last - d)
+    // slots per step on its level; the last level is filled from the left,
+    // so the slots missing there that lie to the left of k are subtracted.
+    size_t rank(size_t k) const
+    {
+        size_t n = size();
+        if (k == 0) {
+            return n;
+        }
+        unsigned last = 63 - __builtin_clzll(n);
+        unsigned depth = 63 - __builtin_clzll(k);
+        size_t perfect = ((2 * (k - (size_t(1) << depth)) + 1) << (last - depth)) - 1;
+        size_t leaves = n - ((size_t(1) << last) - 1);
+        size_t leaves_left = (perfect + 1) / 2;
+        return leaves_left > leaves ? perfect - (leaves_left - leaves) : perfect;
+    }
+
+    // Elements per cache line, at least the two children. For sizes that
+    // do not divide a line the descendants may straddle two lines, and
+    // only the first one is prefetched.
+    static constexpr size_t prefetch_distance = sizeof(T) < detail::cache_line / 2
+        ? detail::cache_line / sizeof(T)
+        : 2;
+
+    std::vector<T, detail::cache_aligned_allocator<T>> tree = std::vector<T, detail::cache_aligned_allocator<T>>(1);
+    Compare comp;
+};
+
+} // namespace perf
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "eytzinger.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<int> random_sorted(size_t n, int max)
+{
+    std::mt19937 rng(static_cast<unsigned>(n));
+    std::uniform_int_distribution<int> dist(0, max);
+    std::vector<int> v(n);
+    std::generate(begin(v), end(v), [&] { return dist(rng); });
+    std::sort(begin(v), end(v));
+    return v;
+}
+
+} // namespace
+
+TEST(Eytzinger, LowerBound)
+{
+    std::vector<int> v{ 1, 1, 2, 3, 3, 3 };
+    perf::eytzinger_array<int> a(v);
+
+    ASSERT_EQ(2u, a.lower_bound(2));
+}
+
+TEST(Eytzinger, UpperBound)
+{
+    std::vector<int> v{ 1, 1, 2, 3, 3, 3 };
+    perf::eytzinger_array<int> a(v);
+
+    ASSERT_EQ(3u, a.upper_bound(2));
+}
+
+TEST(Eytzinger, MatchesStdForEverySize)
+{
+    for (size_t n = 0; n < 70; ++n) {
+        auto v = random_sorted(n, 40);
+        perf::eytzinger_array<int> a(v);
+
+        for (int x = -1; x <= 41; ++x) {
+            ASSERT_EQ(std::lower_bound(begin(v), end(v), x) - begin(v), static_cast<long>(a.lower_bound(x)))
+                << "n = " << n << ", x = " << x;
+            ASSERT_EQ(std::upper_bound(begin(v), end(v), x) - begin(v), static_cast<long>(a.upper_bound(x)))
+                << "n = " << n << ", x = " << x;
+        }
+    }
+}
+
+TEST(Eytzinger, FindsEveryPositionOfEverySize)
+{
+    // Distinct even keys, so every index is the answer to some query
+    for (size_t n = 0; n < 300; ++n) {
+        std::vector<int> v(n);
+        for (size_t i = 0; i < n; ++i) {
+            v[i] = 2 * static_cast<int>(i);
+        }
+        perf::eytzinger_array<int> a(v);
+
+        for (int x = -1; x <= 2 * static_cast<int>(n); ++x) {
+            ASSERT_EQ(static_cast<size_t>((x + 1) / 2), a.lower_bound(x)) << "n = " << n << ", x = " << x;
+            ASSERT_EQ(std::min(n, static_cast<size_t>((x + 2) / 2)), a.upper_bound(x)) << "n = " << n << ", x = " << x;
+        }
+    }
+}
+
+TEST(Eytzinger, CustomComparator)
+{
+    std::vector<double> v{ 5.0, 4.0, 4.0, 2.5, 1.0 };
+    perf::eytzinger_array<double, std::greater<>> a(v);
+
+    ASSERT_EQ(1u, a.lower_bound(4.0));
+    ASSERT_EQ(3u, a.upper_bound(4.0));
+    ASSERT_EQ(5u, a.lower_bound(0.0));
+}
+
+TEST(Eytzinger, Empty)
+{
+    perf::eytzinger_array<int> a;
+
+    ASSERT_EQ(0u, a.size());
+    ASSERT_EQ(0u, a.lower_bound(1));
+    ASSERT_EQ(0u, a.upper_bound(1));
+}
+
+TEST(EytzingerBenchmark, DISABLED_LowerBoundAcrossSizes)
+{
+    const size_t queries = 1 << 20;
+    for (size_t n = 1 << 10; n <= bench::size(1 << 26); n <<= 2) {
+        auto v = random_sorted(n, 1 << 30);
+        perf::eytzinger_array<int> a(v);
+        std::mt19937 rng(1);
+        std::vector<int> q(queries);
+        std::generate(begin(q), end(q), [&] { return static_cast<int>(rng() >> 2); });
+
+        auto std_time = bench::best_of(3, [&] {
+            size_t sum = 0;
+            for (int x : q) {
+                sum += std::lower_bound(begin(v), end(v), x) - begin(v);
+            }
+            bench::keep(sum);
+        });
+        auto eytzinger_time = bench::best_of(3, [&] {
+            size_t sum = 0;
+            for (int x : q) {
+                sum += a.lower_bound(x);
+            }
+            bench::keep(sum);
+        });
+        std::printf("n = %10zu  std::lower_bound %7.1f ns  eytzinger %7.1f ns\n", n,
+            std_time / queries * 1e9, eytzinger_time / queries * 1e9);
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace perf {
+
+// A read-mostly map kept as two sorted arrays, one of keys and one of
+// values.
+//
+// It is built in one go from parallel key and value vectors (or any range
+// of pairs) by sorting once, instead of allocating a tree node per key.
+// Lookups binary search the contiguous key array and touch the value array
+// only for the hit. With the default std::less<> any type comparable with
+// Key can be looked up, e.g. a const char* against std::string keys,
+// without constructing a temporary Key.
+//
+// Duplicate keys keep the value that came first, as if inserted one by one
+// with std::map::insert (or std::inserter into a std::map).
+template <typename Key, typename Value, typename Compare = std::less<>>
+class flat_map {
+public:
+    flat_map() = default;
+
+    flat_map(std::vector<Key> keys, std::vector<Value> values, Compare comp = Compare())
+        : comp(comp)
+    {
+        if (keys.size() != values.size()) {
+            throw std::invalid_argument("flat_map: keys and values differ in length");
+        }
+        std::vector<std::pair<Key, Value>> pairs;
+        pairs.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            pairs.emplace_back(std::move(keys[i]), std::move(values[i]));
+        }
+        build(std::move(pairs));
+    }
+
+    // From a range of (key, value) pairs, e.g. views::zip(keys, values)
+    template <typename InputIt>
+    flat_map(InputIt first, InputIt last, Compare comp = Compare())
+        : comp(comp)
+    {
+        std::vector<std::pair<Key, Value>> pairs;
+        for (; first != last; ++first) {
+            auto&& p = *first;
+            pairs.emplace_back(p.first, p.second);
+        }
+        build(std::move(pairs));
+    }
+
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+
+    // Sorted keys and the values in the same order
+    const std::vector<Key>& keys() const { return keys_; }
+    const std::vector<Value>& values() const { return values_; }
+
+    // Value of key, nullptr if it is not in the map
+    template <typename K>
+    const Value* find(const K& key) const
+    {
+        size_t i = index_of(key);
+        return i == size() ? nullptr : &values_[i];
+    }
+
+    template <typename K>
+    Value* find(const K& key)
+    {
+        size_t i = index_of(key);
+        return i == size() ? nullptr : &values_[i];
+    }
+
+    template <typename K>
+    bool contains(const K& key) const
+    {
+        return index_of(key) != size();
+    }
+
+    template <typename K>
+    const Value& at(const K& key) const
+    {
+        const Value* value = find(key);
+        if (!value) {
+            throw std::out_of_range("flat_map::at: no such key");
+        }
+        return *value;
+    }
+
+    // Position of key in keys(), size() if it is not in the map
+    template <typename K>
+    size_t index_of(const K& key) const
+    {
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key, comp);
+        return it != keys_.end() && !comp(key, *it) ? static_cast<size_t>(it - keys_.begin()) : size();
+    }
+
+private:
+    void build(std::vector<std::pair<Key, Value>> pairs)
+    {
+        // Stable, so among equal keys the first one given is the first one here
+        std::stable_sort(pairs.begin(), pairs.end(),
+            [this](const auto& a, const auto& b) { return comp(a.first, b.first); });
+
+        keys_.reserve(pairs.size());
+        values_.reserve(pairs.size());
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            bool first_of_key = i == 0 || comp(pairs[i - 1].first, pairs[i].first);
+            if (first_of_key) {
+                keys_.push_back(std::move(pairs[i].first));
+                values_.push_back(std::move(pairs[i].second));
+            }
+        }
+        keys_.shrink_to_fit();
+        values_.shrink_to_fit();
+    }
+
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+    Compare comp;
+};
+
+} // namespace perf
@@ -0,0 +1,147 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "flat_map.h"
+#include "views.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> random_keys(size_t n)
+{
+    std::mt19937 rng(3);
+    std::vector<std::string> keys(n);
+    for (auto& k : keys) {
+        k = "city-" + std::to_string(rng());
+    }
+    return keys;
+}
+
+} // namespace
+
+TEST(FlatMap, CreateMapFromKeysAndValues)
+{
+    std::vector<std::string> keys{ "Helsinki", "Espoo", "Tampere", "Vantaa", "Oulu" };
+    std::vector<int> values{ 639'222, 276'087, 228'942, 220'908, 200'600 };
+
+    perf::flat_map<std::string, int> population(keys, values);
+
+    ASSERT_EQ(5u, population.size());
+    ASSERT_EQ(639'222, population.at("Helsinki"));
+    ASSERT_EQ(200'600, population.at("Oulu"));
+    ASSERT_EQ(228'942, population.at("Tampere"));
+    ASSERT_EQ(nullptr, population.find("Turku"));
+    ASSERT_THROW(population.at("Turku"), std::out_of_range);
+}
+
+TEST(FlatMap, KeysAreSorted)
+{
+    perf::flat_map<std::string, int> m({ "b", "c", "a" }, { 2, 3, 1 });
+
+    ASSERT_EQ((std::vector<std::string>{ "a", "b", "c" }), m.keys());
+    ASSERT_EQ((std::vector<int>{ 1, 2, 3 }), m.values());
+}
+
+TEST(FlatMap, FirstDuplicateWinsLikeStdMap)
+{
+    std::vector<int> keys{ 3, 1, 2, 1, 3, 1 };
+    std::vector<char> values{ 'a', 'b', 'c', 'd', 'e', 'f' };
+    perf::flat_map<int, char> m(keys, values);
+    std::map<int, char> expected;
+    std::transform(begin(keys), end(keys), begin(values), std::inserter(expected, expected.end()),
+        [](int k, char v) { return std::make_pair(k, v); });
+
+    ASSERT_EQ(3u, m.size());
+    ASSERT_EQ('b', m.at(1));
+    ASSERT_EQ('a', m.at(3));
+    for (const auto& kv : expected) {
+        ASSERT_EQ(kv.second, m.at(kv.first));
+    }
+}
+
+TEST(FlatMap, FromZippedRange)
+{
+    std::vector<std::string> keys{ "x", "y" };
+    std::vector<double> values{ 1.5, 2.5 };
+    auto pairs = perf::views::zip(keys, values);
+
+    perf::flat_map<std::string, double> m(pairs.begin(), pairs.end());
+
+    ASSERT_EQ(2.5, m.at("y"));
+}
+
+TEST(FlatMap, ValuesAreMutable)
+{
+    perf::flat_map<std::string, int> m({ "a" }, { 1 });
+
+    *m.find("a") += 1;
+
+    ASSERT_EQ(2, m.at(std::string("a")));
+}
+
+TEST(FlatMap, MismatchedLengthsThrow)
+{
+    ASSERT_THROW((perf::flat_map<int, int>({ 1, 2 }, { 1 })), std::invalid_argument);
+}
+
+TEST(FlatMap, MatchesStdMap)
+{
+    auto keys = random_keys(5000);
+    std::vector<int> values(keys.size());
+    std::iota(values.begin(), values.end(), 0);
+
+    std::map<std::string, int> expected;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        expected[keys[i]] = values[i];
+    }
+    perf::flat_map<std::string, int> m(keys, values);
+
+    ASSERT_EQ(expected.size(), m.size());
+    for (auto& kv : expected) {
+        ASSERT_EQ(kv.second, m.at(kv.first.c_str()));
+    }
+}
+
+TEST(FlatMapBenchmark, DISABLED_BuildAndLookup)
+{
+    auto keys = random_keys(bench::size(1 << 20));
+    std::vector<int> values(keys.size(), 1);
+    auto probes = keys;
+    std::shuffle(probes.begin(), probes.end(), std::mt19937(1));
+
+    std::map<std::string, int> tree;
+    perf::flat_map<std::string, int> flat;
+    auto build_tree = bench::best_of(1, [&] {
+        tree.clear();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            tree[keys[i]] = values[i];
+        }
+    });
+    auto build_flat = bench::best_of(1, [&] { flat = perf::flat_map<std::string, int>(keys, values); });
+    auto lookup_tree = bench::best_of(3, [&] {
+        long sum = 0;
+        for (auto& k : probes) {
+            sum += tree.find(k)->second;
+        }
+        bench::keep(sum);
+    });
+    auto lookup_flat = bench::best_of(3, [&] {
+        long sum = 0;
+        for (auto& k : probes) {
+            sum += *flat.find(k);
+        }
+        bench::keep(sum);
+    });
+
+    std::printf("build:  std::map %8.1f ms  flat_map %8.1f ms\n", build_tree * 1e3, build_flat * 1e3);
+    std::printf("lookup: std::map %8.1f ns  flat_map %8.1f ns\n",
+        lookup_tree / probes.size() * 1e9, lookup_flat / probes.size() * 1e9);
+}
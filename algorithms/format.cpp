@@ -0,0 +1,85 @@
+#include "format.h"
+
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+
+namespace perf {
+
+namespace {
+
+    constexpr size_t buffer_size = 1 << 16;
+
+    void write_all(int fd, const char* data, size_t size)
+    {
+        while (size) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    // Formats into the buffer and flushes it whenever the next piece might
+    // not fit. Pieces longer than the buffer (huge separators) are written
+    // directly.
+    template <typename T>
+    void write_joined(int fd, const T* v, size_t n, const std::string& separator,
+        const std::string& prefix, const std::string& suffix)
+    {
+        char buffer[buffer_size];
+        char* out = buffer;
+        auto flush = [&] {
+            if (out != buffer) {
+                write_all(fd, buffer, static_cast<size_t>(out - buffer));
+                out = buffer;
+            }
+        };
+        auto put = [&](const std::string& s) {
+            if (s.size() > buffer_size / 2) {
+                flush();
+                write_all(fd, s.data(), s.size());
+            } else {
+                if (buffer + buffer_size - out < static_cast<ptrdiff_t>(s.size())) {
+                    flush();
+                }
+                out = std::copy(s.begin(), s.end(), out);
+            }
+        };
+
+        // Sign and 19 digits of the longest int64_t
+        const ptrdiff_t longest = 20;
+        put(prefix);
+        for (size_t i = 0; i < n; ++i) {
+            if (i) {
+                put(separator);
+            }
+            if (buffer + buffer_size - out < longest) {
+                flush();
+            }
+            out = format_int(v[i], out);
+        }
+        put(suffix);
+        flush();
+    }
+
+} // namespace
+
+void write_joined(int fd, const int32_t* v, size_t n, const std::string& separator,
+    const std::string& prefix, const std::string& suffix)
+{
+    write_joined<int32_t>(fd, v, n, separator, prefix, suffix);
+}
+
+void write_joined(int fd, const int64_t* v, size_t n, const std::string& separator,
+    const std::string& prefix, const std::string& suffix)
+{
+    write_joined<int64_t>(fd, v, n, separator, prefix, suffix);
+}
+
+} // namespace perf
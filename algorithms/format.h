@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Integer to text conversion and joining.
+//
+// join() measures the output first and formats straight into one buffer
+// of that size, two digits per table lookup, so joining is linear in the
+// output size and allocates once.
+namespace perf {
+
+namespace detail {
+
+    inline const char* digit_pairs()
+    {
+        static const char table[] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+        return table;
+    }
+
+    inline unsigned decimal_digits(uint64_t v)
+    {
+        static const uint64_t powers[] = { 0, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+            100000000, 1000000000, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+            10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+            100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL };
+        // 1233 / 4096 ~ log10(2): estimate from the bit length, then correct
+        unsigned bits = 64 - __builtin_clzll(v | 1);
+        unsigned digits = (bits * 1233) >> 12;
+        return digits + (v >= powers[digits]);
+    }
+
+    // Writes v so that its last digit is at end[-1]
+    inline void format_backwards(uint64_t v, char* end)
+    {
+        const char* pairs = digit_pairs();
+        while (v >= 100) {
+            unsigned i = static_cast<unsigned>(v % 100) * 2;
+            v /= 100;
+            *--end = pairs[i + 1];
+            *--end = pairs[i];
+        }
+        if (v >= 10) {
+            *--end = pairs[v * 2 + 1];
+            *--end = pairs[v * 2];
+        } else {
+            *--end = static_cast<char>('0' + v);
+        }
+    }
+
+    template <typename T>
+    uint64_t magnitude(T value)
+    {
+        // Negating in unsigned arithmetic is safe for the minimum value
+        return value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    }
+
+} // namespace detail
+
+// Number of characters in the decimal form of value
+template <typename T>
+size_t formatted_length(T value)
+{
+    static_assert(std::is_integral<T>::value, "integers only");
+    return (value < 0) + detail::decimal_digits(detail::magnitude(value));
+}
+
+// Writes the decimal form of value to out, returns the end of it
+template <typename T>
+char* format_int(T value, char* out)
+{
+    size_t length = formatted_length(value);
+    if (value < 0) {
+        *out = '-';
+    }
+    detail::format_backwards(detail::magnitude(value), out + length);
+    return out + length;
+}
+
+// Length of prefix + v[0] + separator + ... + v[n - 1] + suffix
+template <typename T>
+size_t joined_length(const T* v, size_t n, size_t separator, size_t prefix = 0, size_t suffix = 0)
+{
+    size_t length = prefix + suffix + (n ? (n - 1) * separator : 0);
+    for (size_t i = 0; i < n; ++i) {
+        length += formatted_length(v[i]);
+    }
+    return length;
+}
+
+// Writes the joined text to out, which must have room for joined_length()
+// characters. Returns the end of it.
+template <typename T>
+char* join_to(char* out, const T* v, size_t n, const std::string& separator,
+    const std::string& prefix = "", const std::string& suffix = "")
+{
+    out = std::copy(prefix.begin(), prefix.end(), out);
+    for (size_t i = 0; i < n; ++i) {
+        if (i) {
+            out = std::copy(separator.begin(), separator.end(), out);
+        }
+        out = format_int(v[i], out);
+    }
+    return std::copy(suffix.begin(), suffix.end(), out);
+}
+
+template <typename T>
+std::string join(const T* v, size_t n, const std::string& separator = ", ",
+    const std::string& prefix = "", const std::string& suffix = "")
+{
+    std::string result(joined_length(v, n, separator.size(), prefix.size(), suffix.size()), '\0');
+    join_to(&result[0], v, n, separator, prefix, suffix);
+    return result;
+}
+
+template <typename T>
+std::string join(const std::vector<T>& v, const std::string& separator = ", ",
+    const std::string& prefix = "", const std::string& suffix = "")
+{
+    return join(v.data(), v.size(), separator, prefix, suffix);
+}
+
+// Writes the joined text to a file descriptor through a fixed 64 KiB
+// buffer, so arbitrarily long output needs no allocation. Throws
+// std::system_error if writing fails.
+void write_joined(int fd, const int32_t* v, size_t n, const std::string& separator = ", ",
+    const std::string& prefix = "", const std::string& suffix = "");
+void write_joined(int fd, const int64_t* v, size_t n, const std::string& separator = ", ",
+    const std::string& prefix = "", const std::string& suffix = "");
+
+} // namespace perf
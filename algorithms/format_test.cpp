@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "format.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+std::vector<int32_t> ints_of_every_length(size_t n)
+{
+    std::mt19937 rng(11);
+    std::vector<int32_t> v(n);
+    for (auto& x : v) {
+        // Random magnitude so every length occurs
+        x = static_cast<int32_t>(rng()) >> (rng() % 32);
+    }
+    return v;
+}
+
+std::string naive_join(const std::vector<int32_t>& v)
+{
+    std::string s;
+    for (size_t i = 0; i < v.size(); ++i) {
+        s += (i ? ", " : "") + std::to_string(v[i]);
+    }
+    return "[" + s + "]";
+}
+
+std::string read_all(std::FILE* f)
+{
+    std::rewind(f);
+    std::string s;
+    char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof buffer, f)) > 0) {
+        s.append(buffer, n);
+    }
+    return s;
+}
+
+} // namespace
+
+TEST(Format, ConvertAVectorToString)
+{
+    std::vector<int> v{ 1, 2, 3, 4, 5 };
+
+    std::string result = perf::join(v, ", ", "[", "]");
+
+    ASSERT_EQ("[1, 2, 3, 4, 5]", result);
+}
+
+TEST(Format, Extremes)
+{
+    for (int64_t x : { std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(),
+             int64_t(0), int64_t(-1), int64_t(9), int64_t(10), int64_t(99), int64_t(100) }) {
+        char buffer[32];
+        char* end = perf::format_int(x, buffer);
+        ASSERT_EQ(std::to_string(x), std::string(buffer, end));
+        ASSERT_EQ(std::to_string(x).size(), perf::formatted_length(x));
+    }
+    uint64_t big = std::numeric_limits<uint64_t>::max();
+    char buffer[32];
+    ASSERT_EQ(std::to_string(big), std::string(buffer, perf::format_int(big, buffer)));
+}
+
+TEST(Format, MatchesToString)
+{
+    auto v = ints_of_every_length(10000);
+
+    ASSERT_EQ(naive_join(v), perf::join(v, ", ", "[", "]"));
+}
+
+TEST(Format, Empty)
+{
+    ASSERT_EQ("[]", perf::join(std::vector<int>{}, ", ", "[", "]"));
+    ASSERT_EQ("7", perf::join(std::vector<int>{ 7 }));
+}
+
+TEST(Format, WriteToFileDescriptor)
+{
+    auto v = ints_of_every_length(100000);
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(nullptr, f);
+
+    perf::write_joined(fileno(f), v.data(), v.size(), ", ", "[", "]\n");
+
+    ASSERT_EQ(naive_join(v) + "\n", read_all(f));
+    std::fclose(f);
+}
+
+TEST(Format, WriteLongSeparators)
+{
+    std::vector<int64_t> v{ -1, 2, -3 };
+    std::string separator(100000, ' ');
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(nullptr, f);
+
+    perf::write_joined(fileno(f), v.data(), v.size(), separator);
+
+    ASSERT_EQ("-1" + separator + "2" + separator + "-3", read_all(f));
+    std::fclose(f);
+}
+
+TEST(Format, WriteToClosedDescriptorThrows)
+{
+    std::vector<int32_t> v{ 1 };
+
+    ASSERT_THROW(perf::write_joined(-1, v.data(), v.size()), std::system_error);
+}
+
+TEST(FormatBenchmark, DISABLED_ConvertAVectorToString)
+{
+    auto v = ints_of_every_length(bench::size(1 << 22));
+    auto small = std::vector<int32_t>(v.begin(), v.begin() + std::min<size_t>(v.size(), 20000));
+    double bytes = static_cast<double>(perf::join(v).size());
+
+    bench::report("std::accumulate (20000 elements)", bench::best_of(1, [&] {
+        auto s = std::accumulate(std::next(begin(small)), end(small), std::to_string(small[0]),
+            [](auto& acc, auto& x) { return acc + ", " + std::to_string(x); });
+        bench::keep(s);
+    }), static_cast<double>(perf::join(small).size()));
+    bench::report("s += \", \" + std::to_string", bench::best_of(3, [&] {
+        bench::keep(naive_join(v));
+    }), bytes);
+    bench::report("perf::join", bench::best_of(3, [&] {
+        bench::keep(perf::join(v));
+    }), bytes);
+
+    std::FILE* f = std::fopen("/dev/null", "w");
+    bench::report("perf::write_joined to /dev/null", bench::best_of(3, [&] {
+        perf::write_joined(fileno(f), v.data(), v.size());
+    }), bytes);
+    std::fclose(f);
+}
@@ -0,0 +1,303 @@
+#include "int_parser.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace perf {
+
+namespace {
+
+    // Longest token carried over between chunks, leading zeros included
+    constexpr size_t max_token = 64;
+
+    bool is_space(char c)
+    {
+        return (c == ' ') | (static_cast<unsigned char>(c - '\t') <= '\r' - '\t');
+    }
+
+    bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    [[noreturn]] void throw_out_of_range()
+    {
+        throw std::out_of_range("integer does not fit in int32_t");
+    }
+
+    [[noreturn]] void throw_invalid()
+    {
+        throw std::invalid_argument("invalid character in integer input");
+    }
+
+    inline int32_t checked(int64_t value, bool negative)
+    {
+        value = negative ? -value : value;
+        if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max()) {
+            throw_out_of_range();
+        }
+        return static_cast<int32_t>(value);
+    }
+
+    // Parses the token starting at p, which is not whitespace. Returns the
+    // position after it.
+    const char* parse_one(const char* p, const char* end, int32_t& value)
+    {
+        bool negative = *p == '-';
+        p += negative || *p == '+';
+
+        const char* digits = p;
+        int64_t magnitude = 0;
+        for (; p != end && is_digit(*p); ++p) {
+            magnitude = magnitude * 10 + (*p - '0');
+            if (magnitude > int64_t(1) << 32) {
+                throw_out_of_range();
+            }
+        }
+        if (p == digits || (p != end && !is_space(*p))) {
+            throw_invalid();
+        }
+
+        value = checked(magnitude, negative);
+        return p;
+    }
+
+#if PERF_X86
+    // Eight digits at once (SWAR): the bytes hold digit values, most
+    // significant first. Pairs, then quads, then the octet are combined
+    // with multiplies.
+    uint32_t eight_digits(uint64_t v)
+    {
+        v = v * 10 + (v >> 8);
+        v = (((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32)))
+                + (((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))))
+            >> 32;
+        return static_cast<uint32_t>(v);
+    }
+
+    // The len <= 8 digits at p. Reads eight bytes.
+    uint32_t short_digits(const char* p, unsigned len)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof v);
+        v -= 0x3030303030303030;
+        // Bytes past the number drop out at the top, zeros come in as
+        // leading zero digits
+        v <<= 8 * (8 - len);
+        return eight_digits(v);
+    }
+
+    uint32_t mask_of(__m128i bytes)
+    {
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+    }
+
+    uint32_t space_mask(__m128i x)
+    {
+        __m128i control = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8('\r' + 1)));
+        return mask_of(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), control));
+    }
+
+    uint32_t digit_mask(__m128i x)
+    {
+        return mask_of(_mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1))));
+    }
+
+    __m128i load(const char* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+#endif
+
+    struct parse_result {
+        size_t count;
+        const char* end;
+    };
+
+    // Parses at most `limit` numbers from input where no number is cut off
+    // at `end`.
+    //
+    // Input is classified 64 bytes at a time into digit, whitespace and sign
+    // bitmasks, which validate the whole block at once and give the start of
+    // every digit run. The same masks give each number's length, and the
+    // digits are converted eight at a time. Nothing depends on the
+    // previous number, so the numbers of a block are parsed in parallel by
+    // the CPU. Unusually long tokens and the last bytes use the scalar parser.
+    parse_result parse_complete(const char* begin, const char* end, int32_t* out, size_t limit)
+    {
+        const char* p = begin;
+        size_t n = 0;
+#if PERF_X86
+        const char* resume = begin;
+        uint64_t prev_digit = 0;
+        uint64_t prev_token = 0;
+        uint64_t prev_minus = 0;
+        for (; end - p >= 64 + 16 && n < limit; p += 64) {
+            uint64_t digits = 0;
+            uint64_t spaces = 0;
+            uint64_t minus = 0;
+            uint64_t plus = 0;
+            for (int j = 0; j < 64; j += 16) {
+                __m128i x = load(p + j);
+                digits |= uint64_t(digit_mask(x)) << j;
+                spaces |= uint64_t(space_mask(x)) << j;
+                minus |= uint64_t(mask_of(_mm_cmpeq_epi8(x, _mm_set1_epi8('-')))) << j;
+                plus |= uint64_t(mask_of(_mm_cmpeq_epi8(x, _mm_set1_epi8('+')))) << j;
+            }
+            // Digits of the next 16 bytes, for numbers running past the block
+            uint64_t next_digits = digit_mask(load(p + 64));
+
+            // The block holding the last number wanted goes to the scalar
+            // parser, which does not look at the bytes after that number
+            uint64_t starts = digits & ~((digits << 1) | prev_digit);
+            if (limit - n <= 64 && static_cast<size_t>(__builtin_popcountll(starts)) >= limit - n) {
+                break;
+            }
+
+            // Every byte is a digit, whitespace or a sign; a sign follows
+            // whitespace and precedes a digit
+            uint64_t signs = minus | plus;
+            uint64_t token = digits | signs;
+            if (~(token | spaces)
+                || (signs & ~((digits >> 1) | (next_digits << 63)))
+                || (signs & ((token << 1) | prev_token))) {
+                throw_invalid();
+            }
+
+            uint64_t signed_starts = (signs << 1) | (prev_token & ~prev_digit);
+            uint64_t negative_starts = (minus << 1) | prev_minus;
+            prev_digit = digits >> 63;
+            prev_token = token >> 63;
+            prev_minus = minus >> 63;
+
+            for (; starts && n < limit; starts &= starts - 1) {
+                unsigned s = __builtin_ctzll(starts);
+                const char* q = p + s;
+                uint64_t run = s ? (digits >> s) | (next_digits << (64 - s)) : digits;
+                unsigned len = __builtin_ctzll(~run | (uint64_t(1) << 63));
+                if (len > 10) {
+                    resume = parse_one(q - ((signed_starts >> s) & 1), end, out[n++]);
+                    continue;
+                }
+
+                // Up to two leading digits, then up to eight more; no branch
+                // on the length since lengths are usually unpredictable
+                unsigned high_len = len > 8 ? len - 8 : 0;
+                uint64_t d0 = q[0] - '0';
+                uint64_t d1 = q[1] - '0';
+                uint64_t high = high_len == 2 ? d0 * 10 + d1 : (high_len == 1 ? d0 : 0);
+                uint64_t magnitude = high * 100000000 + short_digits(q + high_len, len - high_len);
+                out[n++] = checked(static_cast<int64_t>(magnitude), (negative_starts >> s) & 1);
+                resume = q + len;
+            }
+        }
+        if (n == limit) {
+            return { n, resume };
+        }
+        if (p != begin && resume < p && !is_space(p[-1])) {
+            // A sign right before the unprocessed bytes belongs to them
+            --p;
+        }
+        p = std::max(p, resume);
+#endif
+        while (n < limit) {
+            while (p != end && is_space(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            p = parse_one(p, end, out[n++]);
+        }
+        return { n, p };
+    }
+
+} // namespace
+
+size_t int_parser::parse(const char* data, size_t size, int32_t* out)
+{
+    const char* p = data;
+    const char* end = data + size;
+    size_t n = 0;
+
+    if (!carry.empty()) {
+        while (p != end && !is_space(*p) && carry.size() <= max_token) {
+            carry.push_back(*p++);
+        }
+        if (carry.size() > max_token) {
+            throw std::invalid_argument("integer token too long");
+        }
+        if (p == end) {
+            return 0;
+        }
+        parse_one(carry.data(), carry.data() + carry.size(), out[n++]);
+        carry.clear();
+    }
+
+    // Everything after the last whitespace may continue in the next chunk
+    const char* tail = end;
+    while (tail != p && !is_space(tail[-1]) && end - tail <= static_cast<ptrdiff_t>(max_token)) {
+        --tail;
+    }
+    if (end - tail > static_cast<ptrdiff_t>(max_token)) {
+        throw std::invalid_argument("integer token too long");
+    }
+
+    n += parse_complete(p, tail, out + n, std::numeric_limits<size_t>::max()).count;
+    carry.assign(tail, end);
+    return n;
+}
+
+void int_parser::parse(const char* data, size_t size, std::vector<int32_t>& out)
+{
+    size_t old_size = out.size();
+    out.resize(old_size + max_values(size));
+    out.resize(old_size + parse(data, size, out.data() + old_size));
+}
+
+size_t int_parser::finish(int32_t* out)
+{
+    if (carry.empty()) {
+        return 0;
+    }
+    parse_one(carry.data(), carry.data() + carry.size(), out[0]);
+    carry.clear();
+    return 1;
+}
+
+std::vector<int32_t> parse_ints(const char* data, size_t size)
+{
+    std::vector<int32_t> result(int_parser::max_values(size));
+    int_parser parser;
+    size_t n = parser.parse(data, size, result.data());
+    n += parser.finish(result.data() + n);
+    result.resize(n);
+    return result;
+}
+
+size_t parse_counted_ints(const char* data, size_t size, std::vector<int32_t>& out)
+{
+    const char* end = data + size;
+    int32_t count = 0;
+    auto header = parse_complete(data, end, &count, 1);
+    if (header.count == 0 || count < 0) {
+        throw std::invalid_argument("missing or negative count");
+    }
+    // The count comes from the input, so it is checked before it sizes
+    // anything
+    if (static_cast<size_t>(count) > int_parser::max_values(static_cast<size_t>(end - header.end))) {
+        throw std::invalid_argument("fewer numbers than the count says");
+    }
+
+    out.resize(static_cast<size_t>(count));
+    if (parse_complete(header.end, end, out.data(), out.size()).count != out.size()) {
+        throw std::invalid_argument("fewer numbers than the count says");
+    }
+    return out.size();
+}
+
+} // namespace perf
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parsing of whitespace-separated decimal integers, a locale-free
+// replacement for reading ints from an std::istringstream.
+//
+// Numbers may have a leading '+' or '-'. Anything that is not a number or
+// whitespace throws std::invalid_argument, values outside int32_t throw
+// std::out_of_range.
+namespace perf {
+
+// Parses a stream that arrives in chunks. A number cut in two at the end
+// of a chunk is completed by the next call to parse(), or by finish() at
+// the end of the stream.
+class int_parser {
+public:
+    // Most values one parse() call can write for a chunk of `size` bytes
+    static size_t max_values(size_t size) { return size / 2 + 1; }
+
+    // Writes the numbers completed by this chunk to `out`, which must have
+    // room for max_values(size) values. Returns how many were written.
+    size_t parse(const char* data, size_t size, int32_t* out);
+
+    // Appends the numbers completed by this chunk to `out`
+    void parse(const char* data, size_t size, std::vector<int32_t>& out);
+
+    // Writes the number left over at the end of the stream, if any, to
+    // out[0]. Returns how many were written.
+    size_t finish(int32_t* out);
+
+private:
+    std::string carry;
+};
+
+// All numbers of a complete input
+std::vector<int32_t> parse_ints(const char* data, size_t size);
+
+inline std::vector<int32_t> parse_ints(const std::string& s)
+{
+    return parse_ints(s.data(), s.size());
+}
+
+// Input whose first number is the count of numbers that follow. Fills
+// `out` with exactly that many numbers, anything after them is ignored.
+// Throws std::invalid_argument if there are fewer. Returns the count.
+size_t parse_counted_ints(const char* data, size_t size, std::vector<int32_t>& out);
+
+inline size_t parse_counted_ints(const std::string& s, std::vector<int32_t>& out)
+{
+    return parse_counted_ints(s.data(), s.size(), out);
+}
+
+} // namespace perf
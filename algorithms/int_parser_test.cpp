@@ -0,0 +1,197 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "int_parser.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<int32_t> ints_of_every_length(size_t n)
+{
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> digits(1, 10);
+    std::vector<int32_t> v(n);
+    for (auto& x : v) {
+        // Every length from 1 to 10 digits, both signs
+        int64_t limit = 1;
+        for (int d = digits(rng); d > 0; --d) {
+            limit *= 10;
+        }
+        limit = std::min<int64_t>(limit - 1, INT32_MAX);
+        x = static_cast<int32_t>(std::uniform_int_distribution<int64_t>(-limit, limit)(rng));
+    }
+    return v;
+}
+
+std::string to_text(const std::vector<int32_t>& v)
+{
+    const char* separators[] = { " ", "\n", "  \t", "\r\n" };
+    std::string s;
+    for (size_t i = 0; i < v.size(); ++i) {
+        s += std::to_string(v[i]);
+        s += separators[i % 4];
+    }
+    return s;
+}
+
+} // namespace
+
+TEST(IntParser, ReadNumbersFromAString)
+{
+    std::string numbers{ "5 0 1 2 3 4" };
+
+    std::vector<int32_t> result;
+    perf::parse_counted_ints(numbers, result);
+
+    std::vector<int32_t> expected{ 0, 1, 2, 3, 4 };
+    ASSERT_EQ(expected, result);
+}
+
+TEST(IntParser, CountedIgnoresTrailingNumbers)
+{
+    std::vector<int32_t> result;
+
+    ASSERT_EQ(2u, perf::parse_counted_ints("2 7 8 9", result));
+    ASSERT_EQ((std::vector<int32_t>{ 7, 8 }), result);
+    ASSERT_THROW(perf::parse_counted_ints("3 1 2", result), std::invalid_argument);
+    // A count far beyond what the rest of the input can hold allocates
+    // nothing
+    ASSERT_THROW(perf::parse_counted_ints("2000000000\n1 2 3\n", result), std::invalid_argument);
+}
+
+TEST(IntParser, CountedIgnoresLongTrailingText)
+{
+    std::vector<int32_t> result;
+
+    ASSERT_EQ(3u, perf::parse_counted_ints("3 1 2 3 trailing" + std::string(100, ' '), result));
+    ASSERT_EQ((std::vector<int32_t>{ 1, 2, 3 }), result);
+
+    // The last number wanted anywhere in a block of the vectorized parser
+    auto v = ints_of_every_length(300);
+    for (size_t count = 0; count < v.size(); count += 7) {
+        std::vector<int32_t> head(v.begin(), v.begin() + count);
+        std::string text = std::to_string(count) + " " + to_text(head) + " x-+!" + to_text(v) + std::string(200, '#');
+
+        ASSERT_EQ(count, perf::parse_counted_ints(text, result));
+        ASSERT_EQ(head, result);
+    }
+}
+
+TEST(IntParser, MatchesIstringstream)
+{
+    auto v = ints_of_every_length(10000);
+    auto text = to_text(v);
+
+    std::istringstream is(text);
+    std::vector<int32_t> expected(std::istream_iterator<int32_t>(is), {});
+
+    ASSERT_EQ(v, expected);
+    ASSERT_EQ(v, perf::parse_ints(text));
+}
+
+TEST(IntParser, Limits)
+{
+    ASSERT_EQ((std::vector<int32_t>{ INT32_MIN, INT32_MAX, 0, 0, 7, -7 }),
+        perf::parse_ints("-2147483648 2147483647 -0 0000000000000000000 +7 -000000000000007"));
+    ASSERT_THROW(perf::parse_ints("2147483648"), std::out_of_range);
+    ASSERT_THROW(perf::parse_ints("-2147483649"), std::out_of_range);
+    ASSERT_THROW(perf::parse_ints("99999999999999999999"), std::out_of_range);
+}
+
+TEST(IntParser, RejectsGarbage)
+{
+    for (const char* bad : { "1 2 x", "12a", "- 1", "1-2", "--1", "1.5", "+" }) {
+        ASSERT_THROW(perf::parse_ints(bad), std::invalid_argument) << bad;
+        // The same at every offset of a block handled by the SIMD path
+        for (size_t offset = 0; offset < 130; ++offset) {
+            std::string padded = std::string(offset, ' ') + bad + std::string(100, ' ');
+            ASSERT_THROW(perf::parse_ints(padded), std::invalid_argument) << bad << " at " << offset;
+        }
+    }
+}
+
+TEST(IntParser, NumbersAcrossBlockBoundaries)
+{
+    for (const char* token : { "-1234567890", "+42", "-7", "0000000000001234", "2147483647" }) {
+        for (size_t offset = 0; offset < 130; ++offset) {
+            std::string text = "1 " + std::string(offset, ' ') + token + " 5" + std::string(100, '\n');
+
+            auto expected = std::vector<int32_t>{ 1, std::stoi(token), 5 };
+            ASSERT_EQ(expected, perf::parse_ints(text)) << token << " at " << offset;
+        }
+    }
+}
+
+TEST(IntParser, EmptyAndBlankInput)
+{
+    ASSERT_TRUE(perf::parse_ints("").empty());
+    ASSERT_TRUE(perf::parse_ints(" \n\t ").empty());
+}
+
+TEST(IntParser, ChunksSplitAnywhere)
+{
+    auto v = ints_of_every_length(200);
+    auto text = to_text(v);
+
+    for (size_t chunk = 1; chunk < 70; ++chunk) {
+        perf::int_parser parser;
+        std::vector<int32_t> result;
+        for (size_t i = 0; i < text.size(); i += chunk) {
+            parser.parse(text.data() + i, std::min(chunk, text.size() - i), result);
+        }
+        int32_t last;
+        if (parser.finish(&last)) {
+            result.push_back(last);
+        }
+
+        ASSERT_EQ(v, result) << "chunk = " << chunk;
+    }
+}
+
+TEST(IntParser, NumberAtEndOfStream)
+{
+    perf::int_parser parser;
+    int32_t out[4];
+
+    ASSERT_EQ(1u, parser.parse("12 3", 4, out));
+    ASSERT_EQ(0u, parser.parse("4", 1, out + 1));
+    ASSERT_EQ(1u, parser.finish(out + 1));
+    ASSERT_EQ(0u, parser.finish(out + 2));
+
+    ASSERT_EQ(12, out[0]);
+    ASSERT_EQ(34, out[1]);
+}
+
+TEST(IntParserBenchmark, DISABLED_ParseInts)
+{
+    auto v = ints_of_every_length(bench::size(1 << 23));
+    auto text = to_text(v);
+
+    bench::report("istringstream", bench::best_of(3, [&] {
+        std::istringstream is(text);
+        std::vector<int32_t> result;
+        result.reserve(v.size());
+        std::copy(std::istream_iterator<int32_t>(is), std::istream_iterator<int32_t>(), std::back_inserter(result));
+        bench::keep(result);
+    }), static_cast<double>(text.size()));
+    bench::report("perf::parse_ints", bench::best_of(3, [&] {
+        bench::keep(perf::parse_ints(text));
+    }), static_cast<double>(text.size()));
+
+    std::vector<int32_t> out(perf::int_parser::max_values(1 << 16));
+    bench::report("perf::int_parser, 64 KiB chunks", bench::best_of(3, [&] {
+        perf::int_parser parser;
+        size_t n = 0;
+        for (size_t i = 0; i < text.size(); i += 1 << 16) {
+            n += parser.parse(text.data() + i, std::min<size_t>(1 << 16, text.size() - i), out.data());
+        }
+        bench::keep(n);
+    }), static_cast<double>(text.size()));
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+// Searching index ranges of generated values without storing them.
+//
+// Instead of filling a vector with f(0), ..., f(n - 1) and running
+// std::upper_bound over it, these call f only at the O(log n) points the
+// search needs and allocate nothing. The answers are the indexes the
+// materialized search would give, as long as the predicate is monotone
+// over the range: false up to some index, true from there on.
+namespace perf {
+
+namespace detail {
+
+    // The next galloping step: twice `step`, but never more than `room`,
+    // the distance still left to search. A longer step would only probe
+    // the last index again, and doubling past room / 2 could overflow an
+    // Index that runs close to its maximum.
+    template <typename Index>
+    Index double_step(Index step, Index room)
+    {
+        return step <= room / 2 ? 2 * step : room;
+    }
+
+} // namespace detail
+
+// First i in [lo, hi) for which pred(i) is true, hi if there is none
+template <typename Index, typename Pred>
+Index first_true(Index lo, Index hi, Pred pred)
+{
+    while (lo < hi) {
+        Index mid = lo + (hi - lo) / 2;
+        if (pred(mid)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// As first_true, but in O(log d) evaluations where d is the distance of
+// the answer from lo: steps of 1, 2, 4, ... find a bracket, which is then
+// searched in binary. Faster when the answer is likely to be near the
+// start of a long range.
+template <typename Index, typename Pred>
+Index gallop_first_true(Index lo, Index hi, Pred pred)
+{
+    Index step = 1;
+    while (lo < hi) {
+        Index probe = hi - lo > step ? lo + step - 1 : hi - 1;
+        if (pred(probe)) {
+            return first_true(lo, probe, pred);
+        }
+        lo = probe + 1;
+        step = detail::double_step(step, hi - lo);
+    }
+    return hi;
+}
+
+// As first_true, starting from a guess of the answer: gallops up or down
+// from the guess, so a good guess takes O(log |answer - guess|)
+// evaluations
+template <typename Index, typename Pred>
+Index first_true_near(Index lo, Index hi, Index guess, Pred pred)
+{
+    if (lo >= hi) {
+        return hi;
+    }
+    guess = std::min(std::max(guess, lo), hi - 1);
+    if (!pred(guess)) {
+        return gallop_first_true(guess + 1, hi, pred);
+    }
+    // pred(guess) holds, gallop downwards for an index where it doesn't
+    Index top = guess;
+    Index step = 1;
+    while (top > lo) {
+        Index probe = top - lo > step ? top - step : lo;
+        if (!pred(probe)) {
+            return first_true(probe + 1, top, pred);
+        }
+        top = probe;
+        step = detail::double_step(step, top - lo);
+    }
+    return lo;
+}
+
+// Root of a continuous f in [a, b] with Brent's method: inverse quadratic
+// interpolation and secant steps where they converge, bisection where they
+// don't. f(a) and f(b) must not have the same sign, else throws
+// std::invalid_argument. Returns an x within `tolerance` of a sign change.
+template <typename F>
+double brent_root(F f, double a, double b, double tolerance = 1e-12)
+{
+    double fa = f(a);
+    double fb = f(b);
+    if (fa == 0) {
+        return a;
+    }
+    if (fb == 0) {
+        return b;
+    }
+    if ((fa < 0) == (fb < 0)) {
+        throw std::invalid_argument("brent_root: f(a) and f(b) have the same sign");
+    }
+    // b is the best estimate so far, a the other end of the bracket and c
+    // the previous b
+    if (std::abs(fa) < std::abs(fb)) {
+        std::swap(a, b);
+        std::swap(fa, fb);
+    }
+    double c = a;
+    double fc = fa;
+    double d = c;
+    bool bisected = true;
+    for (int iteration = 0; iteration < 200 && std::abs(b - a) > tolerance; ++iteration) {
+        double s;
+        if (fa != fc && fb != fc) {
+            s = a * fb * fc / ((fa - fb) * (fa - fc)) + b * fa * fc / ((fb - fa) * (fb - fc))
+                + c * fa * fb / ((fc - fa) * (fc - fb));
+        } else {
+            s = b - fb * (b - a) / (fb - fa);
+        }
+
+        double quarter = (3 * a + b) / 4;
+        bool outside = quarter < b ? !(s > quarter && s < b) : !(s < quarter && s > b);
+        double last_step = bisected ? std::abs(b - c) : std::abs(c - d);
+        bisected = outside || std::abs(s - b) >= last_step / 2 || last_step < tolerance;
+        if (bisected) {
+            s = (a + b) / 2;
+        }
+
+        double fs = f(s);
+        if (fs == 0) {
+            return s;
+        }
+        d = c;
+        c = b;
+        fc = fb;
+        if ((fa < 0) != (fs < 0)) {
+            b = s;
+            fb = fs;
+        } else {
+            a = s;
+            fa = fs;
+        }
+        if (std::abs(fa) < std::abs(fb)) {
+            std::swap(a, b);
+            std::swap(fa, fb);
+        }
+    }
+    return b;
+}
+
+// First i in [lo, hi) where f(i) reaches `threshold` from the side f(lo)
+// is on: f(i) <= threshold if f(lo) > threshold, f(i) >= threshold if
+// f(lo) < threshold. lo if f(lo) == threshold, hi if never. Over a
+// monotone f this is
+//
+//     std::lower_bound(values, values + n, threshold, std::greater<>())
+//
+// for decreasing values and std::lower_bound for increasing ones.
+//
+// f takes a double. Galloping from lo brackets the first crossing between
+// two probes, Brent's method narrows the bracket to an index, and the
+// exact index is found by galloping around that guess. The result is the
+// first crossing when f is monotone on [lo, hi). Otherwise galloping can
+// step over a dip between two probes, and the index returned is a
+// crossing but not necessarily the first one.
+template <typename Index, typename F>
+Index first_crossing(Index lo, Index hi, F f, double threshold = 0)
+{
+    if (lo >= hi) {
+        return hi;
+    }
+    double first = f(static_cast<double>(lo));
+    if (first == threshold) {
+        return lo;
+    }
+    bool decreasing = first > threshold;
+    auto reached = [&](Index i) {
+        double y = f(static_cast<double>(i));
+        return decreasing ? y <= threshold : y >= threshold;
+    };
+
+    // Not reached at `below`, probe = below + 1, below + 2, below + 4, ...
+    Index below = lo;
+    Index step = 1;
+    while (true) {
+        Index probe = hi - below > step ? below + step : hi - 1;
+        if (probe == below) {
+            return hi;
+        }
+        if (reached(probe)) {
+            if (probe - below == 1) {
+                return probe;
+            }
+            double x = brent_root([&](double x) { return f(x) - threshold; },
+                static_cast<double>(below), static_cast<double>(probe), 0.5);
+            return first_true_near(below + 1, probe + 1, static_cast<Index>(std::ceil(x)), reached);
+        }
+        below = probe;
+        step = detail::double_step(step, hi - below);
+    }
+}
+
+// Position of the maximum of f over [lo, hi) for a unimodal f: strictly
+// increasing up to the peak, non-increasing after it. O(log n)
+// evaluations, and the same answer as std::max_element over the values.
+template <typename Index, typename F>
+Index argmax_unimodal(Index lo, Index hi, F f)
+{
+    if (lo >= hi) {
+        return hi;
+    }
+    return first_true(lo, hi - 1, [&](Index i) { return !(f(i) < f(i + 1)); });
+}
+
+// Position of the minimum of f over [lo, hi) for an f that strictly
+// decreases down to the minimum and does not decrease after it
+template <typename Index, typename F>
+Index argmin_unimodal(Index lo, Index hi, F f)
+{
+    if (lo >= hi) {
+        return hi;
+    }
+    return first_true(lo, hi - 1, [&](Index i) { return !(f(i + 1) < f(i)); });
+}
+
+} // namespace perf
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "monotone_search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+TEST(MonotoneSearch, FindZeroCrossingOfCosine)
+{
+    int evaluations = 0;
+    auto cosine = [&](double i) {
+        ++evaluations;
+        return std::cos(i / 100000.0);
+    };
+
+    auto result = perf::first_crossing(0, 628300, cosine);
+
+    ASSERT_EQ(157080, result);
+    ASSERT_GT(40, evaluations);
+}
+
+TEST(MonotoneSearch, SearchesAgreeWithMaterializedSearch)
+{
+    std::mt19937 rng(1);
+    for (int trial = 0; trial < 200; ++trial) {
+        int64_t n = rng() % 2000;
+        int64_t answer = n ? rng() % (n + 1) : 0;
+        std::vector<char> values(n);
+        for (int64_t i = 0; i < n; ++i) {
+            values[i] = i >= answer;
+        }
+        int64_t expected = std::partition_point(begin(values), end(values), [](char v) { return !v; }) - begin(values);
+        auto pred = [&](int64_t i) { return values.at(i) != 0; };
+        int64_t guess = n ? rng() % n : 0;
+
+        ASSERT_EQ(expected, perf::first_true(int64_t(0), n, pred));
+        ASSERT_EQ(expected, perf::gallop_first_true(int64_t(0), n, pred));
+        ASSERT_EQ(expected, perf::first_true_near(int64_t(0), n, guess, pred));
+    }
+}
+
+TEST(MonotoneSearch, GallopingCostsLogOfTheDistance)
+{
+    int evaluations = 0;
+    auto pred = [&](uint64_t i) {
+        ++evaluations;
+        return i >= 1000;
+    };
+
+    ASSERT_EQ(1000u, perf::gallop_first_true(uint64_t(0), uint64_t(1) << 62, pred));
+    ASSERT_GT(25, evaluations);
+
+    evaluations = 0;
+    ASSERT_EQ(1000u, perf::first_true_near(uint64_t(0), uint64_t(1) << 62, uint64_t(1003), pred));
+    ASSERT_GT(8, evaluations);
+}
+
+TEST(MonotoneSearch, GallopsUpToTheLargestIndex)
+{
+    // The steps would pass 2^31 before reaching the answers
+    const int top = std::numeric_limits<int>::max();
+    for (int answer : { 0, 1, top - 1000, top - 1, top }) {
+        auto pred = [=](int i) { return i >= answer; };
+        ASSERT_EQ(answer, perf::gallop_first_true(0, top, pred));
+        ASSERT_EQ(answer, perf::first_true_near(0, top, top - 1, pred));
+        ASSERT_EQ(answer, perf::first_true_near(0, top, 0, pred));
+        ASSERT_EQ(answer, perf::first_crossing(0, top, [=](double x) { return x - answer; }));
+    }
+}
+
+TEST(MonotoneSearch, CrossingMatchesMaterializedSearch)
+{
+    auto decreasing = [](double x) { return 1e6 - x * x; };
+    auto increasing = [](double x) { return std::log1p(x); };
+    const int n = 100000;
+    std::vector<double> down(n);
+    std::vector<double> up(n);
+    for (int i = 0; i < n; ++i) {
+        down[i] = decreasing(i);
+        up[i] = increasing(i);
+    }
+
+    for (double t : { 1e6, 999999.5, 5e5, 0.0, -1e9, -1e12 }) {
+        auto expected = std::lower_bound(begin(down), end(down), t, std::greater<>()) - begin(down);
+        ASSERT_EQ(expected, perf::first_crossing(0, n, decreasing, t)) << t;
+    }
+    for (double t : { 0.0, 0.5, std::log1p(777.0), 11.0, 12.0 }) {
+        auto expected = std::lower_bound(begin(up), end(up), t) - begin(up);
+        ASSERT_EQ(expected, perf::first_crossing(0, n, increasing, t)) << t;
+    }
+    ASSERT_EQ(5, perf::first_crossing(5, 5, increasing));
+}
+
+TEST(MonotoneSearch, BrentRoot)
+{
+    int evaluations = 0;
+    auto cosine = [&](double x) {
+        ++evaluations;
+        return std::cos(x);
+    };
+
+    ASSERT_NEAR(M_PI / 2, perf::brent_root(cosine, 0.0, 3.0), 1e-12);
+    ASSERT_GT(25, evaluations);
+    ASSERT_NEAR(std::cbrt(2.0), perf::brent_root([](double x) { return x * x * x - 2; }, 0.0, 5.0), 1e-12);
+    ASSERT_THROW(perf::brent_root(cosine, 0.0, 1.0), std::invalid_argument);
+}
+
+TEST(MonotoneSearch, UnimodalMaximumAndMinimum)
+{
+    for (int peak : { 0, 1, 500, 998, 999 }) {
+        std::vector<int> v(1000);
+        for (int i = 0; i < 1000; ++i) {
+            v[i] = i <= peak ? i : 2 * peak - i;
+        }
+        v[std::min(peak + 1, 999)] = v[peak]; // a plateau after the peak is allowed
+        auto at = [&](int i) { return v[i]; };
+        auto negated = [&](int i) { return -v[i]; };
+
+        ASSERT_EQ(std::max_element(begin(v), end(v)) - begin(v), perf::argmax_unimodal(0, 1000, at));
+        ASSERT_EQ(std::max_element(begin(v), end(v)) - begin(v), perf::argmin_unimodal(0, 1000, negated));
+    }
+}
+
+TEST(MonotoneSearchBenchmark, DISABLED_ZeroCrossing)
+{
+    const int n = 628300;
+    double materialized = bench::best_of(5, [] {
+        std::vector<double> c(n);
+        std::iota(begin(c), end(c), 0);
+        std::transform(begin(c), end(c), begin(c), [](auto d) { return std::cos(d / 100000.0); });
+        bench::keep(std::upper_bound(begin(c), end(c), 0.0, std::greater<double>()) - begin(c));
+    });
+    double binary = bench::best_of(5, [] {
+        bench::keep(perf::first_true(0, n, [](int i) { return std::cos(i / 100000.0) <= 0; }));
+    });
+    double brent = bench::best_of(5, [] {
+        bench::keep(perf::first_crossing(0, n, [](double i) { return std::cos(i / 100000.0); }));
+    });
+    std::printf("materialized   %9.3f us\nfirst_true     %9.3f us\nfirst_crossing %9.3f us\n",
+        materialized * 1e6, binary * 1e6, brent * 1e6);
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "parallel.h"
+#include "partition.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Rotating a range and sliding a part of it to another position.
+//
+// std::rotate on random access iterators follows the cycles of the
+// permutation, gcd(n, k) of them, jumping k elements at a time. On arrays
+// larger than the cache every such step is a cache miss. These use the
+// block swap of Gries and Mills instead: the shorter side is swapped with
+// the part of the longer side next to it, which leaves the swapped part in
+// its final place and a smaller rotation of the rest. Every swap streams
+// through two contiguous blocks.
+//
+// Trivially copyable elements are copied with memcpy and memmove. As soon
+// as the shorter side fits in a buffer of rotate_buffer_bytes, it is set
+// aside, the longer side is moved over with one memmove and the shorter
+// one copied back behind it, so most rotations read and write every
+// element once or twice.
+namespace perf {
+
+namespace detail {
+
+    // Trivially copyable blocks are swapped through a stack buffer of this
+    // many bytes, shorter sides of rotations of this size are set aside on it
+    constexpr size_t swap_chunk_bytes = 2048;
+
+    // The largest shorter side that is set aside in the per-thread buffer,
+    // which thread_scratch frees again after the call when it is large
+    constexpr size_t rotate_buffer_bytes = 1 << 20;
+
+    constexpr size_t rotate_grain = 1 << 16;
+
+    // Swaps [a, a + n) with [b, b + n), which do not overlap
+    template <typename T>
+    void swap_blocks(T* a, T* b, size_t n, std::true_type)
+    {
+        constexpr size_t chunk = std::max<size_t>(1, swap_chunk_bytes / sizeof(T));
+        typename std::aligned_storage<chunk * sizeof(T), alignof(T)>::type tmp;
+        for (size_t i = 0; i < n; i += chunk) {
+            size_t bytes = std::min(chunk, n - i) * sizeof(T);
+            std::memcpy(&tmp, a + i, bytes);
+            std::memcpy(a + i, b + i, bytes);
+            std::memcpy(b + i, &tmp, bytes);
+        }
+    }
+
+    template <typename T>
+    void swap_blocks(T* a, T* b, size_t n, std::false_type)
+    {
+        std::swap_ranges(a, a + n, b);
+    }
+
+    // Rotates by setting the shorter side aside in buffer
+    template <typename T>
+    void buffered_rotate(T* first, T* middle, T* last, void* buffer)
+    {
+        size_t a = middle - first;
+        size_t b = last - middle;
+        if (a <= b) {
+            std::memcpy(buffer, first, a * sizeof(T));
+            std::memmove(first, middle, b * sizeof(T));
+            std::memcpy(last - a, buffer, a * sizeof(T));
+        } else {
+            std::memcpy(buffer, middle, b * sizeof(T));
+            std::memmove(first + b, first, a * sizeof(T));
+            std::memcpy(first, buffer, b * sizeof(T));
+        }
+    }
+
+    // Finishes the rotation if its shorter side fits in the buffer
+    template <typename T>
+    bool finish_rotate(T* first, T* middle, T* last, std::true_type)
+    {
+        size_t bytes = std::min(middle - first, last - middle) * sizeof(T);
+        if (bytes <= swap_chunk_bytes) {
+            typename std::aligned_storage<swap_chunk_bytes>::type tmp;
+            buffered_rotate(first, middle, last, &tmp);
+            return true;
+        }
+        if (bytes <= rotate_buffer_bytes) {
+            thread_scratch<unsigned char> scratch;
+            auto& buffer = scratch.get();
+            if (buffer.size() < bytes) {
+                buffer.resize(bytes);
+            }
+            buffered_rotate(first, middle, last, buffer.data());
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool finish_rotate(T*, T*, T*, std::false_type)
+    {
+        return false;
+    }
+
+    // Gries and Mills' block swap. Calls swap(x, y, n) to swap two blocks
+    // and finish(first, middle, last) before every step, which returns
+    // whether it has done the rest of the rotation.
+    template <typename T, typename SwapBlocks, typename Finish>
+    void block_swap_rotate(T* first, T* middle, T* last, SwapBlocks swap, Finish finish)
+    {
+        while (first != middle && middle != last && !finish(first, middle, last)) {
+            size_t a = middle - first;
+            size_t b = last - middle;
+            if (a <= b) {
+                // A B1 B2 -> B1 A B2, B1 is in place
+                swap(first, middle, a);
+                first = middle;
+                middle += a;
+            } else {
+                // A1 A2 B -> A1 B A2, A2 is in place
+                swap(middle - b, middle, b);
+                last = middle;
+                middle -= b;
+            }
+        }
+    }
+
+    // Moves v[0, n) by `shift` elements to the left (shift < 0) or right
+    // on several threads. A block's destination overlaps the first or last
+    // |shift| elements of its neighbour, so every block sets those aside
+    // before any block moves.
+    template <typename T>
+    void parallel_memmove(T* v, size_t n, ptrdiff_t shift)
+    {
+        size_t d = shift < 0 ? -shift : shift;
+        block_partition p(n, std::max(rotate_grain, d));
+        std::vector<unsigned char> saved(p.count * d * sizeof(T));
+        auto aside = [&](size_t b) { return saved.data() + b * d * sizeof(T); };
+
+        parallel_for_each_block(p, [&](size_t b, size_t begin, size_t end) {
+            std::memcpy(aside(b), v + (shift < 0 ? end - d : begin), d * sizeof(T));
+        });
+        parallel_for_each_block(p, [&](size_t b, size_t begin, size_t end) {
+            if (shift < 0) {
+                std::memmove(v + begin - d, v + begin, (end - begin - d) * sizeof(T));
+                std::memcpy(v + end - 2 * d, aside(b), d * sizeof(T));
+            } else {
+                std::memmove(v + begin + 2 * d, v + begin + d, (end - begin - d) * sizeof(T));
+                std::memcpy(v + begin + d, aside(b), d * sizeof(T));
+            }
+        });
+    }
+
+    template <typename T>
+    bool parallel_finish_rotate(T* first, T* middle, T* last, std::true_type)
+    {
+        size_t a = middle - first;
+        size_t b = last - middle;
+        size_t bytes = std::min(a, b) * sizeof(T);
+        if (bytes > rotate_buffer_bytes || std::max(a, b) < 2 * rotate_grain) {
+            return finish_rotate(first, middle, last, std::true_type());
+        }
+        std::vector<unsigned char> buffer(bytes);
+        if (a <= b) {
+            std::memcpy(buffer.data(), first, bytes);
+            parallel_memmove(middle, b, -static_cast<ptrdiff_t>(a));
+            std::memcpy(last - a, buffer.data(), bytes);
+        } else {
+            std::memcpy(buffer.data(), middle, bytes);
+            parallel_memmove(first, a, static_cast<ptrdiff_t>(b));
+            std::memcpy(first, buffer.data(), bytes);
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool parallel_finish_rotate(T*, T*, T*, std::false_type)
+    {
+        return false;
+    }
+
+} // namespace detail
+
+// Exchanges [first, middle) and [middle, last) and returns where *first
+// ends up, first + (last - middle), like std::rotate
+template <typename T>
+T* rotate(T* first, T* middle, T* last)
+{
+    using trivial = typename std::is_trivially_copyable<T>::type;
+    detail::block_swap_rotate(first, middle, last,
+        [](T* x, T* y, size_t n) { detail::swap_blocks(x, y, n, trivial()); },
+        [](T* f, T* m, T* l) { return detail::finish_rotate(f, m, l, trivial()); });
+    return first + (last - middle);
+}
+
+// rotate on several threads: large block swaps are split between the
+// threads, and so is the final memmove of trivially copyable elements.
+// Elements that are not trivially copyable swap small blocks on the
+// calling thread, for example every step of moving one element to the
+// far end of the range.
+template <typename T>
+T* parallel_rotate(T* first, T* middle, T* last)
+{
+    using trivial = typename std::is_trivially_copyable<T>::type;
+    detail::block_swap_rotate(first, middle, last,
+        [](T* x, T* y, size_t n) {
+            if (n < 2 * detail::rotate_grain) {
+                detail::swap_blocks(x, y, n, trivial());
+                return;
+            }
+            parallel_for_each_block(block_partition(n, detail::rotate_grain), [&](size_t, size_t begin, size_t end) {
+                detail::swap_blocks(x + begin, y + begin, end - begin, trivial());
+            });
+        },
+        [](T* f, T* m, T* l) { return detail::parallel_finish_rotate(f, m, l, trivial()); });
+    return first + (last - middle);
+}
+
+// Slides [first, last) to pos: forward so that it ends just before pos,
+// or backward so that it starts at pos. The elements in between fill the
+// gap in their order. Returns where the range is now.
+template <typename T>
+std::pair<T*, T*> move_range(T* first, T* last, T* pos)
+{
+    if (pos < first) {
+        return { pos, perf::rotate(pos, first, last) };
+    }
+    if (last < pos) {
+        return { perf::rotate(first, last, pos), pos };
+    }
+    return { first, last };
+}
+
+template <typename T>
+std::pair<T*, T*> parallel_move_range(T* first, T* last, T* pos)
+{
+    if (pos < first) {
+        return { pos, perf::parallel_rotate(pos, first, last) };
+    }
+    if (last < pos) {
+        return { perf::parallel_rotate(first, last, pos), pos };
+    }
+    return { first, last };
+}
+
+// Index versions: slide v[first, last) to pos, return its new indices
+template <typename T>
+std::pair<size_t, size_t> move_range(std::vector<T>& v, size_t first, size_t last, size_t pos)
+{
+    auto moved = perf::move_range(v.data() + first, v.data() + last, v.data() + pos);
+    return { moved.first - v.data(), moved.second - v.data() };
+}
+
+template <typename T>
+std::pair<size_t, size_t> parallel_move_range(std::vector<T>& v, size_t first, size_t last, size_t pos)
+{
+    auto moved = perf::parallel_move_range(v.data() + first, v.data() + last, v.data() + pos);
+    return { moved.first - v.data(), moved.second - v.data() };
+}
+
+} // namespace perf
@@ -0,0 +1,197 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "move_range.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<int> iota(size_t n)
+{
+    std::vector<int> v(n);
+    std::iota(begin(v), end(v), 0);
+    return v;
+}
+
+std::vector<int> std_rotate(std::vector<int> v, size_t first, size_t middle, size_t last)
+{
+    std::rotate(begin(v) + first, begin(v) + middle, begin(v) + last);
+    return v;
+}
+
+// Sides from empty through the stack buffer and the per-thread one up to
+// rotations that need block swaps first
+const size_t side_lengths[] = { 0, 1, 2, 7, 511, 512, 513, 40000, 262144, 262145, 300001 };
+
+class ParallelMoveRange : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST(MoveRange, MoveMultipleElementsInAContainer)
+{
+    std::vector<int> numbers{ 1, 2, 3, 4, 5, 6, 7 };
+
+    auto moved = perf::move_range(numbers, 1, 3, numbers.size() - 1);
+
+    std::vector<int> expected{ 1, 4, 5, 6, 2, 3, 7 }; // [2, 3] moved near the end
+    ASSERT_EQ(expected, numbers);
+    ASSERT_EQ(4, moved.first);
+    ASSERT_EQ(6, moved.second);
+}
+
+TEST(MoveRange, MovesBackwardToPosition)
+{
+    std::vector<int> numbers{ 1, 2, 3, 4, 5, 6, 7 };
+
+    auto moved = perf::move_range(numbers, 4, 6, 1);
+
+    std::vector<int> expected{ 1, 5, 6, 2, 3, 4, 7 };
+    ASSERT_EQ(expected, numbers);
+    ASSERT_EQ(1, moved.first);
+    ASSERT_EQ(3, moved.second);
+}
+
+TEST(MoveRange, PositionInsideRangeChangesNothing)
+{
+    std::vector<int> numbers{ 1, 2, 3, 4, 5 };
+
+    auto moved = perf::move_range(numbers, 1, 4, 2);
+
+    ASSERT_EQ((std::vector<int>{ 1, 2, 3, 4, 5 }), numbers);
+    ASSERT_EQ(1, moved.first);
+    ASSERT_EQ(4, moved.second);
+}
+
+TEST(MoveRange, RotateMatchesStd)
+{
+    for (size_t a : side_lengths) {
+        for (size_t b : side_lengths) {
+            auto v = iota(a + b + 3);
+            auto expected = std_rotate(v, 1, 1 + a, 1 + a + b);
+
+            int* result = perf::rotate(v.data() + 1, v.data() + 1 + a, v.data() + 1 + a + b);
+
+            ASSERT_EQ(expected, v) << a << " " << b;
+            ASSERT_EQ(v.data() + 1 + b, result);
+        }
+    }
+}
+
+TEST(MoveRange, ThreadBufferKeepsNothingLargeAfterTheCall)
+{
+    // A shorter side of 800 KB goes through the per-thread buffer
+    auto v = iota(1000000);
+    auto expected = std_rotate(v, 0, 200000, v.size());
+
+    perf::rotate(v.data(), v.data() + 200000, v.data() + v.size());
+
+    ASSERT_EQ(expected, v);
+    ASSERT_EQ(0u, perf::detail::partition_scratch<unsigned char>().capacity());
+}
+
+TEST(MoveRange, RotatesElementsThatAreNotTriviallyCopyable)
+{
+    std::mt19937 rng(11);
+    for (int trial = 0; trial < 200; ++trial) {
+        size_t n = rng() % 300;
+        std::vector<std::string> v(n);
+        for (size_t i = 0; i < n; ++i) {
+            v[i] = std::string(20, 'a') + std::to_string(i);
+        }
+        size_t middle = n ? rng() % (n + 1) : 0;
+        auto expected = v;
+        std::rotate(begin(expected), begin(expected) + middle, end(expected));
+
+        perf::rotate(v.data(), v.data() + middle, v.data() + n);
+
+        ASSERT_EQ(expected, v) << n << " " << middle;
+    }
+}
+
+TEST(MoveRange, MovesLargeElements)
+{
+    struct big {
+        int id;
+        char payload[4000];
+    };
+    std::vector<big> v(9);
+    for (int i = 0; i < 9; ++i) {
+        v[i].id = i;
+    }
+
+    perf::move_range(v, 0, 3, 9);
+
+    std::vector<int> ids;
+    for (auto& x : v) {
+        ids.push_back(x.id);
+    }
+    ASSERT_EQ((std::vector<int>{ 3, 4, 5, 6, 7, 8, 0, 1, 2 }), ids);
+}
+
+TEST_F(ParallelMoveRange, RotateMatchesStd)
+{
+    for (size_t a : side_lengths) {
+        for (size_t b : { 0, 1, 511, 262144, 300001, 1000003 }) {
+            auto v = iota(a + b + 3);
+            auto expected = std_rotate(v, 1, 1 + a, 1 + a + b);
+
+            int* result = perf::parallel_rotate(v.data() + 1, v.data() + 1 + a, v.data() + 1 + a + b);
+
+            ASSERT_EQ(expected, v) << a << " " << b;
+            ASSERT_EQ(v.data() + 1 + b, result);
+
+            // And the mirror image
+            v = iota(a + b + 3);
+            expected = std_rotate(v, 1, 1 + b, 1 + a + b);
+            perf::parallel_rotate(v.data() + 1, v.data() + 1 + b, v.data() + 1 + a + b);
+            ASSERT_EQ(expected, v) << b << " " << a;
+        }
+    }
+}
+
+TEST_F(ParallelMoveRange, MovesStrings)
+{
+    std::vector<std::string> v(400000);
+    for (size_t i = 0; i < v.size(); ++i) {
+        v[i] = std::to_string(i);
+    }
+    auto expected = v;
+    std::rotate(begin(expected) + 10, begin(expected) + 150000, end(expected) - 5);
+
+    auto moved = perf::parallel_move_range(v, 10, 150000, v.size() - 5);
+
+    ASSERT_EQ(expected, v);
+    ASSERT_EQ(v.size() - 5 - 149990, moved.first);
+}
+
+TEST(MoveRangeBenchmark, DISABLED_Rotate)
+{
+    // BENCH_N=1000000000 for the 4 GB case
+    auto n = bench::size(1 << 27);
+    std::vector<int> v(n);
+    std::iota(begin(v), end(v), 0);
+
+    for (double split : { 0.001, 0.3, 0.5 }) {
+        size_t k = static_cast<size_t>(n * split);
+        std::printf("%zu ints, shorter side %zu\n", n, k);
+        bench::report("std::rotate", bench::best_of(3, [&] {
+            std::rotate(begin(v), begin(v) + k, end(v));
+            bench::keep(v[0]);
+        }), 2.0 * n * sizeof(int));
+        bench::report("perf::rotate", bench::best_of(3, [&] {
+            perf::rotate(v.data(), v.data() + k, v.data() + n);
+            bench::keep(v[0]);
+        }), 2.0 * n * sizeof(int));
+        bench::report("perf::parallel_rotate", bench::best_of(3, [&] {
+            perf::parallel_rotate(v.data(), v.data() + k, v.data() + n);
+            bench::keep(v[0]);
+        }), 2.0 * n * sizeof(int));
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace perf {
+
+// How many threads the parallel algorithms may use
+inline unsigned& concurrency_setting()
+{
+    static unsigned n = std::max(1u, std::thread::hardware_concurrency());
+    return n;
+}
+
+inline unsigned concurrency()
+{
+    return concurrency_setting();
+}
+
+inline void set_concurrency(unsigned n)
+{
+    concurrency_setting() = std::max(1u, n);
+}
+
+// Whether the workers of default_pool() are pinned to CPUs, off by default
+inline bool& thread_pinning_setting()
+{
+    static bool pin = false;
+    return pin;
+}
+
+inline bool thread_pinning()
+{
+    return thread_pinning_setting();
+}
+
+inline void set_thread_pinning(bool pin)
+{
+    thread_pinning_setting() = pin;
+}
+
+// Splits [0, n) into contiguous blocks of at least `grain` elements,
+// one block per thread at most
+struct block_partition {
+    block_partition(size_t n, size_t grain)
+        : n(n)
+        , count(std::max<size_t>(1, std::min<size_t>(concurrency(), n / std::max<size_t>(1, grain))))
+    {
+    }
+
+    size_t begin(size_t block) const { return n / count * block + std::min(block, n % count); }
+    size_t end(size_t block) const { return begin(block + 1); }
+
+    size_t n;
+    size_t count;
+};
+
+// Calls f(block, begin, end) for every block concurrently on the workers
+// of default_pool(). A single block runs on the calling thread. The first
+// exception thrown by any block is rethrown.
+template <class F>
+void parallel_for_each_block(const block_partition& p, F f)
+{
+    if (p.count == 1) {
+        f(0, p.begin(0), p.end(0));
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(p.count);
+    default_pool().parallel_for(0, p.count, 1, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            try {
+                f(b, p.begin(b), p.end(b));
+            } catch (...) {
+                errors[b] = std::current_exception();
+            }
+        }
+    });
+
+    for (auto& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+} // namespace perf
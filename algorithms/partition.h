@@ -0,0 +1,267 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Stable partitioning: the elements satisfying the predicate come first,
+// and both groups keep their original order, as with std::stable_partition.
+//
+// std::stable_partition allocates a temporary buffer on every call. These
+// take the scratch memory from the caller or from a per-thread buffer
+// that small inputs reuse between calls, and run in one linear pass.
+namespace perf {
+
+namespace detail {
+
+    // Matching elements go forward from out, the others backward from
+    // out + n. Trivially copyable elements are written to both cursors and
+    // only the right one advances, so there is no branch on the predicate:
+    // the stray write lands on a slot that is claimed later.
+    template <typename T, typename UnaryPredicate>
+    size_t partition_copy(const T* in, size_t n, T* out, UnaryPredicate pred, std::true_type)
+    {
+        size_t t = 0;
+        T* back = out + n - 1;
+        for (size_t i = 0; i < n; ++i) {
+            T x = in[i];
+            bool keep = pred(x);
+            out[t] = x;
+            *back = x;
+            t += keep;
+            back -= !keep;
+        }
+        return t;
+    }
+
+    template <typename T, typename UnaryPredicate>
+    size_t partition_copy(const T* in, size_t n, T* out, UnaryPredicate pred, std::false_type)
+    {
+        size_t t = 0;
+        T* back = out + n;
+        for (size_t i = 0; i < n; ++i) {
+            if (pred(in[i])) {
+                out[t++] = in[i];
+            } else {
+                *--back = in[i];
+            }
+        }
+        return t;
+    }
+
+    // Matching elements are compacted in place, the others set aside in
+    // scratch and moved back behind them
+    template <typename T, typename UnaryPredicate>
+    size_t partition_in_place(T* v, size_t n, UnaryPredicate pred, std::vector<T>& scratch, std::true_type)
+    {
+        if (scratch.size() < n) {
+            scratch.resize(n);
+        }
+        T* aside = scratch.data();
+        size_t t = 0;
+        size_t f = 0;
+        for (size_t i = 0; i < n; ++i) {
+            T x = v[i];
+            bool keep = pred(x);
+            v[t] = x;
+            aside[f] = x;
+            t += keep;
+            f += !keep;
+        }
+        std::copy(aside, aside + f, v + t);
+        return t;
+    }
+
+    template <typename T, typename UnaryPredicate>
+    size_t partition_in_place(T* v, size_t n, UnaryPredicate pred, std::vector<T>& scratch, std::false_type)
+    {
+        scratch.clear();
+        size_t t = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (pred(v[i])) {
+                if (t != i) {
+                    v[t] = std::move(v[i]);
+                }
+                ++t;
+            } else {
+                scratch.push_back(std::move(v[i]));
+            }
+        }
+        std::move(scratch.begin(), scratch.end(), v + t);
+        // Keeps the capacity, releases what the elements own
+        scratch.clear();
+        return t;
+    }
+
+    template <typename T>
+    std::vector<T>& partition_scratch()
+    {
+        static thread_local std::vector<T> scratch;
+        return scratch;
+    }
+
+    // Whether partition_scratch<T>() is lent out on this thread
+    template <typename T>
+    bool& partition_scratch_leased()
+    {
+        static thread_local bool leased = false;
+        return leased;
+    }
+
+    // Per-thread buffers up to this size are kept for the next call
+    constexpr size_t scratch_keep_bytes = 1 << 16;
+
+    // Lends the calling thread's scratch buffer for one call. On return a
+    // large buffer is freed and a small one keeps no live elements, so a
+    // single big call does not pin memory for the life of the thread.
+    //
+    // A worker waiting for its blocks runs other tasks, which may be
+    // another call on the same thread while the first one still writes
+    // to the buffer. Such a nested call gets a vector of its own.
+    template <typename T>
+    class thread_scratch {
+    public:
+        thread_scratch()
+            : shared(!partition_scratch_leased<T>())
+            , buffer(shared ? partition_scratch<T>() : own)
+        {
+            if (shared) {
+                partition_scratch_leased<T>() = true;
+            }
+        }
+
+        ~thread_scratch()
+        {
+            if (!shared) {
+                return;
+            }
+            if (buffer.capacity() * sizeof(T) > scratch_keep_bytes) {
+                std::vector<T>().swap(buffer);
+            } else if (!std::is_trivially_destructible<T>::value) {
+                buffer.clear();
+            }
+            partition_scratch_leased<T>() = false;
+        }
+
+        thread_scratch(const thread_scratch&) = delete;
+        thread_scratch& operator=(const thread_scratch&) = delete;
+
+        std::vector<T>& get() { return buffer; }
+
+    private:
+        bool shared;
+        std::vector<T> own;
+        std::vector<T>& buffer;
+    };
+
+    constexpr size_t partition_grain = 1 << 16;
+
+} // namespace detail
+
+// Copies in[0, n) to out[0, n) partitioned: matching elements to the front
+// in order, the others after them in order. Returns how many matched.
+template <typename T, typename UnaryPredicate>
+size_t stable_partition_copy(const T* in, size_t n, T* out, UnaryPredicate pred)
+{
+    if (n == 0) {
+        return 0;
+    }
+    size_t t = detail::partition_copy(in, n, out, pred, std::is_trivially_copyable<T>());
+    // The rejected elements were written back to front
+    std::reverse(out + t, out + n);
+    return t;
+}
+
+// Partitions v[0, n) in place, moving the rejected elements through
+// `scratch`. The scratch vector keeps its capacity, so passing the same
+// one to repeated calls allocates only when the input outgrows it.
+// Returns how many elements matched.
+template <typename T, typename UnaryPredicate>
+size_t stable_partition(T* v, size_t n, UnaryPredicate pred, std::vector<T>& scratch)
+{
+    return detail::partition_in_place(v, n, pred, scratch, std::is_trivially_copyable<T>());
+}
+
+// As above with a buffer owned by the calling thread. Buffers of up to
+// 64 KB are kept for the next call, larger ones are freed on return.
+template <typename T, typename UnaryPredicate>
+size_t stable_partition(T* v, size_t n, UnaryPredicate pred)
+{
+    detail::thread_scratch<T> scratch;
+    return stable_partition(v, n, pred, scratch.get());
+}
+
+template <typename T, typename UnaryPredicate>
+typename std::vector<T>::iterator stable_partition(std::vector<T>& v, UnaryPredicate pred)
+{
+    return v.begin() + stable_partition(v.data(), v.size(), pred);
+}
+
+// stable_partition_copy on several threads. Every block counts its
+// matches, an exclusive prefix sum over the counts gives each block where
+// its matching elements start in the output, and the blocks then scatter
+// their elements independently: a block's rejected elements start at
+// (all matches) + (its begin - matches before it). The predicate is
+// evaluated twice per element.
+template <typename T, typename UnaryPredicate>
+size_t parallel_stable_partition_copy(const T* in, size_t n, T* out, UnaryPredicate pred,
+    size_t grain = detail::partition_grain)
+{
+    block_partition blocks(n, grain);
+    if (blocks.count == 1) {
+        return stable_partition_copy(in, n, out, pred);
+    }
+
+    std::vector<size_t> first_true(blocks.count + 1);
+    parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            count += pred(in[i]) ? 1 : 0;
+        }
+        first_true[b + 1] = count;
+    });
+    for (size_t b = 0; b < blocks.count; ++b) {
+        first_true[b + 1] += first_true[b];
+    }
+    size_t total = first_true[blocks.count];
+
+    parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+        T* t = out + first_true[b];
+        T* f = out + total + (begin - first_true[b]);
+        for (size_t i = begin; i < end; ++i) {
+            if (pred(in[i])) {
+                *t++ = in[i];
+            } else {
+                *f++ = in[i];
+            }
+        }
+    });
+    return total;
+}
+
+// In place, through `scratch`, which ends up holding a copy of the result
+template <typename T, typename UnaryPredicate>
+size_t parallel_stable_partition(T* v, size_t n, UnaryPredicate pred, std::vector<T>& scratch,
+    size_t grain = detail::partition_grain)
+{
+    if (scratch.size() < n) {
+        scratch.resize(n);
+    }
+    size_t t = parallel_stable_partition_copy(v, n, scratch.data(), pred, grain);
+    parallel_for_each_block(block_partition(n, grain), [&](size_t, size_t begin, size_t end) {
+        std::copy(scratch.begin() + begin, scratch.begin() + end, v + begin);
+    });
+    return t;
+}
+
+template <typename T, typename UnaryPredicate>
+typename std::vector<T>::iterator parallel_stable_partition(std::vector<T>& v, UnaryPredicate pred)
+{
+    detail::thread_scratch<T> scratch;
+    return v.begin() + parallel_stable_partition(v.data(), v.size(), pred, scratch.get());
+}
+
+} // namespace perf
@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "partition.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+bool is_even(int x)
+{
+    return x % 2 == 0;
+}
+
+std::vector<int> std_stable_partition(std::vector<int> v)
+{
+    std::stable_partition(begin(v), end(v), is_even);
+    return v;
+}
+
+class ParallelPartition : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST(Partition, MoveMultipleElementsToBeginningOfAContainer)
+{
+    std::vector<int> numbers{ 1, 2, 3, 3, 2, 4, 2, 1, 5 };
+
+    auto middle = perf::stable_partition(numbers, [](int x) { return x == 2; });
+
+    std::vector<int> expected{ 2, 2, 2, 1, 3, 3, 4, 1, 5 };
+    ASSERT_EQ(expected, numbers);
+    ASSERT_EQ(3, middle - begin(numbers));
+}
+
+TEST(Partition, MoveMultipleElementsToEndOfAContainer)
+{
+    std::vector<int> numbers{ 1, 2, 3, 3, 2, 4, 2, 1, 5 };
+
+    perf::stable_partition(numbers, [](int x) { return x != 2; });
+
+    std::vector<int> expected{ 1, 3, 3, 4, 1, 5, 2, 2, 2 };
+    ASSERT_EQ(expected, numbers);
+}
+
+TEST(Partition, CopyMatchesStd)
+{
+    for (size_t n : { 0, 1, 2, 3, 10, 1000 }) {
+        auto v = random_ints(n);
+        std::vector<int> out(n);
+
+        size_t t = perf::stable_partition_copy(v.data(), n, out.data(), is_even);
+
+        ASSERT_EQ(std_stable_partition(v), out) << "n = " << n;
+        ASSERT_EQ(static_cast<size_t>(std::count_if(begin(v), end(v), is_even)), t);
+    }
+}
+
+TEST(Partition, InPlaceMatchesStd)
+{
+    std::vector<int> scratch;
+    for (size_t n : { 0, 1, 2, 3, 10, 1000 }) {
+        auto v = random_ints(n);
+        auto expected = std_stable_partition(v);
+
+        perf::stable_partition(v.data(), n, is_even, scratch);
+
+        ASSERT_EQ(expected, v) << "n = " << n;
+    }
+    // Sized for the biggest input, not reallocated for the smaller ones
+    ASSERT_EQ(1000u, scratch.size());
+}
+
+TEST(Partition, AllOrNoneMatch)
+{
+    std::vector<int> v{ 1, 2, 3, 4 };
+
+    ASSERT_EQ(begin(v) + 4, perf::stable_partition(v, [](int) { return true; }));
+    ASSERT_EQ(begin(v), perf::stable_partition(v, [](int) { return false; }));
+    std::vector<int> expected{ 1, 2, 3, 4 };
+    ASSERT_EQ(expected, v);
+}
+
+TEST(Partition, MovesElementsThatAreNotTriviallyCopyable)
+{
+    std::vector<std::string> words{ "apple", "kiwi", "banana", "fig", "cherry" };
+    std::vector<std::string> out(words.size());
+
+    perf::stable_partition_copy(words.data(), words.size(), out.data(),
+        [](const std::string& s) { return s.size() <= 4; });
+    perf::stable_partition(words, [](const std::string& s) { return s.size() <= 4; });
+
+    std::vector<std::string> expected{ "kiwi", "fig", "apple", "banana", "cherry" };
+    ASSERT_EQ(expected, words);
+    ASSERT_EQ(expected, out);
+}
+
+TEST(Partition, ThreadBufferKeepsNothingAfterTheCall)
+{
+    std::vector<std::string> words(100000, "a long enough word to own a heap block");
+    perf::stable_partition(words, [](const std::string& s) { return s.empty(); });
+    ASSERT_EQ(0u, perf::detail::partition_scratch<std::string>().capacity());
+
+    // A small buffer stays for the next call, without live elements
+    std::vector<std::string> few{ "b", "aa", "c" };
+    perf::stable_partition(few, [](const std::string& s) { return s.size() == 1; });
+    ASSERT_EQ((std::vector<std::string>{ "b", "c", "aa" }), few);
+    ASSERT_EQ(0u, perf::detail::partition_scratch<std::string>().size());
+
+    auto ints = random_ints(1 << 20);
+    perf::stable_partition(ints, is_even);
+    ASSERT_EQ(0u, perf::detail::partition_scratch<int>().capacity());
+}
+
+TEST_F(ParallelPartition, CopyMatchesStd)
+{
+    for (size_t n : { 0, 1, 7, 100, 10000, 100003 }) {
+        auto v = random_ints(n);
+        std::vector<int> out(n);
+
+        size_t t = perf::parallel_stable_partition_copy(v.data(), n, out.data(), is_even, 1000);
+
+        ASSERT_EQ(std_stable_partition(v), out) << "n = " << n;
+        ASSERT_EQ(static_cast<size_t>(std::count_if(begin(v), end(v), is_even)), t);
+    }
+}
+
+TEST_F(ParallelPartition, InPlaceMatchesStd)
+{
+    auto v = random_ints(1 << 20);
+    auto expected = std_stable_partition(v);
+
+    perf::parallel_stable_partition(v, is_even);
+
+    ASSERT_EQ(expected, v);
+}
+
+TEST(PartitionBenchmark, DISABLED_EvensFirst)
+{
+    auto n = bench::size(1 << 24);
+    auto input = random_ints(n);
+    std::vector<int> v(n);
+    std::vector<int> scratch(n);
+    double bytes = 2.0 * n * sizeof(int);
+
+    bench::report("std::stable_partition", bench::best_of(5, [&] {
+        v = input;
+        std::stable_partition(begin(v), end(v), is_even);
+        bench::keep(v[0]);
+    }), bytes);
+    bench::report("perf::stable_partition", bench::best_of(5, [&] {
+        v = input;
+        perf::stable_partition(v.data(), n, is_even, scratch);
+        bench::keep(v[0]);
+    }), bytes);
+    bench::report("perf::stable_partition_copy", bench::best_of(5, [&] {
+        perf::stable_partition_copy(input.data(), n, v.data(), is_even);
+        bench::keep(v[0]);
+    }), bytes);
+    bench::report("perf::parallel_stable_partition_copy", bench::best_of(5, [&] {
+        perf::parallel_stable_partition_copy(input.data(), n, v.data(), is_even);
+        bench::keep(v[0]);
+    }), bytes);
+}
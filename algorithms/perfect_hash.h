@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal perfect hashing of string keys (PTHash style).
+//
+// Keys are spread over buckets of about four by their hash. Then, biggest
+// bucket first, every bucket gets a "pilot": a number that, mixed into the
+// hash of its keys, sends each of them to a distinct free slot of a table
+// about 1% larger than the key set, so the last buckets still find free
+// slots quickly. The slots taken past the key count are then remapped to
+// the ones left free below it, which keeps the map minimal. A lookup
+// hashes the key once, reads the pilot of its bucket, probes one slot,
+// remapped for about 1% of the keys, and compares one key.
+//
+// static_map does all of this at compile time for keys known at build
+// time; perfect_hash_map does it at runtime for large key sets.
+namespace perf {
+
+namespace detail {
+
+    constexpr uint64_t fmix64(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    // FNV-1a over the bytes, then a finalizer so every bit is well mixed
+    constexpr uint64_t hash_bytes(const char* s, size_t length)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < length; ++i) {
+            h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ULL;
+        }
+        return fmix64(h);
+    }
+
+    constexpr size_t string_length(const char* s)
+    {
+        size_t n = 0;
+        while (s[n]) {
+            ++n;
+        }
+        return n;
+    }
+
+    constexpr bool equal_bytes(const char* a, size_t a_length, const char* b, size_t b_length)
+    {
+        if (a_length != b_length) {
+            return false;
+        }
+        for (size_t i = 0; i < a_length; ++i) {
+            if (a[i] != b[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr size_t bucket_count(size_t keys)
+    {
+        return keys / 4 + 1;
+    }
+
+    // Slots the pilots choose from, a load factor of about 0.99
+    constexpr size_t table_size(size_t keys)
+    {
+        return keys + keys / 100 + 1;
+    }
+
+    constexpr size_t bucket_of(uint64_t hash, size_t buckets)
+    {
+        return static_cast<size_t>((hash >> 32) % buckets);
+    }
+
+    // What is stored for a bucket is the mixed pilot, its seed
+    constexpr uint64_t seed_of(uint64_t pilot)
+    {
+        return fmix64(pilot + 1);
+    }
+
+    // Mixing again after the xor matters: otherwise two keys of a bucket
+    // whose hashes agree in the bits the modulo keeps (all low bits for a
+    // power of two table) collide for every pilot
+    constexpr size_t slot_of(uint64_t hash, uint64_t seed, size_t slots)
+    {
+        return static_cast<size_t>(fmix64(hash ^ seed) % slots);
+    }
+
+    // Where a key of the table slot goes among n: the slot itself, or the
+    // free slot it is remapped to
+    template <typename Remap>
+    constexpr size_t final_slot(size_t slot, size_t n, const Remap& remap)
+    {
+        return slot < n ? slot : remap[slot - n];
+    }
+
+    // Gives up on a bucket after this many pilots. At least 1% of the
+    // table stays free, so the last buckets need a few thousand pilots
+    // whatever the key count, and keys with equal hashes, which no pilot
+    // separates, are rejected before the search: this only bounds the
+    // search against bad luck.
+    constexpr uint64_t max_pilot = uint64_t(1) << 24;
+
+    // An array that constexpr code can write to (std::array can't in C++14)
+    template <typename T, size_t N>
+    struct cx_array {
+        constexpr T& operator[](size_t i) { return data[i]; }
+        constexpr const T& operator[](size_t i) const { return data[i]; }
+
+        T data[N ? N : 1] = {};
+    };
+
+    // Working memory of the pilot search at compile time. The runtime
+    // builder has the same members as vectors.
+    template <size_t N, size_t B>
+    struct static_search {
+        cx_array<uint64_t, N> hashes;
+        cx_array<size_t, B + 1> bucket_start;
+        cx_array<size_t, N> by_bucket;
+        cx_array<size_t, N + 1> size_start;
+        cx_array<size_t, B> order;
+        cx_array<bool, table_size(N)> taken;
+        cx_array<size_t, N> trial;
+        cx_array<uint64_t, B> seeds;
+        cx_array<size_t, table_size(N) - N> remap;
+        cx_array<size_t, N> slot;
+    };
+
+    // Fills s.seeds, s.remap and s.slot, the final slot of every key, from
+    // s.hashes. Both sorts are counting sorts, so this runs in linear time
+    // plus the pilot trials.
+    template <typename Search>
+    constexpr void find_pilots(Search& s, size_t n, size_t buckets)
+    {
+        size_t slots = table_size(n);
+        // Keys grouped by bucket
+        for (size_t i = 0; i < n; ++i) {
+            ++s.bucket_start[bucket_of(s.hashes[i], buckets) + 1];
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            s.bucket_start[b + 1] += s.bucket_start[b];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            s.by_bucket[s.bucket_start[bucket_of(s.hashes[i], buckets)]++] = i;
+        }
+        // Filling moved every start to the next bucket's start
+        for (size_t b = buckets; b > 0; --b) {
+            s.bucket_start[b] = s.bucket_start[b - 1];
+        }
+        s.bucket_start[0] = 0;
+
+        // Buckets from the biggest to the smallest
+        for (size_t b = 0; b < buckets; ++b) {
+            ++s.size_start[n - (s.bucket_start[b + 1] - s.bucket_start[b])];
+        }
+        for (size_t k = 0, sum = 0; k <= n; ++k) {
+            size_t count = s.size_start[k];
+            s.size_start[k] = sum;
+            sum += count;
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            s.order[s.size_start[n - (s.bucket_start[b + 1] - s.bucket_start[b])]++] = b;
+        }
+
+        for (size_t o = 0; o < buckets; ++o) {
+            size_t b = s.order[o];
+            size_t first = s.bucket_start[b];
+            size_t size = s.bucket_start[b + 1] - first;
+            if (size == 0) {
+                break;
+            }
+            // Keys with equal hashes, above all equal keys, would share a
+            // slot for every pilot
+            for (size_t j = 1; j < size; ++j) {
+                for (size_t k = 0; k < j; ++k) {
+                    if (s.hashes[s.by_bucket[first + j]] == s.hashes[s.by_bucket[first + k]]) {
+                        throw std::invalid_argument("perfect hash: duplicate keys or equal 64-bit hashes");
+                    }
+                }
+            }
+
+            uint64_t pilot = 0;
+            for (;; ++pilot) {
+                if (pilot == max_pilot) {
+                    throw std::invalid_argument("perfect hash: no pilot found");
+                }
+                bool fits = true;
+                for (size_t j = 0; j < size && fits; ++j) {
+                    size_t slot = slot_of(s.hashes[s.by_bucket[first + j]], seed_of(pilot), slots);
+                    fits = !s.taken[slot];
+                    for (size_t k = 0; k < j && fits; ++k) {
+                        fits = s.trial[k] != slot;
+                    }
+                    s.trial[j] = slot;
+                }
+                if (fits) {
+                    break;
+                }
+            }
+
+            s.seeds[b] = seed_of(pilot);
+            for (size_t j = 0; j < size; ++j) {
+                s.taken[s.trial[j]] = true;
+                s.slot[s.by_bucket[first + j]] = s.trial[j];
+            }
+        }
+
+        // Exactly as many slots are taken past n as are free below it
+        for (size_t p = n, free = 0; p < slots; ++p) {
+            if (s.taken[p]) {
+                while (s.taken[free]) {
+                    ++free;
+                }
+                s.remap[p - n] = free++;
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            s.slot[i] = final_slot(s.slot[i], n, s.remap);
+        }
+    }
+
+} // namespace detail
+
+template <typename Value>
+struct static_entry {
+    const char* key;
+    Value value;
+};
+
+// A constant map from string literals to Value, built by make_static_map
+template <typename Value, size_t N>
+class static_map {
+public:
+    static constexpr size_t buckets = detail::bucket_count(N);
+
+    constexpr size_t size() const { return N; }
+
+    // Value of key, nullptr if key is not in the map
+    constexpr const Value* find(const char* key, size_t length) const
+    {
+        if (N == 0) {
+            return nullptr;
+        }
+        uint64_t h = detail::hash_bytes(key, length);
+        size_t slot = detail::slot_of(h, seeds[detail::bucket_of(h, buckets)], detail::table_size(N));
+        const slot_entry& e = slots[detail::final_slot(slot, N, remap)];
+        return detail::equal_bytes(e.key, e.length, key, length) ? &e.value : nullptr;
+    }
+
+    constexpr const Value* find(const char* key) const
+    {
+        return find(key, detail::string_length(key));
+    }
+
+    const Value* find(const std::string& key) const
+    {
+        return find(key.data(), key.size());
+    }
+
+    template <typename V, size_t M>
+    friend constexpr static_map<V, M> make_static_map(const static_entry<V> (&entries)[M]);
+
+private:
+    struct slot_entry {
+        const char* key = "";
+        size_t length = 0;
+        Value value = {};
+    };
+
+    detail::cx_array<uint64_t, buckets> seeds;
+    detail::cx_array<size_t, detail::table_size(N) - N> remap;
+    detail::cx_array<slot_entry, N> slots;
+};
+
+// Builds the map at compile time when used in a constexpr context:
+//
+//     constexpr auto m = make_static_map<int>({ { "a", 1 }, { "b", 2 } });
+//
+// Duplicate keys fail to compile.
+template <typename Value, size_t N>
+constexpr static_map<Value, N> make_static_map(const static_entry<Value> (&entries)[N])
+{
+    constexpr size_t buckets = static_map<Value, N>::buckets;
+    detail::static_search<N, buckets> s;
+    for (size_t i = 0; i < N; ++i) {
+        s.hashes[i] = detail::hash_bytes(entries[i].key, detail::string_length(entries[i].key));
+    }
+    detail::find_pilots(s, N, buckets);
+
+    static_map<Value, N> m;
+    for (size_t b = 0; b < buckets; ++b) {
+        m.seeds[b] = s.seeds[b];
+    }
+    for (size_t i = 0; i < detail::table_size(N) - N; ++i) {
+        m.remap[i] = s.remap[i];
+    }
+    for (size_t i = 0; i < N; ++i) {
+        auto& e = m.slots[s.slot[i]];
+        e.key = entries[i].key;
+        e.length = detail::string_length(entries[i].key);
+        e.value = entries[i].value;
+    }
+    return m;
+}
+
+// The same structure built at runtime, e.g. from keys loaded from disk
+template <typename Value>
+class perfect_hash_map {
+public:
+    perfect_hash_map() = default;
+
+    // Throws std::invalid_argument on duplicate keys or mismatched lengths
+    perfect_hash_map(std::vector<std::string> keys, std::vector<Value> values)
+    {
+        if (keys.size() != values.size()) {
+            throw std::invalid_argument("perfect_hash_map: keys and values differ in length");
+        }
+        size_t n = keys.size();
+        size_t buckets = detail::bucket_count(n);
+
+        struct search {
+            explicit search(size_t n, size_t buckets)
+                : hashes(n)
+                , bucket_start(buckets + 1)
+                , by_bucket(n)
+                , size_start(n + 1)
+                , order(buckets)
+                , taken(detail::table_size(n))
+                , trial(n)
+                , seeds(buckets)
+                , remap(detail::table_size(n) - n)
+                , slot(n)
+            {
+            }
+            std::vector<uint64_t> hashes;
+            std::vector<size_t> bucket_start;
+            std::vector<size_t> by_bucket;
+            std::vector<size_t> size_start;
+            std::vector<size_t> order;
+            std::vector<char> taken;
+            std::vector<size_t> trial;
+            std::vector<uint64_t> seeds;
+            std::vector<size_t> remap;
+            std::vector<size_t> slot;
+        } s(n, buckets);
+
+        for (size_t i = 0; i < n; ++i) {
+            s.hashes[i] = detail::hash_bytes(keys[i].data(), keys[i].size());
+        }
+        detail::find_pilots(s, n, buckets);
+
+        seeds = std::move(s.seeds);
+        remap = std::move(s.remap);
+        keys_.resize(n);
+        values_.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            keys_[s.slot[i]] = std::move(keys[i]);
+            values_[s.slot[i]] = std::move(values[i]);
+        }
+    }
+
+    size_t size() const { return keys_.size(); }
+
+    // Value of key, nullptr if key is not in the map
+    const Value* find(const char* key, size_t length) const
+    {
+        if (keys_.empty()) {
+            return nullptr;
+        }
+        uint64_t h = detail::hash_bytes(key, length);
+        size_t n = keys_.size();
+        size_t slot = detail::final_slot(detail::slot_of(h, seeds[detail::bucket_of(h, seeds.size())], detail::table_size(n)), n, remap);
+        const std::string& k = keys_[slot];
+        return detail::equal_bytes(k.data(), k.size(), key, length) ? &values_[slot] : nullptr;
+    }
+
+    const Value* find(const std::string& key) const
+    {
+        return find(key.data(), key.size());
+    }
+
+private:
+    std::vector<uint64_t> seeds;
+    std::vector<size_t> remap;
+    std::vector<std::string> keys_;
+    std::vector<Value> values_;
+};
+
+} // namespace perf
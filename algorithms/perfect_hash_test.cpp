@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr auto population = perf::make_static_map<int>({
+    { "Helsinki", 639'222 },
+    { "Espoo", 276'087 },
+    { "Tampere", 228'942 },
+    { "Vantaa", 220'908 },
+    { "Oulu", 200'600 },
+});
+
+// Built by the compiler: looking up is a constant expression too
+static_assert(*population.find("Tampere") == 228'942, "compile-time lookup");
+static_assert(population.find("Turku") == nullptr, "compile-time miss");
+
+std::vector<std::string> random_keys(size_t n)
+{
+    std::mt19937_64 rng(9);
+    std::vector<std::string> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = "key/" + std::to_string(i) + "/" + std::to_string(rng() % 1000);
+    }
+    return keys;
+}
+
+} // namespace
+
+TEST(PerfectHash, CreateMapFromKeysAndValues)
+{
+    ASSERT_EQ(5u, population.size());
+    ASSERT_EQ(639'222, *population.find("Helsinki"));
+    ASSERT_EQ(200'600, *population.find(std::string("Oulu")));
+    ASSERT_EQ(nullptr, population.find("Hels"));
+    ASSERT_EQ(nullptr, population.find(""));
+}
+
+TEST(PerfectHash, StaticMapWithManyKeys)
+{
+    constexpr auto m = perf::make_static_map<char>({ { "a", 'a' }, { "b", 'b' }, { "c", 'c' }, { "d", 'd' },
+        { "e", 'e' }, { "f", 'f' }, { "g", 'g' }, { "h", 'h' }, { "i", 'i' }, { "j", 'j' }, { "k", 'k' },
+        { "l", 'l' }, { "m", 'm' }, { "n", 'n' }, { "o", 'o' }, { "p", 'p' }, { "q", 'q' }, { "r", 'r' },
+        { "s", 's' }, { "t", 't' }, { "u", 'u' }, { "v", 'v' }, { "w", 'w' }, { "x", 'x' }, { "y", 'y' } });
+
+    for (char c = 'a'; c <= 'y'; ++c) {
+        ASSERT_EQ(c, *m.find(std::string(1, c)));
+    }
+    ASSERT_EQ(nullptr, m.find("z"));
+}
+
+TEST(PerfectHash, RuntimeMap)
+{
+    auto keys = random_keys(100000);
+    std::vector<int> values(keys.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<int>(i);
+    }
+
+    perf::perfect_hash_map<int> m(keys, values);
+
+    ASSERT_EQ(keys.size(), m.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(values[i], *m.find(keys[i]));
+    }
+    ASSERT_EQ(nullptr, m.find("missing"));
+}
+
+TEST(PerfectHash, RuntimeMapWithMillionsOfKeys)
+{
+    // The last buckets to be placed still find free slots in the larger
+    // table, instead of needing more pilots the more keys there are
+    auto keys = random_keys(4000000);
+    std::vector<int> values(keys.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<int>(i);
+    }
+
+    perf::perfect_hash_map<int> m(keys, values);
+
+    ASSERT_EQ(keys.size(), m.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(values[i], *m.find(keys[i])) << keys[i];
+    }
+}
+
+TEST(PerfectHash, RuntimeMapEmpty)
+{
+    perf::perfect_hash_map<int> m({}, {});
+
+    ASSERT_EQ(nullptr, m.find("anything"));
+}
+
+TEST(PerfectHash, DuplicateKeysThrow)
+{
+    ASSERT_THROW(perf::perfect_hash_map<int>({ "a", "b", "a" }, { 1, 2, 3 }), std::invalid_argument);
+
+    auto keys = random_keys(10000);
+    keys.push_back(keys[1234]);
+    std::vector<int> values(keys.size());
+    ASSERT_THROW(perf::perfect_hash_map<int>(keys, values), std::invalid_argument);
+}
+
+TEST(PerfectHashBenchmark, DISABLED_Lookup)
+{
+    auto keys = random_keys(bench::size(1 << 20));
+    std::vector<int> values(keys.size(), 1);
+    auto probes = keys;
+    std::shuffle(probes.begin(), probes.end(), std::mt19937(1));
+
+    std::unordered_map<std::string, int> hashed;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        hashed[keys[i]] = values[i];
+    }
+    perf::perfect_hash_map<int> perfect;
+    auto build = bench::best_of(1, [&] { perfect = perf::perfect_hash_map<int>(keys, values); });
+
+    auto lookup_hashed = bench::best_of(3, [&] {
+        long sum = 0;
+        for (auto& k : probes) {
+            sum += hashed.find(k)->second;
+        }
+        bench::keep(sum);
+    });
+    auto lookup_perfect = bench::best_of(3, [&] {
+        long sum = 0;
+        for (auto& k : probes) {
+            sum += *perfect.find(k);
+        }
+        bench::keep(sum);
+    });
+
+    std::printf("build %zu keys: %8.1f ms\n", keys.size(), build * 1e3);
+    std::printf("lookup: std::unordered_map %6.1f ns  perfect_hash_map %6.1f ns\n",
+        lookup_hashed / probes.size() * 1e9, lookup_perfect / probes.size() * 1e9);
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Prefix sums (scans) over contiguous arrays.
+//
+// All scans accept any associative operator; it does not need to be
+// commutative, operands are always combined left to right. Input and
+// output may be the same array.
+namespace perf {
+
+namespace detail {
+
+    template <typename T, typename BinaryOp>
+    struct is_plus : std::false_type {
+    };
+    template <typename T>
+    struct is_plus<T, std::plus<T>> : std::true_type {
+    };
+    template <typename T>
+    struct is_plus<T, std::plus<>> : std::true_type {
+    };
+
+    // 32-bit integer addition gets the SIMD kernels
+    template <typename T, typename BinaryOp>
+    using simd_add = std::integral_constant<bool,
+        is_plus<T, BinaryOp>::value && std::is_integral<T>::value && sizeof(T) == 4>;
+
+    // Inclusive running sum, four lanes at a time. Two shifted adds form the
+    // prefix inside the register, then the carry of the previous register is
+    // broadcast and added. Wraps on overflow like the SIMD lanes do.
+    inline uint32_t add_scan(const uint32_t* in, size_t n, uint32_t* out, uint32_t carry, bool exclusive)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128i c = _mm_set1_epi32(static_cast<int>(carry));
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i s = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+            s = _mm_add_epi32(s, c);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), exclusive ? _mm_sub_epi32(s, x) : s);
+            c = _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        carry = static_cast<uint32_t>(_mm_cvtsi128_si32(c));
+#endif
+        for (; i < n; ++i) {
+            uint32_t x = in[i];
+            out[i] = exclusive ? carry : carry + x;
+            carry += x;
+        }
+        return carry;
+    }
+
+    inline uint32_t add_reduce(const uint32_t* in, size_t n)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += in[i];
+        }
+        return sum;
+    }
+
+    // out[i] = carry op in[0] op ... op in[i] (or up to in[i - 1] if exclusive).
+    // Returns the carry for the next block.
+    template <typename T, typename BinaryOp>
+    T scan(const T* in, size_t n, T* out, T carry, BinaryOp op, bool exclusive, std::false_type)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            T x = in[i];
+            T next = op(carry, x);
+            out[i] = exclusive ? carry : next;
+            carry = next;
+        }
+        return carry;
+    }
+
+    template <typename T, typename BinaryOp>
+    T scan(const T* in, size_t n, T* out, T carry, BinaryOp, bool exclusive, std::true_type)
+    {
+        return static_cast<T>(add_scan(reinterpret_cast<const uint32_t*>(in), n,
+            reinterpret_cast<uint32_t*>(out), static_cast<uint32_t>(carry), exclusive));
+    }
+
+    template <typename T, typename BinaryOp>
+    T scan(const T* in, size_t n, T* out, T carry, BinaryOp op, bool exclusive)
+    {
+        return scan(in, n, out, carry, op, exclusive, simd_add<T, BinaryOp>());
+    }
+
+    // Inclusive scan without a carry: the first element starts the sum
+    template <typename T, typename BinaryOp>
+    void scan_first(const T* in, size_t n, T* out, BinaryOp op)
+    {
+        if (n == 0) {
+            return;
+        }
+        T first = in[0];
+        out[0] = first;
+        scan(in + 1, n - 1, out + 1, first, op, false);
+    }
+
+    // in[0] op ... op in[n - 1], n > 0
+    template <typename T, typename BinaryOp>
+    T reduce(const T* in, size_t n, BinaryOp op, std::false_type)
+    {
+        T sum = in[0];
+        for (size_t i = 1; i < n; ++i) {
+            sum = op(sum, in[i]);
+        }
+        return sum;
+    }
+
+    template <typename T, typename BinaryOp>
+    T reduce(const T* in, size_t n, BinaryOp, std::true_type)
+    {
+        return static_cast<T>(add_reduce(reinterpret_cast<const uint32_t*>(in), n));
+    }
+
+    // Two-pass scan: every block reduces its input, the block totals are
+    // scanned serially, then every block scans again starting from its
+    // offset. Input is read twice and output written once, so the scan runs
+    // at memory bandwidth once there are enough cores.
+    template <typename T, typename BinaryOp>
+    void parallel_scan(const T* in, size_t n, T* out, const T* init, BinaryOp op, size_t grain)
+    {
+        block_partition blocks(n, grain);
+        if (blocks.count == 1) {
+            if (init) {
+                scan(in, n, out, *init, op, true);
+            } else {
+                scan_first(in, n, out, op);
+            }
+            return;
+        }
+
+        std::vector<T> totals(blocks.count);
+        parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+            totals[b] = reduce(in + begin, end - begin, op, simd_add<T, BinaryOp>());
+        });
+
+        // offsets[b] combines everything left of block b
+        std::vector<T> offsets;
+        offsets.reserve(blocks.count);
+        offsets.push_back(init ? *init : totals[0]);
+        for (size_t b = init ? 1 : 2; b < blocks.count; ++b) {
+            offsets.push_back(op(offsets.back(), totals[b - 1]));
+        }
+
+        parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+            if (init) {
+                scan(in + begin, end - begin, out + begin, offsets[b], op, true);
+            } else if (b == 0) {
+                scan_first(in + begin, end - begin, out + begin, op);
+            } else {
+                scan(in + begin, end - begin, out + begin, offsets[b - 1], op, false);
+            }
+        });
+    }
+
+} // namespace detail
+
+// Blocks smaller than this are not worth a thread
+constexpr size_t scan_grain = 1 << 16;
+
+// out[i] = in[0] op in[1] op ... op in[i]
+template <typename T, typename BinaryOp = std::plus<>>
+void inclusive_scan(const T* in, size_t n, T* out, BinaryOp op = BinaryOp())
+{
+    detail::scan_first(in, n, out, op);
+}
+
+// out[0] = init, out[i] = init op in[0] op ... op in[i - 1]
+template <typename T, typename BinaryOp = std::plus<>>
+void exclusive_scan(const T* in, size_t n, T* out, T init, BinaryOp op = BinaryOp())
+{
+    detail::scan(in, n, out, init, op, true);
+}
+
+// Same results as inclusive_scan, computed by all threads
+template <typename T, typename BinaryOp = std::plus<>>
+void parallel_inclusive_scan(const T* in, size_t n, T* out, BinaryOp op = BinaryOp(), size_t grain = scan_grain)
+{
+    detail::parallel_scan(in, n, out, static_cast<const T*>(nullptr), op, grain);
+}
+
+// Same results as exclusive_scan, computed by all threads
+template <typename T, typename BinaryOp = std::plus<>>
+void parallel_exclusive_scan(const T* in, size_t n, T* out, T init, BinaryOp op = BinaryOp(), size_t grain = scan_grain)
+{
+    detail::parallel_scan(in, n, out, &init, op, grain);
+}
+
+template <typename T, typename BinaryOp = std::plus<>>
+std::vector<T> inclusive_scan(const std::vector<T>& v, BinaryOp op = BinaryOp())
+{
+    std::vector<T> result(v.size());
+    inclusive_scan(v.data(), v.size(), result.data(), op);
+    return result;
+}
+
+template <typename T, typename BinaryOp = std::plus<>>
+std::vector<T> exclusive_scan(const std::vector<T>& v, T init, BinaryOp op = BinaryOp())
+{
+    std::vector<T> result(v.size());
+    exclusive_scan(v.data(), v.size(), result.data(), init, op);
+    return result;
+}
+
+} // namespace perf
@@ -0,0 +1,152 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "scan.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+class ParallelScan : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST(Scan, CalculatesHeightsFromDifferences)
+{
+    std::vector<int> diff{ 0, 1, 5, -2, 10, -12 };
+
+    auto heights = perf::inclusive_scan(diff);
+
+    std::vector<int> expected{ 0, 1, 6, 4, 14, 2 };
+    ASSERT_EQ(expected, heights);
+}
+
+TEST(Scan, InclusiveMatchesPartialSumForAllTailLengths)
+{
+    for (size_t n = 0; n < 40; ++n) {
+        auto v = random_ints(n);
+        std::vector<int> expected;
+        std::partial_sum(begin(v), end(v), std::back_inserter(expected));
+
+        ASSERT_EQ(expected, perf::inclusive_scan(v)) << "n = " << n;
+    }
+}
+
+TEST(Scan, ExclusiveStartsFromInit)
+{
+    std::vector<int> v{ 1, 2, 3, 4, 5, 6 };
+
+    std::vector<int> expected{ 10, 11, 13, 16, 20, 25 };
+    ASSERT_EQ(expected, perf::exclusive_scan(v, 10));
+}
+
+TEST(Scan, InPlace)
+{
+    auto v = random_ints(1001);
+    std::vector<int> expected;
+    std::partial_sum(begin(v), end(v), std::back_inserter(expected));
+
+    perf::inclusive_scan(v.data(), v.size(), v.data());
+
+    ASSERT_EQ(expected, v);
+}
+
+TEST(Scan, UserSuppliedOperator)
+{
+    std::vector<int> v{ 3, 1, 4, 1, 5, 9, 2, 6 };
+
+    auto running_max = perf::inclusive_scan(v, [](int a, int b) { return std::max(a, b); });
+
+    std::vector<int> expected{ 3, 3, 4, 4, 5, 9, 9, 9 };
+    ASSERT_EQ(expected, running_max);
+}
+
+TEST(Scan, OtherElementTypes)
+{
+    std::vector<double> d{ 0.5, 0.25, 0.125 };
+    std::vector<long long> l{ 1LL << 40, 1LL << 40 };
+
+    ASSERT_EQ((std::vector<double>{ 0.5, 0.75, 0.875 }), perf::inclusive_scan(d));
+    ASSERT_EQ((std::vector<long long>{ 1LL << 40, 1LL << 41 }), perf::inclusive_scan(l));
+}
+
+TEST_F(ParallelScan, InclusiveMatchesSequential)
+{
+    auto v = random_ints(100003);
+    std::vector<int> expected;
+    std::partial_sum(begin(v), end(v), std::back_inserter(expected));
+
+    std::vector<int> result(v.size());
+    perf::parallel_inclusive_scan(v.data(), v.size(), result.data(), std::plus<>(), 1000);
+
+    ASSERT_EQ(expected, result);
+}
+
+TEST_F(ParallelScan, ExclusiveMatchesSequential)
+{
+    auto v = random_ints(100003);
+    auto expected = perf::exclusive_scan(v, 7);
+
+    perf::parallel_exclusive_scan(v.data(), v.size(), v.data(), 7, std::plus<>(), 1000);
+
+    ASSERT_EQ(expected, v);
+}
+
+TEST_F(ParallelScan, KeepsOrderOfNonCommutativeOperator)
+{
+    std::vector<std::string> words(1000);
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i] = std::string(1, static_cast<char>('a' + i % 26));
+    }
+    auto expected = perf::inclusive_scan(words);
+
+    std::vector<std::string> result(words.size());
+    perf::parallel_inclusive_scan(words.data(), words.size(), result.data(), std::plus<>(), 10);
+
+    ASSERT_EQ(expected, result);
+}
+
+TEST_F(ParallelScan, SmallInputs)
+{
+    for (size_t n = 0; n < 10; ++n) {
+        auto v = random_ints(n);
+        std::vector<int> result(n);
+        perf::parallel_inclusive_scan(v.data(), n, result.data(), std::plus<>(), 1);
+
+        ASSERT_EQ(perf::inclusive_scan(v), result) << "n = " << n;
+    }
+}
+
+TEST(ScanBenchmark, DISABLED_InclusiveScan)
+{
+    auto n = bench::size(1 << 26);
+    auto in = random_ints(n);
+    std::vector<int> out(n);
+    double bytes = 2.0 * n * sizeof(int);
+
+    bench::report("memcpy", bench::best_of(5, [&] {
+        std::memcpy(out.data(), in.data(), n * sizeof(int));
+        bench::keep(out);
+    }), bytes);
+    bench::report("std::partial_sum", bench::best_of(5, [&] {
+        std::partial_sum(begin(in), end(in), begin(out));
+        bench::keep(out);
+    }), bytes);
+    bench::report("perf::inclusive_scan", bench::best_of(5, [&] {
+        perf::inclusive_scan(in.data(), n, out.data());
+        bench::keep(out);
+    }), bytes);
+    bench::report("perf::parallel_inclusive_scan", bench::best_of(5, [&] {
+        perf::parallel_inclusive_scan(in.data(), n, out.data());
+        bench::keep(out);
+    }), 3.0 * n * sizeof(int));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+
+// Instruction set selection for the SIMD kernels.
+//
+// The project is built without -m flags, so SSE2 is the only extension the
+// compiler may use freely on x86-64. AVX2 kernels are compiled per function
+// with PERF_AVX2 and only called when the CPU reports support at runtime.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+#define PERF_X86 1
+#include <immintrin.h>
+#define PERF_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define PERF_X86 0
+#endif
+
+namespace perf {
+
+enum class isa {
+    scalar,
+    sse2,
+    avx2,
+};
+
+inline isa detected_isa()
+{
+#if PERF_X86
+    static const isa best = __builtin_cpu_supports("avx2") ? isa::avx2 : isa::sse2;
+    return best;
+#else
+    return isa::scalar;
+#endif
+}
+
+inline isa& isa_limit()
+{
+    static isa limit = isa::avx2;
+    return limit;
+}
+
+// The instruction set the kernels dispatch to
+inline isa active_isa()
+{
+    return std::min(detected_isa(), isa_limit());
+}
+
+// Keeps the kernels from using anything newer than `level`, for testing
+// the fallbacks and for reproducible benchmarks
+inline void limit_isa(isa level)
+{
+    isa_limit() = level;
+}
+
+} // namespace perf
@@ -0,0 +1,609 @@
+#include "sketch.h"
+
+#include "perfect_hash.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace perf {
+
+namespace {
+
+    uint64_t hash_key(uint64_t key)
+    {
+        // fmix64 maps 0 to 0, which would be the longest possible run
+        return detail::fmix64(key + 0x9e3779b97f4a7c15ull);
+    }
+
+    // Sparse pairs are taken at this precision
+    constexpr unsigned sparse_precision = 25;
+
+    uint32_t sparse_entry(uint64_t hash)
+    {
+        uint64_t rest = hash << sparse_precision;
+        uint32_t run = rest ? __builtin_clzll(rest) + 1 : 64 - sparse_precision + 1;
+        return static_cast<uint32_t>(hash >> (64 - sparse_precision)) << 6 | run;
+    }
+
+    uint32_t entry_register(uint32_t entry)
+    {
+        return entry >> 6;
+    }
+
+    // The register and run of a sparse pair at precision p: the register
+    // bits past p count as leading bits of the run
+    void dense_of(uint32_t entry, unsigned p, uint32_t& index, uint8_t& run)
+    {
+        unsigned extra = sparse_precision - p;
+        uint32_t wide = entry_register(entry);
+        uint32_t low = wide & ((1u << extra) - 1);
+        index = wide >> extra;
+        run = static_cast<uint8_t>(low ? __builtin_clz(low) - (32 - extra) + 1 : extra + (entry & 63));
+    }
+
+    // Sorts v and keeps the largest run of every register, merging in the
+    // sorted, deduplicated list
+    std::vector<uint32_t> merge_entries(const std::vector<uint32_t>& list, std::vector<uint32_t> v)
+    {
+        std::sort(v.begin(), v.end());
+        std::vector<uint32_t> all(list.size() + v.size());
+        std::merge(list.begin(), list.end(), v.begin(), v.end(), all.begin());
+        // Pairs of a register are in order of their runs, keep the last
+        size_t kept = 0;
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (i + 1 < all.size() && entry_register(all[i + 1]) == entry_register(all[i])) {
+                continue;
+            }
+            all[kept++] = all[i];
+        }
+        all.resize(kept);
+        return all;
+    }
+
+    // Ertl's estimator from the histogram of register values
+    double sigma(double x)
+    {
+        if (x == 1) {
+            return std::numeric_limits<double>::infinity();
+        }
+        double y = 1;
+        double z = x;
+        double previous;
+        do {
+            x *= x;
+            previous = z;
+            z += x * y;
+            y += y;
+        } while (z != previous);
+        return z;
+    }
+
+    double tau(double x)
+    {
+        if (x == 0 || x == 1) {
+            return 0;
+        }
+        double y = 1;
+        double z = 1 - x;
+        double previous;
+        do {
+            x = std::sqrt(x);
+            previous = z;
+            y *= 0.5;
+            z -= (1 - x) * (1 - x) * y;
+        } while (z != previous);
+        return z / 3;
+    }
+
+    // a[i] = max(a[i], b[i])
+    void max_bytes_scalar(uint8_t* a, const uint8_t* b, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = std::max(a[i], b[i]);
+        }
+    }
+
+    // a[i] += b[i]
+    void add_words_scalar(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            a[i] += b[i];
+        }
+    }
+
+#if PERF_X86
+    void max_bytes_sse2(uint8_t* a, const uint8_t* b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), _mm_max_epu8(x, y));
+        }
+        max_bytes_scalar(a + i, b + i, n - i);
+    }
+
+    PERF_AVX2 void max_bytes_avx2(uint8_t* a, const uint8_t* b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), _mm256_max_epu8(x, y));
+        }
+        max_bytes_scalar(a + i, b + i, n - i);
+    }
+
+    void add_words_sse2(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), _mm_add_epi64(x, y));
+        }
+        add_words_scalar(a + i, b + i, n - i);
+    }
+
+    PERF_AVX2 void add_words_avx2(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), _mm256_add_epi64(x, y));
+        }
+        add_words_scalar(a + i, b + i, n - i);
+    }
+#endif
+
+    void max_bytes(uint8_t* a, const uint8_t* b, size_t n)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return max_bytes_avx2(a, b, n);
+        case isa::sse2:
+            return max_bytes_sse2(a, b, n);
+        case isa::scalar:
+            break;
+        }
+#endif
+        max_bytes_scalar(a, b, n);
+    }
+
+    void add_words(uint64_t* a, const uint64_t* b, size_t n)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return add_words_avx2(a, b, n);
+        case isa::sse2:
+            return add_words_sse2(a, b, n);
+        case isa::scalar:
+            break;
+        }
+#endif
+        add_words_scalar(a, b, n);
+    }
+
+    // Serialized sketches start with a tag of two characters and a version
+    // byte. Numbers are little endian or LEB128 varints.
+    constexpr uint8_t format_version = 1;
+
+    void put_varint(std::string& out, uint64_t x)
+    {
+        while (x >= 0x80) {
+            out.push_back(static_cast<char>(x | 0x80));
+            x >>= 7;
+        }
+        out.push_back(static_cast<char>(x));
+    }
+
+    void put_u64(std::string& out, uint64_t x)
+    {
+        for (int i = 0; i < 8; ++i) {
+            out.push_back(static_cast<char>(x >> (8 * i)));
+        }
+    }
+
+    class reader {
+    public:
+        reader(const std::string& bytes, const char* tag)
+            : bytes(bytes)
+        {
+            if (bytes.size() < 3 || bytes[0] != tag[0] || bytes[1] != tag[1]) {
+                fail("not a serialized sketch");
+            }
+            if (static_cast<uint8_t>(bytes[2]) != format_version) {
+                fail("unknown sketch format version");
+            }
+            at = 3;
+        }
+
+        uint8_t byte()
+        {
+            if (at >= bytes.size()) {
+                fail("truncated sketch");
+            }
+            return static_cast<uint8_t>(bytes[at++]);
+        }
+
+        uint64_t varint()
+        {
+            uint64_t x = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                uint8_t b = byte();
+                x |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (!(b & 0x80)) {
+                    return x;
+                }
+            }
+            fail("bad varint in sketch");
+        }
+
+        uint64_t u64()
+        {
+            uint64_t x = 0;
+            for (int i = 0; i < 8; ++i) {
+                x |= static_cast<uint64_t>(byte()) << (8 * i);
+            }
+            return x;
+        }
+
+        size_t left() const { return bytes.size() - at; }
+
+        void finish() const
+        {
+            if (at != bytes.size()) {
+                fail("trailing bytes after sketch");
+            }
+        }
+
+        [[noreturn]] static void fail(const char* what)
+        {
+            throw std::invalid_argument(what);
+        }
+
+    private:
+        const std::string& bytes;
+        size_t at = 0;
+    };
+
+} // namespace
+
+hyperloglog::hyperloglog(unsigned precision)
+    : p(precision)
+{
+    if (precision < 4 || precision > 18) {
+        throw std::invalid_argument("hyperloglog precision must be from 4 to 18");
+    }
+}
+
+void hyperloglog::add(uint64_t key)
+{
+    add_hash(hash_key(key));
+}
+
+void hyperloglog::add(const uint64_t* keys, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        add_hash(hash_key(keys[i]));
+    }
+}
+
+void hyperloglog::add(const char* key, size_t length)
+{
+    add_hash(detail::hash_bytes(key, length));
+}
+
+void hyperloglog::add(const std::string& key)
+{
+    add(key.data(), key.size());
+}
+
+void hyperloglog::add_hash(uint64_t hash)
+{
+    if (sparse) {
+        add_entry(sparse_entry(hash));
+        return;
+    }
+    uint64_t rest = hash << p;
+    uint8_t run = static_cast<uint8_t>(rest ? __builtin_clzll(rest) + 1 : 64 - p + 1);
+    uint8_t& r = registers[hash >> (64 - p)];
+    r = std::max(r, run);
+}
+
+void hyperloglog::add_entry(uint32_t entry)
+{
+    buffer.push_back(entry);
+    // Sorting in batches keeps adding linear
+    if (buffer.size() >= std::max<size_t>(64, (size_t(1) << p) / 16)) {
+        flush();
+    }
+}
+
+void hyperloglog::flush()
+{
+    list = merge_entries(list, std::move(buffer));
+    buffer.clear();
+    // A pair takes four bytes, a register one
+    if (list.size() * sizeof(uint32_t) > (size_t(1) << p)) {
+        make_dense();
+    }
+}
+
+std::vector<uint32_t> hyperloglog::sparse_entries() const
+{
+    return merge_entries(list, buffer);
+}
+
+void hyperloglog::make_dense()
+{
+    registers.assign(size_t(1) << p, 0);
+    for (uint32_t entry : sparse_entries()) {
+        uint32_t index;
+        uint8_t run;
+        dense_of(entry, p, index, run);
+        registers[index] = std::max(registers[index], run);
+    }
+    sparse = false;
+    std::vector<uint32_t>().swap(list);
+    std::vector<uint32_t>().swap(buffer);
+}
+
+double hyperloglog::estimate() const
+{
+    if (sparse) {
+        // Linear counting: the expected number of empty registers is
+        // m (1 - 1/m)^n
+        double m = static_cast<double>(uint64_t(1) << sparse_precision);
+        double used = static_cast<double>(sparse_entries().size());
+        return -m * std::log1p(-used / m);
+    }
+
+    unsigned q = 64 - p;
+    std::vector<uint32_t> histogram(q + 2, 0);
+    for (uint8_t r : registers) {
+        ++histogram[r];
+    }
+    double m = static_cast<double>(registers.size());
+    double z = m * tau(1 - histogram[q + 1] / m);
+    for (unsigned k = q; k >= 1; --k) {
+        z = 0.5 * (z + histogram[k]);
+    }
+    z += m * sigma(histogram[0] / m);
+    return m * m / (2 * std::log(2.0)) / z;
+}
+
+void hyperloglog::merge(const hyperloglog& other)
+{
+    if (other.p != p) {
+        throw std::invalid_argument("hyperloglog: merging sketches of different precision");
+    }
+    if (other.sparse) {
+        for (uint32_t entry : other.sparse_entries()) {
+            if (sparse) {
+                add_entry(entry);
+            } else {
+                uint32_t index;
+                uint8_t run;
+                dense_of(entry, p, index, run);
+                registers[index] = std::max(registers[index], run);
+            }
+        }
+        return;
+    }
+    if (sparse) {
+        make_dense();
+    }
+    max_bytes(registers.data(), other.registers.data(), registers.size());
+}
+
+size_t hyperloglog::memory_bytes() const
+{
+    return (list.capacity() + buffer.capacity()) * sizeof(uint32_t) + registers.capacity();
+}
+
+void hyperloglog::clear()
+{
+    sparse = true;
+    list.clear();
+    buffer.clear();
+    std::vector<uint8_t>().swap(registers);
+}
+
+// Tag "HL", version, precision, 0 and the sparse pairs as varint gaps, or
+// 1 and the registers
+std::string hyperloglog::serialize() const
+{
+    std::string out{ 'H', 'L', static_cast<char>(format_version), static_cast<char>(p) };
+    if (sparse) {
+        auto entries = sparse_entries();
+        out.push_back(0);
+        put_varint(out, entries.size());
+        uint32_t previous = 0;
+        for (uint32_t entry : entries) {
+            put_varint(out, entry - previous);
+            previous = entry;
+        }
+    } else {
+        out.push_back(1);
+        out.append(registers.begin(), registers.end());
+    }
+    return out;
+}
+
+hyperloglog hyperloglog::deserialize(const std::string& bytes)
+{
+    reader in(bytes, "HL");
+    unsigned precision = in.byte();
+    if (precision < 4 || precision > 18) {
+        reader::fail("hyperloglog precision must be from 4 to 18");
+    }
+    hyperloglog sketch(precision);
+    uint8_t mode = in.byte();
+    if (mode == 0) {
+        uint64_t count = in.varint();
+        // Every pair takes at least one byte
+        if (count > in.left()) {
+            reader::fail("truncated sketch");
+        }
+        uint64_t entry = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t gap = in.varint();
+            if ((i > 0 && gap == 0) || entry + gap > std::numeric_limits<uint32_t>::max() >> 1) {
+                reader::fail("bad hyperloglog pair");
+            }
+            entry += gap;
+            uint32_t run = entry & 63;
+            if (run == 0 || run > 64 - sparse_precision + 1) {
+                reader::fail("bad hyperloglog pair");
+            }
+            sketch.list.push_back(static_cast<uint32_t>(entry));
+        }
+        sketch.list = merge_entries(sketch.list, {});
+        if (sketch.list.size() * sizeof(uint32_t) > (size_t(1) << precision)) {
+            sketch.make_dense();
+        }
+    } else if (mode == 1) {
+        if (in.left() != (size_t(1) << precision)) {
+            reader::fail("truncated sketch");
+        }
+        sketch.sparse = false;
+        sketch.registers.resize(size_t(1) << precision);
+        for (auto& r : sketch.registers) {
+            r = in.byte();
+            if (r > 64 - precision + 1) {
+                reader::fail("bad hyperloglog register");
+            }
+        }
+    } else {
+        reader::fail("bad hyperloglog mode");
+    }
+    in.finish();
+    return sketch;
+}
+
+count_min_sketch::count_min_sketch(size_t width, size_t depth, uint64_t seed)
+    : columns(width)
+    , rows(depth)
+    , salt(seed)
+{
+    if (width == 0 || depth == 0 || width > std::numeric_limits<uint32_t>::max() || depth > 64) {
+        throw std::invalid_argument("count_min_sketch: width must be from 1 to 2^32 - 1, depth from 1 to 64");
+    }
+    counters.assign(width * depth, 0);
+}
+
+count_min_sketch count_min_sketch::with_error(double epsilon, double delta, uint64_t seed)
+{
+    if (!(epsilon > 0 && epsilon < 1) || !(delta > 0 && delta < 1)) {
+        throw std::invalid_argument("count_min_sketch: epsilon and delta must be between 0 and 1");
+    }
+    auto width = static_cast<size_t>(std::ceil(std::exp(1.0) / epsilon));
+    auto depth = static_cast<size_t>(std::ceil(std::log(1 / delta)));
+    return count_min_sketch(width, std::max<size_t>(1, depth), seed);
+}
+
+// Row i uses the column h1 + i h2 of the two halves of one hash
+// (Kirsch and Mitzenmacher), mapped to [0, width) by a multiplication
+void count_min_sketch::add_hash(uint64_t hash, uint64_t count)
+{
+    hash = detail::fmix64(hash ^ salt);
+    auto h1 = static_cast<uint32_t>(hash);
+    auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+    for (size_t i = 0; i < rows; ++i) {
+        uint32_t h = h1 + static_cast<uint32_t>(i) * h2;
+        counters[i * columns + (static_cast<uint64_t>(h) * columns >> 32)] += count;
+    }
+    sum += count;
+}
+
+uint64_t count_min_sketch::estimate_hash(uint64_t hash) const
+{
+    hash = detail::fmix64(hash ^ salt);
+    auto h1 = static_cast<uint32_t>(hash);
+    auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+    uint64_t least = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < rows; ++i) {
+        uint32_t h = h1 + static_cast<uint32_t>(i) * h2;
+        least = std::min(least, counters[i * columns + (static_cast<uint64_t>(h) * columns >> 32)]);
+    }
+    return least;
+}
+
+void count_min_sketch::add(uint64_t key, uint64_t count)
+{
+    add_hash(hash_key(key), count);
+}
+
+void count_min_sketch::add(const std::string& key, uint64_t count)
+{
+    add_hash(detail::hash_bytes(key.data(), key.size()), count);
+}
+
+uint64_t count_min_sketch::estimate(uint64_t key) const
+{
+    return estimate_hash(hash_key(key));
+}
+
+uint64_t count_min_sketch::estimate(const std::string& key) const
+{
+    return estimate_hash(detail::hash_bytes(key.data(), key.size()));
+}
+
+void count_min_sketch::merge(const count_min_sketch& other)
+{
+    if (other.columns != columns || other.rows != rows || other.salt != salt) {
+        throw std::invalid_argument("count_min_sketch: merging sketches of different shape or seed");
+    }
+    add_words(counters.data(), other.counters.data(), counters.size());
+    sum += other.sum;
+}
+
+void count_min_sketch::clear()
+{
+    std::fill(counters.begin(), counters.end(), 0);
+    sum = 0;
+}
+
+// Tag "CM", version, width, depth, seed, total and the counters, the
+// counters as varints since most of them are small
+std::string count_min_sketch::serialize() const
+{
+    std::string out{ 'C', 'M', static_cast<char>(format_version) };
+    put_varint(out, columns);
+    put_varint(out, rows);
+    put_u64(out, salt);
+    put_varint(out, sum);
+    for (uint64_t c : counters) {
+        put_varint(out, c);
+    }
+    return out;
+}
+
+count_min_sketch count_min_sketch::deserialize(const std::string& bytes)
+{
+    reader in(bytes, "CM");
+    uint64_t width = in.varint();
+    uint64_t depth = in.varint();
+    uint64_t seed = in.u64();
+    uint64_t total = in.varint();
+    // Every counter takes at least one byte
+    if (width == 0 || depth == 0 || depth > 64 || width > in.left() / depth) {
+        reader::fail("bad count_min_sketch shape");
+    }
+    count_min_sketch sketch(width, depth, seed);
+    sketch.sum = total;
+    for (auto& c : sketch.counters) {
+        c = in.varint();
+    }
+    in.finish();
+    return sketch;
+}
+
+} // namespace perf
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Approximate counting over streams in fixed memory.
+//
+// hyperloglog estimates the number of distinct keys. Every key is hashed
+// to 64 bits; the first `precision` bits pick one of m = 2^precision
+// registers, which keeps the longest run of leading zeros seen in the
+// rest. The estimate is the one of Ertl ("New cardinality estimation
+// algorithms for HyperLogLog sketches", 2017), which needs no bias
+// correction tables and has a relative standard error of about
+// 1.04 / sqrt(m) over the whole range: 0.8% with the default 16384
+// registers.
+//
+// A new sketch is sparse, as in HyperLogLog++: it keeps a sorted list of
+// (register, run) pairs at precision 25 and estimates small counts by
+// linear counting on those 2^25 registers, which is nearly exact. Once
+// the list would take more memory than the registers, it turns dense.
+//
+// count_min_sketch estimates how often every key occurred. It is `depth`
+// rows of `width` counters; a key adds to one counter per row and its
+// estimate is the smallest of those. Estimates are never too low, and
+// with with_error(epsilon, delta) they are too high by more than epsilon
+// times the total count with probability at most delta.
+//
+// Both merge with sketches of the same shape, so threads or machines can
+// count parts of a stream on their own and combine the results: merging
+// dense registers is a byte-wise max, merging counters an addition, both
+// with SSE2/AVX2. serialize writes a sketch to a portable byte string
+// that deserialize reads back, throwing std::invalid_argument if it is
+// not one.
+namespace perf {
+
+class hyperloglog {
+public:
+    // 2^precision registers, precision from 4 to 18
+    explicit hyperloglog(unsigned precision = 14);
+
+    void add(uint64_t key);
+    void add(const uint64_t* keys, size_t n);
+    void add(const char* key, size_t length);
+    void add(const std::string& key);
+
+    // Adds a key by its well mixed 64-bit hash
+    void add_hash(uint64_t hash);
+
+    // Estimated number of distinct keys added
+    double estimate() const;
+
+    // Adds every key added to other, which must have the same precision
+    void merge(const hyperloglog& other);
+
+    unsigned precision() const { return p; }
+    bool is_sparse() const { return sparse; }
+    size_t memory_bytes() const;
+    void clear();
+
+    std::string serialize() const;
+    static hyperloglog deserialize(const std::string& bytes);
+
+private:
+    void flush();
+    void make_dense();
+    std::vector<uint32_t> sparse_entries() const;
+    void add_entry(uint32_t entry);
+
+    unsigned p;
+    bool sparse = true;
+    // Sorted (register << 6 | run) pairs at precision 25, one per register
+    std::vector<uint32_t> list;
+    // Pairs not merged into list yet
+    std::vector<uint32_t> buffer;
+    std::vector<uint8_t> registers;
+};
+
+class count_min_sketch {
+public:
+    count_min_sketch(size_t width, size_t depth, uint64_t seed = 0);
+
+    // A sketch whose estimates exceed the true counts by at most
+    // epsilon * total() with probability 1 - delta
+    static count_min_sketch with_error(double epsilon, double delta, uint64_t seed = 0);
+
+    // No overload for a pointer and a length: add("key", 5) would take 5
+    // as the length
+    void add(uint64_t key, uint64_t count = 1);
+    void add(const std::string& key, uint64_t count = 1);
+
+    uint64_t estimate(uint64_t key) const;
+    uint64_t estimate(const std::string& key) const;
+
+    // Adds the counts of other, which must have the same width, depth
+    // and seed
+    void merge(const count_min_sketch& other);
+
+    size_t width() const { return columns; }
+    size_t depth() const { return rows; }
+    uint64_t seed() const { return salt; }
+    // Sum of all counts added
+    uint64_t total() const { return sum; }
+    size_t memory_bytes() const { return counters.size() * sizeof(uint64_t); }
+    void clear();
+
+    std::string serialize() const;
+    static count_min_sketch deserialize(const std::string& bytes);
+
+private:
+    void add_hash(uint64_t hash, uint64_t count);
+    uint64_t estimate_hash(uint64_t hash) const;
+
+    size_t columns;
+    size_t rows;
+    uint64_t salt;
+    uint64_t sum = 0;
+    // Row after row
+    std::vector<uint64_t> counters;
+};
+
+} // namespace perf
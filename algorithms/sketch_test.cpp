@@ -0,0 +1,323 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "parallel.h"
+#include "simd.h"
+#include "sketch.h"
+#include "test_support.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::vector<uint64_t> distinct_keys(size_t n, unsigned seed = 11)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> keys(n);
+    // Consecutive keys from a random start are distinct
+    uint64_t start = rng();
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = start + i;
+    }
+    return keys;
+}
+
+// Keys with a skewed, Zipf-like distribution over [0, range)
+std::vector<uint64_t> skewed_keys(size_t n, uint64_t range, unsigned seed = 13)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(0, std::log(static_cast<double>(range)));
+    std::vector<uint64_t> keys(n);
+    for (auto& k : keys) {
+        k = static_cast<uint64_t>(std::exp(dist(rng))) - 1;
+    }
+    return keys;
+}
+
+double relative_error(double estimate, double exact)
+{
+    return std::abs(estimate - exact) / exact;
+}
+
+class ParallelSketch : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST(HyperLogLog, EmptySketchCountsZero)
+{
+    perf::hyperloglog hll;
+
+    ASSERT_EQ(0.0, hll.estimate());
+    ASSERT_TRUE(hll.is_sparse());
+}
+
+TEST(HyperLogLog, SmallCountsAreNearlyExact)
+{
+    perf::hyperloglog hll;
+    auto keys = distinct_keys(2000);
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        hll.add(keys.data(), keys.size());
+    }
+
+    ASSERT_TRUE(hll.is_sparse());
+    ASSERT_LT(relative_error(hll.estimate(), 2000), 0.002);
+    ASSERT_LT(hll.memory_bytes(), 16384u);
+}
+
+TEST(HyperLogLog, LargeCountsWithinFourStandardErrors)
+{
+    for (unsigned precision : { 8u, 12u, 14u, 16u }) {
+        perf::hyperloglog hll(precision);
+        double bound = 4 * 1.04 / std::sqrt(double(1 << precision));
+        auto keys = distinct_keys(1000000, precision);
+
+        size_t added = 0;
+        for (size_t n : { 100, 1000, 10000, 100000, 1000000 }) {
+            hll.add(keys.data() + added, n - added);
+            added = n;
+            ASSERT_LT(relative_error(hll.estimate(), n), bound) << precision << " " << n;
+        }
+        ASSERT_FALSE(hll.is_sparse());
+    }
+}
+
+TEST(HyperLogLog, StringKeys)
+{
+    perf::hyperloglog hll(12);
+    for (int i = 0; i < 50000; ++i) {
+        hll.add("user-" + std::to_string(i % 20000));
+    }
+
+    ASSERT_LT(relative_error(hll.estimate(), 20000), 4 * 1.04 / 64);
+}
+
+TEST(HyperLogLog, InvalidPrecisionThrows)
+{
+    ASSERT_THROW(perf::hyperloglog(3), std::invalid_argument);
+    ASSERT_THROW(perf::hyperloglog(19), std::invalid_argument);
+}
+
+TEST(HyperLogLog, MergeIsLikeAddingEverything)
+{
+    for (size_t n : { 500, 3000, 200000 }) {
+        auto keys = distinct_keys(n);
+        perf::hyperloglog all(12);
+        perf::hyperloglog even(12);
+        perf::hyperloglog odd(12);
+        for (size_t i = 0; i < n; ++i) {
+            all.add(keys[i]);
+            (i % 2 ? odd : even).add(keys[i]);
+        }
+        // One of them sparse, the other dense
+        perf::hyperloglog small(12);
+        small.add(keys.data(), 10);
+
+        for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+            perf::limit_isa(level);
+            perf::hyperloglog merged = even;
+            merged.merge(odd);
+            merged.merge(small);
+            ASSERT_EQ(all.estimate(), merged.estimate()) << n;
+
+            perf::hyperloglog reverse = small;
+            reverse.merge(odd);
+            reverse.merge(even);
+            ASSERT_EQ(all.estimate(), reverse.estimate()) << n;
+        }
+        perf::limit_isa(perf::isa::avx2);
+    }
+
+    perf::hyperloglog a(12);
+    perf::hyperloglog b(13);
+    ASSERT_THROW(a.merge(b), std::invalid_argument);
+}
+
+TEST_F(ParallelSketch, ThreadsCountPartsAndMerge)
+{
+    auto keys = skewed_keys(2000000, 1000000);
+    perf::hyperloglog serial;
+    serial.add(keys.data(), keys.size());
+
+    perf::block_partition blocks(keys.size(), 1 << 16);
+    std::vector<perf::hyperloglog> partial(blocks.count);
+    perf::parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+        partial[b].add(keys.data() + begin, end - begin);
+    });
+    for (size_t b = 1; b < partial.size(); ++b) {
+        partial[0].merge(partial[b]);
+    }
+
+    ASSERT_EQ(serial.estimate(), partial[0].estimate());
+}
+
+TEST(HyperLogLog, SerializeRoundTrip)
+{
+    for (size_t n : { 0, 100, 5000, 100000 }) {
+        perf::hyperloglog hll(13);
+        auto keys = distinct_keys(n);
+        hll.add(keys.data(), keys.size());
+
+        auto bytes = hll.serialize();
+        auto copy = perf::hyperloglog::deserialize(bytes);
+
+        ASSERT_EQ(hll.is_sparse(), copy.is_sparse()) << n;
+        ASSERT_EQ(13u, copy.precision());
+        ASSERT_EQ(hll.estimate(), copy.estimate()) << n;
+        ASSERT_EQ(bytes, copy.serialize());
+    }
+}
+
+TEST(HyperLogLog, SparseSerializationIsCompact)
+{
+    perf::hyperloglog hll;
+    auto keys = distinct_keys(1000);
+    hll.add(keys.data(), keys.size());
+
+    ASSERT_LT(hll.serialize().size(), 4000u);
+}
+
+TEST(HyperLogLog, DeserializeRejectsOtherBytes)
+{
+    perf::hyperloglog hll(10);
+    auto keys = distinct_keys(50);
+    hll.add(keys.data(), keys.size());
+    auto bytes = hll.serialize();
+
+    ASSERT_THROW(perf::hyperloglog::deserialize(""), std::invalid_argument);
+    ASSERT_THROW(perf::hyperloglog::deserialize("CM\x01"), std::invalid_argument);
+    ASSERT_THROW(perf::hyperloglog::deserialize(bytes.substr(0, bytes.size() - 1)), std::invalid_argument);
+    ASSERT_THROW(perf::hyperloglog::deserialize(bytes + "x"), std::invalid_argument);
+    auto bad_precision = bytes;
+    bad_precision[3] = 30;
+    ASSERT_THROW(perf::hyperloglog::deserialize(bad_precision), std::invalid_argument);
+    auto bad_version = bytes;
+    bad_version[2] = 9;
+    ASSERT_THROW(perf::hyperloglog::deserialize(bad_version), std::invalid_argument);
+}
+
+TEST(CountMinSketch, NeverUnderestimates)
+{
+    auto keys = skewed_keys(500000, 100000);
+    std::unordered_map<uint64_t, uint64_t> exact;
+    auto cms = perf::count_min_sketch::with_error(0.001, 0.01);
+    for (uint64_t k : keys) {
+        cms.add(k);
+        ++exact[k];
+    }
+
+    ASSERT_EQ(keys.size(), cms.total());
+    size_t too_high = 0;
+    for (auto& e : exact) {
+        uint64_t estimate = cms.estimate(e.first);
+        ASSERT_GE(estimate, e.second);
+        too_high += estimate - e.second > 0.001 * keys.size();
+    }
+    ASSERT_LE(too_high, exact.size() / 100);
+}
+
+TEST(CountMinSketch, ShapeFromErrorBounds)
+{
+    auto cms = perf::count_min_sketch::with_error(0.01, 0.001);
+
+    ASSERT_EQ(272u, cms.width());
+    ASSERT_EQ(7u, cms.depth());
+    ASSERT_THROW(perf::count_min_sketch::with_error(0, 0.1), std::invalid_argument);
+    ASSERT_THROW(perf::count_min_sketch::with_error(0.1, 1), std::invalid_argument);
+    ASSERT_THROW(perf::count_min_sketch(0, 4), std::invalid_argument);
+}
+
+TEST(CountMinSketch, WeightedStringKeys)
+{
+    perf::count_min_sketch cms(1000, 5);
+    cms.add("helsinki", 639222);
+    cms.add(std::string("espoo"), 276087);
+    cms.add("oulu", 200600);
+
+    ASSERT_EQ(639222u, cms.estimate("helsinki"));
+    ASSERT_EQ(276087u, cms.estimate("espoo"));
+    ASSERT_EQ(200600u, cms.estimate(std::string("oulu")));
+    ASSERT_EQ(0u, cms.estimate("tampere"));
+    ASSERT_EQ(639222u + 276087u + 200600u, cms.total());
+}
+
+TEST(CountMinSketch, MergeIsLikeAddingEverything)
+{
+    auto keys = skewed_keys(100000, 10000);
+    perf::count_min_sketch all(2000, 4, 99);
+    perf::count_min_sketch even(2000, 4, 99);
+    perf::count_min_sketch odd(2000, 4, 99);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        all.add(keys[i]);
+        (i % 2 ? odd : even).add(keys[i]);
+    }
+
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        auto merged = even;
+        merged.merge(odd);
+        ASSERT_EQ(all.serialize(), merged.serialize());
+    }
+    perf::limit_isa(perf::isa::avx2);
+
+    ASSERT_THROW(all.merge(perf::count_min_sketch(2000, 4, 98)), std::invalid_argument);
+    ASSERT_THROW(all.merge(perf::count_min_sketch(2001, 4, 99)), std::invalid_argument);
+}
+
+TEST(CountMinSketch, SerializeRoundTrip)
+{
+    perf::count_min_sketch cms(777, 3, 12345);
+    for (uint64_t k : skewed_keys(10000, 1000)) {
+        cms.add(k, k % 5);
+    }
+
+    auto bytes = cms.serialize();
+    auto copy = perf::count_min_sketch::deserialize(bytes);
+
+    ASSERT_EQ(777u, copy.width());
+    ASSERT_EQ(3u, copy.depth());
+    ASSERT_EQ(12345u, copy.seed());
+    ASSERT_EQ(cms.total(), copy.total());
+    for (uint64_t k = 0; k < 1000; ++k) {
+        ASSERT_EQ(cms.estimate(k), copy.estimate(k));
+    }
+    ASSERT_THROW(perf::count_min_sketch::deserialize(bytes.substr(0, bytes.size() / 2)), std::invalid_argument);
+    ASSERT_THROW(perf::count_min_sketch::deserialize("HL\x01"), std::invalid_argument);
+}
+
+TEST(SketchBenchmark, DISABLED_AddAndMerge)
+{
+    auto n = bench::size(1 << 24);
+    auto keys = skewed_keys(n, 1 << 30);
+
+    bench::report("hyperloglog add", bench::best_of(3, [&] {
+        perf::hyperloglog hll;
+        hll.add(keys.data(), keys.size());
+        bench::keep(hll.estimate());
+    }), n * sizeof(uint64_t));
+    auto cms = perf::count_min_sketch::with_error(0.0001, 0.001);
+    bench::report("count_min_sketch add", bench::best_of(3, [&] {
+        cms.clear();
+        for (uint64_t k : keys) {
+            cms.add(k);
+        }
+        bench::keep(cms.total());
+    }), n * sizeof(uint64_t));
+
+    perf::hyperloglog a(18);
+    perf::hyperloglog b(18);
+    a.add(keys.data(), keys.size() / 2);
+    b.add(keys.data() + keys.size() / 2, keys.size() / 2);
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* names[] = { "hyperloglog merge scalar", "hyperloglog merge sse2", "hyperloglog merge avx2" };
+        double merge = bench::best_of(100, [&] { a.merge(b); });
+        bench::report(names[static_cast<int>(level)], merge, 2 << 18);
+    }
+}
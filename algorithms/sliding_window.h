@@ -0,0 +1,377 @@
+#pragma once
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Aggregates over the last k values of a stream.
+//
+// Every value pushed gives one result, the aggregate of the window ending
+// at it. The first k - 1 windows are shorter, they start at the beginning
+// of the stream. With k = 2 and min this is the minimum of each adjacent
+// pair.
+//
+// monotonic_window keeps only the values that can still become the
+// minimum (or maximum): a value is dropped as soon as a newer one is at
+// least as small, so the candidates stay sorted and the answer is the
+// oldest one. window_fold does the same for any associative operation
+// with two stacks. Both take amortized O(1) per value and O(k) memory.
+namespace perf {
+
+namespace detail {
+
+    inline void check_window(size_t window)
+    {
+        if (window == 0) {
+            throw std::invalid_argument("sliding window: window must not be empty");
+        }
+    }
+
+    // Windows up to this long are computed directly with SIMD, k - 1
+    // vector operations per four or eight results
+    constexpr size_t max_simd_window = 16;
+
+    struct min_int32 {
+        static int32_t scalar(int32_t a, int32_t b) { return std::min(a, b); }
+#if PERF_X86
+        // SSE2 has no 32-bit min, select with a comparison mask
+        static __m128i sse2(__m128i a, __m128i b)
+        {
+            __m128i b_smaller = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(b_smaller, b), _mm_andnot_si128(b_smaller, a));
+        }
+        PERF_AVX2 static __m256i avx2(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); }
+#endif
+    };
+
+    struct max_int32 {
+        static int32_t scalar(int32_t a, int32_t b) { return std::max(a, b); }
+#if PERF_X86
+        static __m128i sse2(__m128i a, __m128i b)
+        {
+            __m128i b_greater = _mm_cmpgt_epi32(b, a);
+            return _mm_or_si128(_mm_and_si128(b_greater, b), _mm_andnot_si128(b_greater, a));
+        }
+        PERF_AVX2 static __m256i avx2(__m256i a, __m256i b) { return _mm256_max_epi32(a, b); }
+#endif
+    };
+
+    // Which element types and comparisons have a SIMD kernel
+    template <typename T, typename Compare>
+    struct window_kernel {
+        static constexpr bool value = false;
+        using op = void;
+    };
+
+    template <>
+    struct window_kernel<int32_t, std::less<>> {
+        static constexpr bool value = true;
+        using op = min_int32;
+    };
+
+    template <>
+    struct window_kernel<int32_t, std::greater<>> {
+        static constexpr bool value = true;
+        using op = max_int32;
+    };
+
+#if PERF_X86
+    template <typename Op>
+    void full_windows_sse2(const int32_t* v, size_t first, size_t n, size_t k, int32_t* out)
+    {
+        size_t i = first;
+        for (; i + 4 <= n; i += 4) {
+            const int32_t* w = v + i + 1 - k;
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+            for (size_t j = 1; j < k; ++j) {
+                acc = Op::sse2(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + j)));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), acc);
+        }
+        for (; i < n; ++i) {
+            int32_t acc = v[i + 1 - k];
+            for (size_t j = i + 2 - k; j <= i; ++j) {
+                acc = Op::scalar(acc, v[j]);
+            }
+            out[i] = acc;
+        }
+    }
+
+    template <typename Op>
+    PERF_AVX2 void full_windows_avx2(const int32_t* v, size_t first, size_t n, size_t k, int32_t* out)
+    {
+        size_t i = first;
+        for (; i + 8 <= n; i += 8) {
+            const int32_t* w = v + i + 1 - k;
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w));
+            for (size_t j = 1; j < k; ++j) {
+                acc = Op::avx2(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + j)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), acc);
+        }
+        full_windows_sse2<Op>(v, i, n, k, out);
+    }
+#endif
+
+    // out[i] for first <= i < n, where first >= k - 1 so that every window
+    // lies inside v. Returns false if there is no SIMD to do it with.
+    template <typename Op>
+    bool full_windows(const int32_t* v, size_t first, size_t n, size_t k, int32_t* out)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            full_windows_avx2<Op>(v, first, n, k, out);
+            return true;
+        case isa::sse2:
+            full_windows_sse2<Op>(v, first, n, k, out);
+            return true;
+        case isa::scalar:
+            break;
+        }
+#endif
+        return false;
+    }
+
+} // namespace detail
+
+// Minimum of the window under Compare: std::less<> gives the minimum,
+// std::greater<> the maximum. Of equal values the newest is kept.
+template <typename T, typename Compare = std::less<>>
+class monotonic_window {
+public:
+    explicit monotonic_window(size_t window, Compare comp = Compare())
+        : k(window)
+        , comp(comp)
+    {
+        detail::check_window(window);
+        size_t capacity = 1;
+        while (capacity < window) {
+            capacity *= 2;
+        }
+        mask = capacity - 1;
+        values.resize(capacity);
+        positions.resize(capacity);
+    }
+
+    size_t window() const { return k; }
+
+    // Number of values pushed since construction or clear()
+    uint64_t pushed() const { return count; }
+
+    void clear()
+    {
+        count = 0;
+        head = 0;
+        tail = 0;
+    }
+
+    // Adds value to the stream, returns the minimum of the current window
+    const T& push(const T& value)
+    {
+        uint64_t position = count++;
+        if (head != tail && positions[head & mask] + k <= position) {
+            ++head;
+        }
+        while (head != tail && !comp(values[(tail - 1) & mask], value)) {
+            --tail;
+        }
+        values[tail & mask] = value;
+        positions[tail & mask] = position;
+        ++tail;
+        return values[head & mask];
+    }
+
+    // Minimum of the current window, at least one value must have been
+    // pushed
+    const T& current() const { return values[head & mask]; }
+
+    // Pushes n values, out[i] is the result of pushing v[i]. For int32_t
+    // with std::less<> or std::greater<> and windows up to 16 long, the
+    // windows that lie entirely in the batch are computed with SIMD.
+    void push(const T* v, size_t n, T* out)
+    {
+        push_batch(v, n, out, std::integral_constant<bool, detail::window_kernel<T, Compare>::value>());
+    }
+
+private:
+    void push_batch(const T* v, size_t n, T* out, std::false_type)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = push(v[i]);
+        }
+    }
+
+    void push_batch(const T* v, size_t n, T* out, std::true_type)
+    {
+        using op = typename detail::window_kernel<T, Compare>::op;
+        if (k > detail::max_simd_window || n < 4 * k) {
+            push_batch(v, n, out, std::false_type());
+            return;
+        }
+        // The first windows reach back into earlier batches
+        push_batch(v, k - 1, out, std::false_type());
+        if (!detail::full_windows<op>(v, k - 1, n, k, out)) {
+            push_batch(v + k - 1, n - (k - 1), out + k - 1, std::false_type());
+            return;
+        }
+        // The candidates depend only on the last k values
+        uint64_t total = count + n - (k - 1);
+        head = tail;
+        count = total - k;
+        for (size_t i = n - k; i < n; ++i) {
+            push(v[i]);
+        }
+    }
+
+    size_t k;
+    Compare comp;
+    uint64_t mask;
+    uint64_t count = 0;
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    std::vector<T> values;
+    std::vector<uint64_t> positions;
+};
+
+template <typename T>
+using window_min = monotonic_window<T, std::less<>>;
+
+template <typename T>
+using window_max = monotonic_window<T, std::greater<>>;
+
+// op(x[i - k + 1], ..., x[i]) for any associative op, e.g. sums, products,
+// gcd or composition of affine maps; op need not be commutative or
+// invertible.
+//
+// Pushes go on a back stack with a running fold of it. Evictions pop a
+// front stack that holds, for every value, the fold from it to the newest
+// value of the front; when the front is empty the back is flipped onto
+// it. Each value is folded at most twice, so a push costs O(1) amortized.
+template <typename T, typename Op>
+class window_fold {
+public:
+    explicit window_fold(size_t window, Op op = Op())
+        : k(window)
+        , op(op)
+    {
+        detail::check_window(window);
+        front.reserve(window);
+        back.reserve(window);
+    }
+
+    size_t window() const { return k; }
+
+    void clear()
+    {
+        front.clear();
+        back.clear();
+    }
+
+    // Adds value to the stream, returns the fold of the current window
+    T push(const T& value)
+    {
+        if (front.size() + back.size() == k) {
+            if (front.empty()) {
+                flip();
+            }
+            front.pop_back();
+        }
+        back_fold = back.empty() ? value : op(back_fold, value);
+        back.push_back(value);
+        return current();
+    }
+
+    // Fold of the current window, at least one value must have been pushed
+    T current() const
+    {
+        if (front.empty()) {
+            return back_fold;
+        }
+        return back.empty() ? front.back() : op(front.back(), back_fold);
+    }
+
+    // Pushes n values, out[i] is the result of pushing v[i]
+    void push(const T* v, size_t n, T* out)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = push(v[i]);
+        }
+    }
+
+private:
+    void flip()
+    {
+        for (size_t j = back.size(); j-- > 0;) {
+            front.push_back(front.empty() ? back[j] : op(back[j], front.back()));
+        }
+        back.clear();
+    }
+
+    size_t k;
+    Op op;
+    std::vector<T> front;
+    std::vector<T> back;
+    T back_fold = T();
+};
+
+namespace detail {
+
+    template <typename Compare>
+    struct select_min {
+        template <typename T>
+        const T& operator()(const T& a, const T& b) const
+        {
+            return comp(b, a) ? b : a;
+        }
+        Compare comp;
+    };
+
+} // namespace detail
+
+// out[i] = min(v[max(0, i - k + 1)], ..., v[i])
+//
+// Over a whole array the two-stack fold is faster than the monotonic
+// window: its comparisons compile to conditional moves, where the
+// monotonic window branches on every comparison and mispredicts on
+// unsorted input. Short int32_t windows still go to the SIMD kernel.
+template <typename T, typename Compare = std::less<>>
+void sliding_min(const T* v, size_t n, size_t k, T* out, Compare comp = Compare())
+{
+    if (detail::window_kernel<T, Compare>::value && k <= detail::max_simd_window && active_isa() != isa::scalar) {
+        monotonic_window<T, Compare>(k, comp).push(v, n, out);
+    } else {
+        window_fold<T, detail::select_min<Compare>>(k, { comp }).push(v, n, out);
+    }
+}
+
+// out[i] = max(v[max(0, i - k + 1)], ..., v[i])
+template <typename T>
+void sliding_max(const T* v, size_t n, size_t k, T* out)
+{
+    sliding_min(v, n, k, out, std::greater<>());
+}
+
+template <typename T>
+std::vector<T> sliding_min(const std::vector<T>& v, size_t k)
+{
+    std::vector<T> result(v.size());
+    sliding_min(v.data(), v.size(), k, result.data());
+    return result;
+}
+
+template <typename T>
+std::vector<T> sliding_max(const std::vector<T>& v, size_t k)
+{
+    std::vector<T> result(v.size());
+    sliding_max(v.data(), v.size(), k, result.data());
+    return result;
+}
+
+} // namespace perf
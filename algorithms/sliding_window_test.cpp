@@ -0,0 +1,184 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "sliding_window.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+template <typename Compare>
+std::vector<int32_t> naive_sliding(const std::vector<int32_t>& v, size_t k, Compare comp)
+{
+    std::vector<int32_t> result;
+    for (size_t i = 0; i < v.size(); ++i) {
+        auto first = begin(v) + (i + 1 >= k ? i + 1 - k : 0);
+        result.push_back(*std::min_element(first, begin(v) + i + 1, comp));
+    }
+    return result;
+}
+
+class SlidingWindow : public test_support::isa_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, SlidingWindow,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(SlidingWindow, FindMinimumOfAdjacentNumbers)
+{
+    std::vector<int> numbers{ 1, 2, 1, 3, 1, 4 };
+
+    auto minimums = perf::sliding_min(numbers, 2);
+
+    std::vector<int> expected{ 1, 1, 1, 1, 1, 1 };
+    ASSERT_EQ(expected, minimums);
+}
+
+TEST_P(SlidingWindow, MaximumOfThree)
+{
+    std::vector<int32_t> numbers{ 5, 1, 2, 7, 3, 3, 0, 1 };
+
+    auto maximums = perf::sliding_max(numbers, 3);
+
+    std::vector<int32_t> expected{ 5, 5, 5, 7, 7, 7, 3, 3 };
+    ASSERT_EQ(expected, maximums);
+}
+
+TEST_P(SlidingWindow, MatchesNaive)
+{
+    for (size_t n : { 0, 1, 5, 100, 1000 }) {
+        auto v = random_ints(n, -50, 50);
+        for (size_t k : { 1, 2, 3, 7, 8, 16, 17, 64, 2000 }) {
+            ASSERT_EQ(naive_sliding(v, k, std::less<>()), perf::sliding_min(v, k)) << n << " " << k;
+            ASSERT_EQ(naive_sliding(v, k, std::greater<>()), perf::sliding_max(v, k)) << n << " " << k;
+        }
+    }
+}
+
+TEST_P(SlidingWindow, BatchesContinueTheStream)
+{
+    auto v = random_ints(5000, -1000, 1000);
+    for (size_t k : { 1, 4, 16, 100 }) {
+        perf::window_min<int32_t> window(k);
+        std::vector<int32_t> out(v.size());
+        std::mt19937 rng(3);
+        for (size_t i = 0; i < v.size();) {
+            size_t batch = std::min<size_t>(v.size() - i, rng() % 300);
+            window.push(v.data() + i, batch, out.data() + i);
+            i += batch;
+        }
+
+        ASSERT_EQ(naive_sliding(v, k, std::less<>()), out) << k;
+        ASSERT_EQ(v.size(), window.pushed());
+        ASSERT_EQ(out.back(), window.current());
+    }
+}
+
+TEST(SlidingWindow, StreamOneAtATime)
+{
+    perf::window_max<double> window(3);
+
+    ASSERT_EQ(1.0, window.push(1.0));
+    ASSERT_EQ(3.0, window.push(3.0));
+    ASSERT_EQ(3.0, window.push(2.0));
+    ASSERT_EQ(3.0, window.push(0.0));
+    ASSERT_EQ(2.0, window.push(-1.0));
+
+    window.clear();
+    ASSERT_EQ(-5.0, window.push(-5.0));
+}
+
+TEST(SlidingWindow, EmptyWindowThrows)
+{
+    ASSERT_THROW(perf::window_min<int>(0), std::invalid_argument);
+    ASSERT_THROW((perf::window_fold<int, std::plus<>>(0)), std::invalid_argument);
+}
+
+TEST(SlidingWindow, FoldSums)
+{
+    perf::window_fold<long, std::plus<>> window(3);
+    std::vector<long> v{ 1, 2, 3, 4, 5, 6 };
+    std::vector<long> sums(v.size());
+
+    window.push(v.data(), v.size(), sums.data());
+
+    std::vector<long> expected{ 1, 3, 6, 9, 12, 15 };
+    ASSERT_EQ(expected, sums);
+}
+
+TEST(SlidingWindow, FoldKeepsOrder)
+{
+    // Concatenation is associative but not commutative
+    perf::window_fold<std::string, std::plus<>> window(3);
+    std::vector<std::string> results;
+    for (std::string s : { "a", "b", "c", "d", "e" }) {
+        results.push_back(window.push(s));
+    }
+
+    std::vector<std::string> expected{ "a", "ab", "abc", "bcd", "cde" };
+    ASSERT_EQ(expected, results);
+}
+
+TEST(SlidingWindow, FoldMatchesMonotonicWindow)
+{
+    auto v = random_ints(3000, -1000, 1000);
+    for (size_t k : { 1, 2, 10, 1000 }) {
+        auto min = [](int32_t a, int32_t b) { return std::min(a, b); };
+        perf::window_fold<int32_t, decltype(min)> fold(k, min);
+        std::vector<int32_t> out(v.size());
+        fold.push(v.data(), v.size(), out.data());
+
+        ASSERT_EQ(perf::sliding_min(v, k), out) << k;
+    }
+}
+
+TEST(SlidingWindowBenchmark, DISABLED_Minimum)
+{
+    auto n = bench::size(1 << 24);
+    auto v = random_ints(n, -1000000, 1000000);
+    std::vector<int32_t> out(n);
+    double bytes = 2.0 * n * sizeof(int32_t);
+
+    for (size_t k : { 4, 16, 1000 }) {
+        std::printf("k = %zu\n", k);
+        bench::report("std::deque of indices", bench::best_of(3, [&] {
+            std::deque<size_t> candidates;
+            for (size_t i = 0; i < n; ++i) {
+                while (!candidates.empty() && v[candidates.back()] >= v[i]) {
+                    candidates.pop_back();
+                }
+                candidates.push_back(i);
+                if (candidates.front() + k <= i) {
+                    candidates.pop_front();
+                }
+                out[i] = v[candidates.front()];
+            }
+            bench::keep(out[n - 1]);
+        }), bytes);
+        auto min = [](int32_t a, int32_t b) { return std::min(a, b); };
+        bench::report("window_fold", bench::best_of(3, [&] {
+            perf::window_fold<int32_t, decltype(min)>(k, min).push(v.data(), n, out.data());
+            bench::keep(out[n - 1]);
+        }), bytes);
+        for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+            perf::limit_isa(level);
+            const char* names[] = { "sliding_min scalar", "sliding_min sse2", "sliding_min avx2" };
+            bench::report(names[static_cast<int>(level)], bench::best_of(3, [&] {
+                perf::sliding_min(v.data(), n, k, out.data());
+                bench::keep(out[n - 1]);
+            }), bytes);
+        }
+        perf::limit_isa(perf::isa::avx2);
+    }
+}
@@ -0,0 +1,444 @@
+#include "sorted_set.h"
+
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace perf {
+
+namespace {
+
+    enum class set_op {
+        intersection,
+        difference,
+    };
+
+    // Sizes further apart than this are galloped
+    constexpr size_t gallop_ratio = 32;
+    // Union scans the runs of the long array between the elements of the
+    // short one from this ratio on, where the scan branches predictably
+    constexpr size_t union_scan_ratio = 4;
+
+    // The first position p >= from with v[p] >= x, or n. v[from - 1] < x.
+    size_t gallop(const uint32_t* v, size_t n, size_t from, uint32_t x)
+    {
+        size_t step = 1;
+        size_t probe = from;
+        while (probe < n && v[probe] < x) {
+            from = probe + 1;
+            probe += step;
+            step *= 2;
+        }
+        return std::lower_bound(v + from, v + std::min(probe, n), x) - v;
+    }
+
+    // Whether an element of a is kept, given whether b has it
+    template <set_op Op>
+    bool keep(bool found)
+    {
+        return found == (Op == set_op::intersection);
+    }
+
+    template <set_op Op, bool Store>
+    size_t merge(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t i = 0;
+        size_t j = 0;
+        size_t count = 0;
+        uint32_t discard;
+        while (i < na && j < nb) {
+            uint32_t x = a[i];
+            uint32_t y = b[j];
+            bool kept = Op == set_op::intersection ? x == y : x < y;
+            // Without a branch, and nothing past the ids kept: the parallel
+            // functions write the next part right behind them
+            if (Store) {
+                *(kept ? out + count : &discard) = x;
+            }
+            count += kept;
+            i += x <= y;
+            j += y <= x;
+        }
+        if (Op == set_op::difference) {
+            if (Store) {
+                std::copy(a + i, a + na, out + count);
+            }
+            count += na - i;
+        }
+        return count;
+    }
+
+    // a much shorter than b: its elements are searched in b
+    template <set_op Op, bool Store>
+    size_t gallop_short(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t j = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < na; ++i) {
+            j = gallop(b, nb, j, a[i]);
+            if (keep<Op>(j < nb && b[j] == a[i])) {
+                if (Store) {
+                    out[count] = a[i];
+                }
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // a much longer than b: the elements of b are searched in a, and the
+    // difference copies the runs of a between them
+    template <set_op Op, bool Store>
+    size_t gallop_long(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t i = 0;
+        size_t count = 0;
+        for (size_t j = 0; j < nb && i < na; ++j) {
+            size_t p = gallop(a, na, i, b[j]);
+            if (Op == set_op::difference) {
+                if (Store) {
+                    std::copy(a + i, a + p, out + count);
+                }
+                count += p - i;
+            }
+            if (p < na && a[p] == b[j]) {
+                if (Op == set_op::intersection) {
+                    if (Store) {
+                        out[count] = b[j];
+                    }
+                    ++count;
+                }
+                ++p;
+            }
+            i = p;
+        }
+        if (Op == set_op::difference) {
+            if (Store) {
+                std::copy(a + i, a + na, out + count);
+            }
+            count += na - i;
+        }
+        return count;
+    }
+
+    // Continues the blocks of Lanes elements from a[i] and b[j]. `found`
+    // marks the elements of the block of a at i that matched earlier
+    // blocks of b; the others are searched in what is left of b.
+    template <set_op Op, bool Store, size_t Lanes>
+    size_t finish_blocks(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, size_t i, size_t j, unsigned found,
+        uint32_t* out, size_t count)
+    {
+        if (found) {
+            for (size_t k = 0; k < Lanes; ++k) {
+                uint32_t x = a[i + k];
+                bool hit = (found >> k) & 1;
+                if (!hit) {
+                    while (j < nb && b[j] < x) {
+                        ++j;
+                    }
+                    hit = j < nb && b[j] == x;
+                }
+                if (keep<Op>(hit)) {
+                    if (Store) {
+                        out[count] = x;
+                    }
+                    ++count;
+                }
+            }
+            i += Lanes;
+        }
+        return count + merge<Op, Store>(a + i, na - i, b + j, nb - j, Store ? out + count : nullptr);
+    }
+
+#if PERF_X86
+    struct compaction_table {
+        // The positions of the set bits of every byte
+        unsigned char index[256][8] = {};
+    };
+
+    constexpr compaction_table make_compaction_table()
+    {
+        compaction_table t;
+        for (unsigned m = 0; m < 256; ++m) {
+            unsigned k = 0;
+            for (unsigned bit = 0; bit < 8; ++bit) {
+                if ((m >> bit) & 1) {
+                    t.index[m][k++] = static_cast<unsigned char>(bit);
+                }
+            }
+        }
+        return t;
+    }
+
+    constexpr compaction_table compaction = make_compaction_table();
+
+    // Bit k is set when lane k of a equals some lane of b
+    inline unsigned matches_sse2(__m128i a, __m128i b)
+    {
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+    }
+
+    // Rotations within the 128-bit halves, then with the halves swapped
+    PERF_AVX2 inline unsigned matches_avx2(__m256i a, __m256i b)
+    {
+        __m256i s = _mm256_permute2x128_si256(b, b, 1);
+        __m256i m0 = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi32(a, b), _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(_mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+        __m256i m1 = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi32(a, s), _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(s, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(_mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(s, _MM_SHUFFLE(2, 1, 0, 3)))));
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(m0, m1))));
+    }
+
+    template <set_op Op, bool Store>
+    size_t blocks_sse2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t i = 0;
+        size_t j = 0;
+        size_t count = 0;
+        unsigned found = 0;
+        while (i + 4 <= na && j + 4 <= nb) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+            found |= matches_sse2(x, y);
+            uint32_t last_a = a[i + 3];
+            uint32_t last_b = b[j + 3];
+            if (last_a <= last_b) {
+                unsigned kept = Op == set_op::intersection ? found : ~found & 0xf;
+                if (Store) {
+                    for (unsigned m = kept; m; m &= m - 1) {
+                        out[count++] = a[i + __builtin_ctz(m)];
+                    }
+                } else {
+                    count += __builtin_popcount(kept);
+                }
+                found = 0;
+                i += 4;
+            }
+            j += last_b <= last_a ? 4 : 0;
+        }
+        return finish_blocks<Op, Store, 4>(a, na, b, nb, i, j, found, out, count);
+    }
+
+    template <set_op Op, bool Store>
+    PERF_AVX2 size_t blocks_avx2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        size_t i = 0;
+        size_t j = 0;
+        size_t count = 0;
+        unsigned found = 0;
+        while (i + 8 <= na && j + 8 <= nb) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+            found |= matches_avx2(x, y);
+            uint32_t last_a = a[i + 7];
+            uint32_t last_b = b[j + 7];
+            if (last_a <= last_b) {
+                unsigned kept = Op == set_op::intersection ? found : ~found & 0xff;
+                unsigned n = _mm_popcnt_u32(kept);
+                if (Store) {
+                    // A masked store: the whole register may not fit in out
+                    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(compaction.index[kept])));
+                    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(n)), lane);
+                    _mm256_maskstore_epi32(reinterpret_cast<int*>(out + count), mask, _mm256_permutevar8x32_epi32(x, index));
+                }
+                count += n;
+                found = 0;
+                i += 8;
+            }
+            j += last_b <= last_a ? 8 : 0;
+        }
+        return finish_blocks<Op, Store, 8>(a, na, b, nb, i, j, found, out, count);
+    }
+#endif
+
+    template <set_op Op, bool Store>
+    size_t set_operation(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        if (na * gallop_ratio < nb) {
+            return gallop_short<Op, Store>(a, na, b, nb, out);
+        }
+        if (nb * gallop_ratio < na) {
+            return gallop_long<Op, Store>(a, na, b, nb, out);
+        }
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return blocks_avx2<Op, Store>(a, na, b, nb, out);
+        case isa::sse2:
+            return blocks_sse2<Op, Store>(a, na, b, nb, out);
+        case isa::scalar:
+            break;
+        }
+#endif
+        return merge<Op, Store>(a, na, b, nb, out);
+    }
+
+    size_t merge_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t i = 0;
+        size_t j = 0;
+        size_t count = 0;
+        while (i < na && j < nb) {
+            uint32_t x = a[i];
+            uint32_t y = b[j];
+            out[count++] = x < y ? x : y;
+            i += x <= y;
+            j += y <= x;
+        }
+        out = std::copy(a + i, a + na, out + count);
+        std::copy(b + j, b + nb, out);
+        return count + (na - i) + (nb - j);
+    }
+
+    // The elements of the short array go between the runs of the long one,
+    // which are found by galloping or by a scan that copies as it goes
+    template <bool Gallop>
+    size_t insert_union(const uint32_t* s, size_t ns, const uint32_t* l, size_t nl, uint32_t* out)
+    {
+        uint32_t* o = out;
+        size_t i = 0;
+        for (size_t j = 0; j < ns; ++j) {
+            if (Gallop) {
+                size_t p = gallop(l, nl, i, s[j]);
+                o = std::copy(l + i, l + p, o);
+                i = p;
+            } else {
+                while (i < nl && l[i] < s[j]) {
+                    *o++ = l[i++];
+                }
+            }
+            *o++ = s[j];
+            i += i < nl && l[i] == s[j];
+        }
+        o = std::copy(l + i, l + nl, o);
+        return o - out;
+    }
+
+    size_t union_of(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        if (na * gallop_ratio < nb) {
+            return insert_union<true>(a, na, b, nb, out);
+        }
+        if (nb * gallop_ratio < na) {
+            return insert_union<true>(b, nb, a, na, out);
+        }
+        if (na * union_scan_ratio < nb) {
+            return insert_union<false>(a, na, b, nb, out);
+        }
+        if (nb * union_scan_ratio < na) {
+            return insert_union<false>(b, nb, a, na, out);
+        }
+        return merge_union(a, na, b, nb, out);
+    }
+
+    using set_function = size_t (*)(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out);
+
+    // Runs run(a part, b part, out part) on the ids between splitters taken
+    // from the longer array. A first pass counts the intersection of every
+    // part, from which size(ids of a, ids of b, intersection) is the exact
+    // length of its output, so the second pass writes every part in place
+    // right behind the one before. Without out, the sizes are added up.
+    template <typename Size>
+    size_t parallel_parts(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, size_t grain,
+        Size size, set_function run)
+    {
+        bool a_longer = na >= nb;
+        const uint32_t* longer = a_longer ? a : b;
+        block_partition blocks(std::max(na, nb), grain);
+        if (blocks.count == 1) {
+            return run(a, na, b, nb, out);
+        }
+
+        std::vector<size_t> a_begin(blocks.count + 1, na);
+        std::vector<size_t> b_begin(blocks.count + 1, nb);
+        a_begin[0] = b_begin[0] = 0;
+        for (size_t k = 1; k < blocks.count; ++k) {
+            uint32_t splitter = longer[blocks.begin(k)];
+            a_begin[k] = a_longer ? blocks.begin(k) : std::lower_bound(a, a + na, splitter) - a;
+            b_begin[k] = a_longer ? std::lower_bound(b, b + nb, splitter) - b : blocks.begin(k);
+        }
+        std::vector<size_t> offset(blocks.count + 1, 0);
+        parallel_for_each_block(blocks, [&](size_t k, size_t, size_t) {
+            size_t ma = a_begin[k + 1] - a_begin[k];
+            size_t mb = b_begin[k + 1] - b_begin[k];
+            offset[k + 1] = size(ma, mb, sorted_intersection_size(a + a_begin[k], ma, b + b_begin[k], mb));
+        });
+        for (size_t k = 0; k < blocks.count; ++k) {
+            offset[k + 1] += offset[k];
+        }
+
+        if (out) {
+            parallel_for_each_block(blocks, [&](size_t k, size_t, size_t) {
+                run(a + a_begin[k], a_begin[k + 1] - a_begin[k], b + b_begin[k], b_begin[k + 1] - b_begin[k], out + offset[k]);
+            });
+        }
+        return offset[blocks.count];
+    }
+
+} // namespace
+
+size_t sorted_intersection(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+{
+    return set_operation<set_op::intersection, true>(a, na, b, nb, out);
+}
+
+size_t sorted_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+{
+    return union_of(a, na, b, nb, out);
+}
+
+size_t sorted_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+{
+    return set_operation<set_op::difference, true>(a, na, b, nb, out);
+}
+
+size_t sorted_intersection_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb)
+{
+    return set_operation<set_op::intersection, false>(a, na, b, nb, nullptr);
+}
+
+size_t sorted_union_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb)
+{
+    return na + nb - sorted_intersection_size(a, na, b, nb);
+}
+
+size_t sorted_difference_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb)
+{
+    return na - sorted_intersection_size(a, na, b, nb);
+}
+
+size_t parallel_sorted_intersection(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, size_t grain)
+{
+    return parallel_parts(a, na, b, nb, out, grain, [](size_t, size_t, size_t c) { return c; }, sorted_intersection);
+}
+
+size_t parallel_sorted_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, size_t grain)
+{
+    return parallel_parts(a, na, b, nb, out, grain, [](size_t x, size_t y, size_t c) { return x + y - c; }, sorted_union);
+}
+
+size_t parallel_sorted_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, size_t grain)
+{
+    return parallel_parts(a, na, b, nb, out, grain, [](size_t x, size_t, size_t c) { return x - c; }, sorted_difference);
+}
+
+size_t parallel_sorted_intersection_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, size_t grain)
+{
+    return parallel_parts(a, na, b, nb, nullptr, grain, [](size_t, size_t, size_t c) { return c; },
+        [](const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t*) {
+            return sorted_intersection_size(a, na, b, nb);
+        });
+}
+
+} // namespace perf
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Intersection, union and difference of sorted arrays of unique 32-bit
+// ids, such as the posting lists of an inverted index.
+//
+// Arrays of similar size are intersected in blocks, after Schlegel et
+// al. and Lemire et al.: a block of eight ids of a (four with SSE2) is
+// compared with every rotation of a block of b, which takes eight
+// compares instead of a chain of unpredictable branches, and the matches
+// are packed to the output with a shuffle. The block with the smaller
+// last id moves on. Difference uses the same blocks and keeps the ids
+// that found no match.
+//
+// When one array is more than 32 times longer than the other, the
+// elements of the short one are searched in the long one by galloping:
+// steps of 1, 2, 4... from the previous match, then a binary search, so
+// the cost grows with the short array and only logarithmically with the
+// long one.
+//
+// Union merges without branches for similar sizes, and otherwise copies
+// the runs of the long array between the elements of the short one. The
+// _size functions count without writing anything; the union and
+// difference sizes follow from the intersection size. The parallel_
+// functions split both arrays at keys taken from the longer one, so every
+// thread works on the ids between two splitters; they count the output of
+// every part first, so that the parts then write to their exact place in
+// out at the same time.
+namespace perf {
+
+constexpr size_t sorted_set_grain = 1 << 16;
+
+// a and b are sorted without duplicates. The results are sorted too, out
+// needs room for min(na, nb) ids for the intersection, na + nb for the
+// union and na for the difference a - b. Each returns the number of ids
+// written.
+size_t sorted_intersection(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out);
+size_t sorted_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out);
+size_t sorted_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out);
+
+size_t sorted_intersection_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb);
+size_t sorted_union_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb);
+size_t sorted_difference_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb);
+
+size_t parallel_sorted_intersection(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out,
+    size_t grain = sorted_set_grain);
+size_t parallel_sorted_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out,
+    size_t grain = sorted_set_grain);
+size_t parallel_sorted_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out,
+    size_t grain = sorted_set_grain);
+size_t parallel_sorted_intersection_size(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+    size_t grain = sorted_set_grain);
+
+inline std::vector<uint32_t> sorted_intersection(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> out(std::min(a.size(), b.size()));
+    out.resize(sorted_intersection(a.data(), a.size(), b.data(), b.size(), out.data()));
+    return out;
+}
+
+inline std::vector<uint32_t> sorted_union(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> out(a.size() + b.size());
+    out.resize(sorted_union(a.data(), a.size(), b.data(), b.size(), out.data()));
+    return out;
+}
+
+inline std::vector<uint32_t> sorted_difference(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> out(a.size());
+    out.resize(sorted_difference(a.data(), a.size(), b.data(), b.size(), out.data()));
+    return out;
+}
+
+inline size_t sorted_intersection_size(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    return sorted_intersection_size(a.data(), a.size(), b.data(), b.size());
+}
+
+} // namespace perf
@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "parallel.h"
+#include "simd.h"
+#include "sorted_set.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace {
+
+// n sorted unique ids below `range`
+std::vector<uint32_t> random_set(size_t n, uint32_t range, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<uint32_t> dist(0, range - 1);
+    std::vector<uint32_t> v(n);
+    for (auto& x : v) {
+        x = dist(rng);
+    }
+    std::sort(begin(v), end(v));
+    v.erase(std::unique(begin(v), end(v)), end(v));
+    return v;
+}
+
+void expect_like_std(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> intersection;
+    std::vector<uint32_t> united;
+    std::vector<uint32_t> difference;
+    std::set_intersection(begin(a), end(a), begin(b), end(b), std::back_inserter(intersection));
+    std::set_union(begin(a), end(a), begin(b), end(b), std::back_inserter(united));
+    std::set_difference(begin(a), end(a), begin(b), end(b), std::back_inserter(difference));
+
+    ASSERT_EQ(intersection, perf::sorted_intersection(a, b)) << a.size() << " " << b.size();
+    ASSERT_EQ(united, perf::sorted_union(a, b)) << a.size() << " " << b.size();
+    ASSERT_EQ(difference, perf::sorted_difference(a, b)) << a.size() << " " << b.size();
+    ASSERT_EQ(intersection.size(), perf::sorted_intersection_size(a, b));
+    ASSERT_EQ(united.size(), perf::sorted_union_size(a.data(), a.size(), b.data(), b.size()));
+    ASSERT_EQ(difference.size(), perf::sorted_difference_size(a.data(), a.size(), b.data(), b.size()));
+}
+
+class SortedSet : public test_support::isa_fixture {
+};
+
+class ParallelSortedSet : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, SortedSet,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(SortedSet, PostingLists)
+{
+    std::vector<uint32_t> a{ 1, 3, 4, 7, 9, 12, 15, 20, 21, 22, 30 };
+    std::vector<uint32_t> b{ 2, 3, 7, 8, 12, 13, 14, 15, 21, 31 };
+
+    ASSERT_EQ((std::vector<uint32_t>{ 3, 7, 12, 15, 21 }), perf::sorted_intersection(a, b));
+    ASSERT_EQ((std::vector<uint32_t>{ 1, 4, 9, 20, 22, 30 }), perf::sorted_difference(a, b));
+    ASSERT_EQ(16u, perf::sorted_union(a, b).size());
+    ASSERT_EQ(5u, perf::sorted_intersection_size(a, b));
+}
+
+TEST_P(SortedSet, EmptyIdenticalAndDisjoint)
+{
+    std::vector<uint32_t> none;
+    std::vector<uint32_t> evens;
+    std::vector<uint32_t> odds;
+    for (uint32_t i = 0; i < 100; ++i) {
+        evens.push_back(2 * i);
+        odds.push_back(2 * i + 1);
+    }
+
+    expect_like_std(none, none);
+    expect_like_std(none, evens);
+    expect_like_std(evens, none);
+    expect_like_std(evens, evens);
+    expect_like_std(evens, odds);
+    expect_like_std(odds, evens);
+}
+
+TEST_P(SortedSet, ExtremeIds)
+{
+    std::vector<uint32_t> a{ 0, 1, 5, 0x7fffffff, 0x80000000, 0xfffffff0, 0xfffffffe, 0xffffffff };
+    std::vector<uint32_t> b{ 0, 2, 5, 0x80000000, 0x80000001, 0xfffffff1, 0xfffffffe, 0xffffffff };
+
+    expect_like_std(a, b);
+}
+
+TEST_P(SortedSet, RandomSetsOfSimilarSize)
+{
+    std::mt19937_64 rng(11);
+    for (int round = 0; round < 200; ++round) {
+        size_t na = rng() % 300;
+        size_t nb = rng() % 300;
+        // From sparse to dense matches
+        uint32_t range = static_cast<uint32_t>(std::max<size_t>(1, (na + nb) * (1 + rng() % 8)));
+        expect_like_std(random_set(na, range, rng), random_set(nb, range, rng));
+    }
+}
+
+TEST_P(SortedSet, SkewedSizesGallop)
+{
+    std::mt19937_64 rng(12);
+    for (size_t small : { 1, 5, 30, 100 }) {
+        auto big = random_set(100000, 300000, rng);
+        auto few = random_set(small, 300000, rng);
+        // Some of the few are surely in big
+        for (size_t i = 0; i < few.size(); i += 2) {
+            few[i] = big[rng() % big.size()];
+        }
+        std::sort(begin(few), end(few));
+        few.erase(std::unique(begin(few), end(few)), end(few));
+
+        expect_like_std(few, big);
+        expect_like_std(big, few);
+    }
+}
+
+TEST_F(ParallelSortedSet, MatchesSequential)
+{
+    std::mt19937_64 rng(13);
+    for (auto sizes : { std::make_pair(5000, 5000), std::make_pair(20000, 3000), std::make_pair(100, 30000), std::make_pair(0, 9000) }) {
+        auto a = random_set(sizes.first, 60000, rng);
+        auto b = random_set(sizes.second, 60000, rng);
+        // The parts write in place, and nothing past the result
+        const uint32_t untouched = 0xdeadbeef;
+        auto run = [&](auto f) {
+            std::vector<uint32_t> out(a.size() + b.size() + 1, untouched);
+            size_t n = f(a.data(), a.size(), b.data(), b.size(), out.data(), 512);
+            EXPECT_EQ(untouched, out[n]);
+            out.resize(n);
+            return out;
+        };
+
+        ASSERT_EQ(perf::sorted_intersection(a, b), run(perf::parallel_sorted_intersection));
+        ASSERT_EQ(perf::sorted_union(a, b), run(perf::parallel_sorted_union));
+        ASSERT_EQ(perf::sorted_difference(a, b), run(perf::parallel_sorted_difference));
+        ASSERT_EQ(perf::sorted_intersection_size(a, b),
+            perf::parallel_sorted_intersection_size(a.data(), a.size(), b.data(), b.size(), 512));
+    }
+}
+
+TEST(SortedSetBenchmark, DISABLED_Intersections)
+{
+    std::mt19937_64 rng(14);
+    auto n = bench::size(1 << 22);
+    for (size_t ratio : { 1, 10, 1000 }) {
+        auto a = random_set(n / ratio, static_cast<uint32_t>(4 * n), rng);
+        auto b = random_set(n, static_cast<uint32_t>(4 * n), rng);
+        std::vector<uint32_t> out(a.size() + b.size());
+        double bytes = (a.size() + b.size()) * sizeof(uint32_t);
+        std::printf("1:%zu\n", ratio);
+
+        bench::report("std::set_intersection", bench::best_of(5, [&] {
+            bench::keep(std::set_intersection(begin(a), end(a), begin(b), end(b), out.data()));
+        }), bytes);
+        for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+            perf::limit_isa(level);
+            const char* name = level == perf::isa::avx2 ? "sorted_intersection avx2"
+                : level == perf::isa::sse2              ? "sorted_intersection sse2"
+                                                        : "sorted_intersection scalar";
+            bench::report(name, bench::best_of(5, [&] {
+                bench::keep(perf::sorted_intersection(a.data(), a.size(), b.data(), b.size(), out.data()));
+            }), bytes);
+        }
+        bench::report("sorted_intersection_size", bench::best_of(5, [&] {
+            bench::keep(perf::sorted_intersection_size(a.data(), a.size(), b.data(), b.size()));
+        }), bytes);
+        bench::report("parallel_sorted_intersection", bench::best_of(5, [&] {
+            bench::keep(perf::parallel_sorted_intersection(a.data(), a.size(), b.data(), b.size(), out.data()));
+        }), bytes);
+        bench::report("std::set_union", bench::best_of(5, [&] {
+            bench::keep(std::set_union(begin(a), end(a), begin(b), end(b), out.data()));
+        }), bytes);
+        bench::report("sorted_union", bench::best_of(5, [&] {
+            bench::keep(perf::sorted_union(a.data(), a.size(), b.data(), b.size(), out.data()));
+        }), bytes);
+        bench::report("std::set_difference", bench::best_of(5, [&] {
+            bench::keep(std::set_difference(begin(b), end(b), begin(a), end(a), out.data()));
+        }), bytes);
+        bench::report("sorted_difference", bench::best_of(5, [&] {
+            bench::keep(perf::sorted_difference(b.data(), b.size(), a.data(), a.size(), out.data()));
+        }), bytes);
+    }
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "simd.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Sorting networks for arrays of up to 32 elements.
+//
+// A sorting network is a fixed list of compare-exchanges that sorts any
+// input. Nothing depends on the data, so every compare-exchange of
+// numbers compiles to a min and a max without branches, and there are no
+// mispredictions, which dominate sorting a handful of elements with
+// std::sort. The networks are Batcher's odd-even merge sorts, generated
+// at compile time for every size and unrolled into straight-line code:
+// 19 compare-exchanges for 8 elements, 63 for 16, 191 for 32.
+//
+// int32_t and float arrays with std::less are sorted with AVX2 instead:
+// the elements are padded to 8, 16 or 32 lanes and go through a bitonic
+// network in one, two or four registers. Floats are compared as integers
+// with the order of their bit patterns, so -0.0 goes before 0.0 and no
+// element changes, NaNs included.
+//
+// small_sort picks the network for the size at runtime, and uses
+// std::sort for more than 32 elements or for elements that are not
+// trivially copyable.
+namespace perf {
+
+constexpr size_t small_sort_threshold = 32;
+
+namespace detail {
+
+    struct comparator_list {
+        size_t size = 0;
+        unsigned char first[192] = {};
+        unsigned char second[192] = {};
+    };
+
+    // Batcher's odd-even merge sort for the next power of two, without the
+    // comparators reaching past n
+    constexpr comparator_list odd_even_merge_network(size_t n)
+    {
+        comparator_list list;
+        for (size_t p = 1; p < n; p *= 2) {
+            for (size_t k = p; k >= 1; k /= 2) {
+                for (size_t j = k % p; j + k < n; j += 2 * k) {
+                    for (size_t i = 0; i < k && i + j + k < n; ++i) {
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                            list.first[list.size] = static_cast<unsigned char>(i + j);
+                            list.second[list.size] = static_cast<unsigned char>(i + j + k);
+                            ++list.size;
+                        }
+                    }
+                }
+            }
+        }
+        return list;
+    }
+
+    template <size_t N>
+    constexpr comparator_list network = odd_even_merge_network(N);
+
+    // Puts the smaller of a and b in a. Copies of small trivially copyable
+    // elements are selected without a branch.
+    template <typename T, typename Compare>
+    void compare_exchange(T& a, T& b, Compare& comp, std::true_type)
+    {
+        bool swap = comp(b, a);
+        T low = swap ? b : a;
+        T high = swap ? a : b;
+        a = low;
+        b = high;
+    }
+
+    template <typename T, typename Compare>
+    void compare_exchange(T& a, T& b, Compare& comp, std::false_type)
+    {
+        if (comp(b, a)) {
+            std::swap(a, b);
+        }
+    }
+
+    template <size_t N, typename T, typename Compare, size_t... I>
+    void apply_network(T* v, Compare& comp, std::index_sequence<I...>)
+    {
+        using branchless = std::integral_constant<bool, std::is_trivially_copyable<T>::value && sizeof(T) <= 16>;
+        int expand[] = { 0, (compare_exchange(v[network<N>.first[I]], v[network<N>.second[I]], comp, branchless()), 0)... };
+        (void)expand;
+    }
+
+    template <size_t N, typename T, typename Compare>
+    void scalar_network(T* v, Compare& comp)
+    {
+        apply_network<N>(v, comp, std::make_index_sequence<network<N>.size>());
+    }
+
+    // Whether the AVX2 networks sort T with Compare
+    template <typename T, typename Compare>
+    struct simd_network : std::integral_constant<bool, (std::is_same<T, int32_t>::value || std::is_same<T, float>::value)
+                              && (std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value)> {
+    };
+
+#if PERF_X86
+    // Compare-exchange of lanes i and i ^ M of a register; the lane with
+    // the highest bit of M set gets the larger element
+    template <int M>
+    PERF_AVX2 __m256i lane_stage(__m256i x)
+    {
+        __m256i partner;
+        int high;
+        switch (M) {
+        case 1:
+            partner = _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+            high = 0xaa;
+            break;
+        case 2:
+            partner = _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+            high = 0xcc;
+            break;
+        case 3:
+            partner = _mm256_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3));
+            high = 0xcc;
+            break;
+        case 4:
+            partner = _mm256_permute2x128_si256(x, x, 1);
+            high = 0xf0;
+            break;
+        default:
+            partner = _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+            high = 0xf0;
+            break;
+        }
+        __m256i low = _mm256_min_epi32(x, partner);
+        __m256i large = _mm256_max_epi32(x, partner);
+        switch (high) {
+        case 0xaa:
+            return _mm256_blend_epi32(low, large, 0xaa);
+        case 0xcc:
+            return _mm256_blend_epi32(low, large, 0xcc);
+        default:
+            return _mm256_blend_epi32(low, large, 0xf0);
+        }
+    }
+
+    PERF_AVX2 inline __m256i reversed(__m256i x)
+    {
+        return _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    }
+
+    // Bitonic sort of eight lanes, every compare-exchange ascending: each
+    // merge starts by comparing lanes mirrored within its block
+    PERF_AVX2 inline __m256i sort_lanes(__m256i x)
+    {
+        x = lane_stage<1>(x);
+        x = lane_stage<3>(x);
+        x = lane_stage<1>(x);
+        x = lane_stage<7>(x);
+        x = lane_stage<2>(x);
+        return lane_stage<1>(x);
+    }
+
+    PERF_AVX2 inline __m256i merge_lanes(__m256i x)
+    {
+        x = lane_stage<4>(x);
+        x = lane_stage<2>(x);
+        return lane_stage<1>(x);
+    }
+
+    // Sorts the 8 R lanes of r, R a power of two
+    template <size_t R>
+    PERF_AVX2 void sort_registers(__m256i (&r)[R])
+    {
+        for (size_t i = 0; i < R; ++i) {
+            r[i] = sort_lanes(r[i]);
+        }
+        for (size_t block = 2; block <= R; block *= 2) {
+            // Mirrored registers of every block
+            for (size_t b = 0; b < R; b += block) {
+                for (size_t i = 0; i < block / 2; ++i) {
+                    __m256i& a = r[b + i];
+                    __m256i& c = r[b + block - 1 - i];
+                    __m256i mirror = reversed(c);
+                    c = reversed(_mm256_max_epi32(a, mirror));
+                    a = _mm256_min_epi32(a, mirror);
+                }
+            }
+            // Then registers a quarter, an eighth... of the block apart
+            for (size_t d = block / 4; d >= 1; d /= 2) {
+                for (size_t i = 0; i < R; ++i) {
+                    if (!(i & d)) {
+                        __m256i low = _mm256_min_epi32(r[i], r[i + d]);
+                        r[i + d] = _mm256_max_epi32(r[i], r[i + d]);
+                        r[i] = low;
+                    }
+                }
+            }
+            for (size_t i = 0; i < R; ++i) {
+                r[i] = merge_lanes(r[i]);
+            }
+        }
+    }
+
+    // Floats as integers in the order of their values; its own inverse
+    PERF_AVX2 inline __m256i float_keys(__m256i x)
+    {
+        return _mm256_xor_si256(x, _mm256_srli_epi32(_mm256_srai_epi32(x, 31), 1));
+    }
+
+    template <size_t N, typename T>
+    PERF_AVX2 void simd_sort(T* v)
+    {
+        constexpr size_t R = N <= 8 ? 1 : N <= 16 ? 2 : 4;
+        constexpr bool floats = std::is_same<T, float>::value;
+        int* lanes = reinterpret_cast<int*>(v);
+        const __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i padding = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+
+        // Masked loads and stores: copying through a buffer stalls on
+        // loading what was just stored element by element
+        __m256i r[R];
+        __m256i mask[R];
+        for (size_t i = 0; i < R; ++i) {
+            mask[i] = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(N - 8 * i)), index);
+            r[i] = _mm256_maskload_epi32(lanes + 8 * i, mask[i]);
+            if (floats) {
+                r[i] = float_keys(r[i]);
+            }
+            // Padding goes after everything else
+            r[i] = _mm256_blendv_epi8(padding, r[i], mask[i]);
+        }
+        sort_registers(r);
+        for (size_t i = 0; i < R; ++i) {
+            if (floats) {
+                r[i] = float_keys(r[i]);
+            }
+            _mm256_maskstore_epi32(lanes + 8 * i, mask[i], r[i]);
+        }
+    }
+#endif
+
+    template <size_t N, typename T, typename Compare>
+    void sort_network(T* v, Compare& comp, std::true_type)
+    {
+#if PERF_X86
+        // The shuffles cost more than they save for a few elements
+        if (N >= 6 && active_isa() == isa::avx2) {
+            simd_sort<N>(v);
+            return;
+        }
+#endif
+        scalar_network<N>(v, comp);
+    }
+
+    template <size_t N, typename T, typename Compare>
+    void sort_network(T* v, Compare& comp, std::false_type)
+    {
+        scalar_network<N>(v, comp);
+    }
+
+    template <typename T, typename Compare, size_t... N>
+    void small_sort(T* v, size_t n, Compare& comp, std::index_sequence<N...>)
+    {
+        using simd = std::integral_constant<bool, simd_network<T, Compare>::value>;
+        using sorter = void (*)(T*, Compare&, simd);
+        static constexpr sorter networks[] = { &sort_network<N, T, Compare>... };
+        networks[n](v, comp, simd());
+    }
+
+    template <typename T, typename Compare>
+    void small_sort(T* v, size_t n, Compare& comp, std::true_type)
+    {
+        if (n > small_sort_threshold) {
+            std::sort(v, v + n, comp);
+            return;
+        }
+        small_sort(v, n, comp, std::make_index_sequence<small_sort_threshold + 1>());
+    }
+
+    template <typename T, typename Compare>
+    void small_sort(T* v, size_t n, Compare& comp, std::false_type)
+    {
+        std::sort(v, v + n, comp);
+    }
+
+} // namespace detail
+
+// Sorts v[0, N) with a sorting network, N <= 32
+template <size_t N, typename T, typename Compare = std::less<>>
+void sort_network(T* v, Compare comp = Compare())
+{
+    static_assert(N <= small_sort_threshold, "sorting networks go up to 32 elements");
+    detail::sort_network<N>(v, comp, detail::simd_network<T, Compare>());
+}
+
+template <typename T, size_t N, typename Compare = std::less<>>
+void sort_network(std::array<T, N>& a, Compare comp = Compare())
+{
+    sort_network<N>(a.data(), comp);
+}
+
+// Sorts v[0, n): with the sorting network for n up to 32 elements,
+// otherwise with std::sort
+template <typename T, typename Compare = std::less<>>
+void small_sort(T* v, size_t n, Compare comp = Compare())
+{
+    detail::small_sort(v, n, comp, std::is_trivially_copyable<T>());
+}
+
+template <typename T, typename Compare = std::less<>>
+void small_sort(std::vector<T>& v, Compare comp = Compare())
+{
+    small_sort(v.data(), v.size(), comp);
+}
+
+} // namespace perf
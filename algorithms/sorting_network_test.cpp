@@ -0,0 +1,249 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "sorting_network.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using test_support::random_values;
+
+class SortingNetwork : public test_support::isa_fixture {
+};
+
+template <typename T, typename Compare = std::less<>>
+void expect_sorts_like_std(int64_t range, Compare comp = Compare())
+{
+    std::mt19937_64 rng(3);
+    for (size_t n = 0; n <= 40; ++n) {
+        for (int round = 0; round < 20; ++round) {
+            auto v = random_values<T>(n, range, rng);
+            auto expected = v;
+            std::sort(begin(expected), end(expected), comp);
+
+            perf::small_sort(v.data(), v.size(), comp);
+
+            ASSERT_EQ(expected, v) << n;
+        }
+    }
+}
+
+// Sorts every 0/1 input of N elements: then it sorts every input
+template <size_t N>
+bool sorts_all_zero_one_inputs()
+{
+    for (uint32_t bits = 0; bits < (1u << N); ++bits) {
+        std::array<uint8_t, N> a;
+        for (size_t i = 0; i < N; ++i) {
+            a[i] = (bits >> i) & 1;
+        }
+        perf::sort_network(a);
+        if (!std::is_sorted(a.begin(), a.end())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct point {
+    int x;
+    int y;
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, SortingNetwork,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(SortingNetwork, SortVector)
+{
+    std::vector<int> v{ 1, 6, 3, 8, 2, 0, 7 };
+
+    perf::small_sort(v);
+
+    ASSERT_EQ((std::vector<int>{ 0, 1, 2, 3, 6, 7, 8 }), v);
+}
+
+TEST_P(SortingNetwork, FixedSizeArrays)
+{
+    std::array<float, 5> a{ { 2.5f, -1.0f, 0.0f, 7.0f, -3.5f } };
+    std::array<int32_t, 16> b;
+    for (size_t i = 0; i < b.size(); ++i) {
+        b[i] = static_cast<int32_t>((i * 7) % 16) - 8;
+    }
+
+    perf::sort_network(a);
+    perf::sort_network(b);
+    perf::sort_network<3>(b.data() + 13, std::greater<>());
+
+    ASSERT_EQ((std::array<float, 5>{ { -3.5f, -1.0f, 0.0f, 2.5f, 7.0f } }), a);
+    ASSERT_TRUE(std::is_sorted(b.begin(), b.begin() + 13));
+    ASSERT_EQ((std::vector<int32_t>{ 7, 6, 5 }), std::vector<int32_t>(b.begin() + 13, b.end()));
+}
+
+TEST_P(SortingNetwork, MatchesStdSortForAllTypes)
+{
+    expect_sorts_like_std<int32_t>(1000);
+    expect_sorts_like_std<int32_t>(3);
+    expect_sorts_like_std<int32_t>(std::numeric_limits<int32_t>::max());
+    expect_sorts_like_std<float>(1000);
+    expect_sorts_like_std<double>(1000);
+    expect_sorts_like_std<int64_t>(std::numeric_limits<int64_t>::max());
+    expect_sorts_like_std<uint16_t>(1000);
+    expect_sorts_like_std<int8_t>(100);
+    expect_sorts_like_std<int32_t>(1000, std::greater<>());
+    expect_sorts_like_std<float>(1000, std::less<float>());
+}
+
+TEST_P(SortingNetwork, ExtremeValues)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> f{ 0.0f, inf, -0.0f, -inf, std::numeric_limits<float>::max(), 1e-45f, -1e-45f,
+        std::numeric_limits<float>::lowest(), 3.0f, -3.0f };
+    std::vector<int32_t> i{ INT32_MAX, INT32_MIN, 0, -1, 1, INT32_MAX, INT32_MIN, 5, 4, 3 };
+    auto expected_f = f;
+    std::sort(begin(expected_f), end(expected_f));
+    auto expected_i = i;
+    std::sort(begin(expected_i), end(expected_i));
+
+    perf::small_sort(f);
+    perf::small_sort(i);
+
+    ASSERT_EQ(expected_f, f);
+    ASSERT_EQ(expected_i, i);
+}
+
+TEST_P(SortingNetwork, KeepsEveryFloatBitPattern)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<float> v{ 1.0f, nan, -0.0f, 0.0f, -nan, 2.0f, 0.0f, -0.0f, nan, -1.0f, 5.0f, 4.0f };
+    auto bits = [](const std::vector<float>& f) {
+        std::vector<uint32_t> b(f.size());
+        std::memcpy(b.data(), f.data(), f.size() * sizeof(float));
+        std::sort(begin(b), end(b));
+        return b;
+    };
+    auto before = bits(v);
+
+    perf::small_sort(v);
+
+    ASSERT_EQ(before, bits(v));
+}
+
+TEST_P(SortingNetwork, StructsWithComparator)
+{
+    std::vector<point> v;
+    for (int i = 0; i < 20; ++i) {
+        v.push_back({ (i * 13) % 7, i });
+    }
+    auto by_x = [](const point& a, const point& b) { return a.x < b.x; };
+
+    perf::small_sort(v, by_x);
+
+    ASSERT_TRUE(std::is_sorted(begin(v), end(v), by_x));
+    std::vector<int> ys;
+    for (auto& p : v) {
+        ys.push_back(p.y);
+    }
+    std::sort(begin(ys), end(ys));
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQ(i, ys[i]);
+    }
+}
+
+TEST_P(SortingNetwork, StringsAndLargeInputsUseStdSort)
+{
+    std::vector<std::string> s{ "tampere", "espoo", "helsinki", "oulu", "vantaa" };
+    perf::small_sort(s);
+    ASSERT_EQ((std::vector<std::string>{ "espoo", "helsinki", "oulu", "tampere", "vantaa" }), s);
+
+    std::mt19937_64 rng(1);
+    auto v = random_values<int32_t>(1000, 1000000, rng);
+    auto expected = v;
+    std::sort(begin(expected), end(expected));
+    perf::small_sort(v);
+    ASSERT_EQ(expected, v);
+}
+
+TEST(SortingNetwork, NetworkSizes)
+{
+    ASSERT_EQ(0u, perf::detail::network<1>.size);
+    ASSERT_EQ(1u, perf::detail::network<2>.size);
+    ASSERT_EQ(19u, perf::detail::network<8>.size);
+    ASSERT_EQ(63u, perf::detail::network<16>.size);
+    ASSERT_EQ(191u, perf::detail::network<32>.size);
+}
+
+TEST(SortingNetwork, ZeroOnePrinciple)
+{
+    perf::limit_isa(perf::isa::scalar);
+    ASSERT_TRUE(sorts_all_zero_one_inputs<3>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<5>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<7>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<11>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<13>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<16>());
+    ASSERT_TRUE(sorts_all_zero_one_inputs<19>());
+    perf::limit_isa(perf::isa::avx2);
+}
+
+TEST(SortingNetworkBenchmark, DISABLED_SmallArrays)
+{
+    auto total = bench::size(1 << 24);
+    std::mt19937_64 rng(5);
+    auto input = random_values<int32_t>(total, 1000000, rng);
+    auto floats = random_values<float>(total, 1000000, rng);
+    std::vector<int32_t> v;
+    std::vector<float> f;
+
+    for (size_t n : { 4, 8, 12, 16, 24, 32 }) {
+        size_t arrays = total / n;
+        char name[64];
+        std::snprintf(name, sizeof(name), "std::sort %zu ints", n);
+        bench::report(name, bench::best_of(3, [&] {
+            v = input;
+            for (size_t a = 0; a < arrays; ++a) {
+                std::sort(v.data() + a * n, v.data() + a * n + n);
+            }
+            bench::keep(v[0]);
+        }), arrays * n * sizeof(int32_t));
+        for (auto level : { perf::isa::scalar, perf::isa::avx2 }) {
+            perf::limit_isa(level);
+            std::snprintf(name, sizeof(name), "small_sort %zu ints %s", n, level == perf::isa::avx2 ? "avx2" : "scalar");
+            bench::report(name, bench::best_of(3, [&] {
+                v = input;
+                for (size_t a = 0; a < arrays; ++a) {
+                    perf::small_sort(v.data() + a * n, n);
+                }
+                bench::keep(v[0]);
+            }), arrays * n * sizeof(int32_t));
+        }
+        std::snprintf(name, sizeof(name), "std::sort %zu floats", n);
+        bench::report(name, bench::best_of(3, [&] {
+            f = floats;
+            for (size_t a = 0; a < arrays; ++a) {
+                std::sort(f.data() + a * n, f.data() + a * n + n);
+            }
+            bench::keep(f[0]);
+        }), arrays * n * sizeof(float));
+        std::snprintf(name, sizeof(name), "small_sort %zu floats", n);
+        bench::report(name, bench::best_of(3, [&] {
+            f = floats;
+            for (size_t a = 0; a < arrays; ++a) {
+                perf::small_sort(f.data() + a * n, n);
+            }
+            bench::keep(f[0]);
+        }), arrays * n * sizeof(float));
+    }
+}
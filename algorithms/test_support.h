@@ -0,0 +1,75 @@
+#pragma once
+
+#include "gtest/gtest.h"
+
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Fixtures and inputs shared by the tests
+namespace test_support {
+
+// Runs every test once per instruction set the machine has
+class isa_fixture : public ::testing::TestWithParam<perf::isa> {
+protected:
+    virtual void SetUp() override
+    {
+        perf::limit_isa(GetParam());
+    }
+
+    virtual void TearDown() override
+    {
+        perf::limit_isa(perf::isa::avx2);
+    }
+};
+
+// Runs the parallel algorithms on several threads even on a single core box
+class parallel_fixture : public ::testing::Test {
+protected:
+    virtual void SetUp() override
+    {
+        saved = perf::concurrency();
+        perf::set_concurrency(4);
+    }
+
+    virtual void TearDown() override
+    {
+        perf::set_concurrency(saved);
+    }
+
+private:
+    unsigned saved = 1;
+};
+
+// n ints drawn uniformly from [lo, hi]
+inline std::vector<int> random_ints(size_t n, int lo = -1000, int hi = 1000, unsigned seed = 42)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(lo, hi);
+    std::vector<int> v(n);
+    std::generate(begin(v), end(v), [&] { return dist(rng); });
+    return v;
+}
+
+// n values drawn uniformly from the integers in [-range, range]
+template <typename T>
+std::vector<T> random_values(size_t n, int64_t range, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<int64_t> dist(-range, range);
+    std::vector<T> v(n);
+    std::generate(begin(v), end(v), [&] { return static_cast<T>(dist(rng)); });
+    return v;
+}
+
+template <typename T>
+std::vector<T> random_values(size_t n, int64_t range = 1000000, unsigned seed = 7)
+{
+    std::mt19937_64 rng(seed);
+    return random_values<T>(n, range, rng);
+}
+
+} // namespace test_support
@@ -0,0 +1,325 @@
+#include "thread_pool.h"
+
+#include "parallel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace perf {
+
+namespace {
+
+    // Rounds of failed stealing before an idle worker goes to sleep
+    constexpr int idle_rounds = 64;
+
+    uint64_t xorshift(uint64_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    struct cpu {
+        int node;
+        int id;
+    };
+
+#ifdef __linux__
+    // Parses a sysfs CPU list such as "0-3,8-11"
+    std::vector<int> parse_cpu_list(const char* path)
+    {
+        std::vector<int> cpus;
+        FILE* file = std::fopen(path, "r");
+        if (!file) {
+            return cpus;
+        }
+        int first = 0;
+        while (std::fscanf(file, "%d", &first) == 1) {
+            int last = first;
+            int c = std::fgetc(file);
+            if (c == '-') {
+                if (std::fscanf(file, "%d", &last) != 1) {
+                    break;
+                }
+                c = std::fgetc(file);
+            }
+            for (int i = first; i <= last; ++i) {
+                cpus.push_back(i);
+            }
+            if (c != ',') {
+                break;
+            }
+        }
+        std::fclose(file);
+        return cpus;
+    }
+
+    // The CPUs this process may run on, ordered by NUMA node. Without
+    // NUMA information in sysfs every CPU is on node 0.
+    std::vector<cpu> cpus_by_node()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return {};
+        }
+        std::vector<int> node_of(CPU_SETSIZE, 0);
+        if (DIR* dir = opendir("/sys/devices/system/node")) {
+            while (dirent* entry = readdir(dir)) {
+                int node = 0;
+                if (std::sscanf(entry->d_name, "node%d", &node) != 1) {
+                    continue;
+                }
+                std::string path = std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist";
+                for (int id : parse_cpu_list(path.c_str())) {
+                    if (id < CPU_SETSIZE) {
+                        node_of[id] = node;
+                    }
+                }
+            }
+            closedir(dir);
+        }
+
+        std::vector<cpu> cpus;
+        for (int id = 0; id < CPU_SETSIZE; ++id) {
+            if (CPU_ISSET(id, &allowed)) {
+                cpus.push_back({ node_of[id], id });
+            }
+        }
+        std::stable_sort(cpus.begin(), cpus.end(), [](cpu a, cpu b) { return a.node < b.node; });
+        return cpus;
+    }
+
+    void pin(std::thread& thread, int id)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(id, &set);
+        // Best effort: a thread that cannot be pinned still works
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+#else
+    std::vector<cpu> cpus_by_node()
+    {
+        return {};
+    }
+
+    void pin(std::thread&, int)
+    {
+    }
+#endif
+
+} // namespace
+
+thread_pool::thread_pool(unsigned threads, bool pin_threads)
+{
+    threads = std::max(1u, threads);
+    std::vector<cpu> cpus;
+    if (pin_threads) {
+        cpus = cpus_by_node();
+    }
+    std::vector<int> node(threads, 0);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(new worker);
+        workers[i]->pool = this;
+        workers[i]->random = 0x9e3779b97f4a7c15ull * (i + 1);
+        if (!cpus.empty()) {
+            node[i] = cpus[i % cpus.size()].node;
+        }
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        worker& w = *workers[i];
+        for (unsigned j = 0; j < threads; ++j) {
+            if (j != i && node[j] == node[i]) {
+                w.victims.push_back(workers[j].get());
+            }
+        }
+        w.near = w.victims.size();
+        for (unsigned j = 0; j < threads; ++j) {
+            if (node[j] != node[i]) {
+                w.victims.push_back(workers[j].get());
+            }
+        }
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        worker& w = *workers[i];
+        w.thread = std::thread([this, &w] { work(w); });
+        if (!cpus.empty()) {
+            pin(w.thread, cpus[i % cpus.size()].id);
+        }
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto& w : workers) {
+        w->thread.join();
+    }
+}
+
+thread_pool* thread_pool::current()
+{
+    worker* w = this_worker();
+    return w ? w->pool : nullptr;
+}
+
+void thread_pool::work(worker& self)
+{
+    this_worker() = &self;
+    int idle = 0;
+    for (;;) {
+        if (detail::task* t = find_work(self)) {
+            execute(*t);
+            idle = 0;
+        } else if (++idle < idle_rounds) {
+            std::this_thread::yield();
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                if (stopping) {
+                    return;
+                }
+            }
+            park(self);
+            idle = 0;
+        }
+    }
+}
+
+detail::task* thread_pool::find_work(worker& self)
+{
+    if (detail::task* t = self.tasks.pop()) {
+        return t;
+    }
+    if (injected_count.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        if (!injected.empty()) {
+            detail::task* t = injected.front();
+            injected.pop_front();
+            injected_count.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return steal(self);
+}
+
+// Tries the workers on the same node, then the others, each group from a
+// random starting point
+detail::task* thread_pool::steal(worker& self)
+{
+    size_t groups[][2] = { { 0, self.near }, { self.near, self.victims.size() } };
+    for (auto& group : groups) {
+        size_t n = group[1] - group[0];
+        if (n == 0) {
+            continue;
+        }
+        size_t start = xorshift(self.random) % n;
+        for (size_t i = 0; i < n; ++i) {
+            worker* victim = self.victims[group[0] + (start + i) % n];
+            if (detail::task* t = victim->tasks.steal()) {
+                return t;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void thread_pool::execute(detail::task& t)
+{
+    // t may be gone as soon as it is marked done
+    bool external = t.external;
+    t.execute();
+    t.done.store(true, std::memory_order_release);
+    if (external) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done_cv.notify_all();
+    }
+}
+
+// Waits for a stolen task, running other tasks meanwhile
+void thread_pool::join(worker& self, detail::task& t)
+{
+    while (!t.done.load(std::memory_order_acquire)) {
+        if (detail::task* other = find_work(self)) {
+            execute(*other);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Sleeps until a task is pushed or the pool stops. A push that happens
+// after the last look for work below sees sleepers > 0 and bumps wakeups.
+void thread_pool::park(worker& self)
+{
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = wakeups.load(std::memory_order_seq_cst);
+    if (detail::task* t = find_work(self)) {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        execute(*t);
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(lock, [&] { return stopping || wakeups.load(std::memory_order_relaxed) != epoch; });
+    }
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void thread_pool::wake_one()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+    sleep_cv.notify_one();
+}
+
+// Queues a task of a thread that is not a worker and waits for it
+void thread_pool::submit(detail::task& t)
+{
+    {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        injected.push_back(&t);
+        injected_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        wake_one();
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&] { return t.done.load(std::memory_order_acquire); });
+}
+
+thread_pool& default_pool()
+{
+    if (thread_pool* pool = thread_pool::current()) {
+        return *pool;
+    }
+    static std::mutex mutex;
+    static std::unique_ptr<thread_pool> pool;
+    static bool pinned = false;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pool || pool->size() != concurrency() || pinned != thread_pinning()) {
+        pool.reset();
+        pinned = thread_pinning();
+        pool.reset(new thread_pool(concurrency(), pinned));
+    }
+    return *pool;
+}
+
+} // namespace perf
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A work-stealing thread pool for fork-join parallelism.
+//
+// Every worker has a deque of tasks. fork_join(f, g) pushes g on the
+// bottom of the worker's deque and runs f. Idle workers steal from the
+// top of the other deques, so they take the oldest and largest pieces of
+// work. If nobody stole g meanwhile, the worker pops it back and calls it
+// like a function, which costs a handful of atomic operations.
+// parallel_for splits a range in halves this way down to a grain size.
+//
+// The deques are the lock-free ones of Chase and Lev, with the memory
+// orders of Lê, Pop, Cohen and Zappa Nardelli ("Correct and efficient
+// work-stealing for weak memory models", PPoPP 2013).
+//
+// Workers that find nothing to steal yield for a while and then sleep on
+// a condition variable. Pushing a task wakes one sleeping worker; while
+// all of them are busy, a push only reads a counter.
+//
+// Threads that are not workers of the pool queue their work for it and
+// sleep until it is done.
+//
+// With pin_threads on Linux, the workers are pinned to the CPUs the
+// process may run on, in the order of their NUMA nodes, and steal from
+// workers on their own node before the others.
+namespace perf {
+
+namespace detail {
+
+    struct task {
+        virtual void execute() = 0;
+
+        std::atomic<bool> done{ false };
+        // Queued by a thread that is not a worker and waits to be notified
+        bool external = false;
+
+    protected:
+        ~task() = default;
+    };
+
+    template <class F>
+    struct function_task final : task {
+        explicit function_task(F& f)
+            : f(f)
+        {
+        }
+
+        void execute() override
+        {
+            try {
+                f();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        F& f;
+        std::exception_ptr error;
+    };
+
+    // Chase-Lev deque. Only the owner pushes and pops, at the bottom; any
+    // thread steals from the top. pop and steal return nullptr when the
+    // deque is empty, and steal also when it loses a race for the last
+    // task.
+    class work_deque {
+    public:
+        work_deque()
+            : array(new ring(64))
+        {
+        }
+
+        ~work_deque()
+        {
+            delete array.load(std::memory_order_relaxed);
+        }
+
+        work_deque(const work_deque&) = delete;
+        work_deque& operator=(const work_deque&) = delete;
+
+        void push(task* t)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t0 = top.load(std::memory_order_acquire);
+            ring* a = array.load(std::memory_order_relaxed);
+            if (b - t0 > a->capacity - 1) {
+                a = grow(a, t0, b);
+            }
+            a->at(b).store(t, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        task* pop()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            ring* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t0 = top.load(std::memory_order_relaxed);
+            if (t0 > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            task* x = a->at(b).load(std::memory_order_relaxed);
+            if (t0 == b) {
+                // The last task, thieves may be after it too
+                if (!top.compare_exchange_strong(t0, t0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    x = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return x;
+        }
+
+        task* steal()
+        {
+            int64_t t0 = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t0 >= b) {
+                return nullptr;
+            }
+            ring* a = array.load(std::memory_order_acquire);
+            task* x = a->at(t0).load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t0, t0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return x;
+        }
+
+        bool empty() const
+        {
+            return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct ring {
+            explicit ring(int64_t capacity)
+                : capacity(capacity)
+                , slots(new std::atomic<task*>[capacity])
+            {
+            }
+
+            std::atomic<task*>& at(int64_t i) { return slots[i & (capacity - 1)]; }
+
+            int64_t capacity;
+            std::unique_ptr<std::atomic<task*>[]> slots;
+        };
+
+        // Thieves may still read the old ring, so it is kept until the
+        // deque goes away
+        ring* grow(ring* a, int64_t t0, int64_t b)
+        {
+            ring* bigger = new ring(a->capacity * 2);
+            for (int64_t i = t0; i < b; ++i) {
+                bigger->at(i).store(a->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            retired.emplace_back(a);
+            array.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+        // top and bottom on different cache lines
+        std::atomic<int64_t> top{ 0 };
+        char top_padding[64];
+        std::atomic<int64_t> bottom{ 0 };
+        char bottom_padding[64];
+        std::atomic<ring*> array;
+        std::vector<std::unique_ptr<ring>> retired;
+    };
+
+} // namespace detail
+
+class thread_pool {
+public:
+    explicit thread_pool(unsigned threads, bool pin_threads = false);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Runs f() on a worker and returns when it is done. On a worker of this
+    // pool it just calls f.
+    template <class F>
+    void run(F&& f);
+
+    // Calls f() and g(), maybe at the same time, and returns when both are
+    // done. An exception from f is rethrown, otherwise one from g.
+    template <class F, class G>
+    void fork_join(F&& f, G&& g);
+
+    // Calls f(begin, end) for pieces of [first, last) of at most `grain`
+    // elements, at the same time on as many workers as there are pieces
+    template <class F>
+    void parallel_for(size_t first, size_t last, size_t grain, F&& f);
+
+    // The pool whose worker the calling thread is, nullptr if none
+    static thread_pool* current();
+
+private:
+    struct worker {
+        detail::work_deque tasks;
+        thread_pool* pool = nullptr;
+        // Workers to steal from, the ones on the same NUMA node first
+        std::vector<worker*> victims;
+        size_t near = 0;
+        uint64_t random = 0;
+        std::thread thread;
+    };
+
+    static worker*& this_worker()
+    {
+        static thread_local worker* w = nullptr;
+        return w;
+    }
+
+    worker* own_worker() const
+    {
+        worker* w = this_worker();
+        return w && w->pool == this ? w : nullptr;
+    }
+
+    template <class F>
+    void split(size_t first, size_t last, size_t grain, F& f);
+
+    void work(worker& self);
+    detail::task* find_work(worker& self);
+    detail::task* steal(worker& self);
+    void execute(detail::task& t);
+    void join(worker& self, detail::task& t);
+    void park(worker& self);
+    void wake_one();
+    void submit(detail::task& t);
+
+    std::vector<std::unique_ptr<worker>> workers;
+
+    // Tasks from threads that are not workers
+    std::mutex injected_mutex;
+    std::deque<detail::task*> injected;
+    std::atomic<size_t> injected_count{ 0 };
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<unsigned> sleepers{ 0 };
+    std::atomic<uint64_t> wakeups{ 0 };
+    bool stopping = false;
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+};
+
+template <class F>
+void thread_pool::run(F&& f)
+{
+    if (own_worker()) {
+        f();
+        return;
+    }
+    detail::function_task<F> root(f);
+    root.external = true;
+    submit(root);
+    if (root.error) {
+        std::rethrow_exception(root.error);
+    }
+}
+
+template <class F, class G>
+void thread_pool::fork_join(F&& f, G&& g)
+{
+    worker* self = own_worker();
+    if (!self) {
+        run([&] { fork_join(f, g); });
+        return;
+    }
+
+    detail::function_task<G> right(g);
+    self->tasks.push(&right);
+    // Pairs with the fence in park: either a worker going to sleep sees
+    // the task, or this sees the worker
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        wake_one();
+    }
+
+    std::exception_ptr error;
+    try {
+        f();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (self->tasks.pop() == &right) {
+        right.execute();
+    } else {
+        join(*self, right);
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (right.error) {
+        std::rethrow_exception(right.error);
+    }
+}
+
+template <class F>
+void thread_pool::split(size_t first, size_t last, size_t grain, F& f)
+{
+    if (last - first <= grain) {
+        f(first, last);
+        return;
+    }
+    size_t middle = first + (last - first) / 2;
+    fork_join([&] { split(first, middle, grain, f); }, [&] { split(middle, last, grain, f); });
+}
+
+template <class F>
+void thread_pool::parallel_for(size_t first, size_t last, size_t grain, F&& f)
+{
+    grain = std::max<size_t>(1, grain);
+    if (last <= first) {
+        return;
+    }
+    if (last - first <= grain) {
+        f(first, last);
+        return;
+    }
+    run([&] { split(first, last, grain, f); });
+}
+
+// The pool the parallel algorithms run on: concurrency() workers, pinned
+// if thread_pinning() is on. It is replaced when either setting changes,
+// so they must not change while parallel algorithms run. On a worker of a
+// pool, that pool.
+thread_pool& default_pool();
+
+} // namespace perf
@@ -0,0 +1,287 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "parallel.h"
+#include "partition.h"
+#include "test_support.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using test_support::random_ints;
+
+bool is_even(int x)
+{
+    return x % 2 == 0;
+}
+
+uint64_t fib(perf::thread_pool& pool, unsigned n)
+{
+    if (n < 2) {
+        return n;
+    }
+    uint64_t a = 0;
+    uint64_t b = 0;
+    pool.fork_join([&] { a = fib(pool, n - 1); }, [&] { b = fib(pool, n - 2); });
+    return a + b;
+}
+
+uint64_t fib(unsigned n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+class ParallelThreadPool : public test_support::parallel_fixture {
+};
+
+} // namespace
+
+TEST(WorkDeque, PopsNewestAndStealsOldest)
+{
+    struct noop : perf::detail::task {
+        void execute() override {}
+    };
+    std::vector<noop> tasks(1000);
+    perf::detail::work_deque deque;
+
+    ASSERT_EQ(nullptr, deque.pop());
+    ASSERT_EQ(nullptr, deque.steal());
+    for (auto& t : tasks) {
+        deque.push(&t);
+    }
+    ASSERT_EQ(&tasks[0], deque.steal());
+    ASSERT_EQ(&tasks[999], deque.pop());
+    ASSERT_EQ(&tasks[1], deque.steal());
+    for (size_t i = 998; i >= 2; --i) {
+        ASSERT_EQ(&tasks[i], deque.pop());
+    }
+    ASSERT_TRUE(deque.empty());
+    ASSERT_EQ(nullptr, deque.pop());
+}
+
+TEST(WorkDeque, EveryTaskIsTakenOnceUnderContention)
+{
+    struct noop : perf::detail::task {
+        void execute() override {}
+    };
+    const size_t n = 200000;
+    std::vector<noop> tasks(n);
+    std::vector<std::atomic<int>> taken(n);
+    for (auto& t : taken) {
+        t = 0;
+    }
+    perf::detail::work_deque deque;
+    std::atomic<bool> finished{ false };
+    auto mark = [&](perf::detail::task* t) { ++taken[static_cast<noop*>(t) - tasks.data()]; };
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&] {
+            while (!finished.load()) {
+                if (auto t = deque.steal()) {
+                    mark(t);
+                }
+            }
+        });
+    }
+    // Bursts of pushes, popping half of each burst back
+    for (size_t i = 0; i < n; i += 100) {
+        for (size_t j = i; j < i + 100; ++j) {
+            deque.push(&tasks[j]);
+        }
+        for (int j = 0; j < 50; ++j) {
+            if (auto t = deque.pop()) {
+                mark(t);
+            }
+        }
+    }
+    while (auto t = deque.pop()) {
+        mark(t);
+    }
+    finished = true;
+    for (auto& t : thieves) {
+        t.join();
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        ASSERT_EQ(1, taken[i].load()) << i;
+    }
+}
+
+TEST(ThreadPool, ForkJoinComputesFibonacci)
+{
+    perf::thread_pool pool(4);
+
+    ASSERT_EQ(fib(22), fib(pool, 22));
+}
+
+TEST(ThreadPool, ParallelForCoversEveryIndexOnce)
+{
+    perf::thread_pool pool(4);
+    std::vector<std::atomic<int>> hits(100003);
+    for (auto& h : hits) {
+        h = 0;
+    }
+    std::atomic<size_t> pieces{ 0 };
+
+    pool.parallel_for(0, hits.size(), 1000, [&](size_t begin, size_t end) {
+        ASSERT_LE(end - begin, 1000u);
+        ++pieces;
+        for (size_t i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+    });
+
+    for (auto& h : hits) {
+        ASSERT_EQ(1, h.load());
+    }
+    ASSERT_EQ(128u, pieces.load());
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+    perf::thread_pool pool(3);
+    std::vector<uint64_t> sums(50);
+
+    pool.parallel_for(0, sums.size(), 1, [&](size_t begin, size_t end) {
+        ASSERT_EQ(&pool, perf::thread_pool::current());
+        for (size_t i = begin; i < end; ++i) {
+            std::atomic<uint64_t> sum{ 0 };
+            pool.parallel_for(0, 1000 * i, 100, [&](size_t b, size_t e) {
+                uint64_t s = 0;
+                for (size_t j = b; j < e; ++j) {
+                    s += j;
+                }
+                sum += s;
+            });
+            sums[i] = sum;
+        }
+    });
+
+    for (size_t i = 0; i < sums.size(); ++i) {
+        uint64_t n = 1000 * i;
+        ASSERT_EQ(n * (n - (n > 0)) / 2, sums[i]) << i;
+    }
+    ASSERT_EQ(nullptr, perf::thread_pool::current());
+}
+
+TEST_F(ParallelThreadPool, NestedParallelAlgorithms)
+{
+    // Every task partitions in parallel, and a worker waiting for its
+    // blocks runs another task's partition on the same thread
+    std::vector<std::vector<int>> inputs;
+    for (unsigned i = 0; i < 32; ++i) {
+        inputs.push_back(random_ints(300000, -1000, 1000, i));
+    }
+    auto outputs = inputs;
+
+    perf::default_pool().parallel_for(0, outputs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            perf::parallel_stable_partition(outputs[i], is_even);
+        }
+    });
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::stable_partition(begin(inputs[i]), end(inputs[i]), is_even);
+        ASSERT_EQ(inputs[i], outputs[i]) << i;
+    }
+}
+
+TEST(ThreadPool, RethrowsExceptions)
+{
+    perf::thread_pool pool(4);
+
+    ASSERT_THROW(pool.fork_join([] { throw std::runtime_error("f"); }, [] {}), std::runtime_error);
+    ASSERT_THROW(pool.fork_join([] {}, [] { throw std::logic_error("g"); }), std::logic_error);
+    ASSERT_THROW(pool.parallel_for(0, 1000, 10, [](size_t begin, size_t) {
+        if (begin == 500) {
+            throw std::out_of_range("piece");
+        }
+    }),
+        std::out_of_range);
+    ASSERT_EQ(fib(15), fib(pool, 15));
+}
+
+TEST(ThreadPool, ServesSeveralOutsideThreads)
+{
+    perf::thread_pool pool(2);
+    std::vector<uint64_t> results(6);
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < results.size(); ++i) {
+        clients.emplace_back([&, i] { results[i] = fib(pool, 12 + i); });
+    }
+    for (auto& c : clients) {
+        c.join();
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(fib(12 + i), results[i]);
+    }
+}
+
+TEST(ThreadPool, WakesSleepingWorkers)
+{
+    perf::thread_pool pool(4);
+    ASSERT_EQ(fib(12), fib(pool, 12));
+
+    // Long enough for every worker to go to sleep
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::atomic<int> pieces{ 0 };
+    pool.parallel_for(0, 64, 1, [&](size_t, size_t) { ++pieces; });
+    ASSERT_EQ(64, pieces.load());
+}
+
+TEST(ThreadPool, PinnedWorkers)
+{
+    perf::thread_pool pool(3, true);
+
+    ASSERT_EQ(3u, pool.size());
+    ASSERT_EQ(fib(18), fib(pool, 18));
+}
+
+TEST_F(ParallelThreadPool, DefaultPoolFollowsConcurrency)
+{
+    ASSERT_EQ(4u, perf::default_pool().size());
+    perf::set_concurrency(2);
+    ASSERT_EQ(2u, perf::default_pool().size());
+
+    std::vector<int> seen(8, 0);
+    perf::parallel_for_each_block(perf::block_partition(8000, 1000), [&](size_t b, size_t begin, size_t end) {
+        ASSERT_EQ(perf::thread_pool::current(), &perf::default_pool());
+        seen[b] = static_cast<int>(end - begin);
+    });
+    ASSERT_EQ(std::vector<int>(2, 4000), std::vector<int>(seen.begin(), seen.begin() + 2));
+}
+
+TEST(ThreadPoolBenchmark, DISABLED_ForkJoin)
+{
+    perf::thread_pool pool(perf::concurrency());
+    unsigned n = static_cast<unsigned>(bench::size(30));
+    uint64_t tasks = 2 * fib(n + 1) - 1;
+
+    double forked = bench::best_of(3, [&] { bench::keep(fib(pool, n)); });
+    std::printf("fib(%u) on %u workers, %llu calls\n", n, pool.size(), static_cast<unsigned long long>(tasks));
+    std::printf("%-40s %10.3f ms %8.2f ns/call\n", "fork_join", forked * 1e3, forked / tasks * 1e9);
+
+    std::vector<int> v(1 << 26, 1);
+    bench::report("parallel_for sum", bench::best_of(5, [&] {
+        std::atomic<int64_t> sum{ 0 };
+        pool.parallel_for(0, v.size(), 1 << 16, [&](size_t begin, size_t end) {
+            sum += std::accumulate(v.begin() + begin, v.begin() + end, int64_t(0));
+        });
+        bench::keep(sum);
+    }), v.size() * sizeof(int));
+    double empty = bench::best_of(5, [&] {
+        pool.parallel_for(0, 10000, 1, [](size_t, size_t) {});
+    });
+    std::printf("%-40s %10.3f ms %8.2f ns/piece\n", "parallel_for 10000 empty pieces", empty * 1e3, empty / 10000 * 1e9);
+}
@@ -0,0 +1,543 @@
+#pragma once
+
+#include "execution.h"
+#include "extremes.h"
+#include "parallel.h"
+#include "partition.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// Selecting the k largest elements of a stream, and parallel nth_element
+// and partial_sort for arrays.
+//
+// top_k keeps the best k elements seen so far in a heap whose root is the
+// worst of them, the threshold a new element has to beat. Once k elements
+// are in, almost everything in a long stream loses to the threshold, so
+// the batch push compares whole vectors of elements against it with SIMD
+// and only looks at the ones that win. That is for int32_t, int64_t,
+// float and double with std::less (the largest) or std::greater (the
+// smallest); other types and orders go through the heap one by one. NaNs
+// are skipped.
+//
+// Partial results of several threads combine with merge, which is what
+// parallel_top_k does with one top_k per block.
+//
+// parallel_nth_element narrows the range around the nth position with
+// two splitters taken from a sorted random sample, a few ranks either
+// side of where the nth element should be in it. One parallel pass counts
+// the elements below, between and above the splitters in every block and
+// a second one moves them to their part through a scratch buffer. The
+// part holding position nth, usually a small fraction of the range, is
+// narrowed again until it fits in a few blocks, and std::nth_element
+// finishes it. On one thread the range goes to std::nth_element at once.
+// The parallel passes copy elements, so they are used for trivially
+// copyable, default constructible types only; others go to
+// std::nth_element.
+namespace perf {
+
+namespace detail {
+
+    // Lane masks of the elements greater and less than a threshold
+    template <typename T>
+    struct threshold_lanes {
+        static constexpr bool has_sse2 = false;
+        static constexpr bool has_avx2 = false;
+    };
+
+#if PERF_X86
+    template <>
+    struct threshold_lanes<int32_t> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        struct sse2 {
+            using vec = __m128i;
+            static constexpr size_t width = 4;
+            static vec set1(int32_t t) { return _mm_set1_epi32(t); }
+            static vec load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static unsigned above(vec x, vec t) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, t))); }
+            static unsigned below(vec x, vec t) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, t))); }
+        };
+
+        struct avx2 {
+            using vec = __m256i;
+            static constexpr size_t width = 8;
+            PERF_AVX2 static vec set1(int32_t t) { return _mm256_set1_epi32(t); }
+            PERF_AVX2 static vec load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            PERF_AVX2 static unsigned above(vec x, vec t) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, t))); }
+            PERF_AVX2 static unsigned below(vec x, vec t) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t, x))); }
+        };
+    };
+
+    // 64-bit comparisons arrived with SSE4.2
+    template <>
+    struct threshold_lanes<int64_t> {
+        static constexpr bool has_sse2 = false;
+        static constexpr bool has_avx2 = true;
+
+        struct avx2 {
+            using vec = __m256i;
+            static constexpr size_t width = 4;
+            PERF_AVX2 static vec set1(int64_t t) { return _mm256_set1_epi64x(t); }
+            PERF_AVX2 static vec load(const int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            PERF_AVX2 static unsigned above(vec x, vec t) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, t))); }
+            PERF_AVX2 static unsigned below(vec x, vec t) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, x))); }
+        };
+    };
+
+    // Ordered comparisons are false for NaN, so NaNs never pass
+    template <>
+    struct threshold_lanes<float> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        struct sse2 {
+            using vec = __m128;
+            static constexpr size_t width = 4;
+            static vec set1(float t) { return _mm_set1_ps(t); }
+            static vec load(const float* p) { return _mm_loadu_ps(p); }
+            static unsigned above(vec x, vec t) { return _mm_movemask_ps(_mm_cmpgt_ps(x, t)); }
+            static unsigned below(vec x, vec t) { return _mm_movemask_ps(_mm_cmplt_ps(x, t)); }
+        };
+
+        struct avx2 {
+            using vec = __m256;
+            static constexpr size_t width = 8;
+            PERF_AVX2 static vec set1(float t) { return _mm256_set1_ps(t); }
+            PERF_AVX2 static vec load(const float* p) { return _mm256_loadu_ps(p); }
+            PERF_AVX2 static unsigned above(vec x, vec t) { return _mm256_movemask_ps(_mm256_cmp_ps(x, t, _CMP_GT_OQ)); }
+            PERF_AVX2 static unsigned below(vec x, vec t) { return _mm256_movemask_ps(_mm256_cmp_ps(x, t, _CMP_LT_OQ)); }
+        };
+    };
+
+    template <>
+    struct threshold_lanes<double> {
+        static constexpr bool has_sse2 = true;
+        static constexpr bool has_avx2 = true;
+
+        struct sse2 {
+            using vec = __m128d;
+            static constexpr size_t width = 2;
+            static vec set1(double t) { return _mm_set1_pd(t); }
+            static vec load(const double* p) { return _mm_loadu_pd(p); }
+            static unsigned above(vec x, vec t) { return _mm_movemask_pd(_mm_cmpgt_pd(x, t)); }
+            static unsigned below(vec x, vec t) { return _mm_movemask_pd(_mm_cmplt_pd(x, t)); }
+        };
+
+        struct avx2 {
+            using vec = __m256d;
+            static constexpr size_t width = 4;
+            PERF_AVX2 static vec set1(double t) { return _mm256_set1_pd(t); }
+            PERF_AVX2 static vec load(const double* p) { return _mm256_loadu_pd(p); }
+            PERF_AVX2 static unsigned above(vec x, vec t) { return _mm256_movemask_pd(_mm256_cmp_pd(x, t, _CMP_GT_OQ)); }
+            PERF_AVX2 static unsigned below(vec x, vec t) { return _mm256_movemask_pd(_mm256_cmp_pd(x, t, _CMP_LT_OQ)); }
+        };
+    };
+#endif
+
+    // 1 when Compare keeps the largest elements, -1 the smallest, 0 when
+    // it is not known
+    template <typename T, typename Compare>
+    struct threshold_order : std::integral_constant<int, 0> {
+    };
+
+    template <typename T>
+    struct threshold_order<T, std::less<T>> : std::integral_constant<int, 1> {
+    };
+
+    template <typename T>
+    struct threshold_order<T, std::less<>> : std::integral_constant<int, 1> {
+    };
+
+    template <typename T>
+    struct threshold_order<T, std::greater<T>> : std::integral_constant<int, -1> {
+    };
+
+    template <typename T>
+    struct threshold_order<T, std::greater<>> : std::integral_constant<int, -1> {
+    };
+
+#if PERF_X86
+    // Pushes the elements of v[0, n) that beat the threshold to heap, two
+    // vectors at a time, and returns how many elements it looked at. The
+    // threshold is loaded again after the vectors with hits.
+    template <bool Smallest, typename T, typename Heap>
+    size_t prefilter_sse2(const T* v, size_t n, Heap& heap, std::true_type)
+    {
+        using L = typename threshold_lanes<T>::sse2;
+        constexpr size_t w = L::width;
+        auto t = L::set1(heap.threshold());
+        size_t i = 0;
+        for (; i + 2 * w <= n; i += 2 * w) {
+            auto x0 = L::load(v + i);
+            auto x1 = L::load(v + i + w);
+            unsigned hits = Smallest ? L::below(x0, t) | L::below(x1, t) << w : L::above(x0, t) | L::above(x1, t) << w;
+            if (hits == 0) {
+                continue;
+            }
+            do {
+                heap.push(v[i + __builtin_ctz(hits)]);
+                hits &= hits - 1;
+            } while (hits);
+            t = L::set1(heap.threshold());
+        }
+        return i;
+    }
+
+    template <bool Smallest, typename T, typename Heap>
+    size_t prefilter_sse2(const T*, size_t, Heap&, std::false_type)
+    {
+        return 0;
+    }
+
+    template <bool Smallest, typename T, typename Heap>
+    PERF_AVX2 size_t prefilter_avx2(const T* v, size_t n, Heap& heap, std::true_type)
+    {
+        using L = typename threshold_lanes<T>::avx2;
+        constexpr size_t w = L::width;
+        auto t = L::set1(heap.threshold());
+        size_t i = 0;
+        for (; i + 2 * w <= n; i += 2 * w) {
+            auto x0 = L::load(v + i);
+            auto x1 = L::load(v + i + w);
+            unsigned hits = Smallest ? L::below(x0, t) | L::below(x1, t) << w : L::above(x0, t) | L::above(x1, t) << w;
+            if (hits == 0) {
+                continue;
+            }
+            do {
+                heap.push(v[i + __builtin_ctz(hits)]);
+                hits &= hits - 1;
+            } while (hits);
+            t = L::set1(heap.threshold());
+        }
+        return i;
+    }
+
+    template <bool Smallest, typename T, typename Heap>
+    size_t prefilter_avx2(const T* v, size_t n, Heap& heap, std::false_type)
+    {
+        return prefilter_sse2<Smallest>(v, n, heap, std::integral_constant<bool, threshold_lanes<T>::has_sse2>());
+    }
+#endif
+
+    // How many elements of v[0, n) the SIMD prefilter took care of
+    template <int Order, typename T, typename Heap>
+    size_t prefilter(const T* v, size_t n, Heap& heap, std::true_type)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return prefilter_avx2<(Order < 0)>(v, n, heap, std::integral_constant<bool, threshold_lanes<T>::has_avx2>());
+        case isa::sse2:
+            return prefilter_sse2<(Order < 0)>(v, n, heap, std::integral_constant<bool, threshold_lanes<T>::has_sse2>());
+        case isa::scalar:
+            break;
+        }
+#endif
+        return 0;
+    }
+
+    template <int Order, typename T, typename Heap>
+    size_t prefilter(const T*, size_t, Heap&, std::false_type)
+    {
+        return 0;
+    }
+
+    constexpr size_t top_k_grain = 1 << 18;
+    constexpr size_t select_grain = 1 << 16;
+
+} // namespace detail
+
+// The k best elements of everything pushed so far: the largest with the
+// default std::less, the smallest with std::greater
+template <typename T, typename Compare = std::less<T>>
+class top_k {
+public:
+    explicit top_k(size_t k, Compare comp = Compare())
+        : limit(k)
+        , comp(comp)
+    {
+    }
+
+    size_t k() const { return limit; }
+    size_t size() const { return heap.size(); }
+    bool full() const { return heap.size() == limit; }
+
+    // The worst element kept, the one a new element has to beat once
+    // full(). size() must not be 0.
+    const T& threshold() const { return heap.front(); }
+
+    void push(const T& x)
+    {
+        if (detail::is_nan(x)) {
+            return;
+        }
+        if (heap.size() < limit) {
+            heap.push_back(x);
+            std::push_heap(heap.begin(), heap.end(), worse());
+        } else if (limit > 0 && comp(heap.front(), x)) {
+            replace_threshold(x);
+        }
+    }
+
+    void push(const T* v, size_t n)
+    {
+        size_t i = 0;
+        while (i < n && !full()) {
+            push(v[i++]);
+        }
+        if (full() && limit > 0) {
+            using order = detail::threshold_order<T, Compare>;
+            using simd = std::integral_constant<bool, order::value != 0>;
+            i += detail::prefilter<order::value>(v + i, n - i, *this, simd());
+            for (; i < n; ++i) {
+                if (comp(heap.front(), v[i]) && !detail::is_nan(v[i])) {
+                    replace_threshold(v[i]);
+                }
+            }
+        }
+    }
+
+    void push(const std::vector<T>& v)
+    {
+        push(v.data(), v.size());
+    }
+
+    // Adds the elements kept by other, a top_k of another part of the stream
+    void merge(const top_k& other)
+    {
+        push(other.heap.data(), other.heap.size());
+    }
+
+    // The kept elements, best first
+    std::vector<T> sorted() const
+    {
+        std::vector<T> result(heap);
+        std::sort(result.begin(), result.end(), worse());
+        return result;
+    }
+
+    void clear()
+    {
+        heap.clear();
+    }
+
+private:
+    // The heap order: the root is the worst element
+    struct worse_than {
+        bool operator()(const T& a, const T& b) const { return comp(b, a); }
+        const Compare& comp;
+    };
+
+    worse_than worse() const { return worse_than{ comp }; }
+
+    // Sifts x down from the root in place of the threshold
+    void replace_threshold(const T& x)
+    {
+        size_t n = heap.size();
+        size_t i = 0;
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && comp(heap[child + 1], heap[child])) {
+                ++child;
+            }
+            if (!comp(heap[child], x)) {
+                break;
+            }
+            heap[i] = std::move(heap[child]);
+            i = child;
+        }
+        heap[i] = x;
+    }
+
+    size_t limit;
+    Compare comp;
+    std::vector<T> heap;
+};
+
+// The k best elements of v[0, n), best first. Every block of at least
+// `grain` elements is selected on its own thread and the results merged.
+template <typename T, typename Compare = std::less<T>>
+std::vector<T> parallel_top_k(const T* v, size_t n, size_t k, Compare comp = Compare(), size_t grain = detail::top_k_grain)
+{
+    block_partition blocks(n, grain);
+    std::vector<top_k<T, Compare>> partial(blocks.count, top_k<T, Compare>(k, comp));
+    parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+        partial[b].push(v + begin, end - begin);
+    });
+    for (size_t b = 1; b < blocks.count; ++b) {
+        partial[0].merge(partial[b]);
+    }
+    return partial[0].sorted();
+}
+
+template <typename T, typename Compare = std::less<T>>
+std::vector<T> parallel_top_k(const std::vector<T>& v, size_t k, Compare comp = Compare())
+{
+    return parallel_top_k(v.data(), v.size(), k, comp);
+}
+
+namespace detail {
+
+    struct three_way_counts {
+        size_t below, between, above;
+    };
+
+    inline uint64_t select_random(uint64_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Rearranges v[0, n) like std::nth_element
+    template <typename T, typename Compare>
+    void parallel_nth_element(T* v, size_t n, size_t nth, Compare& comp, size_t grain, std::true_type)
+    {
+        constexpr size_t sample_size = 8192;
+        // About four standard deviations of the rank of nth in the sample
+        constexpr size_t margin = 192;
+
+        // Shared with stable_partition, and let go of after the call
+        thread_scratch<T> held;
+        std::vector<T>& scratch = held.get();
+        std::vector<T> sample(sample_size);
+        uint64_t random = 0x9e3779b97f4a7c15ull;
+        size_t first = 0;
+        size_t last = n;
+        while (last - first > 2 * grain && concurrency() > 1) {
+            T* w = v + first;
+            size_t m = last - first;
+            size_t k = nth - first;
+            for (auto& x : sample) {
+                x = w[select_random(random) % m];
+            }
+            std::sort(sample.begin(), sample.end(), comp);
+            size_t r = k * sample_size / m;
+            bool has_low = r >= margin;
+            bool has_high = r + margin < sample_size;
+            T low = sample[has_low ? r - margin : 0];
+            T high = sample[has_high ? r + margin : sample_size - 1];
+            // 0 below low, 1 between, 2 above high
+            auto part = [&](const T& x) { return has_low && comp(x, low) ? 0 : has_high && comp(high, x) ? 2 : 1; };
+
+            block_partition blocks(m, grain);
+            std::vector<three_way_counts> counts(blocks.count);
+            parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+                size_t c[3] = {};
+                for (size_t i = begin; i < end; ++i) {
+                    ++c[part(w[i])];
+                }
+                counts[b] = { c[0], c[1], c[2] };
+            });
+            three_way_counts total{ 0, 0, 0 };
+            for (auto& c : counts) {
+                total.below += c.below;
+                total.between += c.between;
+                total.above += c.above;
+            }
+
+            if (scratch.size() < m) {
+                scratch.resize(m);
+            }
+            std::vector<three_way_counts> offsets(blocks.count);
+            three_way_counts next{ 0, total.below, total.below + total.between };
+            for (size_t b = 0; b < blocks.count; ++b) {
+                offsets[b] = next;
+                next.below += counts[b].below;
+                next.between += counts[b].between;
+                next.above += counts[b].above;
+            }
+            T* out = scratch.data();
+            parallel_for_each_block(blocks, [&](size_t b, size_t begin, size_t end) {
+                size_t at[3] = { offsets[b].below, offsets[b].between, offsets[b].above };
+                for (size_t i = begin; i < end; ++i) {
+                    out[at[part(w[i])]++] = w[i];
+                }
+            });
+            parallel_for_each_block(blocks, [&](size_t, size_t begin, size_t end) {
+                std::copy(out + begin, out + end, w + begin);
+            });
+
+            size_t new_first = first;
+            size_t new_last = last;
+            if (k < total.below) {
+                new_last = first + total.below;
+            } else if (k < total.below + total.between) {
+                new_first = first + total.below;
+                new_last = first + total.below + total.between;
+                // All between elements are equivalent
+                if (has_low && has_high && !comp(low, high)) {
+                    return;
+                }
+            } else {
+                new_first = first + total.below + total.between;
+            }
+            if (new_last - new_first == m) {
+                break;
+            }
+            first = new_first;
+            last = new_last;
+        }
+        std::nth_element(v + first, v + nth, v + last, comp);
+    }
+
+    template <typename T, typename Compare>
+    void parallel_nth_element(T* v, size_t n, size_t nth, Compare& comp, size_t, std::false_type)
+    {
+        std::nth_element(v, v + nth, v + n, comp);
+    }
+
+} // namespace detail
+
+// Rearranges v[0, n) so that v[nth] is the element that would be there
+// if v were sorted, with no element of v[0, nth) after it and none of
+// v[nth + 1, n) before it, as with std::nth_element. Does nothing when
+// nth >= n.
+template <typename T, typename Compare = std::less<T>>
+void parallel_nth_element(T* v, size_t n, size_t nth, Compare comp = Compare(), size_t grain = detail::select_grain)
+{
+    if (nth >= n) {
+        return;
+    }
+    using copyable = std::integral_constant<bool, std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value>;
+    detail::parallel_nth_element(v, n, nth, comp, std::max<size_t>(1, grain), copyable());
+}
+
+template <typename T, typename Compare = std::less<T>>
+void parallel_nth_element(std::vector<T>& v, size_t nth, Compare comp = Compare())
+{
+    parallel_nth_element(v.data(), v.size(), nth, comp);
+}
+
+// Puts the `middle` smallest elements of v[0, n) in order at its start,
+// as with std::partial_sort. The rest are left in no particular order.
+template <typename T, typename Compare = std::less<T>>
+void parallel_partial_sort(T* v, size_t n, size_t middle, Compare comp = Compare(), size_t grain = detail::select_grain)
+{
+    middle = std::min(middle, n);
+    if (middle == 0) {
+        return;
+    }
+    parallel_nth_element(v, n, middle - 1, comp, grain);
+    perf::sort(execution::par, v, v + middle - 1, comp);
+}
+
+template <typename T, typename Compare = std::less<T>>
+void parallel_partial_sort(std::vector<T>& v, size_t middle, Compare comp = Compare())
+{
+    parallel_partial_sort(v.data(), v.size(), middle, comp);
+}
+
+} // namespace perf
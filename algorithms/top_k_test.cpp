@@ -0,0 +1,324 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "test_support.h"
+#include "top_k.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using test_support::random_values;
+
+// The k largest by comp, best first
+template <typename T, typename Compare = std::less<T>>
+std::vector<T> expected_top(std::vector<T> v, size_t k, Compare comp = Compare())
+{
+    std::sort(begin(v), end(v), [&](const T& a, const T& b) { return comp(b, a); });
+    v.resize(std::min(k, v.size()));
+    return v;
+}
+
+struct record {
+    double score;
+    int id;
+};
+
+class TopK : public test_support::isa_fixture {
+};
+
+template <typename T>
+void expect_top_like_sort(const std::vector<T>& v, size_t k)
+{
+    perf::top_k<T> largest(k);
+    largest.push(v);
+    ASSERT_EQ(expected_top(v, k), largest.sorted()) << k;
+
+    perf::top_k<T, std::greater<>> smallest(k);
+    smallest.push(v);
+    ASSERT_EQ(expected_top(v, k, std::greater<>()), smallest.sorted()) << k;
+}
+
+class ParallelSelection : public test_support::parallel_fixture {
+};
+
+template <typename T, typename Compare = std::less<T>>
+void expect_nth_element(std::vector<T> v, size_t nth, Compare comp = Compare())
+{
+    auto sorted = v;
+    std::sort(begin(sorted), end(sorted), comp);
+    auto multiset = sorted;
+
+    perf::parallel_nth_element(v.data(), v.size(), nth, comp, 1000);
+
+    ASSERT_FALSE(comp(v[nth], sorted[nth]) || comp(sorted[nth], v[nth])) << nth;
+    for (size_t i = 0; i < nth; ++i) {
+        ASSERT_FALSE(comp(v[nth], v[i])) << i;
+    }
+    for (size_t i = nth + 1; i < v.size(); ++i) {
+        ASSERT_FALSE(comp(v[i], v[nth])) << i;
+    }
+    std::sort(begin(v), end(v), comp);
+    ASSERT_EQ(multiset, v);
+}
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, TopK,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(TopK, FindThreeLargest)
+{
+    std::vector<int> v{ 1, 6, 3, 8, 2, 0, 7 };
+
+    perf::top_k<int> top(3);
+    top.push(v);
+
+    ASSERT_EQ((std::vector<int>{ 8, 7, 6 }), top.sorted());
+    ASSERT_EQ(6, top.threshold());
+    ASSERT_TRUE(top.full());
+}
+
+TEST_P(TopK, MatchesSortForAllTypes)
+{
+    for (size_t k : { 1, 10, 1000 }) {
+        expect_top_like_sort(random_values<int32_t>(100003), k);
+        expect_top_like_sort(random_values<int64_t>(100003), k);
+        expect_top_like_sort(random_values<float>(100003), k);
+        expect_top_like_sort(random_values<double>(100003), k);
+        expect_top_like_sort(random_values<int16_t>(100003, 30000), k);
+    }
+}
+
+TEST_P(TopK, AscendingInputReplacesTheThresholdEveryTime)
+{
+    std::vector<int32_t> v(50000);
+    std::iota(begin(v), end(v), -25000);
+
+    expect_top_like_sort(v, 100);
+    std::reverse(begin(v), end(v));
+    expect_top_like_sort(v, 100);
+}
+
+TEST_P(TopK, Duplicates)
+{
+    auto v = random_values<int32_t>(100000, 5);
+
+    expect_top_like_sort(v, 7);
+    expect_top_like_sort(v, 40000);
+}
+
+TEST_P(TopK, FewerElementsThanK)
+{
+    std::vector<double> v{ 3, 1, 2 };
+
+    perf::top_k<double> top(10);
+    top.push(v);
+
+    ASSERT_EQ(3u, top.size());
+    ASSERT_FALSE(top.full());
+    ASSERT_EQ((std::vector<double>{ 3, 2, 1 }), top.sorted());
+}
+
+TEST_P(TopK, ZeroKeepsNothing)
+{
+    auto v = random_values<float>(1000);
+
+    perf::top_k<float> top(0);
+    top.push(v);
+    top.push(1.0f);
+
+    ASSERT_EQ(0u, top.size());
+    ASSERT_TRUE(top.sorted().empty());
+}
+
+TEST_P(TopK, NanIsSkipped)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    auto v = random_values<double>(1000);
+    auto with_nan = v;
+    for (size_t i = 0; i < with_nan.size(); i += 7) {
+        with_nan[i] = nan;
+    }
+    with_nan.insert(with_nan.begin(), nan);
+
+    perf::top_k<double> top(20);
+    top.push(with_nan);
+
+    std::vector<double> numbers;
+    std::copy_if(begin(with_nan), end(with_nan), std::back_inserter(numbers), [](double x) { return !std::isnan(x); });
+    ASSERT_EQ(expected_top(numbers, 20), top.sorted());
+}
+
+TEST_P(TopK, StreamInPiecesAndMergePartialResults)
+{
+    auto v = random_values<int64_t>(200000);
+
+    perf::top_k<int64_t> streamed(500);
+    std::vector<perf::top_k<int64_t>> partial(4, perf::top_k<int64_t>(500));
+    for (size_t i = 0; i < v.size(); i += 1234) {
+        size_t n = std::min<size_t>(1234, v.size() - i);
+        streamed.push(v.data() + i, n);
+        partial[i % 4].push(v.data() + i, n);
+    }
+    for (size_t p = 1; p < partial.size(); ++p) {
+        partial[0].merge(partial[p]);
+    }
+
+    ASSERT_EQ(expected_top(v, 500), streamed.sorted());
+    ASSERT_EQ(expected_top(v, 500), partial[0].sorted());
+}
+
+TEST_P(TopK, RecordsByScore)
+{
+    auto scores = random_values<double>(10000);
+    auto by_score = [](const record& a, const record& b) { return a.score < b.score; };
+    perf::top_k<record, decltype(by_score)> top(5, by_score);
+    for (size_t i = 0; i < scores.size(); ++i) {
+        top.push(record{ scores[i], static_cast<int>(i) });
+    }
+
+    auto best = top.sorted();
+    auto expected = expected_top(scores, 5);
+    ASSERT_EQ(5u, best.size());
+    for (size_t i = 0; i < best.size(); ++i) {
+        ASSERT_EQ(expected[i], best[i].score);
+        ASSERT_EQ(expected[i], scores[best[i].id]);
+    }
+}
+
+TEST_F(ParallelSelection, ParallelTopKMatchesSort)
+{
+    auto v = random_values<float>(1000003);
+
+    ASSERT_EQ(expected_top(v, 1000), perf::parallel_top_k(v.data(), v.size(), 1000, std::less<float>(), 10000));
+    ASSERT_EQ(expected_top(v, 10, std::greater<>()), perf::parallel_top_k(v.data(), v.size(), 10, std::greater<>(), 10000));
+    ASSERT_EQ(expected_top(v, 3), perf::parallel_top_k(v, 3));
+}
+
+TEST_F(ParallelSelection, NthElementMatchesSort)
+{
+    auto v = random_values<int32_t>(200003);
+
+    for (size_t nth : { size_t(0), size_t(1), size_t(777), v.size() / 2, v.size() - 2, v.size() - 1 }) {
+        expect_nth_element(v, nth);
+        expect_nth_element(v, nth, std::greater<>());
+    }
+}
+
+TEST_F(ParallelSelection, NthElementKeepsNoScratchAfterTheCall)
+{
+    auto v = random_values<int32_t>(200003);
+    expect_nth_element(v, v.size() / 2);
+    ASSERT_EQ(0u, perf::detail::partition_scratch<int32_t>().capacity());
+}
+
+TEST_F(ParallelSelection, NthElementOfSortedAndRepeatedValues)
+{
+    std::vector<double> sorted(150000);
+    std::iota(begin(sorted), end(sorted), 0.0);
+    expect_nth_element(sorted, 100000);
+    std::reverse(begin(sorted), end(sorted));
+    expect_nth_element(sorted, 100000);
+
+    expect_nth_element(random_values<int64_t>(150000, 3), 50000);
+    expect_nth_element(std::vector<int>(150000, 42), 70000);
+}
+
+TEST_F(ParallelSelection, NthElementOutOfRangeDoesNothing)
+{
+    auto v = random_values<int>(100);
+    auto copy = v;
+
+    perf::parallel_nth_element(v, v.size());
+
+    ASSERT_EQ(copy, v);
+}
+
+TEST_F(ParallelSelection, NthElementOfStrings)
+{
+    std::vector<std::string> v;
+    for (int x : random_values<int>(5000)) {
+        v.push_back(std::to_string(x));
+    }
+
+    expect_nth_element(v, 1234);
+}
+
+TEST_F(ParallelSelection, PartialSortMatchesStd)
+{
+    auto v = random_values<int32_t>(300007);
+
+    for (size_t middle : { size_t(0), size_t(1), size_t(1000), size_t(200000), v.size() }) {
+        auto expected = v;
+        std::partial_sort(begin(expected), begin(expected) + middle, end(expected));
+        auto copy = v;
+        perf::parallel_partial_sort(copy.data(), copy.size(), middle, std::less<int32_t>(), 10000);
+
+        ASSERT_TRUE(std::equal(begin(expected), begin(expected) + middle, begin(copy))) << middle;
+        std::sort(begin(copy), end(copy));
+        std::sort(begin(expected), end(expected));
+        ASSERT_EQ(expected, copy) << middle;
+    }
+}
+
+TEST(TopKBenchmark, DISABLED_TopThousand)
+{
+    auto n = bench::size(1 << 27);
+    auto v = random_values<int32_t>(n, 1 << 30);
+    const size_t k = 1000;
+
+    bench::report("std::partial_sort_copy", bench::best_of(3, [&] {
+        std::vector<int32_t> top(k);
+        std::partial_sort_copy(begin(v), end(v), begin(top), end(top), std::greater<int32_t>());
+        bench::keep(top[0]);
+    }), n * sizeof(int32_t));
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* names[] = { "top_k scalar", "top_k sse2", "top_k avx2" };
+        bench::report(names[static_cast<int>(level)], bench::best_of(3, [&] {
+            perf::top_k<int32_t> top(k);
+            top.push(v);
+            bench::keep(top.threshold());
+        }), n * sizeof(int32_t));
+    }
+    bench::report("parallel_top_k", bench::best_of(3, [&] {
+        bench::keep(perf::parallel_top_k(v, k));
+    }), n * sizeof(int32_t));
+}
+
+TEST(TopKBenchmark, DISABLED_NthElement)
+{
+    auto n = bench::size(1 << 26);
+    auto v = random_values<int32_t>(n, 1 << 30);
+    std::vector<int32_t> copy;
+
+    bench::report("std::nth_element", bench::best_of(3, [&] {
+        copy = v;
+        std::nth_element(begin(copy), begin(copy) + n / 2, end(copy));
+        bench::keep(copy[n / 2]);
+    }), n * sizeof(int32_t));
+    bench::report("parallel_nth_element", bench::best_of(3, [&] {
+        copy = v;
+        perf::parallel_nth_element(copy, n / 2);
+        bench::keep(copy[n / 2]);
+    }), n * sizeof(int32_t));
+    bench::report("std::partial_sort 1%", bench::best_of(3, [&] {
+        copy = v;
+        std::partial_sort(begin(copy), begin(copy) + n / 100, end(copy));
+        bench::keep(copy[0]);
+    }), n * sizeof(int32_t));
+    bench::report("parallel_partial_sort 1%", bench::best_of(3, [&] {
+        copy = v;
+        perf::parallel_partial_sort(copy, n / 100);
+        bench::keep(copy[0]);
+    }), n * sizeof(int32_t));
+}
@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Lazy views for C++14.
+//
+// A view is a cheap pair of iterators that compute elements on demand, so
+// a pipeline such as
+//
+//     views::iota(0, n) | views::transform(f) | views::take_while(p)
+//
+// runs as a single loop without materializing anything. Views built from
+// iota and transform keep random access, so std::lower_bound and
+// std::upper_bound on them evaluate only O(log n) elements.
+//
+// Iterators refer to the function objects stored in their view: keep the
+// view alive while its iterators are in use.
+namespace perf {
+namespace views {
+
+    template <typename It>
+    using category_of = typename std::iterator_traits<It>::iterator_category;
+
+    template <typename It>
+    using is_random_access = std::is_base_of<std::random_access_iterator_tag, category_of<It>>;
+
+    // Most derived category both iterators support, capped at forward for
+    // anything below random access
+    template <typename A, typename B>
+    using common_category = std::conditional_t<is_random_access<A>::value && is_random_access<B>::value,
+        std::random_access_iterator_tag, std::forward_iterator_tag>;
+
+    // Every view is an iterator pair
+    template <typename It>
+    struct view_base {
+        using iterator = It;
+
+        It begin() const { return first; }
+        It end() const { return last; }
+        bool empty() const { return first == last; }
+        size_t size() const { return static_cast<size_t>(std::distance(first, last)); }
+        decltype(auto) operator[](ptrdiff_t i) const { return first[i]; }
+
+        It first;
+        It last;
+    };
+
+    // Random access iterator operations in terms of the three that
+    // Derived provides: get(), move(n) and distance_to(other)
+    template <typename Derived, typename Category, typename Reference>
+    struct iterator_facade {
+        using iterator_category = Category;
+        using reference = Reference;
+        using value_type = std::decay_t<Reference>;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+
+        Reference operator*() const { return self().get(); }
+        Reference operator[](difference_type n) const { return (self() + n).get(); }
+
+        Derived& operator++() { return self().move(1), self(); }
+        Derived& operator--() { return self().move(-1), self(); }
+        Derived operator++(int)
+        {
+            Derived old = self();
+            ++*this;
+            return old;
+        }
+        Derived operator--(int)
+        {
+            Derived old = self();
+            --*this;
+            return old;
+        }
+        Derived& operator+=(difference_type n) { return self().move(n), self(); }
+        Derived& operator-=(difference_type n) { return self().move(-n), self(); }
+        Derived operator+(difference_type n) const
+        {
+            Derived it = self();
+            return it += n;
+        }
+        Derived operator-(difference_type n) const
+        {
+            Derived it = self();
+            return it -= n;
+        }
+        friend Derived operator+(difference_type n, const Derived& it) { return it + n; }
+        difference_type operator-(const Derived& other) const { return other.distance_to(self()); }
+
+        bool operator==(const Derived& other) const { return self().equal(other); }
+        bool operator!=(const Derived& other) const { return !self().equal(other); }
+        bool operator<(const Derived& other) const { return self().distance_to(other) > 0; }
+        bool operator>(const Derived& other) const { return other < self(); }
+        bool operator<=(const Derived& other) const { return !(other < self()); }
+        bool operator>=(const Derived& other) const { return !(self() < other); }
+
+    private:
+        Derived& self() { return static_cast<Derived&>(*this); }
+        const Derived& self() const { return static_cast<const Derived&>(*this); }
+    };
+
+    // ---- iota -----------------------------------------------------------
+
+    template <typename Int>
+    struct iota_iterator : iterator_facade<iota_iterator<Int>, std::random_access_iterator_tag, Int> {
+        iota_iterator() = default;
+        explicit iota_iterator(Int value)
+            : value(value)
+        {
+        }
+
+        Int get() const { return value; }
+        void move(ptrdiff_t n) { value = static_cast<Int>(value + n); }
+        ptrdiff_t distance_to(const iota_iterator& other) const { return static_cast<ptrdiff_t>(other.value - value); }
+        bool equal(const iota_iterator& other) const { return value == other.value; }
+
+        Int value = 0;
+    };
+
+    template <typename Int>
+    using iota_view = view_base<iota_iterator<Int>>;
+
+    // first, first + 1, ..., last - 1
+    template <typename Int>
+    iota_view<Int> iota(Int first, Int last)
+    {
+        return { iota_iterator<Int>(first), iota_iterator<Int>(std::max(first, last)) };
+    }
+
+    // ---- transform ------------------------------------------------------
+
+    template <typename It, typename F>
+    struct transform_iterator : iterator_facade<transform_iterator<It, F>, std::conditional_t<is_random_access<It>::value, std::random_access_iterator_tag, std::forward_iterator_tag>,
+                                    decltype(std::declval<const F&>()(*std::declval<It>()))> {
+        transform_iterator() = default;
+        transform_iterator(It it, const F* f)
+            : it(it)
+            , f(f)
+        {
+        }
+
+        decltype(auto) get() const { return (*f)(*it); }
+        void move(ptrdiff_t n)
+        {
+            if (n == 1) {
+                ++it;
+            } else {
+                std::advance(it, n);
+            }
+        }
+        ptrdiff_t distance_to(const transform_iterator& other) const { return other.it - it; }
+        bool equal(const transform_iterator& other) const { return it == other.it; }
+
+        It it;
+        const F* f = nullptr;
+    };
+
+    template <typename View, typename F>
+    struct transform_view : view_base<transform_iterator<typename View::iterator, F>> {
+        transform_view(View base, F f)
+            : base(std::move(base))
+            , f(std::move(f))
+        {
+            reset();
+        }
+        transform_view(const transform_view& other)
+            : base(other.base)
+            , f(other.f)
+        {
+            reset();
+        }
+        transform_view& operator=(const transform_view&) = delete;
+
+    private:
+        void reset()
+        {
+            this->first = { base.begin(), &f };
+            this->last = { base.end(), &f };
+        }
+
+        View base;
+        F f;
+    };
+
+    // f(x) for every x of view
+    template <typename View, typename F>
+    transform_view<View, F> transform(View view, F f)
+    {
+        return { std::move(view), std::move(f) };
+    }
+
+    // ---- filter ---------------------------------------------------------
+
+    template <typename It, typename Pred>
+    struct filter_iterator : iterator_facade<filter_iterator<It, Pred>, std::forward_iterator_tag,
+                                 typename std::iterator_traits<It>::reference> {
+        filter_iterator() = default;
+        filter_iterator(It it, It end, const Pred* pred)
+            : it(it)
+            , end(end)
+            , pred(pred)
+        {
+            skip();
+        }
+
+        decltype(auto) get() const { return *it; }
+        void move(ptrdiff_t)
+        {
+            ++it;
+            skip();
+        }
+        bool equal(const filter_iterator& other) const { return it == other.it; }
+
+        It it;
+        It end;
+        const Pred* pred = nullptr;
+
+    private:
+        void skip()
+        {
+            while (it != end && !(*pred)(*it)) {
+                ++it;
+            }
+        }
+    };
+
+    template <typename View, typename Pred>
+    struct filter_view : view_base<filter_iterator<typename View::iterator, Pred>> {
+        filter_view(View base, Pred pred)
+            : base(std::move(base))
+            , pred(std::move(pred))
+        {
+            reset();
+        }
+        filter_view(const filter_view& other)
+            : base(other.base)
+            , pred(other.pred)
+        {
+            reset();
+        }
+        filter_view& operator=(const filter_view&) = delete;
+
+    private:
+        void reset()
+        {
+            this->first = { base.begin(), base.end(), &pred };
+            this->last = { base.end(), base.end(), &pred };
+        }
+
+        View base;
+        Pred pred;
+    };
+
+    // The elements of view for which pred holds
+    template <typename View, typename Pred>
+    filter_view<View, Pred> filter(View view, Pred pred)
+    {
+        return { std::move(view), std::move(pred) };
+    }
+
+    // ---- take_while -----------------------------------------------------
+
+    // Evaluates every element once: the current value is computed when the
+    // iterator moves and kept until it moves again
+    template <typename It, typename Pred>
+    struct take_while_iterator : iterator_facade<take_while_iterator<It, Pred>, std::forward_iterator_tag,
+                                     const typename std::iterator_traits<It>::value_type&> {
+        using value_type = typename std::iterator_traits<It>::value_type;
+
+        take_while_iterator() = default;
+        take_while_iterator(It it, It end, const Pred* pred)
+            : it(it)
+            , end(end)
+            , pred(pred)
+        {
+            load();
+        }
+
+        const value_type& get() const { return current; }
+        void move(ptrdiff_t)
+        {
+            ++it;
+            load();
+        }
+        // All finished iterators are equal, which makes end() a sentinel
+        bool equal(const take_while_iterator& other) const
+        {
+            return done == other.done && (done || it == other.it);
+        }
+
+        It it;
+        It end;
+        const Pred* pred = nullptr;
+        value_type current{};
+        bool done = true;
+
+    private:
+        void load()
+        {
+            done = it == end;
+            if (!done) {
+                current = *it;
+                done = !(*pred)(current);
+            }
+        }
+    };
+
+    template <typename View, typename Pred>
+    struct take_while_view {
+        using iterator = take_while_iterator<typename View::iterator, Pred>;
+
+        take_while_view(View base, Pred pred)
+            : base(std::move(base))
+            , pred(std::move(pred))
+        {
+        }
+
+        // Evaluates the first element
+        iterator begin() const { return { base.begin(), base.end(), &pred }; }
+        iterator end() const { return {}; }
+        bool empty() const { return begin() == end(); }
+
+    private:
+        View base;
+        Pred pred;
+    };
+
+    // The leading elements of view for which pred holds
+    template <typename View, typename Pred>
+    take_while_view<View, Pred> take_while(View view, Pred pred)
+    {
+        return { std::move(view), std::move(pred) };
+    }
+
+    // ---- zip ------------------------------------------------------------
+
+    template <typename A, typename B>
+    struct zip_iterator : iterator_facade<zip_iterator<A, B>, common_category<A, B>,
+                              std::pair<typename std::iterator_traits<A>::reference, typename std::iterator_traits<B>::reference>> {
+        using reference = std::pair<typename std::iterator_traits<A>::reference, typename std::iterator_traits<B>::reference>;
+
+        zip_iterator() = default;
+        zip_iterator(A a, B b)
+            : a(a)
+            , b(b)
+        {
+        }
+
+        reference get() const { return reference(*a, *b); }
+        void move(ptrdiff_t n)
+        {
+            std::advance(a, n);
+            std::advance(b, n);
+        }
+        ptrdiff_t distance_to(const zip_iterator& other) const { return other.a - a; }
+        // Either side reaching its end ends the zip
+        bool equal(const zip_iterator& other) const { return a == other.a || b == other.b; }
+
+        A a;
+        B b;
+    };
+
+    template <typename A, typename B>
+    using zip_view = view_base<zip_iterator<typename A::iterator, typename B::iterator>>;
+
+    template <typename It>
+    view_base<It> zip_range(It first, It last, std::forward_iterator_tag)
+    {
+        return { first, last };
+    }
+
+    // Random access zips know their length up front
+    template <typename It>
+    view_base<It> zip_range(It first, It last, std::random_access_iterator_tag)
+    {
+        return { first, first + std::min(last.a - first.a, last.b - first.b) };
+    }
+
+    // Pairs (a[i], b[i]) up to the end of the shorter range. Takes views or
+    // containers by reference; they must outlive the zip.
+    template <typename A, typename B>
+    auto zip(A&& a, B&& b)
+    {
+        using It = zip_iterator<decltype(std::begin(a)), decltype(std::begin(b))>;
+        return zip_range(It(std::begin(a), std::begin(b)), It(std::end(a), std::end(b)), category_of<It>());
+    }
+
+    // A container as a view
+    template <typename Container>
+    auto all(Container& c)
+    {
+        return view_base<decltype(std::begin(c))>{ std::begin(c), std::end(c) };
+    }
+
+    // ---- pipes ----------------------------------------------------------
+
+    template <typename F>
+    struct transform_adaptor {
+        F f;
+    };
+    template <typename Pred>
+    struct filter_adaptor {
+        Pred pred;
+    };
+    template <typename Pred>
+    struct take_while_adaptor {
+        Pred pred;
+    };
+
+    template <typename F>
+    transform_adaptor<F> transform(F f)
+    {
+        return { std::move(f) };
+    }
+
+    template <typename Pred>
+    filter_adaptor<Pred> filter(Pred pred)
+    {
+        return { std::move(pred) };
+    }
+
+    template <typename Pred>
+    take_while_adaptor<Pred> take_while(Pred pred)
+    {
+        return { std::move(pred) };
+    }
+
+    template <typename View, typename F>
+    auto operator|(View view, transform_adaptor<F> a)
+    {
+        return transform(std::move(view), std::move(a.f));
+    }
+
+    template <typename View, typename Pred>
+    auto operator|(View view, filter_adaptor<Pred> a)
+    {
+        return filter(std::move(view), std::move(a.pred));
+    }
+
+    template <typename View, typename Pred>
+    auto operator|(View view, take_while_adaptor<Pred> a)
+    {
+        return take_while(std::move(view), std::move(a.pred));
+    }
+
+} // namespace views
+} // namespace perf
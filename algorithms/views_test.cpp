@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "views.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+using namespace perf;
+
+TEST(Views, FindZeroCrossingOfCosine)
+{
+    int evaluations = 0;
+    auto c = views::iota(0, 628300) | views::transform([&](int i) {
+        ++evaluations;
+        return std::cos(i / 100000.0);
+    });
+
+    // Random access: the search only evaluates O(log n) points
+    auto result = std::upper_bound(c.begin(), c.end(), 0.0, std::greater<double>());
+
+    ASSERT_EQ(157080, result - c.begin());
+    ASSERT_GT(25, evaluations);
+}
+
+TEST(Views, FindStopsAtFirstMatch)
+{
+    int evaluations = 0;
+    auto c = views::iota(0, 628300) | views::transform([&](int i) {
+        ++evaluations;
+        return std::cos(i / 100000.0);
+    });
+
+    auto result = std::find_if(c.begin(), c.end(), [](double x) { return x <= 0; });
+
+    ASSERT_EQ(157080, result - c.begin());
+    ASSERT_EQ(157081, evaluations);
+}
+
+TEST(Views, TakeWhileEvaluatesEachElementOnce)
+{
+    int evaluations = 0;
+    auto squares = views::iota(0, 100) | views::transform([&](int i) {
+        ++evaluations;
+        return i * i;
+    }) | views::take_while([](int x) { return x < 50; });
+
+    std::vector<int> result;
+    for (int x : squares) {
+        result.push_back(x);
+    }
+
+    ASSERT_EQ((std::vector<int>{ 0, 1, 4, 9, 16, 25, 36, 49 }), result);
+    ASSERT_EQ(9, evaluations);
+}
+
+TEST(Views, Filter)
+{
+    auto evens = views::iota(0, 10) | views::filter([](int i) { return i % 2 == 0; });
+
+    int sum = std::accumulate(evens.begin(), evens.end(), 0);
+
+    ASSERT_EQ(20, sum);
+}
+
+TEST(Views, Zip)
+{
+    std::vector<int> a{ 1, 2, 3, 4, 5 };
+    std::vector<int> b{ 10, 2, 30, 4 };
+
+    auto pairs = views::zip(a, b);
+    auto equal = std::count_if(pairs.begin(), pairs.end(), [](auto p) { return p.first == p.second; });
+
+    ASSERT_EQ(2, equal);
+    ASSERT_EQ(4u, pairs.size());
+}
+
+TEST(Views, ZipWritesThroughReferences)
+{
+    std::vector<int> a{ 1, 2, 3 };
+    auto index = views::iota(0, 3);
+
+    for (auto p : views::zip(index, a)) {
+        p.second *= p.first;
+    }
+
+    ASSERT_EQ((std::vector<int>{ 0, 2, 6 }), a);
+}
+
+TEST(Views, ComposesOverContainers)
+{
+    std::vector<int> v{ 3, 1, 4, 1, 5, 9, 2, 6 };
+
+    auto doubled = views::all(v) | views::transform([](int x) { return 2 * x; })
+        | views::filter([](int x) { return x > 4; });
+
+    ASSERT_EQ((std::vector<int>{ 6, 8, 10, 18, 12 }), std::vector<int>(doubled.begin(), doubled.end()));
+}
+
+TEST(Views, EmptyRanges)
+{
+    auto none = views::iota(5, 3);
+    auto taken = none | views::take_while([](int) { return true; });
+
+    ASSERT_TRUE(none.empty());
+    ASSERT_TRUE(taken.empty());
+}
+
+TEST(ViewsBenchmark, DISABLED_ZeroCrossing)
+{
+    const int n = 628300;
+    auto materialized = bench::best_of(5, [] {
+        std::vector<double> c(n);
+        std::iota(begin(c), end(c), 0);
+        std::transform(begin(c), end(c), begin(c), [](auto d) { return std::cos(d / 100000.0); });
+        bench::keep(std::upper_bound(begin(c), end(c), 0.0, std::greater<double>()) - begin(c));
+    });
+    auto lazy = bench::best_of(5, [] {
+        auto c = views::iota(0, n) | views::transform([](int i) { return std::cos(i / 100000.0); });
+        bench::keep(std::upper_bound(c.begin(), c.end(), 0.0, std::greater<double>()) - c.begin());
+    });
+    std::printf("materialized %9.3f us\nlazy         %9.3f us\n", materialized * 1e6, lazy * 1e6);
+}
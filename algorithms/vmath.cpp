@@ -0,0 +1,157 @@
+#include "vmath.h"
+
+#include "simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace perf {
+
+namespace {
+
+    enum class math_function {
+        cos,
+        sin,
+        exp,
+        log,
+    };
+
+    template <math_function F>
+    using fn = std::integral_constant<math_function, F>;
+
+    // Largest |x| the sin and cos kernels reduce themselves
+    template <typename T>
+    constexpr T reduction_limit()
+    {
+        return sizeof(T) == 8 ? 1048576 : 8192;
+    }
+
+    // The kernels for scalars and SSE2
+    namespace base {
+#include "vmath_kernels.inc"
+    }
+
+#if PERF_X86
+#pragma GCC push_options
+#pragma GCC target("avx2")
+    namespace avx2 {
+#include "vmath_kernels.inc"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2_fma {
+        inline __m256d fused_mul_add(__m256d a, __m256d b, __m256d c)
+        {
+            return _mm256_fmadd_pd(a, b, c);
+        }
+
+        inline __m256 fused_mul_add(__m256 a, __m256 b, __m256 c)
+        {
+            return _mm256_fmadd_ps(a, b, c);
+        }
+
+#define PERF_VMATH_FUSED
+#include "vmath_kernels.inc"
+#undef PERF_VMATH_FUSED
+    }
+#pragma GCC pop_options
+
+    typedef double double2 __attribute__((vector_size(16)));
+    typedef double double4 __attribute__((vector_size(32)));
+    typedef float float4 __attribute__((vector_size(16)));
+    typedef float float8 __attribute__((vector_size(32)));
+
+    template <typename T>
+    struct vectors;
+
+    template <>
+    struct vectors<double> {
+        using sse2 = double2;
+        using avx2 = double4;
+    };
+
+    template <>
+    struct vectors<float> {
+        using sse2 = float4;
+        using avx2 = float8;
+    };
+
+    bool has_fma()
+    {
+        static const bool fma = __builtin_cpu_supports("fma");
+        return fma;
+    }
+#endif
+
+    template <math_function F, typename T>
+    void dispatch(const T* in, size_t n, T* out, math_mode mode)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            if (mode == math_mode::fast && has_fma()) {
+                avx2_fma::apply<F, typename vectors<T>::avx2>(in, n, out);
+            } else {
+                avx2::apply<F, typename vectors<T>::avx2>(in, n, out);
+            }
+            return;
+        case isa::sse2:
+            base::apply<F, typename vectors<T>::sse2>(in, n, out);
+            return;
+        case isa::scalar:
+            break;
+        }
+#endif
+        (void)mode;
+        base::apply<F, T>(in, n, out);
+    }
+
+} // namespace
+
+void batch_cos(const double* in, size_t n, double* out, math_mode mode)
+{
+    dispatch<math_function::cos>(in, n, out, mode);
+}
+
+void batch_cos(const float* in, size_t n, float* out, math_mode mode)
+{
+    dispatch<math_function::cos>(in, n, out, mode);
+}
+
+void batch_sin(const double* in, size_t n, double* out, math_mode mode)
+{
+    dispatch<math_function::sin>(in, n, out, mode);
+}
+
+void batch_sin(const float* in, size_t n, float* out, math_mode mode)
+{
+    dispatch<math_function::sin>(in, n, out, mode);
+}
+
+void batch_exp(const double* in, size_t n, double* out, math_mode mode)
+{
+    dispatch<math_function::exp>(in, n, out, mode);
+}
+
+void batch_exp(const float* in, size_t n, float* out, math_mode mode)
+{
+    dispatch<math_function::exp>(in, n, out, mode);
+}
+
+void batch_log(const double* in, size_t n, double* out, math_mode mode)
+{
+    dispatch<math_function::log>(in, n, out, mode);
+}
+
+void batch_log(const float* in, size_t n, float* out, math_mode mode)
+{
+    dispatch<math_function::log>(in, n, out, mode);
+}
+
+} // namespace perf
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Elementary functions over whole arrays: out[i] = f(in[i]).
+//
+// The kernels evaluate polynomials in SIMD registers after reducing the
+// argument to a short interval, so one call costs a few nanoseconds or
+// less per element instead of a libm call each. in and out may be the
+// same array.
+//
+// Largest errors against the correctly rounded result, in units in the
+// last place. The float ones were measured over every float, the double
+// ones over millions of arguments, including the hard cases next
+// to multiples of pi/2:
+//
+//              double     float
+//     cos      0.77 ulp   1.02 ulp   |x| <= 2^20 (double), 8192 (float)
+//     sin      0.79 ulp   1.02 ulp   likewise
+//     exp      0.99 ulp   1.01 ulp
+//     log      0.82 ulp   0.86 ulp
+//
+// Larger arguments of cos and sin go to std::cos and std::sin lane by
+// lane. inf and NaN arguments give the same results as the <cmath>
+// functions, and exp and log handle overflow, underflow to subnormals
+// and zero the same way too.
+namespace perf {
+
+enum class math_mode {
+    // Uses fused multiply-add where the CPU has it
+    fast,
+    // Bitwise the same results on every instruction set, so that the
+    // output does not depend on the machine or on limit_isa(): the
+    // kernels do the same IEEE operations in the same order on every
+    // lane width and never fuse a multiply and an add. Arguments that
+    // fall back to <cmath> are as reproducible as the C library.
+    reproducible,
+};
+
+void batch_cos(const double* in, size_t n, double* out, math_mode mode = math_mode::fast);
+void batch_cos(const float* in, size_t n, float* out, math_mode mode = math_mode::fast);
+void batch_sin(const double* in, size_t n, double* out, math_mode mode = math_mode::fast);
+void batch_sin(const float* in, size_t n, float* out, math_mode mode = math_mode::fast);
+void batch_exp(const double* in, size_t n, double* out, math_mode mode = math_mode::fast);
+void batch_exp(const float* in, size_t n, float* out, math_mode mode = math_mode::fast);
+void batch_log(const double* in, size_t n, double* out, math_mode mode = math_mode::fast);
+void batch_log(const float* in, size_t n, float* out, math_mode mode = math_mode::fast);
+
+template <typename T>
+std::vector<T> batch_cos(const std::vector<T>& v, math_mode mode = math_mode::fast)
+{
+    std::vector<T> out(v.size());
+    batch_cos(v.data(), v.size(), out.data(), mode);
+    return out;
+}
+
+template <typename T>
+std::vector<T> batch_sin(const std::vector<T>& v, math_mode mode = math_mode::fast)
+{
+    std::vector<T> out(v.size());
+    batch_sin(v.data(), v.size(), out.data(), mode);
+    return out;
+}
+
+template <typename T>
+std::vector<T> batch_exp(const std::vector<T>& v, math_mode mode = math_mode::fast)
+{
+    std::vector<T> out(v.size());
+    batch_exp(v.data(), v.size(), out.data(), mode);
+    return out;
+}
+
+template <typename T>
+std::vector<T> batch_log(const std::vector<T>& v, math_mode mode = math_mode::fast)
+{
+    std::vector<T> out(v.size());
+    batch_log(v.data(), v.size(), out.data(), mode);
+    return out;
+}
+
+} // namespace perf
@@ -0,0 +1,278 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "simd.h"
+#include "test_support.h"
+#include "vmath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+template <typename T>
+std::vector<T> uniform(double lo, double hi, size_t n, unsigned seed = 3)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    std::vector<T> v(n);
+    std::generate(begin(v), end(v), [&] { return static_cast<T>(dist(rng)); });
+    return v;
+}
+
+// Spread evenly over the exponents from lo to hi
+template <typename T>
+std::vector<T> log_uniform(double lo, double hi, size_t n, unsigned seed = 4)
+{
+    auto v = uniform<T>(std::log(lo), std::log(hi), n, seed);
+    std::transform(begin(v), end(v), begin(v), [](T x) { return static_cast<T>(std::exp(static_cast<double>(x))); });
+    return v;
+}
+
+// Distance of x from the exact value in units in the last place of T
+template <typename T>
+double ulps(T x, long double exact)
+{
+    T rounded = static_cast<T>(exact);
+    if (std::isnan(x) || std::isnan(rounded) || std::isinf(x) || std::isinf(rounded)) {
+        bool same = std::isnan(x) ? std::isnan(rounded) : x == rounded;
+        return same ? 0 : std::numeric_limits<double>::infinity();
+    }
+    int exponent = 0;
+    std::frexp(rounded, &exponent);
+    exponent = std::max(exponent, std::numeric_limits<T>::min_exponent);
+    long double ulp = std::ldexp(1.0L, exponent - std::numeric_limits<T>::digits);
+    return static_cast<double>(std::fabs(x - exact) / ulp);
+}
+
+template <typename T, typename F, typename Exact>
+double max_ulps(F f, const std::vector<T>& in, Exact exact, perf::math_mode mode = perf::math_mode::fast)
+{
+    std::vector<T> out(in.size());
+    f(in.data(), in.size(), out.data(), mode);
+    double worst = 0;
+    for (size_t i = 0; i < in.size(); ++i) {
+        worst = std::max(worst, ulps(out[i], exact(static_cast<long double>(in[i]))));
+    }
+    return worst;
+}
+
+template <typename T>
+bool same_bits(const std::vector<T>& a, const std::vector<T>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    // memcmp wants valid pointers even for no bytes
+    return a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+long double exact_cos(long double x) { return std::cos(x); }
+long double exact_sin(long double x) { return std::sin(x); }
+long double exact_exp(long double x) { return std::exp(x); }
+long double exact_log(long double x) { return std::log(x); }
+
+void (*const cos_double)(const double*, size_t, double*, perf::math_mode) = perf::batch_cos;
+void (*const sin_double)(const double*, size_t, double*, perf::math_mode) = perf::batch_sin;
+void (*const exp_double)(const double*, size_t, double*, perf::math_mode) = perf::batch_exp;
+void (*const log_double)(const double*, size_t, double*, perf::math_mode) = perf::batch_log;
+void (*const cos_float)(const float*, size_t, float*, perf::math_mode) = perf::batch_cos;
+void (*const sin_float)(const float*, size_t, float*, perf::math_mode) = perf::batch_sin;
+void (*const exp_float)(const float*, size_t, float*, perf::math_mode) = perf::batch_exp;
+void (*const log_float)(const float*, size_t, float*, perf::math_mode) = perf::batch_log;
+
+class Vmath : public test_support::isa_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, Vmath,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(Vmath, ComputeCosineOfAllElements)
+{
+    std::vector<double> v{ 0, M_PI / 3, M_PI, -M_PI / 2, 10 };
+
+    auto c = perf::batch_cos(v);
+
+    ASSERT_EQ(1.0, c[0]);
+    ASSERT_NEAR(0.5, c[1], 1e-15);
+    ASSERT_EQ(-1.0, c[2]);
+    ASSERT_NEAR(0.0, c[3], 1e-15);
+    ASSERT_NEAR(std::cos(10.0), c[4], 1e-15);
+}
+
+TEST_P(Vmath, DoubleWithinOneUlp)
+{
+    const size_t n = 100003;
+    for (auto mode : { perf::math_mode::fast, perf::math_mode::reproducible }) {
+        ASSERT_GT(1.0, max_ulps(cos_double, uniform<double>(-4, 4, n), exact_cos, mode));
+        ASSERT_GT(1.0, max_ulps(sin_double, uniform<double>(-4, 4, n), exact_sin, mode));
+        ASSERT_GT(1.0, max_ulps(cos_double, uniform<double>(-1048576, 1048576, n), exact_cos, mode));
+        ASSERT_GT(1.0, max_ulps(sin_double, log_uniform<double>(1e-300, 1048576, n), exact_sin, mode));
+        ASSERT_GT(1.0, max_ulps(exp_double, uniform<double>(-746, 710, n), exact_exp, mode));
+        ASSERT_GT(1.0, max_ulps(exp_double, uniform<double>(-1, 1, n), exact_exp, mode));
+        ASSERT_GT(1.0, max_ulps(log_double, log_uniform<double>(1e-320, 1e308, n), exact_log, mode));
+        ASSERT_GT(1.0, max_ulps(log_double, uniform<double>(0.5, 2, n), exact_log, mode));
+    }
+}
+
+TEST_P(Vmath, FloatWithinOneUlp)
+{
+    const size_t n = 100003;
+    for (auto mode : { perf::math_mode::fast, perf::math_mode::reproducible }) {
+        ASSERT_GT(1.1, max_ulps(cos_float, uniform<float>(-4, 4, n), exact_cos, mode));
+        ASSERT_GT(1.1, max_ulps(sin_float, uniform<float>(-4, 4, n), exact_sin, mode));
+        ASSERT_GT(1.1, max_ulps(cos_float, uniform<float>(-8192, 8192, n), exact_cos, mode));
+        ASSERT_GT(1.1, max_ulps(sin_float, log_uniform<float>(1e-30, 8192, n), exact_sin, mode));
+        ASSERT_GT(1.1, max_ulps(exp_float, uniform<float>(-104, 89, n), exact_exp, mode));
+        ASSERT_GT(1.1, max_ulps(log_float, log_uniform<float>(1e-45, 3e38, n), exact_log, mode));
+    }
+}
+
+TEST_P(Vmath, CloseToMultiplesOfHalfPi)
+{
+    std::vector<double> d;
+    std::vector<float> f;
+    for (int k = 1; k < 600000; k += 1 + k / 100) {
+        double x = k * M_PI_2;
+        d.insert(end(d), { x, std::nextafter(x, 0.0), std::nextafter(x, 1e9) });
+        if (x < 8192) {
+            float y = static_cast<float>(x);
+            f.insert(end(f), { y, std::nextafter(y, 0.0f), std::nextafter(y, 1e9f) });
+        }
+    }
+
+    ASSERT_GT(1.0, max_ulps(sin_double, d, exact_sin));
+    ASSERT_GT(1.0, max_ulps(cos_double, d, exact_cos));
+    ASSERT_GT(1.0, max_ulps(sin_float, f, exact_sin));
+    ASSERT_GT(1.0, max_ulps(cos_float, f, exact_cos));
+}
+
+TEST_P(Vmath, SpecialValuesLikeCmath)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> v{ 0.0, -0.0, inf, -inf, nan, 1e-310, -1e-310, 1e300, -5e15, 709.8, -745.2, -740, 1 };
+
+    auto c = perf::batch_cos(v);
+    auto s = perf::batch_sin(v);
+    auto e = perf::batch_exp(v);
+    auto l = perf::batch_log(v);
+
+    for (size_t i = 0; i < v.size(); ++i) {
+        ASSERT_GT(1.0, ulps(c[i], exact_cos(v[i]))) << v[i];
+        ASSERT_GT(1.0, ulps(s[i], exact_sin(v[i]))) << v[i];
+        ASSERT_GT(1.0, ulps(e[i], exact_exp(v[i]))) << v[i];
+        ASSERT_GT(1.0, ulps(l[i], exact_log(v[i]))) << v[i];
+        ASSERT_EQ(std::signbit(std::sin(v[i])), std::signbit(s[i])) << v[i];
+    }
+    ASSERT_EQ(-inf, l[0]);
+    ASSERT_EQ(-inf, l[1]);
+    ASSERT_TRUE(std::isnan(l[6]));
+    ASSERT_EQ(0.0, e[10]);
+    ASSERT_EQ(inf, e[9]);
+
+    std::vector<float> f{ 0.0f, -0.0f, 1e-40f, 1e30f, 88.8f, -104, -100, -1, std::nanf("") };
+    auto cf = perf::batch_cos(f);
+    auto sf = perf::batch_sin(f);
+    auto ef = perf::batch_exp(f);
+    auto lf = perf::batch_log(f);
+    for (size_t i = 0; i < f.size(); ++i) {
+        ASSERT_GT(1.0, ulps(cf[i], exact_cos(f[i]))) << f[i];
+        ASSERT_GT(1.0, ulps(sf[i], exact_sin(f[i]))) << f[i];
+        ASSERT_GT(1.0, ulps(ef[i], exact_exp(f[i]))) << f[i];
+        ASSERT_GT(1.0, ulps(lf[i], exact_log(f[i]))) << f[i];
+    }
+}
+
+TEST_P(Vmath, InPlaceAndTails)
+{
+    for (size_t n : { 0, 1, 3, 4, 5, 7, 8, 9, 17 }) {
+        auto v = uniform<float>(-3, 3, n);
+        auto expected = perf::batch_exp(v);
+
+        perf::batch_exp(v.data(), n, v.data());
+
+        ASSERT_TRUE(same_bits(expected, v));
+    }
+}
+
+TEST(Vmath, ReproducibleOnEveryInstructionSet)
+{
+    auto d = uniform<double>(-1e4, 1e4, 1001);
+    auto f = uniform<float>(-1e3, 1e3, 1001);
+    auto positive_d = log_uniform<double>(1e-300, 1e300, 1001);
+    auto positive_f = log_uniform<float>(1e-40, 1e38, 1001);
+    const auto mode = perf::math_mode::reproducible;
+
+    perf::limit_isa(perf::isa::scalar);
+    auto cos_d = perf::batch_cos(d, mode);
+    auto sin_f = perf::batch_sin(f, mode);
+    auto exp_d = perf::batch_exp(d, mode);
+    auto exp_f = perf::batch_exp(f, mode);
+    auto log_d = perf::batch_log(positive_d, mode);
+    auto log_f = perf::batch_log(positive_f, mode);
+    for (auto level : { perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        ASSERT_TRUE(same_bits(cos_d, perf::batch_cos(d, mode)));
+        ASSERT_TRUE(same_bits(sin_f, perf::batch_sin(f, mode)));
+        ASSERT_TRUE(same_bits(exp_d, perf::batch_exp(d, mode)));
+        ASSERT_TRUE(same_bits(exp_f, perf::batch_exp(f, mode)));
+        ASSERT_TRUE(same_bits(log_d, perf::batch_log(positive_d, mode)));
+        ASSERT_TRUE(same_bits(log_f, perf::batch_log(positive_f, mode)));
+    }
+    perf::limit_isa(perf::isa::avx2);
+}
+
+TEST(VmathBenchmark, DISABLED_CosExpLog)
+{
+    auto n = bench::size(1 << 22);
+    auto d = uniform<double>(-100, 100, n);
+    auto f = uniform<float>(-100, 100, n);
+    std::vector<double> out(n);
+    std::vector<float> out_f(n);
+
+    bench::report("std::cos double", bench::best_of(3, [&] {
+        std::transform(begin(d), end(d), begin(out), [](double x) { return std::cos(x); });
+        bench::keep(out[0]);
+    }), n * sizeof(double));
+    bench::report("std::exp double", bench::best_of(3, [&] {
+        std::transform(begin(d), end(d), begin(out), [](double x) { return std::exp(x); });
+        bench::keep(out[0]);
+    }), n * sizeof(double));
+    bench::report("std::cos float", bench::best_of(3, [&] {
+        std::transform(begin(f), end(f), begin(out_f), [](float x) { return std::cos(x); });
+        bench::keep(out_f[0]);
+    }), n * sizeof(float));
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        const char* isa_names[] = { "scalar", "sse2", "avx2" };
+        std::printf("%s\n", isa_names[static_cast<int>(level)]);
+        for (auto mode : { perf::math_mode::fast, perf::math_mode::reproducible }) {
+            const char* mode_name = mode == perf::math_mode::fast ? "fast" : "reproducible";
+            std::printf("  %s\n", mode_name);
+            bench::report("    batch_cos double", bench::best_of(3, [&] {
+                perf::batch_cos(d.data(), n, out.data(), mode);
+                bench::keep(out[0]);
+            }), n * sizeof(double));
+            bench::report("    batch_exp double", bench::best_of(3, [&] {
+                perf::batch_exp(d.data(), n, out.data(), mode);
+                bench::keep(out[0]);
+            }), n * sizeof(double));
+            bench::report("    batch_log double", bench::best_of(3, [&] {
+                perf::batch_log(d.data(), n, out.data(), mode);
+                bench::keep(out[0]);
+            }), n * sizeof(double));
+            bench::report("    batch_cos float", bench::best_of(3, [&] {
+                perf::batch_cos(f.data(), n, out_f.data(), mode);
+                bench::keep(out_f[0]);
+            }), n * sizeof(float));
+        }
+    }
+    perf::limit_isa(perf::isa::avx2);
+}
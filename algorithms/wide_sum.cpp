@@ -0,0 +1,396 @@
+#include "wide_sum.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace perf {
+
+namespace {
+
+    using int128 = __int128;
+
+    // Elements between flushes of the scalar int64_t sums into the total,
+    // and SIMD steps between flushes of the 64-bit lanes
+    constexpr size_t block = size_t(1) << 16;
+    // Steps a 32-bit lane takes pmaddwd results of up to 2^16 without
+    // overflowing
+    constexpr size_t lane_steps = size_t(1) << 14;
+
+    constexpr int64_t offset = int64_t(1) << 31;
+
+    template <typename T>
+    int128 sum_scalar(const T* v, size_t n)
+    {
+        int128 total = 0;
+        for (size_t i = 0; i < n; i += block) {
+            size_t end = std::min(n, i + block);
+            int64_t sum = 0;
+            for (size_t j = i; j < end; ++j) {
+                sum += v[j];
+            }
+            total += sum;
+        }
+        return total;
+    }
+
+    template <typename T>
+    int128 dot_scalar(const T* a, const T* b, size_t n)
+    {
+        // Products of int32_t take up to 62 bits, so a few of them overflow
+        // an int64_t
+        using sum_type = typename std::conditional<sizeof(T) < 4, int64_t, int128>::type;
+        int128 total = 0;
+        for (size_t i = 0; i < n; i += block) {
+            size_t end = std::min(n, i + block);
+            sum_type sum = 0;
+            for (size_t j = i; j < end; ++j) {
+                sum += static_cast<int64_t>(a[j]) * b[j];
+            }
+            total += sum;
+        }
+        return total;
+    }
+
+#if PERF_X86
+    // The kernels take `steps` times the elements of one step, at most
+    // `block` steps, and return their exact sum. They add what fits in a
+    // lane into 64-bit lanes that are flushed once per call.
+
+    inline int128 unsigned_lanes(__m128i x)
+    {
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), x);
+        return static_cast<int128>(lanes[0]) + lanes[1];
+    }
+
+    PERF_AVX2 inline int128 unsigned_lanes(__m256i x)
+    {
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), x);
+        return static_cast<int128>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    inline int64_t signed_lanes32(__m128i x)
+    {
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), x);
+        return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    PERF_AVX2 inline int64_t signed_lanes32(__m256i x)
+    {
+        return signed_lanes32(_mm256_castsi256_si128(x)) + signed_lanes32(_mm256_extracti128_si256(x, 1));
+    }
+
+    // Adds the unsigned 32-bit lanes of u to the 64-bit lanes of low (even
+    // lanes) and high (odd lanes)
+    inline void widen(__m128i u, __m128i& low, __m128i& high)
+    {
+        low = _mm_add_epi64(low, _mm_and_si128(u, _mm_set1_epi64x(0xffffffff)));
+        high = _mm_add_epi64(high, _mm_srli_epi64(u, 32));
+    }
+
+    PERF_AVX2 inline void widen(__m256i u, __m256i& low, __m256i& high)
+    {
+        low = _mm256_add_epi64(low, _mm256_and_si256(u, _mm256_set1_epi64x(0xffffffff)));
+        high = _mm256_add_epi64(high, _mm256_srli_epi64(u, 32));
+    }
+
+    // int8_t + 128 is a byte from 0 to 255, and psadbw adds eight of them
+    // into a 64-bit lane
+    int128 sum_sse2(const int8_t* v, size_t steps)
+    {
+        const __m128i flip = _mm_set1_epi8(-128);
+        __m128i acc = _mm_setzero_si128();
+        for (size_t s = 0; s < steps; ++s) {
+            __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + 16 * s)), flip);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(x, _mm_setzero_si128()));
+        }
+        return unsigned_lanes(acc) - static_cast<int128>(steps) * 16 * 128;
+    }
+
+    PERF_AVX2 int128 sum_avx2(const int8_t* v, size_t steps)
+    {
+        const __m256i flip = _mm256_set1_epi8(-128);
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t s = 0; s < steps; ++s) {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + 32 * s)), flip);
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(x, _mm256_setzero_si256()));
+        }
+        return unsigned_lanes(acc) - static_cast<int128>(steps) * 32 * 128;
+    }
+
+    // pmaddwd with ones adds pairs into 32-bit lanes
+    int128 sum_sse2(const int16_t* v, size_t steps)
+    {
+        const __m128i ones = _mm_set1_epi16(1);
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += lane_steps) {
+            size_t end = std::min(steps, s + lane_steps);
+            __m128i acc = _mm_setzero_si128();
+            for (size_t i = s; i < end; ++i) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + 8 * i));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(x, ones));
+            }
+            total += signed_lanes32(acc);
+        }
+        return total;
+    }
+
+    PERF_AVX2 int128 sum_avx2(const int16_t* v, size_t steps)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += lane_steps) {
+            size_t end = std::min(steps, s + lane_steps);
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t i = s; i < end; ++i) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + 16 * i));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, ones));
+            }
+            total += signed_lanes32(acc);
+        }
+        return total;
+    }
+
+    // int32_t + 2^31 is unsigned
+    int128 sum_sse2(const int32_t* v, size_t steps)
+    {
+        const __m128i flip = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        for (size_t s = 0; s < steps; ++s) {
+            widen(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + 4 * s)), flip), low, high);
+        }
+        return unsigned_lanes(low) + unsigned_lanes(high) - static_cast<int128>(steps) * 4 * offset;
+    }
+
+    PERF_AVX2 int128 sum_avx2(const int32_t* v, size_t steps)
+    {
+        const __m256i flip = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        for (size_t s = 0; s < steps; ++s) {
+            widen(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + 8 * s)), flip), low, high);
+        }
+        return unsigned_lanes(low) + unsigned_lanes(high) - static_cast<int128>(steps) * 8 * offset;
+    }
+
+    // Bytes sign extended to int16_t, then pmaddwd: pairs of products of
+    // up to 2^14 each
+    inline __m128i madd_bytes(__m128i a, __m128i b, bool high)
+    {
+        __m128i a16 = high ? _mm_unpackhi_epi8(a, a) : _mm_unpacklo_epi8(a, a);
+        __m128i b16 = high ? _mm_unpackhi_epi8(b, b) : _mm_unpacklo_epi8(b, b);
+        return _mm_madd_epi16(_mm_srai_epi16(a16, 8), _mm_srai_epi16(b16, 8));
+    }
+
+    int128 dot_sse2(const int8_t* a, const int8_t* b, size_t steps)
+    {
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += lane_steps) {
+            size_t end = std::min(steps, s + lane_steps);
+            __m128i acc = _mm_setzero_si128();
+            for (size_t i = s; i < end; ++i) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16 * i));
+                __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16 * i));
+                acc = _mm_add_epi32(acc, _mm_add_epi32(madd_bytes(x, y, false), madd_bytes(x, y, true)));
+            }
+            total += signed_lanes32(acc);
+        }
+        return total;
+    }
+
+    PERF_AVX2 int128 dot_avx2(const int8_t* a, const int8_t* b, size_t steps)
+    {
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += lane_steps) {
+            size_t end = std::min(steps, s + lane_steps);
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t i = s; i < end; ++i) {
+                auto x = reinterpret_cast<const __m128i*>(a + 32 * i);
+                auto y = reinterpret_cast<const __m128i*>(b + 32 * i);
+                __m256i low = _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128(x)), _mm256_cvtepi8_epi16(_mm_loadu_si128(y)));
+                __m256i high = _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128(x + 1)), _mm256_cvtepi8_epi16(_mm_loadu_si128(y + 1)));
+                acc = _mm256_add_epi32(acc, _mm256_add_epi32(low, high));
+            }
+            total += signed_lanes32(acc);
+        }
+        return total;
+    }
+
+    // A pair of int16_t products is from -2^31 + 2^16 to 2^31; the single
+    // overflow, 2^31, wraps to -2^31. Adding 2^31 - 1 makes every pair an
+    // unsigned 32-bit number.
+    int128 dot_sse2(const int16_t* a, const int16_t* b, size_t steps)
+    {
+        const __m128i bias = _mm_set1_epi32(offset - 1);
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        for (size_t s = 0; s < steps; ++s) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 8 * s));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 8 * s));
+            widen(_mm_add_epi32(_mm_madd_epi16(x, y), bias), low, high);
+        }
+        return unsigned_lanes(low) + unsigned_lanes(high) - static_cast<int128>(steps) * 4 * (offset - 1);
+    }
+
+    PERF_AVX2 int128 dot_avx2(const int16_t* a, const int16_t* b, size_t steps)
+    {
+        const __m256i bias = _mm256_set1_epi32(offset - 1);
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        for (size_t s = 0; s < steps; ++s) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 16 * s));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 16 * s));
+            widen(_mm256_add_epi32(_mm256_madd_epi16(x, y), bias), low, high);
+        }
+        return unsigned_lanes(low) + unsigned_lanes(high) - static_cast<int128>(steps) * 8 * (offset - 1);
+    }
+
+    // 64-bit products are split into their unsigned low 32 bits and their
+    // signed high 32 bits plus 2^31. SSE2 only multiplies unsigned numbers:
+    // a signed product is the unsigned one minus 2^32 b if a < 0 and minus
+    // 2^32 a if b < 0, which only changes the high half.
+    int128 dot_sse2(const int32_t* a, const int32_t* b, size_t steps)
+    {
+        const __m128i low_half = _mm_set1_epi64x(0xffffffff);
+        const __m128i flip = _mm_set1_epi64x(offset);
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        for (size_t s = 0; s < steps; ++s) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 4 * s));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 4 * s));
+            __m128i even = _mm_mul_epu32(x, y);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+            __m128i sign = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(x, 31), y), _mm_and_si128(_mm_srai_epi32(y, 31), x));
+            __m128i even_high = _mm_sub_epi32(_mm_srli_epi64(even, 32), _mm_and_si128(sign, low_half));
+            __m128i odd_high = _mm_sub_epi32(_mm_srli_epi64(odd, 32), _mm_srli_epi64(sign, 32));
+            low = _mm_add_epi64(low, _mm_add_epi64(_mm_and_si128(even, low_half), _mm_and_si128(odd, low_half)));
+            high = _mm_add_epi64(high, _mm_add_epi64(_mm_xor_si128(even_high, flip), _mm_xor_si128(odd_high, flip)));
+        }
+        int128 high_sum = unsigned_lanes(high) - static_cast<int128>(steps) * 4 * offset;
+        return unsigned_lanes(low) + high_sum * (int128(1) << 32);
+    }
+
+    PERF_AVX2 int128 dot_avx2(const int32_t* a, const int32_t* b, size_t steps)
+    {
+        const __m256i low_half = _mm256_set1_epi64x(0xffffffff);
+        const __m256i flip = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        for (size_t s = 0; s < steps; ++s) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 8 * s));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 8 * s));
+            __m256i even = _mm256_mul_epi32(x, y);
+            __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+            low = _mm256_add_epi64(low, _mm256_add_epi64(_mm256_and_si256(even, low_half), _mm256_and_si256(odd, low_half)));
+            high = _mm256_add_epi64(high,
+                _mm256_add_epi64(_mm256_srli_epi64(_mm256_xor_si256(even, flip), 32), _mm256_srli_epi64(_mm256_xor_si256(odd, flip), 32)));
+        }
+        int128 high_sum = unsigned_lanes(high) - static_cast<int128>(steps) * 8 * offset;
+        return unsigned_lanes(low) + high_sum * (int128(1) << 32);
+    }
+
+    // Runs Kernel over blocks of whole steps of Width elements and the
+    // scalar code over the rest
+    template <size_t Width, typename T, int128 (*Kernel)(const T*, size_t)>
+    int128 sum_blocks(const T* v, size_t n)
+    {
+        size_t steps = n / Width;
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += block) {
+            total += Kernel(v + s * Width, std::min(block, steps - s));
+        }
+        return total + sum_scalar(v + steps * Width, n - steps * Width);
+    }
+
+    template <size_t Width, typename T, int128 (*Kernel)(const T*, const T*, size_t)>
+    int128 dot_blocks(const T* a, const T* b, size_t n)
+    {
+        size_t steps = n / Width;
+        int128 total = 0;
+        for (size_t s = 0; s < steps; s += block) {
+            total += Kernel(a + s * Width, b + s * Width, std::min(block, steps - s));
+        }
+        return total + dot_scalar(a + steps * Width, b + steps * Width, n - steps * Width);
+    }
+#endif
+
+    template <typename T>
+    int128 exact_sum(const T* v, size_t n)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return sum_blocks<32 / sizeof(T), T, sum_avx2>(v, n);
+        case isa::sse2:
+            return sum_blocks<16 / sizeof(T), T, sum_sse2>(v, n);
+        case isa::scalar:
+            break;
+        }
+#endif
+        return sum_scalar(v, n);
+    }
+
+    template <typename T>
+    int128 exact_dot(const T* a, const T* b, size_t n)
+    {
+#if PERF_X86
+        switch (active_isa()) {
+        case isa::avx2:
+            return dot_blocks<32 / sizeof(T), T, dot_avx2>(a, b, n);
+        case isa::sse2:
+            return dot_blocks<16 / sizeof(T), T, dot_sse2>(a, b, n);
+        case isa::scalar:
+            break;
+        }
+#endif
+        return dot_scalar(a, b, n);
+    }
+
+    int64_t narrow(int128 total, overflow_mode mode, const char* what)
+    {
+        if (mode == overflow_mode::check
+            && (total < std::numeric_limits<int64_t>::min() || total > std::numeric_limits<int64_t>::max())) {
+            throw std::out_of_range(what);
+        }
+        return static_cast<int64_t>(static_cast<uint64_t>(total));
+    }
+
+} // namespace
+
+int64_t wide_sum(const int8_t* v, size_t n, overflow_mode mode)
+{
+    return narrow(exact_sum(v, n), mode, "wide_sum: the sum does not fit int64_t");
+}
+
+int64_t wide_sum(const int16_t* v, size_t n, overflow_mode mode)
+{
+    return narrow(exact_sum(v, n), mode, "wide_sum: the sum does not fit int64_t");
+}
+
+int64_t wide_sum(const int32_t* v, size_t n, overflow_mode mode)
+{
+    return narrow(exact_sum(v, n), mode, "wide_sum: the sum does not fit int64_t");
+}
+
+int64_t wide_dot(const int8_t* a, const int8_t* b, size_t n, overflow_mode mode)
+{
+    return narrow(exact_dot(a, b, n), mode, "wide_dot: the dot product does not fit int64_t");
+}
+
+int64_t wide_dot(const int16_t* a, const int16_t* b, size_t n, overflow_mode mode)
+{
+    return narrow(exact_dot(a, b, n), mode, "wide_dot: the dot product does not fit int64_t");
+}
+
+int64_t wide_dot(const int32_t* a, const int32_t* b, size_t n, overflow_mode mode)
+{
+    return narrow(exact_dot(a, b, n), mode, "wide_dot: the dot product does not fit int64_t");
+}
+
+} // namespace perf
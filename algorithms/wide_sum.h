@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Sums and dot products of int8_t, int16_t and int32_t arrays as int64_t,
+// where std::accumulate and std::inner_product into an int overflow
+// without a word once the data grows.
+//
+// The SIMD kernels add narrow elements into wider lanes: int8_t sums with
+// psadbw straight into 64-bit lanes; int16_t sums and int8_t products
+// pairwise with pmaddwd into 32-bit lanes, which are flushed before they
+// could overflow; int32_t elements and int16_t products are offset by
+// 2^31 to be unsigned and split into two 64-bit lanes; int32_t products
+// into their low and high 32 bits in separate 64-bit lanes. Every 2^16
+// steps the lanes go into a 128-bit total, so the sum is exact however
+// long the array is, and the kernels keep up with the wrapping int32_t
+// ones.
+//
+// Results that do not fit int64_t, in practice only dot products of
+// large int32_t values, wrap around by default or throw
+// std::out_of_range with overflow_mode::check.
+namespace perf {
+
+enum class overflow_mode {
+    // The result modulo 2^64, as a two's complement int64_t
+    wrap,
+    // Throws std::out_of_range instead of wrapping
+    check,
+};
+
+int64_t wide_sum(const int8_t* v, size_t n, overflow_mode mode = overflow_mode::wrap);
+int64_t wide_sum(const int16_t* v, size_t n, overflow_mode mode = overflow_mode::wrap);
+int64_t wide_sum(const int32_t* v, size_t n, overflow_mode mode = overflow_mode::wrap);
+
+int64_t wide_dot(const int8_t* a, const int8_t* b, size_t n, overflow_mode mode = overflow_mode::wrap);
+int64_t wide_dot(const int16_t* a, const int16_t* b, size_t n, overflow_mode mode = overflow_mode::wrap);
+int64_t wide_dot(const int32_t* a, const int32_t* b, size_t n, overflow_mode mode = overflow_mode::wrap);
+
+template <typename T>
+int64_t wide_sum(const std::vector<T>& v, overflow_mode mode = overflow_mode::wrap)
+{
+    return wide_sum(v.data(), v.size(), mode);
+}
+
+template <typename T>
+int64_t wide_dot(const std::vector<T>& a, const std::vector<T>& b, overflow_mode mode = overflow_mode::wrap)
+{
+    if (a.size() != b.size()) {
+        throw std::invalid_argument("wide_dot: vectors differ in length");
+    }
+    return wide_dot(a.data(), b.data(), a.size(), mode);
+}
+
+} // namespace perf
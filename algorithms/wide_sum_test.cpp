@@ -0,0 +1,217 @@
+#include "gtest/gtest.h"
+
+#include "benchmark.h"
+#include "simd.h"
+#include "test_support.h"
+#include "wide_sum.h"
+
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using int128 = __int128;
+
+// n values drawn from every value T can hold
+template <typename T>
+std::vector<T> full_range_values(size_t n, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<int64_t> dist(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+    std::vector<T> v(n);
+    for (auto& x : v) {
+        x = static_cast<T>(dist(rng));
+    }
+    return v;
+}
+
+template <typename T>
+int128 exact_sum(const std::vector<T>& v)
+{
+    int128 sum = 0;
+    for (T x : v) {
+        sum += x;
+    }
+    return sum;
+}
+
+template <typename T>
+int128 exact_dot(const std::vector<T>& a, const std::vector<T>& b)
+{
+    int128 sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += static_cast<int128>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+template <typename T>
+void expect_exact(size_t n, std::mt19937_64& rng)
+{
+    auto a = full_range_values<T>(n, rng);
+    auto b = full_range_values<T>(n, rng);
+
+    ASSERT_EQ(static_cast<int64_t>(exact_sum(a)), perf::wide_sum(a)) << n;
+    ASSERT_EQ(static_cast<int64_t>(exact_dot(a, b)), perf::wide_dot(a, b)) << n;
+}
+
+// Every element the smallest or the largest value: the lanes fill up as
+// fast as they can
+template <typename T>
+void expect_exact_at_limits(size_t n)
+{
+    std::vector<T> low(n, std::numeric_limits<T>::min());
+    std::vector<T> high(n, std::numeric_limits<T>::max());
+
+    ASSERT_EQ(static_cast<int64_t>(exact_sum(low)), perf::wide_sum(low, perf::overflow_mode::check)) << n;
+    ASSERT_EQ(static_cast<int64_t>(exact_sum(high)), perf::wide_sum(high, perf::overflow_mode::check)) << n;
+    if (sizeof(T) < 4) {
+        ASSERT_EQ(static_cast<int64_t>(exact_dot(low, low)), perf::wide_dot(low, low, perf::overflow_mode::check)) << n;
+        ASSERT_EQ(static_cast<int64_t>(exact_dot(low, high)), perf::wide_dot(low, high, perf::overflow_mode::check)) << n;
+    }
+}
+
+class WideSum : public test_support::isa_fixture {
+};
+
+} // namespace
+
+INSTANTIATE_TEST_CASE_P(Isa, WideSum,
+    ::testing::Values(perf::isa::scalar, perf::isa::sse2, perf::isa::avx2));
+
+TEST_P(WideSum, SumDoesNotOverflowLikeInt)
+{
+    std::vector<int> v(10, std::numeric_limits<int>::max());
+
+    ASSERT_EQ(int64_t(10) * std::numeric_limits<int>::max(), perf::wide_sum(v));
+}
+
+TEST_P(WideSum, InnerProductDoesNotOverflowLikeInt)
+{
+    std::vector<int> a{ 100000, -200000, 300000 };
+    std::vector<int> b{ 400000, 500000, -600000 };
+
+    ASSERT_EQ(int64_t(-240000000000), perf::wide_dot(a, b));
+}
+
+TEST_P(WideSum, RandomValues)
+{
+    std::mt19937_64 rng(7);
+    for (size_t n = 0; n < 100; ++n) {
+        expect_exact<int8_t>(n, rng);
+        expect_exact<int16_t>(n, rng);
+        expect_exact<int32_t>(n, rng);
+    }
+    for (size_t n : { 1000, 4099, 65537 }) {
+        expect_exact<int8_t>(n, rng);
+        expect_exact<int16_t>(n, rng);
+        expect_exact<int32_t>(n, rng);
+    }
+}
+
+TEST_P(WideSum, LimitsAcrossLaneFlushes)
+{
+    for (size_t n : { 1, 33, 1000 }) {
+        expect_exact_at_limits<int8_t>(n);
+        expect_exact_at_limits<int16_t>(n);
+        expect_exact_at_limits<int32_t>(n);
+    }
+    // Several flushes of the 32-bit lanes and of the 64-bit lanes
+    expect_exact_at_limits<int16_t>(600003);
+    expect_exact_at_limits<int8_t>(2100003);
+    expect_exact_at_limits<int32_t>(1100003);
+}
+
+TEST_P(WideSum, PairsOfInt16ProductsOverflowingPmaddwd)
+{
+    // -32768 * -32768 twice is 2^31, one more than an int32_t holds
+    std::vector<int16_t> v(1001, std::numeric_limits<int16_t>::min());
+
+    ASSERT_EQ(int64_t(1001) << 30, perf::wide_dot(v, v));
+}
+
+TEST_P(WideSum, Int32Products)
+{
+    const int32_t min = std::numeric_limits<int32_t>::min();
+    const int32_t max = std::numeric_limits<int32_t>::max();
+    std::vector<int32_t> a{ min, max, min, -1, 0, max, min, 1, 12345, -54321 };
+    std::vector<int32_t> b{ max, min, 7, min, min, -1, 3, max, -99999, 77777 };
+
+    // Wraps around, like the products of the extremes do
+    ASSERT_EQ(static_cast<int64_t>(static_cast<uint64_t>(exact_dot(a, b))), perf::wide_dot(a, b));
+    a = { min, -1, 0, max, min, 1, 12345, 3, 5 };
+    b = { max, min, min, -1, 7, max, -99999, min, -5 };
+    ASSERT_EQ(static_cast<int64_t>(exact_dot(a, b)), perf::wide_dot(a, b, perf::overflow_mode::check));
+}
+
+TEST_P(WideSum, CheckedModeThrowsOnOverflow)
+{
+    const int32_t min = std::numeric_limits<int32_t>::min();
+    // 2^62 twice is 2^63
+    std::vector<int32_t> a(2, min);
+    std::vector<int32_t> b(17, min);
+    std::vector<int32_t> c(17, std::numeric_limits<int32_t>::max());
+    // -2^62 + 2^31 twice still fits
+    std::vector<int32_t> d(2, std::numeric_limits<int32_t>::max());
+
+    ASSERT_THROW(perf::wide_dot(a, a, perf::overflow_mode::check), std::out_of_range);
+    ASSERT_EQ(std::numeric_limits<int64_t>::min(), perf::wide_dot(a, a));
+    ASSERT_THROW(perf::wide_dot(b, b, perf::overflow_mode::check), std::out_of_range);
+    ASSERT_EQ(static_cast<int64_t>(static_cast<uint64_t>(exact_dot(b, b))), perf::wide_dot(b, b));
+    ASSERT_THROW(perf::wide_dot(b, c, perf::overflow_mode::check), std::out_of_range);
+    ASSERT_EQ(static_cast<int64_t>(exact_dot(a, d)), perf::wide_dot(a, d, perf::overflow_mode::check));
+}
+
+TEST(WideSum, VectorsOfDifferentLength)
+{
+    std::vector<int16_t> a(3);
+    std::vector<int16_t> b(4);
+
+    ASSERT_THROW(perf::wide_dot(a, b), std::invalid_argument);
+}
+
+TEST(WideSumBenchmark, DISABLED_SumsAndDotProducts)
+{
+    std::mt19937_64 rng(9);
+    auto n = bench::size(1 << 24);
+    auto a32 = full_range_values<int32_t>(n, rng);
+    auto b32 = full_range_values<int32_t>(n, rng);
+    auto a16 = full_range_values<int16_t>(n, rng);
+    auto b16 = full_range_values<int16_t>(n, rng);
+    auto a8 = full_range_values<int8_t>(n, rng);
+    auto b8 = full_range_values<int8_t>(n, rng);
+
+    bench::report("std::accumulate int32 into int", bench::best_of(5, [&] {
+        bench::keep(std::accumulate(begin(a32), end(a32), 0));
+    }), n * sizeof(int32_t));
+    bench::report("std::inner_product int32 into int", bench::best_of(5, [&] {
+        bench::keep(std::inner_product(begin(a32), end(a32), begin(b32), 0));
+    }), 2 * n * sizeof(int32_t));
+    for (auto level : { perf::isa::scalar, perf::isa::sse2, perf::isa::avx2 }) {
+        perf::limit_isa(level);
+        std::string name = level == perf::isa::avx2 ? " avx2" : level == perf::isa::sse2 ? " sse2" : " scalar";
+        bench::report(("wide_sum int8" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_sum(a8));
+        }), n * sizeof(int8_t));
+        bench::report(("wide_sum int16" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_sum(a16));
+        }), n * sizeof(int16_t));
+        bench::report(("wide_sum int32" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_sum(a32));
+        }), n * sizeof(int32_t));
+        bench::report(("wide_dot int8" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_dot(a8, b8));
+        }), 2 * n * sizeof(int8_t));
+        bench::report(("wide_dot int16" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_dot(a16, b16));
+        }), 2 * n * sizeof(int16_t));
+        bench::report(("wide_dot int32" + name).c_str(), bench::best_of(5, [&] {
+            bench::keep(perf::wide_dot(a32, b32));
+        }), 2 * n * sizeof(int32_t));
+    }
+    perf::limit_isa(perf::isa::avx2);
+}